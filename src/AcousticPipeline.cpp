@@ -0,0 +1,332 @@
+#include <algorithm>
+#include <iostream>
+#include <numeric>
+
+#include "AcousticPipeline.h"
+#include "HashUtil.hpp"
+#include "Inference/InferenceUtils.hpp"
+
+namespace diffsinger {
+
+    AcousticPipeline::AcousticPipeline(const DsConfig &config)
+            : m_config(config),
+              m_acousticInference(config.acoustic, config.acousticData),
+              m_denoiserInference(config.denoiser, config.denoiserData),
+              m_sampler(config.timesteps, config.maxBeta),
+              m_rng(std::random_device{}()) {}
+
+    bool AcousticPipeline::initSessions(ExecutionProvider ep, int deviceIndex, const SessionConfig &sessionConfig) {
+        if (!m_acousticInference.initSession(ep, deviceIndex, sessionConfig)) {
+            return false;
+        }
+
+        bool isEncoder = m_acousticInference.getModelFlags().check(AcousticModelFlags::SplitDiffusion);
+        if (isEncoder != !m_config.denoiser.empty()) {
+            std::cout << (isEncoder
+                          ? "ERROR: The acoustic model is the encoder of a split model, but no denoiser is configured.\n"
+                          : "ERROR: A denoiser is configured, but the acoustic model is not the encoder of a split model.\n");
+            m_acousticInference.endSession();
+            return false;
+        }
+        if (isEncoder && (m_config.specMin.empty() || m_config.specMax.empty())) {
+            std::cout << "ERROR: spec_min and spec_max must not be empty for split acoustic models.\n";
+            m_acousticInference.endSession();
+            return false;
+        }
+        if (isEncoder) {
+            std::cout << "Initializing denoiser inference session...\n";
+            if (!m_denoiserInference.initSession(ep, deviceIndex, sessionConfig)) {
+                m_acousticInference.endSession();
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void AcousticPipeline::endSessions() {
+        m_acousticInference.endSession();
+        m_denoiserInference.endSession();
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_encoderCache.clear();
+        m_encoderCacheOrder.clear();
+        m_encoderCacheBytes = 0;
+    }
+
+    void AcousticPipeline::setWarmupSettings(const AcousticInferenceSettings &inferSettings) {
+        m_acousticInference.setWarmupSettings(inferSettings);
+    }
+
+    void AcousticPipeline::setEncoderCacheLimit(size_t bytes) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_encoderCacheLimit = bytes;
+        trimEncoderCache();
+    }
+
+    void AcousticPipeline::printModelFeatures() {
+        m_acousticInference.printModelFeatures();
+    }
+
+    AcousticModelFlags AcousticPipeline::getModelFlags() const {
+        return m_acousticInference.getModelFlags();
+    }
+
+    bool AcousticPipeline::isSplitModel() const {
+        return m_acousticInference.getModelFlags().check(AcousticModelFlags::SplitDiffusion);
+    }
+
+    uint64_t AcousticPipeline::getModelHash() const {
+        return Hasher()
+                .updateValue(m_acousticInference.getModelHash())
+                .updateValue(m_denoiserInference.getModelHash())
+                .digest();
+    }
+
+    bool AcousticPipeline::canBatch() const {
+        return isSplitModel() && m_denoiserInference.canBatch();
+    }
+
+    std::vector<Ort::Value> AcousticPipeline::inferBatch(const std::vector<const PreprocessedData *> &inputs,
+                                                         const AcousticInferenceSettings &inferSettings) {
+        std::vector<Ort::Value> out;
+        out.reserve(inputs.size());
+
+        if (!isSplitModel()) {
+            for (const auto *pd : inputs) {
+                out.push_back(m_acousticInference.inferToOrtValue(*pd, inferSettings));
+            }
+            return out;
+        }
+
+        std::vector<std::shared_ptr<const AcousticEncodedData>> encoded;
+        encoded.reserve(inputs.size());
+        for (const auto *pd : inputs) {
+            encoded.push_back(encode(*pd));
+        }
+
+        // Failed segments are left out of the batch.
+        std::vector<size_t> batchIndices;
+        std::vector<std::shared_ptr<const AcousticEncodedData>> batch;
+        for (size_t i = 0; i < encoded.size(); ++i) {
+            out.emplace_back(nullptr);
+            if (encoded[i]) {
+                batchIndices.push_back(i);
+                batch.push_back(encoded[i]);
+            }
+        }
+        if (batch.empty()) {
+            return out;
+        }
+
+        if (batch.size() == 1 || !m_denoiserInference.canBatch()) {
+            for (size_t k = 0; k < batch.size(); ++k) {
+                auto mels = denoiseBatch({batch[k]}, inferSettings);
+                if (!mels.empty()) {
+                    out[batchIndices[k]] = std::move(mels[0]);
+                }
+            }
+            return out;
+        }
+
+        // Shortest first, and a new group wherever the length grows too much, to limit the padded frames.
+        constexpr double maxLengthRatio = 1.25;
+        std::vector<size_t> order(batch.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(),
+                         [&batch](size_t a, size_t b) { return batch[a]->frames < batch[b]->frames; });
+        size_t groupStart = 0;
+        while (groupStart < order.size()) {
+            auto groupEnd = groupStart + 1;
+            auto maxFrames = static_cast<double>(batch[order[groupStart]]->frames) * maxLengthRatio;
+            while (groupEnd < order.size() && static_cast<double>(batch[order[groupEnd]]->frames) <= maxFrames) {
+                ++groupEnd;
+            }
+            std::vector<std::shared_ptr<const AcousticEncodedData>> group;
+            for (auto k = groupStart; k < groupEnd; ++k) {
+                group.push_back(batch[order[k]]);
+            }
+            auto mels = denoiseBatch(group, inferSettings);
+            for (size_t k = 0; k < mels.size(); ++k) {
+                out[batchIndices[order[groupStart + k]]] = std::move(mels[k]);
+            }
+            groupStart = groupEnd;
+        }
+        return out;
+    }
+
+    std::shared_ptr<const AcousticEncodedData> AcousticPipeline::encode(const PreprocessedData &pd) {
+        auto key = encoderCacheKey(pd);
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto it = m_encoderCache.find(key);
+            if (it != m_encoderCache.end()) {
+                m_encoderCacheOrder.splice(m_encoderCacheOrder.begin(), m_encoderCacheOrder, it->second.position);
+                return it->second.encoded;
+            }
+        }
+
+        auto outputTensors = m_acousticInference.inferEncoder(pd);
+        if (outputTensors.empty()) {
+            return nullptr;
+        }
+
+        // condition: [1, frames, hidden]
+        auto conditionShape = outputTensors[0].GetTensorTypeAndShapeInfo().GetShape();
+        if (conditionShape.size() != 3 || conditionShape[1] <= 0 || conditionShape[2] <= 0) {
+            std::cout << "ERROR: The encoder output has an unexpected shape.\n";
+            return nullptr;
+        }
+
+        auto encoded = std::make_shared<AcousticEncodedData>();
+        encoded->frames = conditionShape[1];
+        encoded->hidden_size = conditionShape[2];
+        encoded->condition = AcousticInference::ortValueToVector(outputTensors[0]);
+        if (outputTensors.size() > 1) {
+            encoded->aux_mel = AcousticInference::ortValueToVector(outputTensors[1]);
+        }
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_encoderCache.find(key) == m_encoderCache.end()) {
+            m_encoderCacheOrder.push_front(key);
+            m_encoderCache.emplace(key, EncoderCacheEntry{encoded, m_encoderCacheOrder.begin()});
+            m_encoderCacheBytes += encodedBytes(*encoded);
+            trimEncoderCache();
+        }
+        return encoded;
+    }
+
+    size_t AcousticPipeline::encodedBytes(const AcousticEncodedData &encoded) {
+        return (encoded.condition.size() + encoded.aux_mel.size()) * sizeof(float);
+    }
+
+    void AcousticPipeline::trimEncoderCache() {
+        while (m_encoderCacheBytes > m_encoderCacheLimit && !m_encoderCacheOrder.empty()) {
+            auto it = m_encoderCache.find(m_encoderCacheOrder.back());
+            m_encoderCacheBytes -= encodedBytes(*it->second.encoded);
+            m_encoderCache.erase(it);
+            m_encoderCacheOrder.pop_back();
+        }
+    }
+
+    uint64_t AcousticPipeline::encoderCacheKey(const PreprocessedData &pd) {
+        return Hasher()
+                .update(pd.tokens)
+                .update(pd.durations)
+                .update(pd.f0)
+                .update(pd.velocity)
+                .update(pd.gender)
+                .update(pd.spk_embed)
+                .update(pd.energy)
+                .update(pd.breathiness)
+                .digest();
+    }
+
+    std::vector<Ort::Value> AcousticPipeline::denoiseBatch(
+            const std::vector<std::shared_ptr<const AcousticEncodedData>> &encoded,
+            const AcousticInferenceSettings &inferSettings) {
+        auto batchSize = static_cast<int64_t>(encoded.size());
+        auto hiddenSize = encoded[0]->hidden_size;
+        int64_t maxFrames = 0;
+        for (const auto &item : encoded) {
+            if (item->hidden_size != hiddenSize) {
+                std::cout << "ERROR: Encoder outputs of the batch have different hidden sizes.\n";
+                return {};
+            }
+            maxFrames = std::max(maxFrames, item->frames);
+        }
+
+        // Shallow diffusion starts from the auxiliary mel diffused to `depth`, instead of pure noise.
+        bool isShallow = std::all_of(encoded.begin(), encoded.end(),
+                                     [](const auto &item) { return !item->aux_mel.empty(); });
+        auto numMelBins = isShallow
+                          ? static_cast<int64_t>(encoded[0]->aux_mel.size()) / encoded[0]->frames
+                          : m_denoiserInference.getNumMelBins();
+        auto depth = isShallow
+                     ? std::clamp(inferSettings.depth, 1, m_sampler.getTimesteps())
+                     : m_sampler.getTimesteps();
+
+        std::vector<float> cond(batchSize * maxFrames * hiddenSize, 0.0f);
+        std::vector<float> x(batchSize * maxFrames * numMelBins, 0.0f);
+        for (int64_t b = 0; b < batchSize; ++b) {
+            const auto &item = *encoded[b];
+            auto condBegin = cond.begin() + b * maxFrames * hiddenSize;
+            std::copy(item.condition.begin(), item.condition.end(), condBegin);
+            // Padded frames repeat the last frame, which disturbs the end of the segment less than zeros.
+            for (auto frame = item.frames; frame < maxFrames; ++frame) {
+                std::copy(condBegin + (item.frames - 1) * hiddenSize, condBegin + item.frames * hiddenSize,
+                          condBegin + frame * hiddenSize);
+            }
+            if (isShallow) {
+                // The same for the auxiliary mel, whose zero frames would be out of range once normalized.
+                auto auxFrames = std::min(static_cast<int64_t>(item.aux_mel.size()) / numMelBins, item.frames);
+                auto xBegin = x.begin() + b * maxFrames * numMelBins;
+                std::copy(item.aux_mel.begin(), item.aux_mel.begin() + auxFrames * numMelBins, xBegin);
+                for (auto frame = auxFrames; auxFrames > 0 && frame < maxFrames; ++frame) {
+                    std::copy(xBegin + (auxFrames - 1) * numMelBins, xBegin + auxFrames * numMelBins,
+                              xBegin + frame * numMelBins);
+                }
+            }
+        }
+
+        if (isShallow) {
+            normalizeMel(x, numMelBins);
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_sampler.addNoise(x, depth - 1, m_rng);
+        } else {
+            std::normal_distribution<float> normal;
+            std::lock_guard<std::mutex> lock(m_mutex);
+            for (auto &value : x) {
+                value = normal(m_rng);
+            }
+        }
+
+        auto denoise = [this, &cond, batchSize, maxFrames](const std::vector<float> &sample, int64_t t,
+                                                           std::vector<float> &noise) {
+            try {
+                noise = m_denoiserInference.denoise(sample, t, cond, batchSize, maxFrames);
+                return true;
+            }
+            catch (const Ort::Exception &ortException) {
+                printOrtError(ortException);
+            }
+            return false;
+        };
+        if (!m_sampler.sample(x, depth, inferSettings.speedup, inferSettings.sampler, denoise)) {
+            std::cout << "ERROR: Denoiser failed.\n";
+            return {};
+        }
+        denormalizeMel(x, numMelBins);
+
+        std::vector<Ort::Value> mels;
+        mels.reserve(encoded.size());
+        for (int64_t b = 0; b < batchSize; ++b) {
+            auto frames = encoded[b]->frames;
+            auto rowBegin = x.begin() + b * maxFrames * numMelBins;
+            std::vector<float> mel(rowBegin, rowBegin + frames * numMelBins);
+            mels.push_back(vectorToTensorWithShape<float, float>(mel, {1, frames, numMelBins}));
+        }
+        return mels;
+    }
+
+    void AcousticPipeline::normalizeMel(std::vector<float> &mel, int64_t numMelBins) const {
+        const auto &specMin = m_config.specMin;
+        const auto &specMax = m_config.specMax;
+        for (size_t i = 0; i < mel.size(); ++i) {
+            auto bin = static_cast<size_t>(i % numMelBins);
+            auto minValue = specMin[specMin.size() == 1 ? 0 : std::min(bin, specMin.size() - 1)];
+            auto maxValue = specMax[specMax.size() == 1 ? 0 : std::min(bin, specMax.size() - 1)];
+            mel[i] = (mel[i] - minValue) / (maxValue - minValue) * 2 - 1;
+        }
+    }
+
+    void AcousticPipeline::denormalizeMel(std::vector<float> &mel, int64_t numMelBins) const {
+        const auto &specMin = m_config.specMin;
+        const auto &specMax = m_config.specMax;
+        for (size_t i = 0; i < mel.size(); ++i) {
+            auto bin = static_cast<size_t>(i % numMelBins);
+            auto minValue = specMin[specMin.size() == 1 ? 0 : std::min(bin, specMin.size() - 1)];
+            auto maxValue = specMax[specMax.size() == 1 ? 0 : std::min(bin, specMax.size() - 1)];
+            mel[i] = (mel[i] + 1) / 2 * (maxValue - minValue) + minValue;
+        }
+    }
+
+}  // namespace diffsinger
@@ -0,0 +1,115 @@
+#ifndef DS_ONNX_INFER_ACOUSTICPIPELINE_H
+#define DS_ONNX_INFER_ACOUSTICPIPELINE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+#include "DsConfig.h"
+#include "ModelData.h"
+#include "Inference/AcousticInference.h"
+#include "Inference/DenoiserInference.h"
+#include "Inference/DiffusionSampler.h"
+
+namespace diffsinger {
+
+    /**
+     * @brief Renders mel spectrograms with the acoustic model of a voicebank.
+     *
+     * Whole acoustic models run the diffusion loop inside the graph. Split models (`denoiser` in the config)
+     * export the encoder and a single denoising step separately, and the loop runs here with the selected
+     * sampler. For split models, encoder outputs are cached per segment, so changing speedup, depth or the
+     * sampler only runs the denoiser again, and the denoising steps of a batch of segments run in one call.
+     *
+     * `inferBatch` may be called from several threads at once. The config must outlive the pipeline.
+     */
+    class AcousticPipeline {
+    public:
+        explicit AcousticPipeline(const DsConfig &config);
+
+        bool initSessions(ExecutionProvider ep = ExecutionProvider::CPU, int deviceIndex = 0,
+                          const SessionConfig &sessionConfig = {});
+
+        void endSessions();
+
+        void setWarmupSettings(const AcousticInferenceSettings &inferSettings);
+
+        /**
+         * @brief Limits the memory of the cached encoder outputs; the least recently used ones are dropped first.
+         */
+        void setEncoderCacheLimit(size_t bytes);
+
+        void printModelFeatures();
+
+        AcousticModelFlags getModelFlags() const;
+
+        bool isSplitModel() const;
+
+        /**
+         * @brief Hash of the acoustic (and denoiser) model bytes, identifying the models in cache keys.
+         */
+        uint64_t getModelHash() const;
+
+        /**
+         * @return Whether several segments can be rendered in one batch (split models with a dynamic batch axis).
+         */
+        bool canBatch() const;
+
+        /**
+         * @brief Renders the mel spectrograms [1, frames, mel_bins] of the segments.
+         *
+         * Segments are denoised in groups of similar lengths (at most 25% longer than the shortest), padded to the
+         * longest one by repeating their last frame, in the condition and in the auxiliary mel of shallow diffusion.
+         * The denoiser's receptive field spans about 150 frames, so the last frames of the shorter segments of a
+         * group can differ slightly from an unbatched render.
+         *
+         * @return The mels in the order of `inputs`. Failed items are empty values.
+         */
+        std::vector<Ort::Value> inferBatch(const std::vector<const PreprocessedData *> &inputs,
+                                           const AcousticInferenceSettings &inferSettings);
+
+    private:
+        const DsConfig &m_config;
+        AcousticInference m_acousticInference;
+        DenoiserInference m_denoiserInference;
+        DiffusionSampler m_sampler;
+        std::mt19937 m_rng;
+
+        // Guards the random generator and the encoder cache; the sessions themselves can be run concurrently.
+        std::mutex m_mutex;
+
+        // Encoder outputs of split models, keyed by the hash of the acoustic inputs, most recently used first.
+        struct EncoderCacheEntry {
+            std::shared_ptr<const AcousticEncodedData> encoded;
+            std::list<uint64_t>::iterator position;
+        };
+        std::unordered_map<uint64_t, EncoderCacheEntry> m_encoderCache;
+        std::list<uint64_t> m_encoderCacheOrder;
+        size_t m_encoderCacheBytes = 0;
+        size_t m_encoderCacheLimit = 256 * 1024 * 1024;
+
+        static size_t encodedBytes(const AcousticEncodedData &encoded);
+
+        void trimEncoderCache();
+
+        std::shared_ptr<const AcousticEncodedData> encode(const PreprocessedData &pd);
+
+        static uint64_t encoderCacheKey(const PreprocessedData &pd);
+
+        std::vector<Ort::Value> denoiseBatch(const std::vector<std::shared_ptr<const AcousticEncodedData>> &encoded,
+                                             const AcousticInferenceSettings &inferSettings);
+
+        // Maps mel values from/to the [-1, 1] range the denoiser works in.
+        void normalizeMel(std::vector<float> &mel, int64_t numMelBins) const;
+
+        void denormalizeMel(std::vector<float> &mel, int64_t numMelBins) const;
+    };  // class AcousticPipeline
+
+}  // namespace diffsinger
+
+#endif //DS_ONNX_INFER_ACOUSTICPIPELINE_H
@@ -0,0 +1,270 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Autotune.h"
+#include "AcousticPipeline.h"
+#include "PowerManagement.h"
+#include "ThreadPool.h"
+#include "TuningProfile.h"
+#include "Inference/InferenceUtils.hpp"
+#include "Inference/VocoderInference.h"
+
+namespace diffsinger {
+
+    bool autotuneSessions(const RenderSettings &settings, int numSampleJobs) {
+        DsConfig dsConfig;
+        DsVocoderConfig vocoderConfig;
+        bool hasVocoder = false;
+        if (!loadConfigs(settings, dsConfig, vocoderConfig, hasVocoder)) {
+            return false;
+        }
+        if (!hasVocoder) {
+            std::cout << "!! ERROR: --vocoder-config is required because no vocoder is packed in the bundle.\n";
+            return false;
+        }
+        auto speedup = settings.acousticSpeedup;
+        auto depth = settings.shallowDiffusionDepth;
+        if (!resolveDiffusionSettings(dsConfig, speedup, depth)) {
+            return false;
+        }
+        AcousticInferenceSettings inferSettings{};
+        inferSettings.speedup = speedup;
+        inferSettings.depth = depth;
+        inferSettings.sampler = settings.sampler;
+
+        // The first jobs with audio are the sample every candidate renders.
+        auto dsProject = loadDsProject(settings.dsFilePath, settings.spkMixStr);
+        auto renderPlan = RenderPlan::fromSegments(dsProject, settings.renderPlanOptions);
+        JobPreparer jobPreparer(dsConfig, jobPrepareOptions(settings), vocoderConfig.sampleRate,
+                                vocoderConfig.hopSize);
+        std::vector<PreparedJob> sampleJobs;
+        for (const auto &job : renderPlan.jobs) {
+            if (sampleJobs.size() >= static_cast<size_t>(numSampleJobs)) {
+                break;
+            }
+            PreparedJob prepared;
+            auto status = jobPreparer.prepare(job, prepared);
+            if (status == JobPreparer::Status::Failed) {
+                return false;
+            }
+            if (status == JobPreparer::Status::Ready) {
+                sampleJobs.push_back(std::move(prepared));
+            }
+        }
+        if (sampleJobs.empty()) {
+            std::cout << "!! ERROR: The project has nothing to render.\n";
+            return false;
+        }
+
+        keepSystemAwake();
+
+        auto hardwareThreads = static_cast<int>(std::max(std::thread::hardware_concurrency(), 1u));
+        std::vector<int> threadCounts;
+        for (int threads = 1; threads < hardwareThreads; threads *= 2) {
+            threadCounts.push_back(threads);
+        }
+        threadCounts.push_back(hardwareThreads);
+
+        auto secondsSince = [](std::chrono::steady_clock::time_point start) {
+            return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        };
+
+        // Every candidate gets new sessions, renders the first job once untimed, then renders the sample.
+        // Times are in seconds, negative on failure.
+        // The vocoder consumes the mel tensors it is given, so the sample mels are kept as values, and every vocoder
+        // call gets a new tensor of them.
+        struct SampleMel {
+            std::vector<float> values;
+            std::vector<int64_t> shape;
+        };
+        std::vector<SampleMel> sampleMels;
+        auto sampleMelTensors = [&sampleMels](size_t i) {
+            std::vector<Ort::Value> mels;
+            mels.push_back(vectorToTensorWithShape<float>(sampleMels[i].values, sampleMels[i].shape));
+            return mels;
+        };
+        auto timeAcoustic = [&](const SessionConfig &config) {
+            AcousticPipeline acousticPipeline(dsConfig);
+            if (!acousticPipeline.initSessions(settings.ep, settings.deviceIndex, config)) {
+                return -1.0;
+            }
+            try {
+                acousticPipeline.inferBatch({&sampleJobs[0].pd}, inferSettings);
+                std::vector<std::vector<Ort::Value>> mels;
+                auto start = std::chrono::steady_clock::now();
+                for (const auto &prepared : sampleJobs) {
+                    mels.push_back(acousticPipeline.inferBatch({&prepared.pd}, inferSettings));
+                    if (mels.back().empty() || mels.back()[0] == Ort::Value(nullptr)) {
+                        return -1.0;
+                    }
+                }
+                auto seconds = secondsSince(start);
+                // The vocoder candidates are fed the mels of the first acoustic candidate.
+                if (sampleMels.empty()) {
+                    for (const auto &mel : mels) {
+                        auto info = mel[0].GetTensorTypeAndShapeInfo();
+                        auto buffer = mel[0].GetTensorData<float>();
+                        sampleMels.push_back({std::vector<float>(buffer, buffer + info.GetElementCount()),
+                                              info.GetShape()});
+                    }
+                }
+                return seconds;
+            }
+            catch (const Ort::Exception &ortException) {
+                printOrtError(ortException);
+                return -1.0;
+            }
+        };
+        auto timeVocoder = [&](const SessionConfig &config) {
+            VocoderInference vocoderInference(vocoderConfig.model, vocoderConfig.modelData);
+            if (!vocoderInference.initSession(ExecutionProvider::CPU, 0, config)) {
+                return -1.0;
+            }
+            try {
+                auto warmupMels = sampleMelTensors(0);
+                vocoderInference.inferBatch(warmupMels, {&sampleJobs[0].pd.f0});
+                double seconds = 0.0;
+                for (size_t i = 0; i < sampleJobs.size(); i++) {
+                    // Only the inference is timed, not the copy of the mel.
+                    auto mels = sampleMelTensors(i);
+                    auto start = std::chrono::steady_clock::now();
+                    auto waveforms = vocoderInference.inferBatch(mels, {&sampleJobs[i].pd.f0});
+                    seconds += secondsSince(start);
+                    if (waveforms.empty() || waveforms[0].empty()) {
+                        return -1.0;
+                    }
+                }
+                return seconds;
+            }
+            catch (const Ort::Exception &ortException) {
+                printOrtError(ortException);
+                return -1.0;
+            }
+        };
+
+        // Threads for a single operator first, then whether running independent operators side by side helps.
+        std::vector<std::string> report;
+        auto tuneSession = [&](const char *name, const auto &timeSession, SessionTuning &best) {
+            double bestSeconds = -1.0;
+            auto tryTuning = [&](const SessionTuning &tuning) {
+                std::cout << "\n>> " << name << ": " << tuning.intraOpThreads << " threads, "
+                          << (tuning.parallelExecution ? "parallel" : "sequential") << '\n';
+                auto seconds = timeSession(tunedSessionConfig(settings.sessionConfig, tuning));
+                if (seconds < 0) {
+                    std::cout << "!! WARNING: The candidate failed.\n";
+                    return;
+                }
+                std::ostringstream line;
+                line << name << ": " << tuning.intraOpThreads << " threads, "
+                     << (tuning.parallelExecution ? "parallel (" + std::to_string(tuning.interOpThreads) + " threads)"
+                                                  : std::string("sequential"))
+                     << ": " << millisecondsToSecondsString(static_cast<long long>(seconds * 1000)) << " seconds";
+                report.push_back(line.str());
+                if (bestSeconds < 0 || seconds < bestSeconds) {
+                    bestSeconds = seconds;
+                    best = tuning;
+                }
+            };
+            for (auto threads : threadCounts) {
+                tryTuning({threads, 0, false});
+            }
+            if (bestSeconds < 0) {
+                return false;
+            }
+            auto intraOpThreads = best.intraOpThreads;
+            for (auto interOpThreads : {2, 4}) {
+                if (interOpThreads <= hardwareThreads) {
+                    tryTuning({intraOpThreads, interOpThreads, true});
+                }
+            }
+            return true;
+        };
+
+        TuningProfile profile;
+        if (!tuneSession("acoustic", timeAcoustic, profile.acoustic)) {
+            std::cout << "!! ERROR: Every acoustic candidate failed.\n";
+            return false;
+        }
+        if (!tuneSession("vocoder", timeVocoder, profile.vocoder)) {
+            std::cout << "!! ERROR: Every vocoder candidate failed.\n";
+            return false;
+        }
+
+        // Batch renders share one session of each model between the workers, which split the cores.
+        auto timeBatch = [&](int numWorkers) {
+            auto config = settings.sessionConfig;
+            config.intraOpThreads = std::max(hardwareThreads / numWorkers, 1);
+            AcousticPipeline acousticPipeline(dsConfig);
+            VocoderInference vocoderInference(vocoderConfig.model, vocoderConfig.modelData);
+            if (!acousticPipeline.initSessions(settings.ep, settings.deviceIndex, config)
+                || !vocoderInference.initSession(ExecutionProvider::CPU, 0, config)) {
+                return -1.0;
+            }
+            std::atomic<bool> isFailed{false};
+            auto renderSample = [&](const PreparedJob &prepared) {
+                try {
+                    auto mels = acousticPipeline.inferBatch({&prepared.pd}, inferSettings);
+                    if (mels.empty() || mels[0] == Ort::Value(nullptr)
+                        || vocoderInference.inferBatch(mels, {&prepared.pd.f0}).empty()) {
+                        isFailed = true;
+                    }
+                }
+                catch (const Ort::Exception &ortException) {
+                    printOrtError(ortException);
+                    isFailed = true;
+                }
+            };
+            renderSample(sampleJobs[0]);
+            auto start = std::chrono::steady_clock::now();
+            {
+                ThreadPool pool(static_cast<size_t>(numWorkers));
+                for (const auto &prepared : sampleJobs) {
+                    pool.submit([&renderSample, &prepared]() { renderSample(prepared); });
+                }
+                pool.wait();
+            }
+            return isFailed ? -1.0 : secondsSince(start);
+        };
+        double bestBatchSeconds = -1.0;
+        for (auto numWorkers : threadCounts) {
+            std::cout << "\n>> batch: " << numWorkers << " workers\n";
+            auto seconds = timeBatch(numWorkers);
+            if (seconds < 0) {
+                std::cout << "!! WARNING: The candidate failed.\n";
+                continue;
+            }
+            report.push_back("batch: " + std::to_string(numWorkers) + " workers: "
+                             + millisecondsToSecondsString(static_cast<long long>(seconds * 1000)) + " seconds");
+            if (bestBatchSeconds < 0 || seconds < bestBatchSeconds) {
+                bestBatchSeconds = seconds;
+                profile.batchWorkers = numWorkers;
+                profile.batchIntraOpThreads = std::max(hardwareThreads / numWorkers, 1);
+            }
+        }
+
+        std::cout << "\nRender times of " << sampleJobs.size() << " jobs:\n";
+        for (const auto &line : report) {
+            std::cout << "  " << line << '\n';
+        }
+        std::cout << "Fastest: acoustic " << profile.acoustic.intraOpThreads << " threads"
+                  << (profile.acoustic.parallelExecution ? " (parallel)" : "") << ", vocoder "
+                  << profile.vocoder.intraOpThreads << " threads"
+                  << (profile.vocoder.parallelExecution ? " (parallel)" : "") << ", batch "
+                  << profile.batchWorkers << " workers\n";
+
+        restorePowerState();
+        auto profilePath = tuningProfilePath(settings);
+        if (!saveTuningProfile(profilePath, profile)) {
+            std::cout << "!! ERROR: Failed to save the tuning profile.\n";
+            return false;
+        }
+        std::cout << "Saved the tuning profile to " << profilePath.string() << '\n';
+        return true;
+    }
+
+}  // namespace diffsinger
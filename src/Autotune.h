@@ -0,0 +1,16 @@
+#ifndef DS_ONNX_INFER_AUTOTUNE_H
+#define DS_ONNX_INFER_AUTOTUNE_H
+
+#include "RenderCommon.h"
+
+namespace diffsinger {
+
+    /**
+     * @brief Times the sessions with different thread counts and execution modes, and batch renders with
+     *        different worker counts, on the first jobs of the project. Saves the fastest to the tuning profile.
+     */
+    bool autotuneSessions(const RenderSettings &settings, int numSampleJobs);
+
+}  // namespace diffsinger
+
+#endif //DS_ONNX_INFER_AUTOTUNE_H
@@ -0,0 +1,82 @@
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+#include <rapidjson/document.h>
+#include <rapidjson/istreamwrapper.h>
+
+#include "BatchManifest.h"
+
+namespace diffsinger {
+
+    std::vector<BatchJobSpec> loadBatchManifest(const TString &manifestPath, bool *ok) {
+        if (ok) {
+            *ok = false;
+        }
+
+        std::ifstream manifestFile(manifestPath);
+        if (!manifestFile.is_open()) {
+            std::cout << "ERROR: Failed to open the batch manifest.\n";
+            return {};
+        }
+
+        rapidjson::IStreamWrapper streamWrapper(manifestFile);
+        rapidjson::Document data;
+        data.ParseStream(streamWrapper);
+        if (!data.IsObject() || !data.HasMember("jobs") || !data["jobs"].IsArray()) {
+            std::cout << "ERROR: The batch manifest must be an object with a \"jobs\" array.\n";
+            return {};
+        }
+
+        auto baseDirectory = std::filesystem::path(manifestPath).parent_path();
+        auto resolvePath = [&baseDirectory](const rapidjson::Value &job, const char *key) {
+            if (!job.HasMember(key) || !job[key].IsString()) {
+                return TString();
+            }
+            auto path = std::filesystem::u8path(job[key].GetString());
+            if (path.is_relative()) {
+                path = baseDirectory / path;
+            }
+            return path.native();
+        };
+
+        std::vector<BatchJobSpec> specs;
+        const auto &jobs = data["jobs"];
+        for (rapidjson::SizeType i = 0; i < jobs.Size(); i++) {
+            const auto &job = jobs[i];
+            if (!job.IsObject()) {
+                std::cout << "ERROR: Job at index " << i << " is not an object.\n";
+                return {};
+            }
+
+            BatchJobSpec spec;
+            spec.dsFilePath = resolvePath(job, "ds");
+            spec.outputWavePath = resolvePath(job, "out");
+            spec.dsConfigPath = resolvePath(job, "acoustic_config");
+            spec.bundlePath = resolvePath(job, "bundle");
+            spec.vocoderConfigPath = resolvePath(job, "vocoder_config");
+            if (spec.dsFilePath.empty() || spec.outputWavePath.empty()
+                || (spec.dsConfigPath.empty() && spec.bundlePath.empty())) {
+                std::cout << "ERROR: Job at index " << i
+                          << " must contain \"ds\", \"out\", and \"acoustic_config\" or \"bundle\".\n";
+                return {};
+            }
+            if (job.HasMember("spk") && job["spk"].IsString()) {
+                spec.spkMixStr = job["spk"].GetString();
+            }
+            if (job.HasMember("speedup") && job["speedup"].IsInt()) {
+                spec.speedup = job["speedup"].GetInt();
+            }
+            if (job.HasMember("depth") && job["depth"].IsInt()) {
+                spec.depth = job["depth"].GetInt();
+            }
+            specs.push_back(std::move(spec));
+        }
+
+        if (ok) {
+            *ok = true;
+        }
+        return specs;
+    }
+
+}  // namespace diffsinger
@@ -0,0 +1,33 @@
+#ifndef DS_ONNX_INFER_BATCHMANIFEST_H
+#define DS_ONNX_INFER_BATCHMANIFEST_H
+
+#include <string>
+#include <vector>
+
+#include "TString.h"
+
+namespace diffsinger {
+
+    struct BatchJobSpec {
+        TString dsFilePath;
+        TString dsConfigPath;
+        TString bundlePath;
+        TString vocoderConfigPath;
+        TString outputWavePath;
+        std::string spkMixStr;
+        int speedup = 10;
+        int depth = 1000;
+    };  // struct BatchJobSpec
+
+    /**
+     * @brief Reads the jobs of a batch render from a JSON manifest.
+     *
+     * The manifest is an object with a "jobs" array. Each job has "ds", "out", and either "acoustic_config"
+     * or "bundle"; "vocoder_config", "spk", "speedup" and "depth" are optional. Relative paths are resolved
+     * against the directory of the manifest.
+     */
+    std::vector<BatchJobSpec> loadBatchManifest(const TString &manifestPath, bool *ok = nullptr);
+
+}  // namespace diffsinger
+
+#endif //DS_ONNX_INFER_BATCHMANIFEST_H
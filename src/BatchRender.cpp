@@ -0,0 +1,314 @@
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "BatchRender.h"
+#include "AcousticPipeline.h"
+#include "BatchManifest.h"
+#include "CostModel.h"
+#include "PowerManagement.h"
+#include "ThreadPool.h"
+#include "TuningProfile.h"
+#include "Inference/InferenceUtils.hpp"
+#include "Inference/SharedEnv.h"
+#include "Inference/VocoderInference.h"
+
+namespace diffsinger {
+
+    bool renderBatch(const RenderSettings &settings, const TString &manifestPath, int numWorkers) {
+        bool ok = false;
+        auto specs = loadBatchManifest(manifestPath, &ok);
+        if (!ok) {
+            std::cout << "!! ERROR: Could not load the batch manifest.\n";
+            return false;
+        }
+
+        keepSystemAwake();
+        auto timeStart = std::chrono::steady_clock::now();
+
+        // Without --workers, the profile of the first voicebank found by the autotune subcommand decides.
+        auto voicebankSettings = [&settings](const BatchJobSpec &spec) {
+            auto voicebank = settings;
+            voicebank.dsConfigPath = spec.dsConfigPath;
+            voicebank.bundlePath = spec.bundlePath;
+            voicebank.vocoderConfigPath = spec.vocoderConfigPath;
+            return voicebank;
+        };
+        if (numWorkers == 0 && !specs.empty()) {
+            bool hasTuningProfile = false;
+            auto tuningProfile = loadTuningProfile(tuningProfilePath(voicebankSettings(specs[0])), &hasTuningProfile);
+            if (hasTuningProfile) {
+                numWorkers = tuningProfile.batchWorkers;
+            }
+        }
+
+        // With --shared-threads, the workers are pinned to the first cores, and the sessions share one ORT pool
+        // with a thread on each core left (none if the workers take them all).
+        ThreadPool pool(static_cast<size_t>(numWorkers), settings.sharedThreads);
+        if (settings.sharedThreads) {
+            useGlobalThreadPool(pool.size(), true);
+        }
+        std::cout << "Rendering " << specs.size() << " projects with " << pool.size() << " workers.\n";
+
+        // Sessions run side by side, so each one gets its share of the cores (unless they share one thread pool).
+        auto sessionConfig = settings.sessionConfig;
+        if (sessionConfig.intraOpThreads == 0) {
+            auto hardwareThreads = std::max(std::thread::hardware_concurrency(), 1u);
+            sessionConfig.intraOpThreads = std::max(static_cast<int>(hardwareThreads / pool.size()), 1);
+        }
+
+        // Each voicebank (acoustic config and vocoder) is loaded once, and shared by all projects using it.
+        struct LoadedVoicebank {
+            DsConfig dsConfig;
+            DsVocoderConfig vocoderConfig;
+            std::unique_ptr<AcousticPipeline> acousticPipeline;
+            std::unique_ptr<VocoderInference> vocoderInference;
+            std::unique_ptr<CostModel> costModel;
+        };
+        std::map<std::pair<TString, TString>, std::unique_ptr<LoadedVoicebank>> voicebanks;
+
+        auto loadVoicebank = [&](const RenderSettings &projectSettings) -> LoadedVoicebank * {
+            auto key = std::make_pair(projectSettings.bundlePath.empty() ? projectSettings.dsConfigPath
+                                                                         : projectSettings.bundlePath,
+                                      projectSettings.vocoderConfigPath);
+            auto it = voicebanks.find(key);
+            if (it != voicebanks.end()) {
+                return it->second.get();
+            }
+            // Failed voicebanks are remembered as null, so that they are not loaded again.
+            auto &voicebank = voicebanks[key];
+
+            auto loaded = std::make_unique<LoadedVoicebank>();
+            bool hasVocoder = false;
+            if (!loadConfigs(projectSettings, loaded->dsConfig, loaded->vocoderConfig, hasVocoder)) {
+                return nullptr;
+            }
+            if (!hasVocoder) {
+                std::cout << "!! ERROR: \"vocoder_config\" is required because no vocoder is packed in the bundle.\n";
+                return nullptr;
+            }
+
+            auto voicebankSessionConfig = sessionConfig;
+            if (settings.sessionConfig.intraOpThreads == 0) {
+                bool hasTuningProfile = false;
+                auto tuningProfile = loadTuningProfile(tuningProfilePath(projectSettings), &hasTuningProfile);
+                if (hasTuningProfile && tuningProfile.batchWorkers == static_cast<int>(pool.size())
+                    && tuningProfile.batchIntraOpThreads > 0) {
+                    voicebankSessionConfig.intraOpThreads = tuningProfile.batchIntraOpThreads;
+                }
+            }
+
+            std::cout << "Initializing acoustic inference session...\n";
+            loaded->acousticPipeline = std::make_unique<AcousticPipeline>(loaded->dsConfig);
+            if (!loaded->acousticPipeline->initSessions(projectSettings.ep, projectSettings.deviceIndex,
+                                                        voicebankSessionConfig)) {
+                std::cout << "!! ERROR: Acoustic Session initialization failed.\n";
+                return nullptr;
+            }
+            std::cout << "Initializing vocoder inference session...\n";
+            loaded->vocoderInference = std::make_unique<VocoderInference>(loaded->vocoderConfig.model,
+                                                                          loaded->vocoderConfig.modelData);
+            if (!loaded->vocoderInference->initSession(ExecutionProvider::CPU, 0, voicebankSessionConfig)) {
+                std::cout << "!! ERROR: Vocoder Session initialization failed.\n";
+                return nullptr;
+            }
+            loaded->costModel = std::make_unique<CostModel>(costModelPath(projectSettings));
+            voicebank = std::move(loaded);
+            return voicebank.get();
+        };
+
+        struct BatchProject {
+            RenderSettings settings;
+            LoadedVoicebank *voicebank = nullptr;
+            RenderPlan renderPlan;
+            std::unique_ptr<JobPreparer> jobPreparer;
+            AcousticInferenceSettings inferSettings;
+            int diffusionSteps = 1;
+            std::vector<JobWaveform> jobWaveforms;
+            std::vector<char> jobFailed;
+        };
+        std::vector<std::unique_ptr<BatchProject>> projects;
+
+        struct BatchTask {
+            BatchProject *project;
+            size_t job;
+            double cost;
+        };
+        std::vector<BatchTask> tasks;
+
+        bool isAllOk = true;
+        for (const auto &spec : specs) {
+            auto project = std::make_unique<BatchProject>();
+            auto &projectSettings = project->settings;
+            projectSettings = settings;
+            projectSettings.dsFilePath = spec.dsFilePath;
+            projectSettings.dsConfigPath = spec.dsConfigPath;
+            projectSettings.bundlePath = spec.bundlePath;
+            projectSettings.vocoderConfigPath = spec.vocoderConfigPath;
+            projectSettings.outputWavePath = spec.outputWavePath;
+            projectSettings.spkMixStr = spec.spkMixStr;
+            projectSettings.acousticSpeedup = spec.speedup;
+            projectSettings.shallowDiffusionDepth = spec.depth;
+
+            std::cout << '\n' << "Loading " << std::filesystem::path(spec.dsFilePath).filename().string() << "...\n";
+            project->voicebank = loadVoicebank(projectSettings);
+            if (!project->voicebank) {
+                isAllOk = false;
+                continue;
+            }
+            const auto &dsConfig = project->voicebank->dsConfig;
+            const auto &vocoderConfig = project->voicebank->vocoderConfig;
+            if (!resolveDiffusionSettings(dsConfig, projectSettings.acousticSpeedup,
+                                          projectSettings.shallowDiffusionDepth)) {
+                isAllOk = false;
+                continue;
+            }
+            project->inferSettings.speedup = projectSettings.acousticSpeedup;
+            project->inferSettings.depth = projectSettings.shallowDiffusionDepth;
+            project->inferSettings.sampler = projectSettings.sampler;
+
+            auto dsProject = loadDsProject(projectSettings.dsFilePath, projectSettings.spkMixStr);
+            if (dsProject.empty()) {
+                std::cout << "!! ERROR: The project has no segments.\n";
+                isAllOk = false;
+                continue;
+            }
+            // Batch renders do not run the duration and variance models, so the project must have what they
+            // would predict.
+            auto incomplete = std::find_if(dsProject.begin(), dsProject.end(), [](const DsSegment &segment) {
+                return segment.ph_dur.empty() || segment.f0.samples.empty();
+            });
+            if (incomplete != dsProject.end()) {
+                bool needsDurations = incomplete->ph_dur.empty();
+                std::cout << "!! ERROR: Segment " << (incomplete - dsProject.begin()) + 1 << " has no "
+                          << (needsDurations ? "ph_dur" : "f0") << ", which batch renders do not predict. "
+                          << "Render the project on its own with "
+                          << (needsDurations ? "--dur-config" : "--variance-config")
+                          << ", or save the predictions with --save-predictions first.\n";
+                isAllOk = false;
+                continue;
+            }
+            project->renderPlan = RenderPlan::fromSegments(dsProject, projectSettings.renderPlanOptions);
+            auto numJobs = project->renderPlan.jobs.size();
+            project->jobWaveforms.resize(numJobs);
+            project->jobFailed.resize(numJobs, 0);
+            project->jobPreparer = std::make_unique<JobPreparer>(dsConfig, jobPrepareOptions(projectSettings),
+                                                                 vocoderConfig.sampleRate, vocoderConfig.hopSize);
+
+            double frameLength = 1.0 * vocoderConfig.hopSize / vocoderConfig.sampleRate;
+            auto diffusionSteps = diffusionStepCount(dsConfig, projectSettings.acousticSpeedup,
+                                                     projectSettings.shallowDiffusionDepth);
+            project->diffusionSteps = diffusionSteps;
+            for (size_t i = 0; i < numJobs; i++) {
+                auto frames = estimateJobFrames(projectSettings, project->renderPlan.jobs[i], frameLength);
+                auto cost = project->voicebank->costModel->estimate(frames, diffusionSteps, vocoderConfig.hopSize);
+                tasks.push_back({project.get(), i, cost.totalSeconds()});
+            }
+            projects.push_back(std::move(project));
+        }
+
+        // The most expensive jobs of all projects start first; workers that run out steal the cheap ones.
+        std::vector<double> taskCosts;
+        taskCosts.reserve(tasks.size());
+        for (const auto &task : tasks) {
+            taskCosts.push_back(task.cost);
+        }
+        std::mutex printMutex;
+        // Guards the cost models, which are calibrated with the timed calls of all workers.
+        std::mutex costMutex;
+        size_t numFinished = 0;
+        std::cout << '\n' << "Rendering " << tasks.size() << " jobs...\n";
+        for (auto t : scheduleLongestFirst(taskCosts)) {
+            const auto &task = tasks[t];
+            pool.submit([&task, &printMutex, &costMutex, &numFinished, numTasks = tasks.size()]() {
+                auto &project = *task.project;
+                auto &voicebank = *project.voicebank;
+                const auto &job = project.renderPlan.jobs[task.job];
+
+                PreparedJob prepared;
+                auto status = project.jobPreparer->prepare(job, prepared);
+                if (status == JobPreparer::Status::Silent) {
+                    project.jobWaveforms[task.job] = project.jobPreparer->silentWaveform(job);
+                } else if (status == JobPreparer::Status::Failed) {
+                    project.jobFailed[task.job] = 1;
+                } else {
+                    try {
+                        auto frames = static_cast<int64_t>(prepared.pd.f0.size());
+                        auto acousticStart = std::chrono::steady_clock::now();
+                        auto mels = voicebank.acousticPipeline->inferBatch({&prepared.pd}, project.inferSettings);
+                        auto acousticSeconds = std::chrono::duration<double>(
+                                std::chrono::steady_clock::now() - acousticStart).count();
+                        if (mels.empty() || mels[0] == Ort::Value(nullptr)) {
+                            project.jobFailed[task.job] = 1;
+                        } else {
+                            auto vocoderStart = std::chrono::steady_clock::now();
+                            auto waveforms = voicebank.vocoderInference->inferBatch(mels, {&prepared.pd.f0});
+                            auto vocoderSeconds = std::chrono::duration<double>(
+                                    std::chrono::steady_clock::now() - vocoderStart).count();
+                            {
+                                std::lock_guard<std::mutex> lock(costMutex);
+                                voicebank.costModel->addAcousticSample(frames, project.diffusionSteps,
+                                                                       acousticSeconds);
+                                voicebank.costModel->addVocoderSample(frames, vocoderSeconds);
+                            }
+                            if (waveforms.empty() || waveforms[0].empty()) {
+                                project.jobFailed[task.job] = 1;
+                            } else {
+                                project.jobWaveforms[task.job] = project.jobPreparer->finishWaveform(
+                                        std::move(waveforms[0]), prepared);
+                            }
+                        }
+                    }
+                    catch (const Ort::Exception &ortException) {
+                        printOrtError(ortException);
+                        project.jobFailed[task.job] = 1;
+                    }
+                }
+
+                std::lock_guard<std::mutex> lock(printMutex);
+                ++numFinished;
+                std::cout << numFinished << " of " << numTasks << ": "
+                          << std::filesystem::path(project.settings.dsFilePath).filename().string()
+                          << ", job " << task.job + 1
+                          << (project.jobFailed[task.job] ? " failed" : "") << "\n";
+            });
+        }
+        pool.wait();
+        for (const auto &[key, voicebank] : voicebanks) {
+            if (voicebank) {
+                voicebank->costModel->save();
+            }
+        }
+
+        std::cout << '\n' << ">> Saving wave files...\n";
+        for (const auto &project : projects) {
+            auto outputName = std::filesystem::path(project->settings.outputWavePath).filename().string();
+            auto numFailed = std::count(project->jobFailed.begin(), project->jobFailed.end(), 1);
+            if (numFailed > 0) {
+                std::cout << "!! ERROR: " << numFailed << " jobs of " << outputName << " failed.\n";
+                isAllOk = false;
+            }
+            auto sampleRate = project->voicebank->vocoderConfig.sampleRate;
+            auto samples = mixJobWaveforms(project->renderPlan, project->jobWaveforms, sampleRate);
+            if (writeWaveFile(project->settings.outputWavePath, samples, sampleRate)) {
+                std::cout << "Saved " << outputName << "\n";
+            } else {
+                isAllOk = false;
+            }
+        }
+
+        auto timeSpent = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now() - timeStart).count();
+        std::cout << ">> Time Elapsed: " << millisecondsToSecondsString(timeSpent) << " seconds\n";
+
+        // Allow system sleep
+        restorePowerState();
+        return isAllOk;
+    }
+
+}  // namespace diffsinger
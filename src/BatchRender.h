@@ -0,0 +1,18 @@
+#ifndef DS_ONNX_INFER_BATCHRENDER_H
+#define DS_ONNX_INFER_BATCHRENDER_H
+
+#include "TString.h"
+#include "RenderCommon.h"
+
+namespace diffsinger {
+
+    /**
+     * @brief Renders the projects of a batch manifest, sharing voicebanks and worker threads between them.
+     *
+     * @param settings  Settings common to all projects (execution provider, cache, silence handling, ...).
+     */
+    bool renderBatch(const RenderSettings &settings, const TString &manifestPath, int numWorkers);
+
+}  // namespace diffsinger
+
+#endif //DS_ONNX_INFER_BATCHRENDER_H
@@ -0,0 +1,228 @@
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+
+#include "Benchmark.h"
+#include "AcousticPipeline.h"
+#include "CostModel.h"
+#include "DeadlinePlan.h"
+#include "PowerManagement.h"
+#include "QualityMetrics.h"
+#include "Inference/InferenceUtils.hpp"
+#include "Inference/VocoderInference.h"
+
+namespace diffsinger {
+
+    bool benchmarkDiffusionSettings(const RenderSettings &settings, const BenchmarkOptions &options) {
+        DsConfig dsConfig;
+        DsVocoderConfig vocoderConfig;
+        bool hasVocoder = false;
+        if (!loadConfigs(settings, dsConfig, vocoderConfig, hasVocoder)) {
+            return false;
+        }
+        if (!hasVocoder) {
+            std::cout << "!! ERROR: --vocoder-config is required because no vocoder is packed in the bundle.\n";
+            return false;
+        }
+
+        // The reference first, then the grid. Settings that resolve to the same ones are measured once.
+        std::vector<DiffusionSettings> grid;
+        auto addSettings = [&](int speedup, int depth) {
+            if (!resolveDiffusionSettings(dsConfig, speedup, depth)) {
+                return false;
+            }
+            if (dsConfig.useShallowDiffusion && depth < 1) {
+                std::cout << "!! WARNING: Skipping speedup " << speedup << ", which is larger than the depth.\n";
+                return true;
+            }
+            auto isMeasured = std::any_of(grid.begin(), grid.end(), [&](const DiffusionSettings &other) {
+                return other.speedup == speedup && other.depth == depth;
+            });
+            if (!isMeasured) {
+                grid.push_back({speedup, depth, diffusionStepCount(dsConfig, speedup, depth)});
+            }
+            return true;
+        };
+        if (!addSettings(options.referenceSpeedup, settings.shallowDiffusionDepth)) {
+            return false;
+        }
+        if (grid.empty()) {
+            std::cout << "!! ERROR: The reference speedup is larger than the depth.\n";
+            return false;
+        }
+        auto depths = options.depths;
+        if (depths.empty() || !dsConfig.useShallowDiffusion) {
+            depths = {settings.shallowDiffusionDepth};
+        }
+        for (auto depth : depths) {
+            for (auto speedup : options.speedups) {
+                addSettings(speedup, depth);
+            }
+        }
+
+        keepSystemAwake();
+
+        std::cout << "Initializing acoustic inference session...\n";
+        AcousticPipeline acousticPipeline(dsConfig);
+        if (!acousticPipeline.initSessions(settings.ep, settings.deviceIndex, settings.sessionConfig)) {
+            std::cout << "!! ERROR: Acoustic Session initialization failed.\n";
+            return false;
+        }
+        std::cout << "Initializing vocoder inference session...\n";
+        VocoderInference vocoderInference(vocoderConfig.model, vocoderConfig.modelData);
+        if (!vocoderInference.initSession(ExecutionProvider::CPU, 0, settings.sessionConfig)) {
+            std::cout << "!! ERROR: Vocoder Session initialization failed.\n";
+            return false;
+        }
+
+        // Only the jobs with audio are measured.
+        auto dsProject = loadDsProject(settings.dsFilePath, settings.spkMixStr);
+        auto renderPlan = RenderPlan::fromSegments(dsProject, settings.renderPlanOptions);
+        JobPreparer jobPreparer(dsConfig, jobPrepareOptions(settings), vocoderConfig.sampleRate,
+                                vocoderConfig.hopSize);
+        std::vector<PreparedJob> preparedJobs;
+        int64_t totalFrames = 0;
+        for (const auto &job : renderPlan.jobs) {
+            PreparedJob prepared;
+            auto status = jobPreparer.prepare(job, prepared);
+            if (status == JobPreparer::Status::Failed) {
+                return false;
+            }
+            if (status == JobPreparer::Status::Ready) {
+                totalFrames += static_cast<int64_t>(prepared.pd.f0.size());
+                preparedJobs.push_back(std::move(prepared));
+            }
+        }
+        if (preparedJobs.empty()) {
+            std::cout << "!! ERROR: The project has nothing to render.\n";
+            return false;
+        }
+        auto audioSeconds = static_cast<double>(totalFrames) * vocoderConfig.hopSize / vocoderConfig.sampleRate;
+
+        struct JobOutput {
+            std::vector<float> mel;
+            size_t numBins = 0;
+            std::vector<float> waveform;
+        };
+        CostModel costModel(costModelPath(settings));
+        // Renders every job with the settings, returning the render time in seconds, or a negative time on failure.
+        // With `recordCosts`, the timings are added to the cost model; cold timings of the warm-up are not.
+        auto renderJobs = [&](const DiffusionSettings &diffusion, std::vector<JobOutput> &outputs, bool recordCosts) {
+            AcousticInferenceSettings inferSettings{};
+            inferSettings.speedup = diffusion.speedup;
+            inferSettings.depth = diffusion.depth;
+            inferSettings.sampler = settings.sampler;
+            outputs.resize(preparedJobs.size());
+            double seconds = 0.0;
+            for (size_t i = 0; i < preparedJobs.size(); i++) {
+                const auto &prepared = preparedJobs[i];
+                auto frames = static_cast<int64_t>(prepared.pd.f0.size());
+                try {
+                    auto acousticStart = std::chrono::steady_clock::now();
+                    auto mels = acousticPipeline.inferBatch({&prepared.pd}, inferSettings);
+                    auto acousticSeconds = std::chrono::duration<double>(
+                            std::chrono::steady_clock::now() - acousticStart).count();
+                    if (mels.empty() || mels[0] == Ort::Value(nullptr)) {
+                        std::cout << "!! ERROR: Acoustic Infer failed.\n";
+                        return -1.0;
+                    }
+                    auto melShape = mels[0].GetTensorTypeAndShapeInfo().GetShape();
+                    auto melBuffer = mels[0].GetTensorData<float>();
+                    outputs[i].mel.assign(melBuffer,
+                                          melBuffer + mels[0].GetTensorTypeAndShapeInfo().GetElementCount());
+                    outputs[i].numBins = static_cast<size_t>(melShape.back());
+
+                    auto vocoderStart = std::chrono::steady_clock::now();
+                    auto waveforms = vocoderInference.inferBatch(mels, {&prepared.pd.f0});
+                    auto vocoderSeconds = std::chrono::duration<double>(
+                            std::chrono::steady_clock::now() - vocoderStart).count();
+                    if (waveforms.empty() || waveforms[0].empty()) {
+                        std::cout << "!! ERROR: Vocoder Infer failed.\n";
+                        return -1.0;
+                    }
+                    outputs[i].waveform = std::move(waveforms[0]);
+
+                    if (recordCosts) {
+                        costModel.addAcousticSample(frames, diffusion.steps, acousticSeconds);
+                        costModel.addVocoderSample(frames, vocoderSeconds);
+                    }
+                    seconds += acousticSeconds + vocoderSeconds;
+                }
+                catch (const Ort::Exception &ortException) {
+                    printOrtError(ortException);
+                    return -1.0;
+                }
+            }
+            return seconds;
+        };
+
+        // The first calls of a session are slower, so render once before measuring.
+        std::cout << "Warming up...\n";
+        std::vector<JobOutput> referenceOutputs;
+        if (renderJobs(grid.back(), referenceOutputs, false) < 0) {
+            return false;
+        }
+        std::cout << "Rendering the reference (speedup " << grid[0].speedup << ", depth " << grid[0].depth << ")...\n";
+        auto referenceSeconds = renderJobs(grid[0], referenceOutputs, true);
+        if (referenceSeconds < 0) {
+            return false;
+        }
+
+        std::vector<double> realTimeFactors{referenceSeconds / audioSeconds};
+        std::vector<double> melDistances{0.0};
+        std::vector<double> spectralDistances{0.0};
+        std::vector<JobOutput> outputs;
+        for (size_t g = 1; g < grid.size(); g++) {
+            std::cout << "Rendering speedup " << grid[g].speedup << ", depth " << grid[g].depth << "...\n";
+            auto seconds = renderJobs(grid[g], outputs, true);
+            if (seconds < 0) {
+                return false;
+            }
+            // Distances of the jobs, weighted by their length.
+            double melDistance = 0.0;
+            double spectralDistance = 0.0;
+            for (size_t i = 0; i < outputs.size(); i++) {
+                auto weight = static_cast<double>(preparedJobs[i].pd.f0.size()) / static_cast<double>(totalFrames);
+                melDistance += weight * melL1Distance(outputs[i].mel, referenceOutputs[i].mel, outputs[i].numBins);
+                spectralDistance += weight * logSpectralDistance(outputs[i].waveform, referenceOutputs[i].waveform);
+            }
+            realTimeFactors.push_back(seconds / audioSeconds);
+            melDistances.push_back(melDistance);
+            spectralDistances.push_back(spectralDistance);
+        }
+        costModel.save();
+
+        auto frontier = paretoFrontier(realTimeFactors, spectralDistances);
+        std::cout << '\n' << "Benchmark of " << std::filesystem::path(settings.dsFilePath).filename().string()
+                  << " (" << std::fixed << std::setprecision(1) << audioSeconds << " seconds of audio):\n";
+        std::cout << "  speedup  depth  steps      RTF  mel L1  LSD (dB)\n";
+        for (size_t g = 0; g < grid.size(); g++) {
+            bool isOnFrontier = std::find(frontier.begin(), frontier.end(), g) != frontier.end();
+            std::cout << std::setw(9) << grid[g].speedup << std::setw(7) << grid[g].depth << std::setw(7)
+                      << grid[g].steps << std::setw(9) << std::setprecision(3) << realTimeFactors[g]
+                      << std::setw(8) << melDistances[g] << std::setw(10) << std::setprecision(2)
+                      << spectralDistances[g] << (g == 0 ? "  reference" : "") << (isOnFrontier ? "  *" : "")
+                      << '\n';
+        }
+        std::cout << "(* on the Pareto frontier: no other setting is both faster and closer to the reference)\n";
+
+        if (options.maxDistance > 0) {
+            // The frontier is ordered by cost, so the first setting within the distance is the cheapest.
+            auto it = std::find_if(frontier.begin(), frontier.end(),
+                                   [&](size_t g) { return spectralDistances[g] <= options.maxDistance; });
+            if (it != frontier.end()) {
+                std::cout << "Cheapest setting within " << options.maxDistance << " dB: --speedup "
+                          << grid[*it].speedup << " --depth " << grid[*it].depth << '\n';
+            } else {
+                std::cout << "!! WARNING: No setting is within " << options.maxDistance << " dB of the reference.\n";
+            }
+        }
+        std::cout << std::defaultfloat << std::setprecision(6);
+
+        restorePowerState();
+        return true;
+    }
+
+}  // namespace diffsinger
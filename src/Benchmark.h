@@ -0,0 +1,29 @@
+#ifndef DS_ONNX_INFER_BENCHMARK_H
+#define DS_ONNX_INFER_BENCHMARK_H
+
+#include <vector>
+
+#include "RenderCommon.h"
+
+namespace diffsinger {
+
+    struct BenchmarkOptions {
+        std::vector<int> speedups;
+        std::vector<int> depths;  // Shallow diffusion models only; empty for the depth of the settings
+
+        // The reference render every setting is compared with.
+        int referenceSpeedup = 1;
+
+        // Recommend the cheapest setting with a log-spectral distance below this (in dB). 0 to disable.
+        double maxDistance = 0.0;
+    };
+
+    /**
+     * @brief Renders the project with every speedup and depth of the grid, and prints the real-time factor and
+     *        the distance to a reference render of each, marking the Pareto frontier.
+     */
+    bool benchmarkDiffusionSettings(const RenderSettings &settings, const BenchmarkOptions &options);
+
+}  // namespace diffsinger
+
+#endif //DS_ONNX_INFER_BENCHMARK_H
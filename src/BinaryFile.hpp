@@ -0,0 +1,92 @@
+#ifndef DS_ONNX_INFER_BINARYFILE_HPP
+#define DS_ONNX_INFER_BINARYFILE_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <ostream>
+#include <vector>
+
+namespace diffsinger {
+
+    /**
+     * @brief Binary cache files start with an 8-byte magic identifying the format and version, followed by the
+     *        key of the entry, so that a file of another format or a stale file of another key is not read.
+     */
+    using BinaryFileMagic = char[8];
+
+    template<class T>
+    inline bool readValue(std::istream &in, T &value);
+
+    template<class T>
+    inline void writeValue(std::ostream &out, const T &value);
+
+    inline bool readBinaryFileHeader(std::istream &in, const BinaryFileMagic &magic, uint64_t key);
+
+    inline void writeBinaryFileHeader(std::ostream &out, const BinaryFileMagic &magic, uint64_t key);
+
+    /**
+     * @brief Reads an array written by `writeArray` (a uint64 count, then the elements).
+     *
+     * The count is checked against the size of the rest of the stream before anything is allocated, so that
+     * truncated or corrupted files fail cleanly. With `isLast`, the array must end the stream exactly.
+     */
+    template<class T>
+    inline bool readArray(std::istream &in, std::vector<T> &values, bool isLast = false);
+
+    template<class T>
+    inline void writeArray(std::ostream &out, const std::vector<T> &values);
+
+
+    template<class T>
+    bool readValue(std::istream &in, T &value) {
+        in.read(reinterpret_cast<char *>(&value), sizeof(value));
+        return static_cast<bool>(in);
+    }
+
+    template<class T>
+    void writeValue(std::ostream &out, const T &value) {
+        out.write(reinterpret_cast<const char *>(&value), sizeof(value));
+    }
+
+    bool readBinaryFileHeader(std::istream &in, const BinaryFileMagic &magic, uint64_t key) {
+        char storedMagic[sizeof(BinaryFileMagic)];
+        uint64_t storedKey = 0;
+        in.read(storedMagic, sizeof(storedMagic));
+        return in && std::memcmp(storedMagic, magic, sizeof(storedMagic)) == 0
+               && readValue(in, storedKey) && storedKey == key;
+    }
+
+    void writeBinaryFileHeader(std::ostream &out, const BinaryFileMagic &magic, uint64_t key) {
+        out.write(magic, sizeof(BinaryFileMagic));
+        writeValue(out, key);
+    }
+
+    template<class T>
+    bool readArray(std::istream &in, std::vector<T> &values, bool isLast) {
+        uint64_t count = 0;
+        if (!readValue(in, count)) {
+            return false;
+        }
+        auto dataStart = in.tellg();
+        in.seekg(0, std::ios::end);
+        auto remaining = static_cast<uint64_t>(in.tellg() - dataStart);
+        in.seekg(dataStart);
+        if (!in || count > remaining / sizeof(T) || (isLast && count * sizeof(T) != remaining)) {
+            return false;
+        }
+        values.resize(count);
+        in.read(reinterpret_cast<char *>(values.data()), static_cast<std::streamsize>(count * sizeof(T)));
+        return static_cast<bool>(in);
+    }
+
+    template<class T>
+    void writeArray(std::ostream &out, const std::vector<T> &values) {
+        writeValue(out, static_cast<uint64_t>(values.size()));
+        out.write(reinterpret_cast<const char *>(values.data()),
+                  static_cast<std::streamsize>(values.size() * sizeof(T)));
+    }
+
+}  // namespace diffsinger
+
+#endif //DS_ONNX_INFER_BINARYFILE_HPP
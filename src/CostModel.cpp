@@ -0,0 +1,199 @@
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <numeric>
+#include <queue>
+#include <string>
+#include <utility>
+
+#include "CostModel.h"
+#include "FileUtil.h"
+
+namespace diffsinger {
+
+    namespace {
+        constexpr auto FILE_HEADER = "ds_onnx_infer-cost-model-1";
+
+        // Defaults measured on a desktop CPU, used until the first calls are timed.
+        constexpr double DEFAULT_ACOUSTIC_FIXED = 0.05;
+        constexpr double DEFAULT_ACOUSTIC_PER_FRAME_STEP = 2e-5;
+        constexpr double DEFAULT_VOCODER_FIXED = 0.02;
+        constexpr double DEFAULT_VOCODER_PER_FRAME = 1e-3;
+
+        // Activations of the acoustic model per frame (hidden channels times layers), and of the vocoder
+        // per output sample (channels of the upsampling stack).
+        constexpr double ACOUSTIC_BYTES_PER_FRAME = 40.0 * 1024;
+        constexpr double VOCODER_BYTES_PER_SAMPLE = 512.0;
+
+        // Older calls count less once this many are recorded, so the fit follows hardware and model changes.
+        constexpr double MAX_SAMPLE_WEIGHT = 200.0;
+    }
+
+    double CostModel::LinearFit::predict(double units) const {
+        return fixed + perUnit * units;
+    }
+
+    void CostModel::LinearFit::add(double units, double seconds) {
+        if (n >= MAX_SAMPLE_WEIGHT) {
+            auto scale = (MAX_SAMPLE_WEIGHT - 1) / n;
+            n *= scale;
+            sumX *= scale;
+            sumY *= scale;
+            sumXX *= scale;
+            sumXY *= scale;
+        }
+        n += 1;
+        sumX += units;
+        sumY += seconds;
+        sumXX += units * units;
+        sumXY += units * seconds;
+
+        auto denominator = n * sumXX - sumX * sumX;
+        if (n >= 2 && denominator > 1e-9 * n * sumXX) {
+            auto slope = (n * sumXY - sumX * sumY) / denominator;
+            auto intercept = (sumY - slope * sumX) / n;
+            if (slope > 0 && intercept >= 0) {
+                perUnit = slope;
+                fixed = intercept;
+                return;
+            }
+        }
+        // Not enough spread in the sizes to separate the fixed cost: keep it, and scale the rest.
+        if (sumX > 0) {
+            perUnit = std::max(sumY - n * fixed, 0.0) / sumX;
+        }
+    }
+
+    CostModel::CostModel(std::filesystem::path file)
+            : m_file(std::move(file)),
+              m_acoustic{DEFAULT_ACOUSTIC_FIXED, DEFAULT_ACOUSTIC_PER_FRAME_STEP},
+              m_vocoder{DEFAULT_VOCODER_FIXED, DEFAULT_VOCODER_PER_FRAME} {
+        if (!m_file.empty()) {
+            load();
+        }
+    }
+
+    CostEstimate CostModel::estimate(int64_t frames, int steps, int hopSize) const {
+        CostEstimate cost;
+        if (frames <= 0) {
+            return cost;
+        }
+        auto numFrames = static_cast<double>(frames);
+        cost.acousticSeconds = m_acoustic.predict(numFrames * std::max(steps, 1));
+        cost.vocoderSeconds = m_vocoder.predict(numFrames);
+        cost.memoryBytes = std::max(numFrames * ACOUSTIC_BYTES_PER_FRAME,
+                                    numFrames * hopSize * VOCODER_BYTES_PER_SAMPLE);
+        return cost;
+    }
+
+    void CostModel::addAcousticSample(int64_t frames, int steps, double seconds) {
+        m_acoustic.add(static_cast<double>(frames) * std::max(steps, 1), seconds);
+    }
+
+    void CostModel::addVocoderSample(int64_t frames, double seconds) {
+        m_vocoder.add(static_cast<double>(frames), seconds);
+    }
+
+    int64_t CostModel::numSamples() const {
+        return static_cast<int64_t>(std::min(m_acoustic.n, m_vocoder.n));
+    }
+
+    bool CostModel::load() {
+        std::ifstream file(m_file);
+        std::string header;
+        if (!(file >> header) || header != FILE_HEADER) {
+            return false;
+        }
+        LinearFit acoustic = m_acoustic;
+        LinearFit vocoder = m_vocoder;
+        for (auto *fit : {&acoustic, &vocoder}) {
+            std::string name;
+            file >> name >> fit->fixed >> fit->perUnit >> fit->n >> fit->sumX >> fit->sumY >> fit->sumXX >> fit->sumXY;
+        }
+        if (!file || acoustic.perUnit <= 0 || vocoder.perUnit <= 0) {
+            return false;
+        }
+        m_acoustic = acoustic;
+        m_vocoder = vocoder;
+        return true;
+    }
+
+    bool CostModel::save() const {
+        if (m_file.empty()) {
+            return false;
+        }
+        return writeFileAtomically(m_file, [this](std::ostream &file) {
+            file.precision(17);
+            file << FILE_HEADER << '\n';
+            const std::pair<const char *, const LinearFit *> fits[] = {{"acoustic", &m_acoustic},
+                                                                       {"vocoder", &m_vocoder}};
+            for (const auto &[name, fit] : fits) {
+                file << name << ' ' << fit->fixed << ' ' << fit->perUnit << ' ' << fit->n << ' '
+                     << fit->sumX << ' ' << fit->sumY << ' ' << fit->sumXX << ' ' << fit->sumXY << '\n';
+            }
+            return true;
+        });
+    }
+
+    std::vector<size_t> scheduleLongestFirst(const std::vector<double> &costs) {
+        std::vector<size_t> order(costs.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&costs](size_t a, size_t b) {
+            return costs[a] > costs[b];
+        });
+        return order;
+    }
+
+    std::vector<size_t> chooseSettingsWithinBudget(const std::vector<std::vector<double>> &costs,
+                                                   const std::vector<double> &weights,
+                                                   double budget) {
+        constexpr double minWeight = 1e-6;
+        std::vector<size_t> choices(costs.size(), 0);
+        double total = 0.0;
+        for (const auto &taskCosts : costs) {
+            if (!taskCosts.empty()) {
+                total += taskCosts.front();
+            }
+        }
+
+        // The next setting of each task. The largest saving per weight comes first; savings equal up to
+        // rounding (as for tasks whose cost and weight both grow with their length) go to the lighter task.
+        struct Candidate {
+            double saving;
+            double weight;
+            size_t task;
+        };
+        auto isLess = [](const Candidate &a, const Candidate &b) {
+            constexpr double tolerance = 1e-9;
+            if (std::abs(a.saving - b.saving) > tolerance * std::max(std::abs(a.saving), std::abs(b.saving))) {
+                return a.saving < b.saving;
+            }
+            if (a.weight != b.weight) {
+                return a.weight > b.weight;
+            }
+            return a.task > b.task;
+        };
+        std::priority_queue<Candidate, std::vector<Candidate>, decltype(isLess)> candidates(isLess);
+        auto addCandidate = [&](size_t task) {
+            auto choice = choices[task];
+            if (choice + 1 < costs[task].size()) {
+                auto weight = std::max(weights[task], minWeight);
+                auto saving = costs[task][choice] - costs[task][choice + 1];
+                candidates.push({saving / weight, weight, task});
+            }
+        };
+        for (size_t task = 0; task < costs.size(); ++task) {
+            addCandidate(task);
+        }
+
+        while (total > budget && !candidates.empty()) {
+            auto task = candidates.top().task;
+            candidates.pop();
+            total -= costs[task][choices[task]] - costs[task][choices[task] + 1];
+            ++choices[task];
+            addCandidate(task);
+        }
+        return choices;
+    }
+
+}  // namespace diffsinger
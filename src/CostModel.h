@@ -0,0 +1,98 @@
+#ifndef DS_ONNX_INFER_COSTMODEL_H
+#define DS_ONNX_INFER_COSTMODEL_H
+
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+namespace diffsinger {
+
+    struct CostEstimate {
+        double acousticSeconds = 0.0;
+        double vocoderSeconds = 0.0;
+
+        // Rough peak memory of the activations, in bytes.
+        double memoryBytes = 0.0;
+
+        double totalSeconds() const {
+            return acousticSeconds + vocoderSeconds;
+        }
+    };  // struct CostEstimate
+
+
+    /**
+     * @brief Estimates the render time of a segment from its frame count.
+     *
+     * Each model call is modelled as a fixed cost plus a cost per unit of work: frames times diffusion steps
+     * for the acoustic model, frames for the vocoder. The coefficients start from rough CPU defaults, and are
+     * fitted to the calls timed by `addAcousticSample` and `addVocoderSample`. The fit is stored in a file,
+     * so that later runs (and `--plan`) start calibrated.
+     */
+    class CostModel {
+    public:
+        /**
+         * @param file  File of the calibration. Empty to keep it in memory only.
+         */
+        explicit CostModel(std::filesystem::path file = {});
+
+        CostEstimate estimate(int64_t frames, int steps, int hopSize) const;
+
+        void addAcousticSample(int64_t frames, int steps, double seconds);
+
+        void addVocoderSample(int64_t frames, double seconds);
+
+        /**
+         * @return The number of calls the calibration is fitted to, or 0 if the defaults are used.
+         */
+        int64_t numSamples() const;
+
+        bool save() const;
+
+    private:
+        // Least squares fit of seconds = fixed + perUnit * units, kept as running sums.
+        struct LinearFit {
+            double fixed;
+            double perUnit;
+
+            double n = 0;
+            double sumX = 0;
+            double sumY = 0;
+            double sumXX = 0;
+            double sumXY = 0;
+
+            double predict(double units) const;
+
+            void add(double units, double seconds);
+        };
+
+        std::filesystem::path m_file;
+        LinearFit m_acoustic;
+        LinearFit m_vocoder;
+
+        bool load();
+    };  // class CostModel
+
+
+    /**
+     * @brief Orders tasks by cost, most expensive first, so that the longest ones do not start last.
+     */
+    std::vector<size_t> scheduleLongestFirst(const std::vector<double> &costs);
+
+    /**
+     * @brief Picks one of several render settings for each task, so that the total cost fits in `budget`.
+     *
+     * Starting from the best setting everywhere, the task that saves the most per unit of weight is moved to its
+     * next setting, until the total fits. Tasks with more weight (e.g. heard for longer) thus keep their quality
+     * the longest; of equal candidates, the lighter task is moved first.
+     *
+     * @param costs    Cost of each task with each setting, from the best to the fastest setting.
+     * @param weights  How much the quality of each task matters.
+     * @return         The setting of each task. If the budget cannot be met, every task gets its fastest setting.
+     */
+    std::vector<size_t> chooseSettingsWithinBudget(const std::vector<std::vector<double>> &costs,
+                                                   const std::vector<double> &weights,
+                                                   double budget);
+
+}  // namespace diffsinger
+
+#endif //DS_ONNX_INFER_COSTMODEL_H
@@ -0,0 +1,101 @@
+#include <algorithm>
+#include <iostream>
+#include <map>
+
+#include "DeadlinePlan.h"
+#include "SegmentUtil.h"
+
+namespace diffsinger {
+
+    std::vector<DiffusionSettings> fasterDiffusionSettings(const DsConfig &dsConfig, int speedup, int depth) {
+        std::vector<DiffusionSettings> candidates;
+        for (auto candidateSpeedup : {1, 2, 4, 5, 8, 10, 20, 25, 40, 50, 100, 125, 200, 250, 500, 1000}) {
+            if (candidateSpeedup <= speedup) {
+                continue;
+            }
+            if (!dsConfig.useShallowDiffusion) {
+                candidates.push_back({candidateSpeedup, depth, diffusionStepCount(dsConfig, candidateSpeedup, depth)});
+                continue;
+            }
+            // Shallower diffusion saves steps too, at a smaller cost in quality than a larger speedup.
+            for (auto candidateDepth : {depth, depth / 2, depth / 4}) {
+                candidateDepth = candidateDepth / candidateSpeedup * candidateSpeedup;
+                if (candidateDepth >= candidateSpeedup) {
+                    candidates.push_back({candidateSpeedup, candidateDepth,
+                                          diffusionStepCount(dsConfig, candidateSpeedup, candidateDepth)});
+                }
+            }
+        }
+        // Fewest steps last; of the settings with the same steps, the deepest.
+        std::stable_sort(candidates.begin(), candidates.end(), [](const auto &a, const auto &b) {
+            return a.steps != b.steps ? a.steps > b.steps : a.depth > b.depth;
+        });
+
+        std::vector<DiffusionSettings> ladder{{speedup, depth, diffusionStepCount(dsConfig, speedup, depth)}};
+        for (const auto &candidate : candidates) {
+            if (candidate.steps < ladder.back().steps) {
+                ladder.push_back(candidate);
+            }
+        }
+        return ladder;
+    }
+
+    DeadlinePlan makeDeadlinePlan(const RenderPlan &renderPlan, std::vector<DiffusionSettings> ladder) {
+        DeadlinePlan plan;
+        plan.ladder = std::move(ladder);
+        plan.jobExposure.resize(renderPlan.jobs.size(), 0.0);
+        plan.jobSettings.resize(renderPlan.jobs.size(), 0);
+        for (const auto &clip : renderPlan.clips) {
+            plan.jobExposure[clip.job] += (clip.sourceLength >= 0) ? clip.sourceLength
+                                                                   : segmentDuration(renderPlan.jobs[clip.job]);
+        }
+        return plan;
+    }
+
+    void replanDeadline(DeadlinePlan &plan, const RenderSettings &settings, const RenderPlan &renderPlan,
+                        const std::vector<size_t> &jobOrder, size_t firstJob, const CostModel &costModel,
+                        double frameLength, int hopSize, size_t numMixes, double secondsLeft) {
+        std::vector<std::vector<double>> settingsCosts;
+        std::vector<double> weights;
+        for (auto n = firstJob; n < jobOrder.size(); n++) {
+            auto frames = estimateJobFrames(settings, renderPlan.jobs[jobOrder[n]], frameLength);
+            std::vector<double> costs;
+            for (const auto &candidate : plan.ladder) {
+                costs.push_back(costModel.estimate(frames, candidate.steps, hopSize).totalSeconds()
+                                * static_cast<double>(numMixes));
+            }
+            settingsCosts.push_back(std::move(costs));
+            weights.push_back(plan.jobExposure[jobOrder[n]]);
+        }
+        auto choices = chooseSettingsWithinBudget(settingsCosts, weights, secondsLeft);
+        for (auto n = firstJob; n < jobOrder.size(); n++) {
+            plan.jobSettings[jobOrder[n]] = choices[n - firstJob];
+        }
+    }
+
+    void printDeadlinePlan(const DeadlinePlan &plan, double deadline) {
+        std::map<size_t, size_t> jobsPerSettings;
+        for (auto choice : plan.jobSettings) {
+            ++jobsPerSettings[choice];
+        }
+        std::cout << "Deadline " << deadline << " seconds:";
+        for (const auto &[choice, count] : jobsPerSettings) {
+            std::cout << ' ' << count << " jobs at speedup " << plan.ladder[choice].speedup
+                      << " (depth " << plan.ladder[choice].depth << ')';
+        }
+        std::cout << '\n';
+    }
+
+    size_t limitBatchToOneSetting(const DeadlinePlan &plan, const std::vector<size_t> &jobOrder, size_t numMixes,
+                                  size_t batchStart, size_t &batchEnd) {
+        auto choice = plan.jobSettings[jobOrder[batchStart / numMixes]];
+        for (auto n = batchStart + 1; n < batchEnd; n++) {
+            if (plan.jobSettings[jobOrder[n / numMixes]] != choice) {
+                batchEnd = n;
+                break;
+            }
+        }
+        return choice;
+    }
+
+}  // namespace diffsinger
@@ -0,0 +1,57 @@
+#ifndef DS_ONNX_INFER_DEADLINEPLAN_H
+#define DS_ONNX_INFER_DEADLINEPLAN_H
+
+#include <cstddef>
+#include <vector>
+
+#include "CostModel.h"
+#include "DsConfig.h"
+#include "RenderCommon.h"
+#include "RenderPlan.h"
+
+namespace diffsinger {
+
+    struct DiffusionSettings {
+        int speedup;
+        int depth;
+        int steps;
+    };
+
+    /**
+     * @brief The given (resolved) speedup and depth, followed by faster settings with fewer steps each,
+     *        down to a single step. Depths are rounded as in resolveDiffusionSettings.
+     */
+    std::vector<DiffusionSettings> fasterDiffusionSettings(const DsConfig &dsConfig, int speedup, int depth);
+
+    /**
+     * @brief Diffusion settings of each job of the final pass under --deadline.
+     */
+    struct DeadlinePlan {
+        std::vector<DiffusionSettings> ladder;  // From fasterDiffusionSettings
+        std::vector<double> jobExposure;        // Seconds each job is heard in the output
+        std::vector<size_t> jobSettings;        // Index into `ladder` of each job
+    };
+
+    DeadlinePlan makeDeadlinePlan(const RenderPlan &renderPlan, std::vector<DiffusionSettings> ladder);
+
+    /**
+     * @brief Chooses the settings of the jobs not started yet (`jobOrder[firstJob]` on) that let them finish in
+     *        `secondsLeft` by the cost model. Jobs heard for longer keep their quality longest.
+     */
+    void replanDeadline(DeadlinePlan &plan, const RenderSettings &settings, const RenderPlan &renderPlan,
+                        const std::vector<size_t> &jobOrder, size_t firstJob, const CostModel &costModel,
+                        double frameLength, int hopSize, size_t numMixes, double secondsLeft);
+
+    void printDeadlinePlan(const DeadlinePlan &plan, double deadline);
+
+    /**
+     * @brief Shortens the batch of units `[batchStart, batchEnd)` to the units sharing the settings of the first.
+     *
+     * @return Index into `plan.ladder` of the settings of the batch.
+     */
+    size_t limitBatchToOneSetting(const DeadlinePlan &plan, const std::vector<size_t> &jobOrder, size_t numMixes,
+                                  size_t batchStart, size_t &batchEnd);
+
+}  // namespace diffsinger
+
+#endif //DS_ONNX_INFER_DEADLINEPLAN_H
@@ -1,9 +1,12 @@
 #include <fstream>
 #include <filesystem>
+#include <iostream>
+#include <sstream>
 
 #include <yaml-cpp/yaml.h>
 
 #include "DsConfig.h"
+#include "VoicebankBundle.h"
 
 #ifdef _WIN32
 #define DS_STRING_CONVERT(x) diffsinger::MBStringToWString((x), 65001)
@@ -12,6 +15,95 @@
 #endif
 
 namespace diffsinger {
+    namespace {
+        // Options that do not refer to other files, shared by YAML files and voicebank bundles.
+        void loadAcousticOptions(const YAML::Node &config, DsConfig &dsConfig) {
+            if (config["vocoder"]) {
+                dsConfig.vocoder = config["vocoder"].as<std::string>();
+            }
+
+            if (config["augmentation_args"]) {
+                auto augmentation_args_node = config["augmentation_args"];
+
+                auto random_pitch_shifting_node = augmentation_args_node["random_pitch_shifting"];
+                auto pitch_range_node = random_pitch_shifting_node["range"];
+                dsConfig.randomPitchShifting.domain = AxisDomain::Linear;
+                dsConfig.randomPitchShifting.rangeLow = pitch_range_node[0].as<float>();
+                dsConfig.randomPitchShifting.rangeHigh = pitch_range_node[1].as<float>();
+                dsConfig.randomPitchShifting.scale = random_pitch_shifting_node["scale"].as<float>();
+
+                auto random_time_stretching_node = augmentation_args_node["random_time_stretching"];
+                dsConfig.randomTimeShifting.domain = random_time_stretching_node["domain"].as<std::string>() == "log" ? AxisDomain::Log : AxisDomain::Linear;
+                auto time_range_node = random_time_stretching_node["range"];
+                dsConfig.randomTimeShifting.rangeLow = time_range_node[0].as<float>();
+                dsConfig.randomTimeShifting.rangeHigh = time_range_node[1].as<float>();
+                dsConfig.randomTimeShifting.scale = random_time_stretching_node["scale"].as<float>();
+            }
+
+            if (config["use_key_shift_embed"]) {
+                dsConfig.useKeyShiftEmbed = config["use_key_shift_embed"].as<bool>();
+            }
+
+            if (config["use_speed_embed"]) {
+                dsConfig.useSpeedEmbed = config["use_speed_embed"].as<bool>();
+            }
+
+            if (config["use_energy_embed"]) {
+                dsConfig.useEnergyEmbed = config["use_energy_embed"].as<bool>();
+            }
+
+            if (config["use_breathiness_embed"]) {
+                dsConfig.useBreathinessEmbed = config["use_breathiness_embed"].as<bool>();
+            }
+
+            if (config["use_shallow_diffusion"]) {
+                dsConfig.useShallowDiffusion = config["use_shallow_diffusion"].as<bool>();
+            }
+
+            if (config["max_depth"]) {
+                dsConfig.maxDepth = config["max_depth"].as<int>();
+            }
+
+            if (config["speakers"]) {
+                dsConfig.speakers = config["speakers"].as<std::vector<std::string>>();
+            }
+
+            if (config["timesteps"]) {
+                dsConfig.timesteps = config["timesteps"].as<int>();
+            }
+
+            if (config["max_beta"]) {
+                dsConfig.maxBeta = config["max_beta"].as<float>();
+            }
+
+            if (config["spec_min"]) {
+                dsConfig.specMin = config["spec_min"].as<std::vector<float>>();
+            }
+
+            if (config["spec_max"]) {
+                dsConfig.specMax = config["spec_max"].as<std::vector<float>>();
+            }
+        }
+
+        void loadVocoderOptions(const YAML::Node &config, DsVocoderConfig &dsVocoderConfig) {
+            if (config["name"]) {
+                dsVocoderConfig.name = config["name"].as<std::string>();
+            }
+
+            if (config["num_mel_bins"]) {
+                dsVocoderConfig.numMelBins = config["num_mel_bins"].as<int>();
+            }
+
+            if (config["hop_size"]) {
+                dsVocoderConfig.hopSize = config["hop_size"].as<int>();
+            }
+
+            if (config["sample_rate"]) {
+                dsVocoderConfig.sampleRate = config["sample_rate"].as<int>();
+            }
+        }
+    }
+
     DsConfig DsConfig::fromYAML(const TString &dsConfigPath, bool *ok) {
         DsConfig dsConfig;
 
@@ -29,6 +121,7 @@ namespace diffsinger {
         if (config["phonemes"]) {
             auto phonemesFilename = DS_STRING_CONVERT(config["phonemes"].as<std::string>());
             dsConfig.phonemes = dsConfigDir / phonemesFilename;
+            dsConfig.phonemeTable = PhonemeTable::fromFile(dsConfig.phonemes);
         }
 
         if (config["acoustic"]) {
@@ -36,55 +129,67 @@ namespace diffsinger {
             dsConfig.acoustic = dsConfigDir / acousticFilename;
         }
 
-        if (config["vocoder"]) {
-            dsConfig.vocoder = config["vocoder"].as<std::string>();
+        if (config["denoiser"]) {
+            auto denoiserFilename = DS_STRING_CONVERT(config["denoiser"].as<std::string>());
+            dsConfig.denoiser = dsConfigDir / denoiserFilename;
         }
 
-        if (config["augmentation_args"]) {
-            auto augmentation_args_node = config["augmentation_args"];
-
-            auto random_pitch_shifting_node = augmentation_args_node["random_pitch_shifting"];
-            auto pitch_range_node = random_pitch_shifting_node["range"];
-            dsConfig.randomPitchShifting.domain = AxisDomain::Linear;
-            dsConfig.randomPitchShifting.rangeLow = pitch_range_node[0].as<float>();
-            dsConfig.randomPitchShifting.rangeHigh = pitch_range_node[1].as<float>();
-            dsConfig.randomPitchShifting.scale = random_pitch_shifting_node["scale"].as<float>();
+        loadAcousticOptions(config, dsConfig);
 
-            auto random_time_stretching_node = augmentation_args_node["random_time_stretching"];
-            dsConfig.randomTimeShifting.domain = random_time_stretching_node["domain"].as<std::string>() == "log" ? AxisDomain::Log : AxisDomain::Linear;
-            auto time_range_node = random_time_stretching_node["range"];
-            dsConfig.randomTimeShifting.rangeLow = time_range_node[0].as<float>();
-            dsConfig.randomTimeShifting.rangeHigh = time_range_node[1].as<float>();
-            dsConfig.randomTimeShifting.scale = random_time_stretching_node["scale"].as<float>();
+        if (!dsConfig.speakers.empty()) {
+            dsConfig.spkEmb.loadSpeakers(dsConfig.speakers, dsConfigDir);
         }
 
-        if (config["use_key_shift_embed"]) {
-            dsConfig.useKeyShiftEmbed = config["use_key_shift_embed"].as<bool>();
+        if (ok) {
+            *ok = true;
         }
+        return dsConfig;
+    }
 
-        if (config["use_speed_embed"]) {
-            dsConfig.useSpeedEmbed = config["use_speed_embed"].as<bool>();
-        }
+    DsConfig DsConfig::fromBundle(const VoicebankBundle &bundle, bool *ok) {
+        DsConfig dsConfig;
 
-        if (config["use_energy_embed"]) {
-            dsConfig.useEnergyEmbed = config["use_energy_embed"].as<bool>();
+        if (!bundle.hasSection(VoicebankBundle::ACOUSTIC_CONFIG) || !bundle.hasSection(VoicebankBundle::ACOUSTIC_MODEL)) {
+            if (ok) {
+                *ok = false;
+            }
+            return dsConfig;
         }
 
-        if (config["use_breathiness_embed"]) {
-            dsConfig.useBreathinessEmbed = config["use_breathiness_embed"].as<bool>();
-        }
+        YAML::Node config = YAML::Load(bundle.sectionString(VoicebankBundle::ACOUSTIC_CONFIG));
+        loadAcousticOptions(config, dsConfig);
 
-        if (config["use_shallow_diffusion"]) {
-            dsConfig.useShallowDiffusion = config["use_shallow_diffusion"].as<bool>();
+        bool isPhonemeTableOk = false;
+        dsConfig.phonemeTable = PhonemeTable::fromBuffer(bundle.section(VoicebankBundle::PHONEMES), &isPhonemeTableOk);
+        if (!isPhonemeTableOk) {
+            std::cout << "ERROR: The phoneme table in the bundle is invalid!\n";
+            if (ok) {
+                *ok = false;
+            }
+            return dsConfig;
         }
 
-        if (config["max_depth"]) {
-            dsConfig.maxDepth = config["max_depth"].as<int>();
+        // The bundle only contains speakers whose embeddings were loaded successfully when packing.
+        std::istringstream speakerNames(bundle.sectionString(VoicebankBundle::SPEAKER_NAMES));
+        std::vector<std::string> speakers;
+        std::string speaker;
+        while (std::getline(speakerNames, speaker)) {
+            speakers.push_back(speaker);
+        }
+        if (!dsConfig.spkEmb.loadSpeakersFromMatrix(speakers, bundle.section(VoicebankBundle::SPEAKER_EMBEDS))) {
+            std::cout << "ERROR: The speaker embedding matrix in the bundle does not match the speaker list!\n";
+            if (ok) {
+                *ok = false;
+            }
+            return dsConfig;
         }
+        dsConfig.speakers = std::move(speakers);
 
-        if (config["speakers"]) {
-            dsConfig.speakers = config["speakers"].as<std::vector<std::string>>();
-            dsConfig.spkEmb.loadSpeakers(dsConfig.speakers, dsConfigDir);
+        dsConfig.acoustic = std::filesystem::path(bundle.getPath()) / VoicebankBundle::ACOUSTIC_MODEL;
+        dsConfig.acousticData = bundle.section(VoicebankBundle::ACOUSTIC_MODEL);
+        if (bundle.hasSection(VoicebankBundle::DENOISER_MODEL)) {
+            dsConfig.denoiser = std::filesystem::path(bundle.getPath()) / VoicebankBundle::DENOISER_MODEL;
+            dsConfig.denoiserData = bundle.section(VoicebankBundle::DENOISER_MODEL);
         }
 
         if (ok) {
@@ -107,31 +212,105 @@ namespace diffsinger {
         auto dsVocoderConfigPathFs = std::filesystem::path(dsVocoderConfigPath);
         auto dsVocoderConfigDir = dsVocoderConfigPathFs.parent_path();
         YAML::Node config = YAML::Load(fileStream);
-        if (config["name"]) {
-            dsVocoderConfig.name = config["name"].as<std::string>();
-        }
-
         if (config["model"]) {
             auto model = DS_STRING_CONVERT(config["model"].as<std::string>());
             dsVocoderConfig.model = dsVocoderConfigDir / model;
         }
 
-        if (config["num_mel_bins"]) {
-            dsVocoderConfig.numMelBins = config["num_mel_bins"].as<int>();
+        loadVocoderOptions(config, dsVocoderConfig);
+
+        if (ok) {
+            *ok = true;
+        }
+        return dsVocoderConfig;
+    }
+
+    DsVocoderConfig DsVocoderConfig::fromBundle(const VoicebankBundle &bundle, bool *ok) {
+        DsVocoderConfig dsVocoderConfig;
+
+        if (!bundle.hasSection(VoicebankBundle::VOCODER_CONFIG) || !bundle.hasSection(VoicebankBundle::VOCODER_MODEL)) {
+            if (ok) {
+                *ok = false;
+            }
+            return dsVocoderConfig;
+        }
+
+        YAML::Node config = YAML::Load(bundle.sectionString(VoicebankBundle::VOCODER_CONFIG));
+        loadVocoderOptions(config, dsVocoderConfig);
+
+        dsVocoderConfig.model = std::filesystem::path(bundle.getPath()) / VoicebankBundle::VOCODER_MODEL;
+        dsVocoderConfig.modelData = bundle.section(VoicebankBundle::VOCODER_MODEL);
+
+        if (ok) {
+            *ok = true;
+        }
+        return dsVocoderConfig;
+    }
+
+    DsVarianceConfig DsVarianceConfig::fromYAML(const TString &dsVarianceConfigPath, bool *ok) {
+        DsVarianceConfig dsVarianceConfig;
+
+        std::ifstream fileStream(dsVarianceConfigPath);
+        if (!fileStream.is_open()) {
+            if (ok) {
+                *ok = false;
+            }
+            return dsVarianceConfig;
+        }
+
+        auto dsVarianceConfigPathFs = std::filesystem::path(dsVarianceConfigPath);
+        auto dsVarianceConfigDir = dsVarianceConfigPathFs.parent_path();
+        YAML::Node config = YAML::Load(fileStream);
+        if (config["phonemes"]) {
+            auto phonemesFilename = DS_STRING_CONVERT(config["phonemes"].as<std::string>());
+            dsVarianceConfig.phonemes = dsVarianceConfigDir / phonemesFilename;
+            dsVarianceConfig.phonemeTable = PhonemeTable::fromFile(dsVarianceConfig.phonemes);
+        }
+
+        if (config["linguistic"]) {
+            auto model = DS_STRING_CONVERT(config["linguistic"].as<std::string>());
+            dsVarianceConfig.linguistic = dsVarianceConfigDir / model;
+        }
+
+        if (config["variance"]) {
+            auto model = DS_STRING_CONVERT(config["variance"].as<std::string>());
+            dsVarianceConfig.variance = dsVarianceConfigDir / model;
+        }
+
+        if (config["pitch"]) {
+            auto model = DS_STRING_CONVERT(config["pitch"].as<std::string>());
+            dsVarianceConfig.pitch = dsVarianceConfigDir / model;
+        }
+
+        if (config["hidden_size"]) {
+            dsVarianceConfig.hiddenSize = config["hidden_size"].as<int>();
         }
 
         if (config["hop_size"]) {
-            dsVocoderConfig.hopSize = config["hop_size"].as<int>();
+            dsVarianceConfig.hopSize = config["hop_size"].as<int>();
         }
 
         if (config["sample_rate"]) {
-            dsVocoderConfig.sampleRate = config["sample_rate"].as<int>();
+            dsVarianceConfig.sampleRate = config["sample_rate"].as<int>();
+        }
+
+        if (config["predict_energy"]) {
+            dsVarianceConfig.predictEnergy = config["predict_energy"].as<bool>();
+        }
+
+        if (config["predict_breathiness"]) {
+            dsVarianceConfig.predictBreathiness = config["predict_breathiness"].as<bool>();
+        }
+
+        if (config["speakers"]) {
+            dsVarianceConfig.speakers = config["speakers"].as<std::vector<std::string>>();
+            dsVarianceConfig.spkEmb.loadSpeakers(dsVarianceConfig.speakers, dsVarianceConfigDir);
         }
 
         if (ok) {
             *ok = true;
         }
-        return dsVocoderConfig;
+        return dsVarianceConfig;
     }
 
     DsDurConfig DsDurConfig::fromYAML(const TString &dsDurConfigPath, bool *ok) {
@@ -151,6 +330,7 @@ namespace diffsinger {
         if (config["phonemes"]) {
             auto model = DS_STRING_CONVERT(config["phonemes"].as<std::string>());
             dsDurConfig.phonemes = dsDurConfigDir / model;
+            dsDurConfig.phonemeTable = PhonemeTable::fromFile(dsDurConfig.phonemes);
         }
 
         if (config["linguistic"]) {
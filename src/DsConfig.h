@@ -7,8 +7,12 @@
 
 #include "TString.h"
 #include "SpeakerEmbed.h"
+#include "PhonemeTable.h"
+#include "MappedFile.h"
 
 namespace diffsinger {
+    class VoicebankBundle;
+
     enum class AxisDomain {
         Linear,
         Log
@@ -18,12 +22,14 @@ namespace diffsinger {
         std::string name;
 
         std::filesystem::path model;
+        MappedBuffer modelData;  // Set if the model is loaded from a voicebank bundle; `model` is unused then.
 
         int numMelBins = 128;
         int hopSize = 512;
         int sampleRate = 44100;
 
         static DsVocoderConfig fromYAML(const TString &dsVocoderConfigPath, bool *ok = nullptr);
+        static DsVocoderConfig fromBundle(const VoicebankBundle &bundle, bool *ok = nullptr);
     };
 
 
@@ -37,9 +43,15 @@ namespace diffsinger {
     struct DsConfig {
         std::filesystem::path phonemes;
         std::filesystem::path acoustic;
+        MappedBuffer acousticData;  // Set if the model is loaded from a voicebank bundle; `acoustic` is unused then.
+
+        // Denoiser of a split acoustic model, whose `acoustic` model is the encoder. Empty for whole models.
+        std::filesystem::path denoiser;
+        MappedBuffer denoiserData;
         std::string vocoder;
         std::vector<std::string> speakers;
         SpeakerEmbed spkEmb;
+        PhonemeTable phonemeTable;
 
         AugmentationArgs randomTimeShifting {0.5f, 2.0f, 1.5f, AxisDomain::Log};
         AugmentationArgs randomPitchShifting{-5.0f, 5.0f, 1.5f, AxisDomain::Linear};
@@ -54,13 +66,39 @@ namespace diffsinger {
         bool useBreathinessEmbed = false;
         bool useShallowDiffusion = false;
 
+        // Diffusion parameters of split acoustic models.
+        int timesteps = 1000;
+        float maxBeta = 0.02f;
+        std::vector<float> specMin{-5.0f};  // One value for all mel bins, or one per mel bin
+        std::vector<float> specMax{0.0f};
+
         static DsConfig fromYAML(const TString &dsConfigPath, bool *ok = nullptr);
+        static DsConfig fromBundle(const VoicebankBundle &bundle, bool *ok = nullptr);
+    };
+
+    struct DsVarianceConfig {
+        std::filesystem::path phonemes;
+        std::filesystem::path linguistic;
+        std::filesystem::path variance;
+        std::filesystem::path pitch;
+        std::vector<std::string> speakers;
+        SpeakerEmbed spkEmb;
+        PhonemeTable phonemeTable;
+
+        int hiddenSize = 256;
+        int hopSize = 512;
+        int sampleRate = 44100;
+        bool predictEnergy = false;
+        bool predictBreathiness = false;
+
+        static DsVarianceConfig fromYAML(const TString &dsVarianceConfigPath, bool *ok = nullptr);
     };
 
     struct DsDurConfig {
         std::filesystem::path phonemes;
         std::filesystem::path linguistic;
         std::filesystem::path dur;
+        PhonemeTable phonemeTable;
 
         int hopSize = 512;
         int sampleRate = 44100;
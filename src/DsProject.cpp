@@ -1,12 +1,17 @@
 #include <fstream>
+#include <iomanip>
 #include <iostream>
 #include <regex>
+#include <sstream>
 
 #include <rapidjson/document.h>
 #include <rapidjson/istreamwrapper.h>
+#include <rapidjson/ostreamwrapper.h>
+#include <rapidjson/prettywriter.h>
 
 #include "ArrayUtil.hpp"
 #include "DsProject.h"
+#include "FileUtil.h"
 #include "SpeakerEmbed.h"
 
 namespace diffsinger {
@@ -42,28 +47,24 @@ namespace diffsinger {
                 continue;
             }
 
-            // TODO: ph_dur and f0 curve can be inferred using rhythmizers and autopitch models.
-            //       In this case, these parameters can be omitted from .ds files, but note sequences
-            //       must be supplied.
-            if (!segment.HasMember("ph_seq")
-                || !segment.HasMember("ph_dur")
-                || !segment.HasMember("f0_seq")
-                || !segment.HasMember("f0_timestep")) {
+            // ph_dur and f0_seq may be omitted, in which case they are predicted from the notes
+            // by the duration and pitch models.
+            if (!segment.HasMember("ph_seq")) {
                 std::cout << "Segment at index " << i
-                          << " must contain required keys (ph_seq, ph_dur, f0_seq, f0_timestep)!\n";
+                          << " must contain required keys (ph_seq)!\n";
                 continue;
             }
-            if (!segment["ph_seq"].IsString()
-                || !segment["ph_dur"].IsString()
-                || !segment["f0_seq"].IsString()
-                || !(segment["f0_timestep"].IsNumber() || segment["f0_timestep"].IsString())) {
+            if (!segment["ph_seq"].IsString()) {
                 std::cout << "Segment at index " << i
-                          << " must contain valid keys (ph_seq, ph_dur, f0_seq, f0_timestep)!\n";
+                          << " must contain valid keys (ph_seq)!\n";
                 continue;
             }
+            dsSegment.index = i;
 
             dsSegment.ph_seq = splitString<std::string>(segment["ph_seq"].GetString());
-            dsSegment.ph_dur = splitString<double>(segment["ph_dur"].GetString());
+            if (segment.HasMember("ph_dur") && segment["ph_dur"].IsString()) {
+                dsSegment.ph_dur = splitString<double>(segment["ph_dur"].GetString());
+            }
 
             // ph_num (word_div)
             if (segment.HasMember("ph_num") && segment["ph_num"].IsString()) {
@@ -131,6 +132,95 @@ namespace diffsinger {
         return result;
     }
 
+    bool saveDsProjectPredictions(const TString &dsFilePath, const std::vector<DsSegment> &segments) {
+        rapidjson::Document data;
+        {
+            std::ifstream dsFile(dsFilePath);
+            if (!dsFile.is_open()) {
+                std::cout << "Failed to open file!\n";
+                return false;
+            }
+            rapidjson::IStreamWrapper streamWrapper(dsFile);
+            data.ParseStream(streamWrapper);
+        }
+        if (!data.IsArray()) {
+            std::cout << "Invalid ds file format!\n";
+            return false;
+        }
+
+        auto &allocator = data.GetAllocator();
+        auto setCurve = [&allocator](rapidjson::Value &segment, const char *sampleKey, const char *timestepKey,
+                                     const SampleCurve &curve, int precision) {
+            std::ostringstream oss;
+            oss << std::fixed << std::setprecision(precision);
+            for (size_t i = 0; i < curve.samples.size(); ++i) {
+                if (i > 0) {
+                    oss << ' ';
+                }
+                oss << curve.samples[i];
+            }
+            rapidjson::Value samples(oss.str().c_str(), allocator);
+            rapidjson::Value timestep(curve.timestep);
+            if (segment.HasMember(sampleKey)) {
+                segment[sampleKey] = samples;
+            } else {
+                rapidjson::Value name(sampleKey, allocator);
+                segment.AddMember(name, samples, allocator);
+            }
+            if (segment.HasMember(timestepKey)) {
+                segment[timestepKey] = timestep;
+            } else {
+                rapidjson::Value name(timestepKey, allocator);
+                segment.AddMember(name, timestep, allocator);
+            }
+        };
+
+        for (const auto &dsSegment : segments) {
+            if (dsSegment.index >= data.Size() || !data[dsSegment.index].IsObject()) {
+                continue;
+            }
+            auto &segment = data[dsSegment.index];
+            if (dsSegment.isPhDurPredicted) {
+                std::ostringstream oss;
+                oss << std::fixed << std::setprecision(6);
+                for (size_t i = 0; i < dsSegment.ph_dur.size(); ++i) {
+                    if (i > 0) {
+                        oss << ' ';
+                    }
+                    oss << dsSegment.ph_dur[i];
+                }
+                rapidjson::Value phDur(oss.str().c_str(), allocator);
+                if (segment.HasMember("ph_dur")) {
+                    segment["ph_dur"] = phDur;
+                } else {
+                    rapidjson::Value name("ph_dur", allocator);
+                    segment.AddMember(name, phDur, allocator);
+                }
+            }
+            if (dsSegment.isF0Predicted) {
+                setCurve(segment, "f0_seq", "f0_timestep", dsSegment.f0, 1);
+            }
+            if (dsSegment.isEnergyPredicted) {
+                setCurve(segment, "energy", "energy_timestep", dsSegment.energy, 4);
+            }
+            if (dsSegment.isBreathinessPredicted) {
+                setCurve(segment, "breathiness", "breathiness_timestep", dsSegment.breathiness, 4);
+            }
+        }
+
+        bool isWriteOk = writeFileAtomically(dsFilePath, [&data](std::ostream &outFile) {
+            rapidjson::OStreamWrapper streamWrapper(outFile);
+            rapidjson::PrettyWriter<rapidjson::OStreamWrapper> writer(streamWrapper);
+            writer.SetIndent(' ', 2);
+            data.Accept(writer);
+            return true;
+        });
+        if (!isWriteOk) {
+            std::cout << "Failed to write file!\n";
+        }
+        return isWriteOk;
+    }
+
     int pitchOffset(char pitch) {
         switch (pitch) {
             case 'C':
@@ -11,6 +11,7 @@
 namespace diffsinger {
 
     struct DsSegment {
+        size_t index = 0;  // Index of the segment in the .ds file
         double offset = 0.0;
         std::vector<std::string> ph_seq;
         std::vector<double> ph_dur;
@@ -23,10 +24,24 @@ namespace diffsinger {
         SampleCurve energy;
         SampleCurve breathiness;
         SpeakerMixCurve spk_mix;
+
+        // Set for parameters predicted by the variance models instead of loaded from the .ds file.
+        bool isPhDurPredicted = false;
+        bool isF0Predicted = false;
+        bool isEnergyPredicted = false;
+        bool isBreathinessPredicted = false;
     };
 
     std::vector<DsSegment> loadDsProject(const TString &dsFilePath, const std::string &spkMixStr = "");
 
+    /**
+     * @brief Writes the predicted parameters of the segments back into the .ds file.
+     *
+     * Only the predicted parameters are replaced; everything else in the file is kept as is.
+     * The file is replaced atomically.
+     */
+    bool saveDsProjectPredictions(const TString &dsFilePath, const std::vector<DsSegment> &segments);
+
     int noteNameToMidi(const std::string &note);
 
 }
@@ -0,0 +1,140 @@
+#include <algorithm>
+#include <iostream>
+#include <numeric>
+
+#include "DurationPipeline.h"
+#include "Preprocess.h"
+
+namespace diffsinger {
+
+    DurationPipeline::DurationPipeline(const DsDurConfig &config)
+            : m_config(config),
+              m_frameLength(1.0 * config.hopSize / config.sampleRate),
+              m_linguisticInference(config.linguistic),
+              m_durInference(config.dur) {}
+
+    bool DurationPipeline::initSessions(ExecutionProvider ep, int deviceIndex, const SessionConfig &sessionConfig) {
+        if (!m_linguisticInference.initSession(ep, deviceIndex, sessionConfig)) {
+            std::cout << "ERROR: Linguistic encoder session initialization failed.\n";
+            return false;
+        }
+        if (m_linguisticInference.usesPhonemeDurations()) {
+            std::cout << "ERROR: The linguistic encoder of the duration predictor must take words "
+                         "(word_div, word_dur), not phoneme durations.\n";
+            return false;
+        }
+        if (!m_durInference.initSession(ep, deviceIndex, sessionConfig)) {
+            std::cout << "ERROR: Duration predictor session initialization failed.\n";
+            return false;
+        }
+        return true;
+    }
+
+    void DurationPipeline::endSessions() {
+        m_linguisticInference.endSession();
+        m_durInference.endSession();
+    }
+
+    bool DurationPipeline::fillDurations(std::vector<DsSegment> &segments) {
+        std::vector<size_t> indices;
+        for (size_t i = 0; i < segments.size(); ++i) {
+            if (!segments[i].ph_dur.empty()) {
+                continue;
+            }
+            const auto &segment = segments[i];
+            auto numPhonemes = std::accumulate(segment.ph_num.begin(), segment.ph_num.end(), static_cast<size_t>(0));
+            if (segment.ph_num.empty()
+                || numPhonemes != segment.ph_seq.size()
+                || segment.note_seq.size() != segment.ph_num.size()
+                || segment.note_dur.size() != segment.ph_num.size()) {
+                std::cout << "ERROR: Segment at index " << segment.index
+                          << " has no ph_dur, and no valid words (ph_num, note_seq, note_dur) to predict it from.\n";
+                return false;
+            }
+            indices.push_back(i);
+        }
+        if (indices.empty()) {
+            return true;
+        }
+
+        // Sorting by phoneme count keeps the padding within each batch small.
+        std::stable_sort(indices.begin(), indices.end(), [&segments](size_t a, size_t b) {
+            return segments[a].ph_seq.size() < segments[b].ph_seq.size();
+        });
+
+        for (size_t batchStart = 0; batchStart < indices.size(); batchStart += maxBatchSize) {
+            auto batchEnd = std::min(indices.size(), batchStart + maxBatchSize);
+            std::vector<size_t> batch(indices.begin() + batchStart, indices.begin() + batchEnd);
+
+            std::vector<LinguisticInput> linguisticInputs;
+            std::vector<std::vector<int>> phMidi;
+            linguisticInputs.reserve(batch.size());
+            phMidi.reserve(batch.size());
+            for (auto i : batch) {
+                linguisticInputs.push_back(linguisticPreprocess(m_config.phonemeTable, segments[i], m_frameLength));
+                phMidi.push_back(fillZeroMidiWithNearest(noteMidiToDurMidi(segments[i].note_seq, segments[i].ph_num)));
+            }
+
+            std::vector<const LinguisticInput *> linguisticInputPtrs;
+            std::vector<const std::vector<int> *> phMidiPtrs;
+            for (size_t k = 0; k < batch.size(); ++k) {
+                linguisticInputPtrs.push_back(&linguisticInputs[k]);
+                phMidiPtrs.push_back(&phMidi[k]);
+            }
+
+            std::vector<std::vector<float>> phDurPred;
+            try {
+                auto encoded = m_linguisticInference.inferBatch(linguisticInputPtrs);
+                if (encoded.size() != batch.size()) {
+                    std::cout << "ERROR: Linguistic encoding failed.\n";
+                    return false;
+                }
+                std::vector<const LinguisticEncodedData *> encodedPtrs;
+                for (const auto &item : encoded) {
+                    encodedPtrs.push_back(&item);
+                }
+                phDurPred = m_durInference.inferBatch(encodedPtrs, phMidiPtrs);
+            }
+            catch (const Ort::Exception &ortException) {
+                std::cout << "ERROR: Duration prediction failed: " << ortException.what() << '\n';
+                return false;
+            }
+            if (phDurPred.size() != batch.size()) {
+                std::cout << "ERROR: Duration prediction failed.\n";
+                return false;
+            }
+
+            for (size_t k = 0; k < batch.size(); ++k) {
+                auto &segment = segments[batch[k]];
+                segment.ph_dur = fitToWords(phDurPred[k], segment.ph_num, linguisticInputs[k].word_dur);
+                segment.isPhDurPredicted = true;
+            }
+        }
+        return true;
+    }
+
+    std::vector<double> DurationPipeline::fitToWords(const std::vector<float> &phDurPred,
+                                                     const std::vector<int> &phNum,
+                                                     const std::vector<int64_t> &wordDur) const {
+        std::vector<double> phDur;
+        phDur.reserve(phDurPred.size());
+
+        size_t phStart = 0;
+        for (size_t word = 0; word < phNum.size() && word < wordDur.size(); ++word) {
+            auto phEnd = std::min(phStart + phNum[word], phDurPred.size());
+            double predSum = 0.0;
+            for (auto i = phStart; i < phEnd; ++i) {
+                predSum += std::max(phDurPred[i], 0.0f);
+            }
+            auto numPhonemes = static_cast<double>(phEnd - phStart);
+            for (auto i = phStart; i < phEnd; ++i) {
+                // Split evenly if the model predicts nothing for the whole word.
+                double ratio = (predSum > 0) ? std::max(phDurPred[i], 0.0f) / predSum : 1.0 / numPhonemes;
+                phDur.push_back(ratio * static_cast<double>(wordDur[word]) * m_frameLength);
+            }
+            phStart = phEnd;
+        }
+        return phDur;
+    }
+
+}  // namespace diffsinger
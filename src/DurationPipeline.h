@@ -0,0 +1,58 @@
+#ifndef DS_ONNX_INFER_DURATIONPIPELINE_H
+#define DS_ONNX_INFER_DURATIONPIPELINE_H
+
+#include <vector>
+
+#include "DsConfig.h"
+#include "DsProject.h"
+#include "Inference/LinguisticInference.h"
+#include "Inference/PhonemeDurInference.h"
+
+namespace diffsinger {
+
+    /**
+     * @brief Predicts phoneme durations from the notes (rhythmizer), for segments without ph_dur.
+     *
+     * Segments are encoded and predicted in padded batches of similar lengths instead of one call per phrase.
+     * The predicted durations of each word are scaled to fill the word exactly.
+     *
+     * The config must outlive the pipeline.
+     */
+    class DurationPipeline {
+    public:
+        explicit DurationPipeline(const DsDurConfig &config);
+
+        bool initSessions(ExecutionProvider ep = ExecutionProvider::CPU, int deviceIndex = 0,
+                          const SessionConfig &sessionConfig = {});
+
+        void endSessions();
+
+        /**
+         * @brief Predicts ph_dur for the segments that do not have it.
+         *
+         * Requires ph_num, note_seq and note_dur, with one note per word.
+         *
+         * @return false if a segment lacks the notes, or the inference failed.
+         */
+        bool fillDurations(std::vector<DsSegment> &segments);
+
+    private:
+        static constexpr size_t maxBatchSize = 8;
+
+        const DsDurConfig &m_config;
+        double m_frameLength;
+        LinguisticInference m_linguisticInference;
+        PhonemeDurInference m_durInference;
+
+        /**
+         * @brief Scales the predicted durations (in frames) of each word to the word duration,
+         *        and converts them to seconds.
+         */
+        std::vector<double> fitToWords(const std::vector<float> &phDurPred,
+                                       const std::vector<int> &phNum,
+                                       const std::vector<int64_t> &wordDur) const;
+    };  // class DurationPipeline
+
+}  // namespace diffsinger
+
+#endif //DS_ONNX_INFER_DURATIONPIPELINE_H
@@ -0,0 +1,75 @@
+#include <cstdlib>
+#include <fstream>
+#include <random>
+
+#include "FileUtil.h"
+
+namespace diffsinger {
+
+    std::filesystem::path defaultCacheDirectory() {
+        constexpr auto appDirName = "ds_onnx_infer";
+#if defined(_WIN32)
+        if (auto localAppData = ::_wgetenv(L"LOCALAPPDATA"); localAppData && *localAppData) {
+            return std::filesystem::path(localAppData) / appDirName;
+        }
+#elif defined(__APPLE__)
+        if (auto home = std::getenv("HOME"); home && *home) {
+            return std::filesystem::path(home) / "Library" / "Caches" / appDirName;
+        }
+#else
+        if (auto xdgCacheHome = std::getenv("XDG_CACHE_HOME"); xdgCacheHome && *xdgCacheHome) {
+            return std::filesystem::path(xdgCacheHome) / appDirName;
+        }
+        if (auto home = std::getenv("HOME"); home && *home) {
+            return std::filesystem::path(home) / ".cache" / appDirName;
+        }
+#endif
+        return {};
+    }
+
+    std::filesystem::path makeTemporaryPath(const std::filesystem::path &target) {
+        thread_local std::mt19937_64 generator{std::random_device{}()};
+        auto suffix = std::to_string(generator());
+        auto tempPath = target;
+        tempPath += ".tmp-" + suffix;
+        return tempPath;
+    }
+
+    bool replaceFileAtomically(const std::filesystem::path &source, const std::filesystem::path &target) {
+        std::error_code ec;
+        std::filesystem::rename(source, target, ec);
+        if (ec) {
+            std::filesystem::remove(source, ec);
+            return false;
+        }
+        return true;
+    }
+
+    bool writeFileAtomicallyByPath(const std::filesystem::path &target,
+                                   const std::function<bool(const std::filesystem::path &)> &writeTemporary) {
+        std::error_code ec;
+        if (target.has_parent_path()) {
+            std::filesystem::create_directories(target.parent_path(), ec);
+        }
+        auto tempPath = makeTemporaryPath(target);
+        if (!writeTemporary(tempPath)) {
+            std::filesystem::remove(tempPath, ec);
+            return false;
+        }
+        return replaceFileAtomically(tempPath, target);
+    }
+
+    bool writeFileAtomically(const std::filesystem::path &target, const std::function<bool(std::ostream &)> &write,
+                             bool isBinary) {
+        return writeFileAtomicallyByPath(target, [&write, isBinary](const std::filesystem::path &tempPath) {
+            std::ofstream file(tempPath, isBinary ? std::ios::out | std::ios::binary : std::ios::out);
+            if (!file.is_open() || !write(file)) {
+                return false;
+            }
+            // Closed before the rename, which also flushes it.
+            file.close();
+            return !file.fail();
+        });
+    }
+
+}  // namespace diffsinger
@@ -0,0 +1,48 @@
+#ifndef DS_ONNX_INFER_FILEUTIL_H
+#define DS_ONNX_INFER_FILEUTIL_H
+
+#include <filesystem>
+#include <functional>
+#include <ostream>
+
+namespace diffsinger {
+
+    /**
+     * @brief Returns the per-user cache directory of this program, e.g. `~/.cache/ds_onnx_infer`
+     *        on Linux or `%LOCALAPPDATA%\ds_onnx_infer` on Windows.
+     *
+     * @return The directory (not necessarily existing yet), or an empty path if it cannot be determined.
+     */
+    std::filesystem::path defaultCacheDirectory();
+
+    /**
+     * @brief Returns a unique temporary path in the same directory as `target`, so that the
+     *        temporary file can be atomically renamed to `target` once it is completely written.
+     */
+    std::filesystem::path makeTemporaryPath(const std::filesystem::path &target);
+
+    /**
+     * @brief Atomically replaces `target` with `source`. `source` is removed on failure.
+     */
+    bool replaceFileAtomically(const std::filesystem::path &source, const std::filesystem::path &target);
+
+    /**
+     * @brief Writes `target` through a temporary file in the same directory (created if missing), so that
+     *        readers never see a half-written file.
+     *
+     * @param writeTemporary  Writes the temporary file at the given path. Returns false on failure, after which
+     *                        the temporary file is removed and `target` is left as it is.
+     */
+    bool writeFileAtomicallyByPath(const std::filesystem::path &target,
+                                   const std::function<bool(const std::filesystem::path &)> &writeTemporary);
+
+    /**
+     * @brief Like `writeFileAtomicallyByPath`, for contents written to a stream. The write fails if `write`
+     *        returns false or the stream fails.
+     */
+    bool writeFileAtomically(const std::filesystem::path &target, const std::function<bool(std::ostream &)> &write,
+                             bool isBinary = false);
+
+}  // namespace diffsinger
+
+#endif //DS_ONNX_INFER_FILEUTIL_H
@@ -0,0 +1,124 @@
+#include <cerrno>
+#include <chrono>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <thread>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#include "FileWatcher.h"
+#include "HashUtil.hpp"
+
+namespace diffsinger {
+
+    namespace {
+        // Editors may write a file in several steps; a save is complete once nothing happened for this long.
+        constexpr int SETTLE_TIME_MS = 150;
+
+        // Interval of checking the modification time where inotify is not available.
+        constexpr int POLL_INTERVAL_MS = 250;
+    }
+
+    FileWatcher::FileWatcher(std::filesystem::path path)
+            : m_path(std::move(path)) {
+        std::error_code ec;
+        m_lastWriteTime = std::filesystem::last_write_time(m_path, ec);
+        m_contentHash = hashContent();
+#ifdef __linux__
+        m_inotifyFd = ::inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
+        if (m_inotifyFd >= 0) {
+            auto directory = m_path.parent_path().empty() ? std::filesystem::path(".") : m_path.parent_path();
+            if (::inotify_add_watch(m_inotifyFd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE) < 0) {
+                ::close(m_inotifyFd);
+                m_inotifyFd = -1;
+            }
+        }
+#endif
+    }
+
+    FileWatcher::~FileWatcher() {
+#ifdef __linux__
+        if (m_inotifyFd >= 0) {
+            ::close(m_inotifyFd);
+        }
+#endif
+    }
+
+    bool FileWatcher::waitForChange() {
+        while (true) {
+            if (!waitForEvent(-1)) {
+                return false;
+            }
+            while (waitForEvent(SETTLE_TIME_MS)) {
+            }
+            auto contentHash = hashContent();
+            if (contentHash != 0 && contentHash != m_contentHash) {
+                m_contentHash = contentHash;
+                return true;
+            }
+        }
+    }
+
+    void FileWatcher::acceptCurrentContent() {
+        std::error_code ec;
+        m_lastWriteTime = std::filesystem::last_write_time(m_path, ec);
+        m_contentHash = hashContent();
+    }
+
+    bool FileWatcher::waitForEvent(int timeoutMs) {
+#ifdef __linux__
+        if (m_inotifyFd >= 0) {
+            auto fileName = m_path.filename().native();
+            alignas(inotify_event) char buffer[4096];
+            while (true) {
+                pollfd pfd{m_inotifyFd, POLLIN, 0};
+                auto ready = ::poll(&pfd, 1, timeoutMs);
+                if (ready < 0 && errno == EINTR) {
+                    continue;
+                }
+                if (ready <= 0) {
+                    return false;
+                }
+                auto length = ::read(m_inotifyFd, buffer, sizeof(buffer));
+                if (length <= 0) {
+                    continue;
+                }
+                for (char *p = buffer; p < buffer + length;) {
+                    auto *event = reinterpret_cast<inotify_event *>(p);
+                    if (event->len > 0 && fileName == event->name) {
+                        return true;
+                    }
+                    p += sizeof(inotify_event) + event->len;
+                }
+            }
+        }
+#endif
+        auto waited = 0;
+        while (timeoutMs < 0 || waited < timeoutMs) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(POLL_INTERVAL_MS));
+            waited += POLL_INTERVAL_MS;
+            std::error_code ec;
+            auto writeTime = std::filesystem::last_write_time(m_path, ec);
+            if (!ec && writeTime != m_lastWriteTime) {
+                m_lastWriteTime = writeTime;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    uint64_t FileWatcher::hashContent() const {
+        std::ifstream file(m_path, std::ios::binary);
+        if (!file.is_open()) {
+            return 0;
+        }
+        std::string content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        return Hasher().update(content).digest();
+    }
+
+}  // namespace diffsinger
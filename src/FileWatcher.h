@@ -0,0 +1,48 @@
+#ifndef DS_ONNX_INFER_FILEWATCHER_H
+#define DS_ONNX_INFER_FILEWATCHER_H
+
+#include <cstdint>
+#include <filesystem>
+
+namespace diffsinger {
+
+    /**
+     * @brief Waits for changes to the content of a file.
+     *
+     * The directory of the file is watched with inotify on Linux, so that editors replacing the file on save
+     * are noticed too; elsewhere, the modification time is polled. Saves are only reported once the file has
+     * been quiet for a moment, and only if its content actually changed.
+     */
+    class FileWatcher {
+    public:
+        explicit FileWatcher(std::filesystem::path path);
+        ~FileWatcher();
+
+        FileWatcher(const FileWatcher &) = delete;
+        FileWatcher &operator=(const FileWatcher &) = delete;
+
+        /**
+         * @brief Blocks until the content of the file differs from the last seen content.
+         *
+         * @return false if the file can no longer be watched.
+         */
+        bool waitForChange();
+
+        /**
+         * @brief Takes the current content of the file as seen, e.g. after this program wrote to it.
+         */
+        void acceptCurrentContent();
+
+    private:
+        std::filesystem::path m_path;
+        uint64_t m_contentHash = 0;
+        int m_inotifyFd = -1;
+        std::filesystem::file_time_type m_lastWriteTime;
+
+        bool waitForEvent(int timeoutMs);
+        uint64_t hashContent() const;
+    };  // class FileWatcher
+
+}  // namespace diffsinger
+
+#endif //DS_ONNX_INFER_FILEWATCHER_H
@@ -0,0 +1,120 @@
+#ifndef DS_ONNX_INFER_HASHUTIL_HPP
+#define DS_ONNX_INFER_HASHUTIL_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+namespace diffsinger {
+
+    /**
+     * @brief Incremental 64-bit non-cryptographic hash for cache keys.
+     *
+     * Input is consumed 8 bytes at a time, so hashing large buffers (e.g. model files) runs at
+     * close to memory bandwidth. Containers are hashed together with their sizes, so that e.g.
+     * {"ab", "c"} and {"a", "bc"} produce different digests.
+     */
+    class Hasher {
+    public:
+        Hasher() : m_state(0x9E3779B97F4A7C15ull), m_length(0) {}
+
+        Hasher &update(const void *data, size_t size);
+
+        Hasher &update(std::string_view str) {
+            updateValue(static_cast<uint64_t>(str.size()));
+            return update(str.data(), str.size());
+        }
+
+        template<class T>
+        Hasher &update(const std::vector<T> &vec);
+
+        Hasher &update(const std::vector<std::string> &vec);
+
+        template<class T>
+        Hasher &updateValue(const T &value);
+
+        uint64_t digest() const;
+
+    private:
+        static uint64_t mix(uint64_t word) {
+            word *= 0xBF58476D1CE4E5B9ull;
+            word ^= word >> 31;
+            return word;
+        }
+
+        uint64_t m_state;
+        uint64_t m_length;
+    };  // class Hasher
+
+    inline std::string toHexString(uint64_t value);
+
+
+    /* IMPLEMENTATION BELOW */
+
+    inline Hasher &Hasher::update(const void *data, size_t size) {
+        auto bytes = static_cast<const unsigned char *>(data);
+        m_length += size;
+        while (size >= sizeof(uint64_t)) {
+            uint64_t word;
+            std::memcpy(&word, bytes, sizeof(word));
+            m_state = (m_state ^ mix(word)) * 0x94D049BB133111EBull;
+            m_state = (m_state << 27) | (m_state >> 37);
+            bytes += sizeof(word);
+            size -= sizeof(word);
+        }
+        if (size > 0) {
+            uint64_t word = 0;
+            std::memcpy(&word, bytes, size);
+            m_state = (m_state ^ mix(word ^ (static_cast<uint64_t>(size) << 56))) * 0x94D049BB133111EBull;
+        }
+        return *this;
+    }
+
+    template<class T>
+    Hasher &Hasher::update(const std::vector<T> &vec) {
+        static_assert(std::is_trivially_copyable_v<T>, "Only vectors of trivially copyable types can be hashed.");
+        updateValue(static_cast<uint64_t>(vec.size()));
+        return update(vec.data(), vec.size() * sizeof(T));
+    }
+
+    inline Hasher &Hasher::update(const std::vector<std::string> &vec) {
+        updateValue(static_cast<uint64_t>(vec.size()));
+        for (const auto &str : vec) {
+            update(std::string_view(str));
+        }
+        return *this;
+    }
+
+    template<class T>
+    Hasher &Hasher::updateValue(const T &value) {
+        static_assert(std::is_trivially_copyable_v<T>, "Only trivially copyable values can be hashed.");
+        return update(&value, sizeof(T));
+    }
+
+    inline uint64_t Hasher::digest() const {
+        // splitmix64 finalizer
+        uint64_t x = m_state ^ m_length;
+        x ^= x >> 30;
+        x *= 0xBF58476D1CE4E5B9ull;
+        x ^= x >> 27;
+        x *= 0x94D049BB133111EBull;
+        x ^= x >> 31;
+        return x;
+    }
+
+    std::string toHexString(uint64_t value) {
+        constexpr char digits[] = "0123456789abcdef";
+        std::string str(16, '0');
+        for (int i = 15; i >= 0; --i) {
+            str[i] = digits[value & 0xF];
+            value >>= 4;
+        }
+        return str;
+    }
+
+}  // namespace diffsinger
+
+#endif //DS_ONNX_INFER_HASHUTIL_HPP
@@ -0,0 +1,214 @@
+#include <algorithm>
+#include <fstream>
+
+#include "BinaryFile.hpp"
+#include "FileUtil.h"
+#include "HashUtil.hpp"
+#include "IncrementalRender.h"
+
+namespace diffsinger {
+
+    namespace {
+        // File layout: magic, uint64 key, int64 leading frames, int64 trailing frames,
+        //              uint64 frame count, uint64[frame count], int64 waveform start,
+        //              uint64 sample count, float[sample count]
+        constexpr BinaryFileMagic STATE_MAGIC = {'D', 'S', 'J', 'O', 'B', 'S', '0', '1'};
+
+        float sampleAt(const JobWaveform &waveform, int64_t position) {
+            auto index = position - waveform.first;
+            if (index < 0 || index >= static_cast<int64_t>(waveform.second.size())) {
+                return 0.0f;
+            }
+            return waveform.second[index];
+        }
+    }
+
+    std::vector<uint64_t> hashAcousticFrames(const PreprocessedData &pd, int64_t numFrames) {
+        numFrames = std::min(numFrames, static_cast<int64_t>(pd.f0.size()));
+        if (numFrames <= 0) {
+            return {};
+        }
+
+        std::vector<int64_t> frameTokens;
+        frameTokens.reserve(numFrames);
+        for (size_t i = 0; i < pd.tokens.size() && i < pd.durations.size(); ++i) {
+            frameTokens.insert(frameTokens.end(), pd.durations[i], pd.tokens[i]);
+        }
+        auto embedSize = pd.spk_embed.size() / pd.f0.size();
+
+        std::vector<uint64_t> hashes(numFrames);
+        for (int64_t t = 0; t < numFrames; ++t) {
+            Hasher hasher;
+            hasher.updateValue(t < static_cast<int64_t>(frameTokens.size()) ? frameTokens[t] : int64_t(-1));
+            hasher.updateValue(pd.f0[t]);
+            for (const auto *curve : {&pd.velocity, &pd.gender, &pd.energy, &pd.breathiness}) {
+                if (t < static_cast<int64_t>(curve->size())) {
+                    hasher.updateValue((*curve)[t]);
+                }
+            }
+            if (embedSize > 0) {
+                hasher.update(pd.spk_embed.data() + t * embedSize, embedSize * sizeof(float));
+            }
+            hashes[t] = hasher.digest();
+        }
+        return hashes;
+    }
+
+    JobWaveform spliceWaveform(const JobWaveform &previous, const JobWaveform &replacement,
+                               int64_t spliceStart, int64_t spliceEnd, int64_t fadeIn, int64_t fadeOut) {
+        // The replacement is heard (with a gain above zero) in [mixStart, mixEnd).
+        auto mixStart = spliceStart - fadeIn / 2;
+        auto mixEnd = spliceEnd + fadeOut / 2;
+        auto previousEnd = previous.first + static_cast<int64_t>(previous.second.size());
+        auto replacementEnd = replacement.first + static_cast<int64_t>(replacement.second.size());
+        auto start = std::min(previous.first, std::max(mixStart, replacement.first));
+        auto end = std::max(previousEnd, std::min(mixEnd, replacementEnd));
+        if (end <= start) {
+            return {0, {}};
+        }
+
+        std::vector<float> samples(end - start);
+        for (auto t = start; t < end; ++t) {
+            float gain = 0.0f;
+            if (t >= mixStart && t < mixEnd) {
+                gain = 1.0f;
+                if (t < mixStart + fadeIn) {
+                    gain = std::min(gain, (static_cast<float>(t - mixStart) + 0.5f) / static_cast<float>(fadeIn));
+                }
+                if (t >= mixEnd - fadeOut) {
+                    gain = std::min(gain, (static_cast<float>(mixEnd - t) - 0.5f) / static_cast<float>(fadeOut));
+                }
+            }
+            samples[t - start] = (1.0f - gain) * sampleAt(previous, t) + gain * sampleAt(replacement, t);
+        }
+        return {start, std::move(samples)};
+    }
+
+    IncrementalRenderer::IncrementalRenderer(std::filesystem::path directory, double contextSeconds,
+                                             int sampleRate, int hopSize)
+            : m_directory(std::move(directory)),
+              m_contextFrames(std::max(static_cast<int64_t>(contextSeconds * sampleRate / hopSize), int64_t(2))),
+              m_hopSize(hopSize),
+              m_frameLength(1.0 * hopSize / sampleRate) {}
+
+    IncrementalRenderer::Decision IncrementalRenderer::plan(uint64_t key, const PreparedJob &prepared, Unit &unit,
+                                                            JobWaveform &reused,
+                                                            double &windowStart, double &windowEnd) {
+        auto numFrames = prepared.numFrames >= 0 ? prepared.numFrames : static_cast<int64_t>(prepared.pd.f0.size());
+        unit = Unit();
+        unit.key = key;
+        unit.state.trim = prepared.trim;
+        unit.state.frameHashes = hashAcousticFrames(prepared.pd, numFrames);
+        if (!load(key, unit.previous)) {
+            return Decision::Full;
+        }
+
+        // Frames can only be compared if they are at the same place in the job.
+        const auto &oldHashes = unit.previous.frameHashes;
+        const auto &newHashes = unit.state.frameHashes;
+        if (unit.previous.trim.leadingFrames != prepared.trim.leadingFrames
+            || unit.previous.trim.trailingFrames != prepared.trim.trailingFrames
+            || oldHashes.size() != newHashes.size()) {
+            return Decision::Full;
+        }
+        size_t first = 0;
+        while (first < newHashes.size() && oldHashes[first] == newHashes[first]) {
+            ++first;
+        }
+        if (first == newHashes.size()) {
+            reused = std::move(unit.previous.waveform);
+            return Decision::Reuse;
+        }
+        auto last = newHashes.size();
+        while (last > first && oldHashes[last - 1] == newHashes[last - 1]) {
+            --last;
+        }
+
+        // In frames of the whole job, before trimming.
+        auto totalFrames = prepared.trim.leadingFrames + static_cast<int64_t>(newHashes.size())
+                           + prepared.trim.trailingFrames;
+        auto changedStart = prepared.trim.leadingFrames + static_cast<int64_t>(first);
+        auto changedEnd = prepared.trim.leadingFrames + static_cast<int64_t>(last);
+        auto renderStart = std::max(changedStart - m_contextFrames, int64_t(0));
+        auto renderEnd = std::min(changedEnd + m_contextFrames, totalFrames);
+        if ((renderEnd - renderStart) * 2 > totalFrames) {
+            // Rendering the window saves too little.
+            return Decision::Full;
+        }
+
+        // Splice in the middle of the context; where the window reaches an end of the job, there is nothing
+        // to crossfade with.
+        auto halfContext = m_contextFrames / 2;
+        unit.isWindow = true;
+        unit.windowStartSample = renderStart * m_hopSize;
+        unit.spliceStart = (renderStart == 0 ? 0 : changedStart - halfContext) * m_hopSize;
+        unit.spliceEnd = (renderEnd == totalFrames ? totalFrames : changedEnd + halfContext) * m_hopSize;
+        unit.fadeIn = (renderStart == 0) ? 0 : halfContext * m_hopSize;
+        unit.fadeOut = (renderEnd == totalFrames) ? 0 : halfContext * m_hopSize;
+        windowStart = static_cast<double>(renderStart) * m_frameLength;
+        windowEnd = static_cast<double>(renderEnd) * m_frameLength;
+        return Decision::Window;
+    }
+
+    JobWaveform IncrementalRenderer::finish(Unit &unit, JobWaveform rendered) {
+        rendered = preview(unit, std::move(rendered));
+        unit.state.waveform = rendered;
+        store(unit.key, unit.state);
+        return rendered;
+    }
+
+    JobWaveform IncrementalRenderer::preview(const Unit &unit, JobWaveform rendered) const {
+        if (!unit.isWindow) {
+            return rendered;
+        }
+        rendered.first += unit.windowStartSample;
+        return spliceWaveform(unit.previous.waveform, rendered, unit.spliceStart, unit.spliceEnd,
+                              unit.fadeIn, unit.fadeOut);
+    }
+
+    std::filesystem::path IncrementalRenderer::getStatePath(uint64_t key) const {
+        return m_directory / (toHexString(key) + ".bin");
+    }
+
+    bool IncrementalRenderer::load(uint64_t key, JobRenderState &state) {
+        auto it = m_states.find(key);
+        if (it != m_states.end()) {
+            state = it->second;
+            return true;
+        }
+        if (m_directory.empty()) {
+            return false;
+        }
+        std::ifstream file(getStatePath(key), std::ios::binary);
+        if (!file.is_open()) {
+            return false;
+        }
+        if (!readBinaryFileHeader(file, STATE_MAGIC, key)
+            || !readValue(file, state.trim.leadingFrames) || !readValue(file, state.trim.trailingFrames)
+            || !readArray(file, state.frameHashes)
+            || !readValue(file, state.waveform.first) || !readArray(file, state.waveform.second, true)) {
+            return false;
+        }
+        m_states.emplace(key, state);
+        return true;
+    }
+
+    void IncrementalRenderer::store(uint64_t key, const JobRenderState &state) {
+        m_states[key] = state;
+        if (m_directory.empty()) {
+            return;
+        }
+
+        // Failing to store the state only means the job is rendered in full next time.
+        writeFileAtomically(getStatePath(key), [key, &state](std::ostream &file) {
+            writeBinaryFileHeader(file, STATE_MAGIC, key);
+            writeValue(file, state.trim.leadingFrames);
+            writeValue(file, state.trim.trailingFrames);
+            writeArray(file, state.frameHashes);
+            writeValue(file, state.waveform.first);
+            writeArray(file, state.waveform.second);
+            return true;
+        }, true);
+    }
+
+}  // namespace diffsinger
@@ -0,0 +1,102 @@
+#ifndef DS_ONNX_INFER_INCREMENTALRENDER_H
+#define DS_ONNX_INFER_INCREMENTALRENDER_H
+
+#include <cstdint>
+#include <filesystem>
+#include <unordered_map>
+#include <vector>
+
+#include "Preprocess.h"
+#include "RenderJob.h"
+
+namespace diffsinger {
+
+    /**
+     * @brief What was rendered for a job last time: a hash of each acoustic input frame, and the audio.
+     */
+    struct JobRenderState {
+        SilenceTrim trim;
+        std::vector<uint64_t> frameHashes;  // Frames of the trimmed inputs, without bucket padding
+        JobWaveform waveform;
+    };  // struct JobRenderState
+
+    /**
+     * @brief Hashes each of the first `numFrames` frames of the acoustic inputs (phoneme token, curves
+     *        and speaker embedding), so that two versions of a job can be compared frame by frame.
+     */
+    std::vector<uint64_t> hashAcousticFrames(const PreprocessedData &pd, int64_t numFrames);
+
+    /**
+     * @brief Replaces `[spliceStart, spliceEnd)` of `previous` with `replacement` (all in samples from the start
+     *        of the job), crossfading linearly over `fadeIn` and `fadeOut` samples centered on the splice points.
+     */
+    JobWaveform spliceWaveform(const JobWaveform &previous, const JobWaveform &replacement,
+                               int64_t spliceStart, int64_t spliceEnd, int64_t fadeIn, int64_t fadeOut);
+
+    /**
+     * @brief Re-renders only the frames of a job that changed since the last render.
+     *
+     * The state of each job is kept in memory and stored in `directory` (if set), keyed by the caller
+     * (e.g. by the project, the position of the job and the render settings). For a job whose inputs changed in a few frames only, `plan` returns
+     * the time range to render again: the changed frames plus `contextSeconds` at each side. The new audio
+     * is crossfaded into the previous audio in the middle of the context, away from the edges of the window.
+     */
+    class IncrementalRenderer {
+    public:
+        enum class Decision {
+            Reuse,   // Nothing changed; `reused` is filled
+            Window,  // Render the job between `windowStart` and `windowEnd` only
+            Full     // Render the whole job
+        };
+
+        struct Unit {
+            uint64_t key = 0;
+            JobRenderState state;  // The new state; the waveform is set by `finish`
+            bool isWindow = false;
+            JobRenderState previous;
+            int64_t windowStartSample = 0;
+            int64_t spliceStart = 0;
+            int64_t spliceEnd = 0;
+            int64_t fadeIn = 0;
+            int64_t fadeOut = 0;
+        };
+
+        /**
+         * @param directory  Directory of the state files. Empty to keep the states in memory only.
+         */
+        IncrementalRenderer(std::filesystem::path directory, double contextSeconds, int sampleRate, int hopSize);
+
+        /**
+         * @param prepared     The job prepared by JobPreparer.
+         * @param windowStart  Set for Decision::Window, in seconds from the start of the job.
+         */
+        Decision plan(uint64_t key, const PreparedJob &prepared, Unit &unit, JobWaveform &reused,
+                      double &windowStart, double &windowEnd);
+
+        /**
+         * @brief Stores the state of a rendered unit, and returns the audio of the whole job.
+         *
+         * @param rendered  The audio of the job, or of the window (from its start) for Decision::Window.
+         */
+        JobWaveform finish(Unit &unit, JobWaveform rendered);
+
+        /**
+         * @brief Like `finish`, but without storing the state, e.g. for a draft of the job.
+         */
+        JobWaveform preview(const Unit &unit, JobWaveform rendered) const;
+
+    private:
+        std::filesystem::path m_directory;
+        int64_t m_contextFrames;
+        int m_hopSize;
+        double m_frameLength;
+        std::unordered_map<uint64_t, JobRenderState> m_states;
+
+        bool load(uint64_t key, JobRenderState &state);
+        void store(uint64_t key, const JobRenderState &state);
+        std::filesystem::path getStatePath(uint64_t key) const;
+    };  // class IncrementalRenderer
+
+}  // namespace diffsinger
+
+#endif //DS_ONNX_INFER_INCREMENTALRENDER_H
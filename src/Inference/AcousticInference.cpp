@@ -5,7 +5,8 @@
 
 namespace diffsinger {
 
-    AcousticInference::AcousticInference(const TString &modelPath) : Inference(modelPath), m_modelFlags() {}
+    AcousticInference::AcousticInference(const TString &modelPath, const MappedBuffer &modelData)
+            : Inference(modelPath, modelData), m_modelFlags(), m_warmupSettings(), m_bindingPlan(), m_inputSlots() {}
 
     bool AcousticInference::postInitCheck() {
         updateFlags();
@@ -14,12 +15,47 @@ namespace diffsinger {
             endSession();
             return false;
         }
+        updateBindingPlan();
 
         return true;
     }
 
     void AcousticInference::postCleanup() {
         m_modelFlags.reset();
+        m_bindingPlan.clear();
+        m_inputSlots = InputSlots();
+    }
+
+    void AcousticInference::setWarmupSettings(const AcousticInferenceSettings &inferSettings) {
+        m_warmupSettings = inferSettings;
+    }
+
+    bool AcousticInference::warmUp(int64_t frames) {
+        // A single phoneme lasting all frames. Only inputs supported by the model are filled,
+        // so the warm-up runs the same graph as the real inputs.
+        PreprocessedData pd;
+        pd.tokens = {0};
+        pd.durations = {frames};
+        pd.f0.resize(frames, 440.0);
+        pd.velocity.resize(frames, 1.0);
+        pd.gender.resize(frames, 0.0);
+        if (m_modelFlags.check(AcousticModelFlags::MultiSpeakers)) {
+            pd.spk_embed.resize(frames * spkEmbedLastDimension, 0.0f);
+        }
+        if (m_modelFlags.check(AcousticModelFlags::Energy)) {
+            pd.energy.resize(frames, -96.0);
+        }
+        if (m_modelFlags.check(AcousticModelFlags::Breathiness)) {
+            pd.breathiness.resize(frames, -96.0);
+        }
+        if (m_modelFlags.check(AcousticModelFlags::SplitDiffusion)) {
+            return !inferEncoder(pd).empty();
+        }
+        return inferToOrtValue(pd, m_warmupSettings) != Ort::Value(nullptr);
+    }
+
+    AcousticModelFlags AcousticInference::getModelFlags() const {
+        return m_modelFlags;
     }
 
     void AcousticInference::printModelFeatures() {
@@ -40,104 +76,98 @@ namespace diffsinger {
                   << "Breathiness="
                   << (m_modelFlags.check(AcousticModelFlags::Breathiness) ? "Yes" : "No") << "; "
                   << "Shallow_Diffusion="
-                  << (m_modelFlags.check(AcousticModelFlags::ShallowDiffusion) ? "Yes" : "No") << '\n';
+                  << (m_modelFlags.check(AcousticModelFlags::ShallowDiffusion) ? "Yes" : "No") << "; "
+                  << "Split_Diffusion="
+                  << (m_modelFlags.check(AcousticModelFlags::SplitDiffusion) ? "Yes" : "No") << '\n';
     }
 
     Ort::Value AcousticInference::inferToOrtValue(const PreprocessedData &pd, const AcousticInferenceSettings &inferSettings) {
-        if (!m_session) {
-            std::cout << "Session is not initialized!\n";
+        if (m_modelFlags.check(AcousticModelFlags::SplitDiffusion)) {
+            std::cout << "ERROR: The acoustic model is the encoder of a split model, which needs a denoiser.\n";
             return Ort::Value(nullptr);
         }
-
-        if (!m_modelFlags.check(AcousticModelFlags::Valid)) {
-            std::cout << "Invalid acoustic model!\n";
+        auto outputTensors = run(pd, inferSettings);
+        if (outputTensors.empty()) {
             return Ort::Value(nullptr);
         }
+        return std::move(outputTensors[0]);
+    }
+
+    std::vector<Ort::Value> AcousticInference::inferEncoder(const PreprocessedData &pd) {
+        if (!m_modelFlags.check(AcousticModelFlags::SplitDiffusion)) {
+            std::cout << "ERROR: The acoustic model is not the encoder of a split model.\n";
+            return {};
+        }
+        // The encoder has no diffusion inputs, so the settings are unused.
+        return run(pd, AcousticInferenceSettings{});
+    }
+
+    std::vector<Ort::Value> AcousticInference::run(const PreprocessedData &pd, const AcousticInferenceSettings &inferSettings) {
+        if (!m_session) {
+            std::cout << "Session is not initialized!\n";
+            return {};
+        }
 
-        std::vector<const char *> inputNames;
-        std::vector<Ort::Value> inputTensors;
+        // The session is only kept if the model is valid (see postInitCheck), so the required slots are set.
+        auto inputTensors = m_bindingPlan.createInputs();
 
-        // tokens
-        appendVectorToInputTensors<int64_t, int64_t>("tokens", pd.tokens, inputNames, inputTensors);
-        // durations
-        appendVectorToInputTensors<int64_t, int64_t>("durations", pd.durations, inputNames, inputTensors);
-        // F0
-        appendVectorToInputTensors<double, float>("f0", pd.f0, inputNames, inputTensors);
-        // Speedup
-        appendScalarToInputTensors<decltype(inferSettings.speedup), int64_t>(
-                "speedup", inferSettings.speedup, inputNames, inputTensors);
-        // Velocity
-        if (m_modelFlags.check(AcousticModelFlags::Velocity)) {
-            appendVectorToInputTensors<double, float>("velocity", pd.velocity, inputNames, inputTensors);
+        inputTensors[m_inputSlots.tokens] = vectorToTensor<int64_t, int64_t>(pd.tokens);
+        inputTensors[m_inputSlots.durations] = vectorToTensor<int64_t, int64_t>(pd.durations);
+        inputTensors[m_inputSlots.f0] = vectorToTensor<double, float>(pd.f0);
+        if (m_inputSlots.speedup != BindingPlan::npos) {
+            inputTensors[m_inputSlots.speedup] = scalarToTensor<decltype(inferSettings.speedup), int64_t>(
+                    inferSettings.speedup);
         }
-        // Gender
-        if (m_modelFlags.check(AcousticModelFlags::Gender)) {
-            appendVectorToInputTensors<double, float>("gender", pd.gender, inputNames, inputTensors);
+        if (m_inputSlots.velocity != BindingPlan::npos) {
+            inputTensors[m_inputSlots.velocity] = vectorToTensor<double, float>(pd.velocity);
         }
-        // Speakers Embed
-        if (m_modelFlags.check(AcousticModelFlags::MultiSpeakers)) {
+        if (m_inputSlots.gender != BindingPlan::npos) {
+            inputTensors[m_inputSlots.gender] = vectorToTensor<double, float>(pd.gender);
+        }
+        if (m_inputSlots.spkEmbed != BindingPlan::npos) {
             auto spkEmbedFrames = static_cast<int64_t>(pd.spk_embed.size()) / spkEmbedLastDimension;
-            appendVectorToInputTensorsWithShape<float, float>("spk_embed", pd.spk_embed,
-                                                              {1, spkEmbedFrames, spkEmbedLastDimension},
-                                                              inputNames, inputTensors);
+            inputTensors[m_inputSlots.spkEmbed] = vectorToTensorWithShape<float, float>(
+                    pd.spk_embed, {1, spkEmbedFrames, spkEmbedLastDimension});
         }
-        // TODO: If energy and breathiness are not supplied but required by the acoustic model,
-        //       they should be inferred by the variance model.
+        // If a variance model is given, energy and breathiness missing from the .ds file
+        // are predicted beforehand (see VariancePipeline).
         bool isVarianceError = false;
-        // Energy
-        if (m_modelFlags.check(AcousticModelFlags::Energy)) {
+        if (m_inputSlots.energy != BindingPlan::npos) {
             if (pd.energy.empty()) {
                 std::cout << "ERROR: The acoustic model required energy input, but such parameter is not supplied.\n";
                 isVarianceError = true;
             }
-            appendVectorToInputTensors<double, float>("energy", pd.energy, inputNames, inputTensors);
+            inputTensors[m_inputSlots.energy] = vectorToTensor<double, float>(pd.energy);
         }
-        // Breathiness
-        if (m_modelFlags.check(AcousticModelFlags::Breathiness)) {
+        if (m_inputSlots.breathiness != BindingPlan::npos) {
             if (pd.breathiness.empty()) {
                 std::cout << "ERROR: The acoustic model required breathiness input, but such parameter is not supplied.\n";
                 isVarianceError = true;
             }
-            appendVectorToInputTensors<double, float>("breathiness", pd.breathiness, inputNames, inputTensors);
+            inputTensors[m_inputSlots.breathiness] = vectorToTensor<double, float>(pd.breathiness);
         }
 
         if (isVarianceError) {
-            return Ort::Value(nullptr);
+            return {};
         }
 
         // Shallow Diffusion depth
-        if (m_modelFlags.check(AcousticModelFlags::ShallowDiffusion)) {
+        if (m_inputSlots.depth != BindingPlan::npos) {
             if (inferSettings.depth < 0) {
                 std::cout << "ERROR: The model supports shallow diffusion, but depth is unset or negative.\n";
-                return Ort::Value(nullptr);
+                return {};
             }
-            appendScalarToInputTensors<decltype(inferSettings.depth), int64_t>(
-                    "depth", inferSettings.depth, inputNames, inputTensors);
+            inputTensors[m_inputSlots.depth] = scalarToTensor<decltype(inferSettings.depth), int64_t>(
+                    inferSettings.depth);
         }
 
-        // Create output names
-        const char *outputNames[] = { "mel" };
-        auto outputNamesSize = sizeof(outputNames) / sizeof(outputNames[0]);
-
         try {
-            // Run the session
-            auto outputTensors = m_session.Run(
-                    Ort::RunOptions{},
-                    inputNames.data(),
-                    inputTensors.data(),
-                    inputNames.size(),
-                    outputNames,
-                    outputNamesSize);
-
-            // Get the output tensor
-            Ort::Value &outputTensor = outputTensors[0];
-
-            return std::move(outputTensor);
+            return m_bindingPlan.run(m_session, inputTensors);
         }
         catch (const Ort::Exception &ortException) {
             printOrtError(ortException);
         }
-        return Ort::Value(nullptr);
+        return {};
     }
 
     std::vector<float> AcousticInference::ortValueToVector(const Ort::Value &value) {
@@ -156,30 +186,57 @@ namespace diffsinger {
             return;
         }
 
-        auto supportedInputNames = getSupportedInputNames(m_session);
-        auto supportedOutputNames = getSupportedOutputNames(m_session);
+        const auto &signature = m_signature;
 
         // Basic validation
         bool isValidModel = true;
         // Required input names
-        isValidModel &= hasKey(supportedInputNames, "tokens");
-        isValidModel &= hasKey(supportedInputNames, "durations");
-        isValidModel &= hasKey(supportedInputNames, "f0");
-        isValidModel &= hasKey(supportedInputNames, "speedup");
-        // Required Output names
-        isValidModel &= hasKey(supportedOutputNames, "mel");
-        isValidModel &= (supportedOutputNames.size() == 1);
+        isValidModel &= signature.hasInput("tokens");
+        isValidModel &= signature.hasInput("durations");
+        isValidModel &= signature.hasInput("f0");
+
+        // Either the whole model (speedup -> mel), or the encoder of a split model (-> condition),
+        // whose diffusion loop is run by AcousticPipeline.
+        bool isWholeModel = signature.hasInput("speedup")
+                            && signature.hasOutput("mel")
+                            && (signature.outputs().size() == 1);
+        bool isEncoder = !isWholeModel && signature.hasOutput("condition");
+        isValidModel &= (isWholeModel || isEncoder);
         m_modelFlags.setIf(AcousticModelFlags::Valid, isValidModel);
         if (!isValidModel) {
             return;
         }
+        m_modelFlags.setIf(AcousticModelFlags::SplitDiffusion, isEncoder);
 
         // Parameters that the model may support
-        m_modelFlags.setIf(AcousticModelFlags::Velocity, hasKey(supportedInputNames, "velocity"));
-        m_modelFlags.setIf(AcousticModelFlags::Gender, hasKey(supportedInputNames, "gender"));
-        m_modelFlags.setIf(AcousticModelFlags::MultiSpeakers, hasKey(supportedInputNames, "spk_embed"));
-        m_modelFlags.setIf(AcousticModelFlags::Energy, hasKey(supportedInputNames, "energy"));
-        m_modelFlags.setIf(AcousticModelFlags::Breathiness, hasKey(supportedInputNames, "breathiness"));
-        m_modelFlags.setIf(AcousticModelFlags::ShallowDiffusion, hasKey(supportedInputNames, "depth"));
+        m_modelFlags.setIf(AcousticModelFlags::Velocity, signature.hasInput("velocity"));
+        m_modelFlags.setIf(AcousticModelFlags::Gender, signature.hasInput("gender"));
+        m_modelFlags.setIf(AcousticModelFlags::MultiSpeakers, signature.hasInput("spk_embed"));
+        m_modelFlags.setIf(AcousticModelFlags::Energy, signature.hasInput("energy"));
+        m_modelFlags.setIf(AcousticModelFlags::Breathiness, signature.hasInput("breathiness"));
+        m_modelFlags.setIf(AcousticModelFlags::ShallowDiffusion,
+                           isEncoder ? signature.hasOutput("aux_mel") : signature.hasInput("depth"));
+    }
+
+    void AcousticInference::updateBindingPlan() {
+        m_bindingPlan.clear();
+        m_inputSlots.tokens = m_bindingPlan.addInput(m_signature, "tokens");
+        m_inputSlots.durations = m_bindingPlan.addInput(m_signature, "durations");
+        m_inputSlots.f0 = m_bindingPlan.addInput(m_signature, "f0");
+        m_inputSlots.speedup = m_bindingPlan.addInput(m_signature, "speedup");
+        m_inputSlots.velocity = m_bindingPlan.addInput(m_signature, "velocity");
+        m_inputSlots.gender = m_bindingPlan.addInput(m_signature, "gender");
+        m_inputSlots.spkEmbed = m_bindingPlan.addInput(m_signature, "spk_embed");
+        m_inputSlots.energy = m_bindingPlan.addInput(m_signature, "energy");
+        m_inputSlots.breathiness = m_bindingPlan.addInput(m_signature, "breathiness");
+        m_inputSlots.depth = m_bindingPlan.addInput(m_signature, "depth");
+        if (m_modelFlags.check(AcousticModelFlags::SplitDiffusion)) {
+            m_bindingPlan.addOutput("condition");
+            if (m_modelFlags.check(AcousticModelFlags::ShallowDiffusion)) {
+                m_bindingPlan.addOutput("aux_mel");
+            }
+        } else {
+            m_bindingPlan.addOutput("mel");
+        }
     }
 } // namespace diffsinger
@@ -6,6 +6,7 @@
 #include "TString.h"
 #include "Inference.h"
 #include "AcousticModelFlags.h"
+#include "DiffusionSampler.h"
 
 namespace diffsinger {
 
@@ -15,30 +16,74 @@ namespace diffsinger {
     struct AcousticInferenceSettings {
         int speedup = 10;
         int depth = 1000;
+
+        // Only used by split acoustic models, whose diffusion loop runs in C++ (see AcousticPipeline).
+        SamplerType sampler = SamplerType::PNDM;
     };  // struct AcousticInferenceSettings
 
 
     class AcousticInference : public Inference {
     public:
-        explicit AcousticInference(const TString &modelPath);
+        explicit AcousticInference(const TString &modelPath, const MappedBuffer &modelData = {});
 
         void printModelFeatures();
 
+        AcousticModelFlags getModelFlags() const;
+
         static std::vector<float> ortValueToVector(const Ort::Value &value);
 
         std::vector<float> infer(const PreprocessedData &pd, const AcousticInferenceSettings &inferSettings);
 
         Ort::Value inferToOrtValue(const PreprocessedData &pd, const AcousticInferenceSettings &inferSettings);
 
+        /**
+         * @brief Runs the encoder of a split acoustic model (see AcousticModelFlags::SplitDiffusion).
+         *
+         * @return The condition [1, frames, hidden], followed by the auxiliary mel [1, frames, mel_bins]
+         *         if the model supports shallow diffusion. Empty on failure.
+         */
+        std::vector<Ort::Value> inferEncoder(const PreprocessedData &pd);
+
+        /**
+         * @brief Sets the inference settings used by warm-up inferences.
+         *
+         * The diffusion steps run the same kernels on every step, so settings with a few steps
+         * are enough to warm up the session.
+         */
+        void setWarmupSettings(const AcousticInferenceSettings &inferSettings);
+
     private:
+        // Slots of the inputs in m_bindingPlan. `BindingPlan::npos` if the model does not have the input.
+        struct InputSlots {
+            int tokens = BindingPlan::npos;
+            int durations = BindingPlan::npos;
+            int f0 = BindingPlan::npos;
+            int speedup = BindingPlan::npos;
+            int velocity = BindingPlan::npos;
+            int gender = BindingPlan::npos;
+            int spkEmbed = BindingPlan::npos;
+            int energy = BindingPlan::npos;
+            int breathiness = BindingPlan::npos;
+            int depth = BindingPlan::npos;
+        };
+
         AcousticModelFlags m_modelFlags;
+        AcousticInferenceSettings m_warmupSettings;
+        BindingPlan m_bindingPlan;
+        InputSlots m_inputSlots;
     private:
         void updateFlags();
 
+        void updateBindingPlan();
+
+        std::vector<Ort::Value> run(const PreprocessedData &pd, const AcousticInferenceSettings &inferSettings);
+
     protected:
         bool postInitCheck() override;
 
         void postCleanup() override;
+
+        bool warmUp(int64_t frames) override;
     };  // class AcousticInference
 
 } // namespace diffsinger
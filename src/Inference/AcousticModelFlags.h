@@ -12,7 +12,8 @@ namespace diffsinger {
             MultiSpeakers = 1 << 3,
             Energy = 1 << 4,
             Breathiness = 1 << 5,
-            ShallowDiffusion = 1 << 6
+            ShallowDiffusion = 1 << 6,
+            SplitDiffusion = 1 << 7
         };
     private:
         unsigned int m_flag;
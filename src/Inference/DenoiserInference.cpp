@@ -0,0 +1,110 @@
+#include "DenoiserInference.h"
+#include "InferenceUtils.hpp"
+
+namespace diffsinger {
+
+    DenoiserInference::DenoiserInference(const TString &modelPath, const MappedBuffer &modelData)
+            : Inference(modelPath, modelData),
+              m_bindingPlan(),
+              m_xSlot(BindingPlan::npos),
+              m_tSlot(BindingPlan::npos),
+              m_condSlot(BindingPlan::npos),
+              m_canBatch(false) {}
+
+    bool DenoiserInference::postInitCheck() {
+        bool isValidModel = true;
+        isValidModel &= m_signature.hasInput("x");
+        isValidModel &= m_signature.hasInput("t");
+        isValidModel &= m_signature.hasInput("cond");
+        isValidModel &= m_signature.hasOutput("noise_pred");
+        if (!isValidModel) {
+            std::cout << "Invalid denoiser model! "
+                         "Must have inputs: x, t, cond; "
+                         "outputs: noise_pred\n";
+            endSession();
+            return false;
+        }
+
+        m_bindingPlan.clear();
+        m_xSlot = m_bindingPlan.addInput(m_signature, "x");
+        m_tSlot = m_bindingPlan.addInput(m_signature, "t");
+        m_condSlot = m_bindingPlan.addInput(m_signature, "cond");
+        m_bindingPlan.addOutput("noise_pred");
+
+        m_canBatch = m_signature.findInput("x")->isDynamicAxis(0);
+        return true;
+    }
+
+    void DenoiserInference::postCleanup() {
+        m_bindingPlan.clear();
+        m_xSlot = BindingPlan::npos;
+        m_tSlot = BindingPlan::npos;
+        m_condSlot = BindingPlan::npos;
+        m_canBatch = false;
+    }
+
+    std::vector<float> DenoiserInference::denoise(const std::vector<float> &x, int64_t t,
+                                                  const std::vector<float> &cond,
+                                                  int64_t batchSize, int64_t frames) {
+        if (!m_session || batchSize <= 0 || frames <= 0) {
+            return {};
+        }
+
+        auto numMelBins = static_cast<int64_t>(x.size()) / (batchSize * frames);
+        auto hiddenSize = static_cast<int64_t>(cond.size()) / (batchSize * frames);
+
+        auto inputTensors = m_bindingPlan.createInputs();
+        inputTensors[m_xSlot] = vectorToTensorWithShape<float, float>(x, {batchSize, frames, numMelBins});
+        inputTensors[m_tSlot] = vectorToTensorWithShape<int64_t, int64_t>(
+                std::vector<int64_t>(batchSize, t), {batchSize});
+        inputTensors[m_condSlot] = vectorToTensorWithShape<float, float>(cond, {batchSize, frames, hiddenSize});
+
+        std::vector<Ort::Value> outputTensors = m_bindingPlan.run(m_session, inputTensors);
+
+        Ort::Value &noiseOutput = outputTensors[0];
+        auto noiseBuffer = noiseOutput.GetTensorData<float>();
+        return {noiseBuffer, noiseBuffer + noiseOutput.GetTensorTypeAndShapeInfo().GetElementCount()};
+    }
+
+    bool DenoiserInference::canBatch() const {
+        return m_canBatch;
+    }
+
+    int64_t DenoiserInference::getNumMelBins() const {
+        // x: [batch, frames, mel_bins]. Fall back to the most common value if the axis is dynamic.
+        constexpr int64_t defaultNumMelBins = 128;
+        auto x = m_signature.findInput("x");
+        if (x && x->shape.size() == 3 && !x->isDynamicAxis(2)) {
+            return x->shape[2];
+        }
+        return defaultNumMelBins;
+    }
+
+    int64_t DenoiserInference::getHiddenSize() const {
+        // cond: [batch, frames, hidden]. The hidden size is fixed by the encoder, 0 if unknown.
+        auto cond = m_signature.findInput("cond");
+        if (cond && cond->shape.size() == 3 && !cond->isDynamicAxis(2)) {
+            return cond->shape[2];
+        }
+        return 0;
+    }
+
+    bool DenoiserInference::warmUp(int64_t frames) {
+        auto numMelBins = getNumMelBins();
+        auto hiddenSize = getHiddenSize();
+        if (hiddenSize <= 0) {
+            // Without a known condition size, dummy inputs may not fit the model.
+            return true;
+        }
+        std::vector<float> x(frames * numMelBins, 0.0f);
+        std::vector<float> cond(frames * hiddenSize, 0.0f);
+        try {
+            return !denoise(x, 0, cond, 1, frames).empty();
+        }
+        catch (const Ort::Exception &ortException) {
+            printOrtError(ortException);
+        }
+        return false;
+    }
+
+}  // namespace diffsinger
@@ -0,0 +1,54 @@
+#ifndef DS_ONNX_INFER_DENOISERINFERENCE_H
+#define DS_ONNX_INFER_DENOISERINFERENCE_H
+
+#include <vector>
+
+#include "TString.h"
+#include "Inference.h"
+
+namespace diffsinger {
+
+    /**
+     * @brief A single denoising step of a split acoustic model.
+     *
+     * Inputs: x [batch, frames, mel_bins] (normalized noisy mel), t [batch] (timestep),
+     *         cond [batch, frames, hidden] (encoder condition).
+     * Output: noise_pred [batch, frames, mel_bins].
+     */
+    class DenoiserInference : public Inference {
+    public:
+        explicit DenoiserInference(const TString &modelPath, const MappedBuffer &modelData = {});
+
+        /**
+         * @brief Predicts the noise of a batch of samples at timestep `t`. Throws Ort::Exception on failure.
+         */
+        std::vector<float> denoise(const std::vector<float> &x, int64_t t, const std::vector<float> &cond,
+                                   int64_t batchSize, int64_t frames);
+
+        /**
+         * @return Whether the batch axis is dynamic, so that several samples can be denoised in one call.
+         */
+        bool canBatch() const;
+
+        int64_t getNumMelBins() const;
+
+        int64_t getHiddenSize() const;
+
+    protected:
+        bool postInitCheck() override;
+
+        void postCleanup() override;
+
+        bool warmUp(int64_t frames) override;
+
+    private:
+        BindingPlan m_bindingPlan;
+        int m_xSlot;
+        int m_tSlot;
+        int m_condSlot;
+        bool m_canBatch;
+    };  // class DenoiserInference
+
+}  // namespace diffsinger
+
+#endif //DS_ONNX_INFER_DENOISERINFERENCE_H
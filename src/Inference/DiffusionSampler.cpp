@@ -0,0 +1,175 @@
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <deque>
+#include <iterator>
+
+#include "DiffusionSampler.h"
+
+namespace diffsinger {
+
+    SamplerType parseSamplerFromString(const std::string &sampler, bool *ok) {
+        std::string samplerLower;
+        samplerLower.reserve(sampler.size());
+        std::transform(sampler.begin(), sampler.end(), std::back_inserter(samplerLower),
+                       [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+
+        if (ok) {
+            *ok = true;
+        }
+        if (samplerLower == "ddim") {
+            return SamplerType::DDIM;
+        }
+        if (samplerLower != "pndm" && ok) {
+            *ok = false;
+        }
+        return SamplerType::PNDM;
+    }
+
+    DiffusionSampler::DiffusionSampler(int timesteps, float maxBeta) {
+        timesteps = std::max(timesteps, 1);
+        m_alphasCumprod.resize(timesteps);
+
+        constexpr double minBeta = 1e-4;
+        double alphaCumprod = 1.0;
+        for (int i = 0; i < timesteps; ++i) {
+            double beta = (timesteps == 1)
+                          ? minBeta
+                          : minBeta + (maxBeta - minBeta) * i / (timesteps - 1);
+            alphaCumprod *= 1.0 - beta;
+            m_alphasCumprod[i] = alphaCumprod;
+        }
+    }
+
+    int DiffusionSampler::getTimesteps() const {
+        return static_cast<int>(m_alphasCumprod.size());
+    }
+
+    void DiffusionSampler::addNoise(std::vector<float> &x, int t, std::mt19937 &rng) const {
+        t = std::clamp(t, 0, getTimesteps() - 1);
+        auto sqrtAlpha = static_cast<float>(std::sqrt(m_alphasCumprod[t]));
+        auto sqrtOneMinusAlpha = static_cast<float>(std::sqrt(1.0 - m_alphasCumprod[t]));
+
+        std::normal_distribution<float> normal;
+        for (auto &value : x) {
+            value = sqrtAlpha * value + sqrtOneMinusAlpha * normal(rng);
+        }
+    }
+
+    bool DiffusionSampler::sample(std::vector<float> &x, int depth, int speedup, SamplerType type,
+                                  const DenoiseFunction &denoise) const {
+        depth = std::clamp(depth, 1, getTimesteps());
+        speedup = std::clamp(speedup, 1, depth);
+        switch (type) {
+            case SamplerType::DDIM:
+                return sampleDdim(x, depth, speedup, denoise);
+            case SamplerType::PNDM:
+            default:
+                return samplePndm(x, depth, speedup, denoise);
+        }
+    }
+
+    bool DiffusionSampler::samplePndm(std::vector<float> &x, int depth, int speedup,
+                                      const DenoiseFunction &denoise) const {
+        // Noise predictions of the previous steps, newest last.
+        std::deque<std::vector<float>> noiseList;
+        std::vector<float> noise;
+        std::vector<float> noisePrime(x.size());
+
+        for (int t = (depth - 1) / speedup * speedup; t >= 0; t -= speedup) {
+            int tPrev = std::max(t - speedup, 0);
+            if (!denoise(x, t, noise) || noise.size() != x.size()) {
+                return false;
+            }
+
+            // The first step has no history, so it uses an improved Euler (Heun) step with an extra denoiser call.
+            switch (noiseList.size()) {
+                case 0: {
+                    auto xPred = pndmStep(x, noise, t, tPrev);
+                    std::vector<float> noisePrev;
+                    if (!denoise(xPred, tPrev, noisePrev) || noisePrev.size() != x.size()) {
+                        return false;
+                    }
+                    for (size_t i = 0; i < x.size(); ++i) {
+                        noisePrime[i] = (noise[i] + noisePrev[i]) / 2;
+                    }
+                    break;
+                }
+                case 1: {
+                    const auto &n1 = noiseList[0];
+                    for (size_t i = 0; i < x.size(); ++i) {
+                        noisePrime[i] = (3 * noise[i] - n1[i]) / 2;
+                    }
+                    break;
+                }
+                case 2: {
+                    const auto &n1 = noiseList[1];
+                    const auto &n2 = noiseList[0];
+                    for (size_t i = 0; i < x.size(); ++i) {
+                        noisePrime[i] = (23 * noise[i] - 16 * n1[i] + 5 * n2[i]) / 12;
+                    }
+                    break;
+                }
+                default: {
+                    const auto &n1 = noiseList[2];
+                    const auto &n2 = noiseList[1];
+                    const auto &n3 = noiseList[0];
+                    for (size_t i = 0; i < x.size(); ++i) {
+                        noisePrime[i] = (55 * noise[i] - 59 * n1[i] + 37 * n2[i] - 9 * n3[i]) / 24;
+                    }
+                    break;
+                }
+            }
+
+            x = pndmStep(x, noisePrime, t, tPrev);
+
+            noiseList.push_back(std::move(noise));
+            if (noiseList.size() > 3) {
+                noiseList.pop_front();
+            }
+            noise = std::vector<float>();
+        }
+        return true;
+    }
+
+    std::vector<float> DiffusionSampler::pndmStep(const std::vector<float> &x, const std::vector<float> &noise,
+                                                  int t, int tPrev) const {
+        double alpha = m_alphasCumprod[t];
+        double alphaPrev = m_alphasCumprod[tPrev];
+        double sqrtAlpha = std::sqrt(alpha);
+        double sqrtAlphaPrev = std::sqrt(alphaPrev);
+
+        auto xCoeff = static_cast<float>((alphaPrev - alpha) / (sqrtAlpha * (sqrtAlpha + sqrtAlphaPrev)));
+        auto noiseCoeff = static_cast<float>(
+                (alphaPrev - alpha)
+                / (sqrtAlpha * (std::sqrt((1 - alphaPrev) * alpha) + std::sqrt((1 - alpha) * alphaPrev))));
+
+        std::vector<float> xPrev(x.size());
+        for (size_t i = 0; i < x.size(); ++i) {
+            xPrev[i] = x[i] + xCoeff * x[i] - noiseCoeff * noise[i];
+        }
+        return xPrev;
+    }
+
+    bool DiffusionSampler::sampleDdim(std::vector<float> &x, int depth, int speedup,
+                                      const DenoiseFunction &denoise) const {
+        std::vector<float> noise;
+        for (int t = (depth - 1) / speedup * speedup; t >= 0; t -= speedup) {
+            int tPrev = std::max(t - speedup, 0);
+            if (!denoise(x, t, noise) || noise.size() != x.size()) {
+                return false;
+            }
+
+            double alpha = m_alphasCumprod[t];
+            double alphaPrev = m_alphasCumprod[tPrev];
+            auto xCoeff = static_cast<float>(std::sqrt(alphaPrev / alpha));
+            auto noiseCoeff = static_cast<float>(
+                    std::sqrt(alphaPrev) * (std::sqrt((1 - alphaPrev) / alphaPrev) - std::sqrt((1 - alpha) / alpha)));
+            for (size_t i = 0; i < x.size(); ++i) {
+                x[i] = xCoeff * x[i] + noiseCoeff * noise[i];
+            }
+        }
+        return true;
+    }
+
+}  // namespace diffsinger
@@ -0,0 +1,65 @@
+#ifndef DS_ONNX_INFER_DIFFUSIONSAMPLER_H
+#define DS_ONNX_INFER_DIFFUSIONSAMPLER_H
+
+#include <cstdint>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace diffsinger {
+
+    enum class SamplerType {
+        PNDM,
+        DDIM
+    };  // enum class SamplerType
+
+    SamplerType parseSamplerFromString(const std::string &sampler, bool *ok = nullptr);
+
+
+    /**
+     * @brief Reverse diffusion loop of split acoustic models, driven step by step in C++.
+     *
+     * Uses the linear beta schedule of DiffSinger (betas from 1e-4 to `maxBeta` over `timesteps` steps).
+     * Samples are flattened tensors in the normalized spectrogram domain; the whole batch shares the
+     * same timesteps, so one denoiser call covers every sample of the batch.
+     */
+    class DiffusionSampler {
+    public:
+        /**
+         * @brief Predicts the noise of `x` at timestep `t`. Returns false on failure.
+         */
+        using DenoiseFunction = std::function<bool(const std::vector<float> &x, int64_t t, std::vector<float> &noise)>;
+
+        explicit DiffusionSampler(int timesteps = 1000, float maxBeta = 0.02f);
+
+        int getTimesteps() const;
+
+        /**
+         * @brief Diffuses the clean sample `x` to timestep `t` (q_sample), in place.
+         */
+        void addNoise(std::vector<float> &x, int t, std::mt19937 &rng) const;
+
+        /**
+         * @brief Denoises `x` from timestep `depth - 1` down to 0, skipping `speedup` steps at a time.
+         *
+         * @return false if the denoiser failed. `x` is undefined then.
+         */
+        bool sample(std::vector<float> &x, int depth, int speedup, SamplerType type,
+                    const DenoiseFunction &denoise) const;
+
+    private:
+        std::vector<double> m_alphasCumprod;
+
+        bool samplePndm(std::vector<float> &x, int depth, int speedup, const DenoiseFunction &denoise) const;
+
+        bool sampleDdim(std::vector<float> &x, int depth, int speedup, const DenoiseFunction &denoise) const;
+
+        // One linear multistep update of PNDM from t to tPrev.
+        std::vector<float> pndmStep(const std::vector<float> &x, const std::vector<float> &noise,
+                                    int t, int tPrev) const;
+    };  // class DiffusionSampler
+
+}  // namespace diffsinger
+
+#endif //DS_ONNX_INFER_DIFFUSIONSAMPLER_H
@@ -7,22 +7,49 @@
 
 #include "Inference.h"
 #include "InferenceUtils.hpp"
+#include "OptimizedModelCache.h"
+#include "SharedEnv.h"
 
 namespace diffsinger {
 
-    Inference::Inference(const TString &modelPath)
+    Inference::Inference(const TString &modelPath, const MappedBuffer &modelData)
             : m_modelPath(modelPath),
-              m_env(ORT_LOGGING_LEVEL_ERROR, "DiffSinger"),
+              m_modelData(modelData),
+              m_sharedModel(nullptr),
+              m_env(sharedOrtEnv()),
               m_session(nullptr),
-              ortApi(Ort::GetApi()) {}
+              ortApi(Ort::GetApi()),
+              m_signature() {}
 
     TString Inference::getModelPath() {
         return m_modelPath;
     }
 
-    bool Inference::initSession(ExecutionProvider ep, int deviceIndex) {
+    const ModelSignature &Inference::getSignature() const {
+        return m_signature;
+    }
+
+    uint64_t Inference::getModelHash() const {
+        return m_sharedModel ? m_sharedModel->getContentHash() : 0;
+    }
+
+    bool Inference::initSession(ExecutionProvider ep, int deviceIndex, const SessionConfig &config) {
         try {
             auto options = Ort::SessionOptions();
+            if (hasGlobalThreadPool()) {
+                // The threads are sized once for the whole process.
+                options.DisablePerSessionThreads();
+            } else {
+                if (config.intraOpThreads > 0) {
+                    options.SetIntraOpNumThreads(config.intraOpThreads);
+                }
+                if (config.parallelExecution) {
+                    options.SetExecutionMode(ExecutionMode::ORT_PARALLEL);
+                    if (config.interOpThreads > 0) {
+                        options.SetInterOpNumThreads(config.interOpThreads);
+                    }
+                }
+            }
             switch (ep) {
                 case ExecutionProvider::DirectML:
 #ifdef ONNXRUNTIME_ENABLE_DML
@@ -102,10 +129,39 @@ namespace diffsinger {
                     break;
             }
 
-            //options.AppendExecutionProvider_CUDA(options1);
-            m_session = Ort::Session(m_env, m_modelPath.c_str(), options);
+            // All sessions of the same model share the memory-mapped model bytes and prepacked weights,
+            // so running several sessions of a model does not multiply its weight memory.
+            m_sharedModel = SharedModel::acquire(m_modelPath, m_modelData);
+            if (!m_sharedModel) {
+                std::cout << "Failed to open the model file.\n";
+                return false;
+            }
+            if (!config.cacheDirectory.empty() && ep == ExecutionProvider::CPU) {
+                m_session = OptimizedModelCache(config.cacheDirectory).createSession(*m_env, options, m_sharedModel);
+            }
+            if (!m_session) {
+                const auto &modelBuffer = m_sharedModel->getBuffer();
+                m_session = Ort::Session(*m_env, modelBuffer.data, modelBuffer.size, options,
+                                         m_sharedModel->getPrepackedWeights());
+            }
+
+            m_signature = ModelSignature::fromSession(m_session);
+            if (!postInitCheck()) {
+                return false;
+            }
 
-            return postInitCheck();
+            // A failed warm-up does not invalidate the session, the real inputs may still work.
+            for (auto frames : config.warmupFrameBuckets) {
+                if (frames <= 0) {
+                    continue;
+                }
+                std::cout << "Warming up with " << frames << " frames...\n";
+                if (!warmUp(frames)) {
+                    std::cout << "Warm-up failed. Skipped the remaining warm-up inferences.\n";
+                    break;
+                }
+            }
+            return true;
         }
         catch (const Ort::Exception &ortException) {
             printOrtError(ortException);
@@ -123,6 +179,8 @@ namespace diffsinger {
             Ort::Session emptySession(nullptr);
             std::swap(m_session, emptySession);
         }
+        m_sharedModel.reset();
+        m_signature = ModelSignature();
         postCleanup();
     }
 
@@ -132,4 +190,8 @@ namespace diffsinger {
 
     void Inference::postCleanup() {}
 
+    bool Inference::warmUp(int64_t /*frames*/) {
+        return true;
+    }
+
 }  // namespace diffsinger
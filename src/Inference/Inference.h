@@ -2,12 +2,18 @@
 #ifndef DS_ONNX_INFER_INFERENCE_H
 #define DS_ONNX_INFER_INFERENCE_H
 
+#include <cstdint>
+#include <filesystem>
+#include <memory>
 #include <string>
 #include <vector>
 
 #include <onnxruntime_cxx_api.h>
 
 #include "TString.h"
+#include "MappedFile.h"
+#include "SharedModel.h"
+#include "ModelSignature.h"
 
 namespace diffsinger {
 
@@ -17,12 +23,36 @@ namespace diffsinger {
         DirectML
     };  // enum class ExecutionProvider
 
+    struct SessionConfig {
+        // Directory of the optimized model cache (see OptimizedModelCache). Empty to disable the cache.
+        std::filesystem::path cacheDirectory;
+
+        // Frame lengths to run warm-up inferences with right after the session is created,
+        // so that kernel selection and memory allocation are done before the first real input.
+        // Empty to skip warm-up.
+        std::vector<int64_t> warmupFrameBuckets;
+
+        // Threads of each session for a single operator. 0 to use the ORT default (one per core), which
+        // oversubscribes the CPU when several sessions run at the same time.
+        int intraOpThreads = 0;
+
+        // Threads running independent operators side by side, with `parallelExecution` only. 0 for the ORT default.
+        int interOpThreads = 0;
+        bool parallelExecution = false;
+    };  // struct SessionConfig
+
 
     class Inference {
     public:
-        explicit Inference(const TString &modelPath);
+        /**
+         * @param modelPath  Path to the ONNX model.
+         * @param modelData  Optional in-memory model bytes (e.g. from a voicebank bundle). If not empty,
+         *                   the session is created from these bytes and `modelPath` is only informational.
+         */
+        explicit Inference(const TString &modelPath, const MappedBuffer &modelData = {});
 
-        bool initSession(ExecutionProvider ep = ExecutionProvider::CPU, int deviceIndex = 0);
+        bool initSession(ExecutionProvider ep = ExecutionProvider::CPU, int deviceIndex = 0,
+                         const SessionConfig &config = {});
 
         void endSession();
 
@@ -30,19 +60,43 @@ namespace diffsinger {
 
         TString getModelPath();
 
+        const ModelSignature &getSignature() const;
+
+        /**
+         * @brief Hash of the bytes of the model the session was created from, or 0 without a session.
+         *        Identifies the model in cache keys of predictions.
+         */
+        uint64_t getModelHash() const;
+
     protected:
         TString m_modelPath;
+        MappedBuffer m_modelData;
+
+        // The session is created from the shared model's bytes and shares its prepacked weights container,
+        // which must outlive the session, so it is also defined before Ort::Session.
+        std::shared_ptr<SharedModel> m_sharedModel;
 
         // Ort::Env must be initialized before Ort::Session.
         // (In this class, it should be defined before Ort::Session)
         // Otherwise, access violation will occur when Ort::Session destructor is called.
-        Ort::Env m_env;
+        // All sessions share the environment, and with it the global thread pool (see SharedEnv).
+        std::shared_ptr<Ort::Env> m_env;
         Ort::Session m_session;
         OrtApi const &ortApi; // Uses ORT_API_VERSION
+
+        // Inputs and outputs of the session, read once after the session is created (before postInitCheck).
+        ModelSignature m_signature;
     protected:
         virtual bool postInitCheck();
 
         virtual void postCleanup();
+
+        /**
+         * @brief Runs one inference with dummy inputs of `frames` frames. Does nothing by default.
+         *
+         * @return false if the inference failed.
+         */
+        virtual bool warmUp(int64_t frames);
     };  // class Inference
 
 }  // namespace diffsinger
@@ -6,6 +6,7 @@
 #include <iostream>
 #include <unordered_set>
 #include <cstdint>
+#include <algorithm>
 
 #include <onnxruntime_cxx_api.h>
 
@@ -43,6 +44,21 @@ namespace diffsinger {
                                            std::vector<const char *> &inputNames,
                                            std::vector<Ort::Value> &inputTensors);
 
+    /**
+     * @brief Stacks rows of different lengths into a [batch, maxLength] tensor, or a [batch, maxLength, innerSize]
+     *        tensor if `innerSize` is positive. Rows shorter than the longest one are padded with `padValue`.
+     */
+    template<class T_vector, class T_tensor = T_vector>
+    inline Ort::Value stackVectorsToTensor(const std::vector<const std::vector<T_vector> *> &rows,
+                                           int64_t innerSize,
+                                           T_tensor padValue);
+
+    /**
+     * @brief Copies the first `length` steps of row `index` of a [batch, maxLength, ...] tensor.
+     */
+    template<class T_tensor, class T_vector = T_tensor>
+    inline std::vector<T_vector> tensorRowToVector(const Ort::Value &value, size_t index, int64_t length);
+
     inline bool hasKey(const std::unordered_set<std::string> &container, const std::string &key);
 
     inline void printOrtError(const Ort::Exception &err);
@@ -153,6 +169,53 @@ namespace diffsinger {
         inputTensors.push_back(std::move(inputTensor));
     }
 
+    template<class T_vector, class T_tensor>
+    Ort::Value stackVectorsToTensor(const std::vector<const std::vector<T_vector> *> &rows,
+                                    int64_t innerSize,
+                                    T_tensor padValue) {
+        auto stepSize = (innerSize > 0) ? innerSize : 1;
+        int64_t maxLength = 0;
+        for (const auto *row : rows) {
+            maxLength = std::max(maxLength, static_cast<int64_t>(row->size()) / stepSize);
+        }
+
+        std::vector<int64_t> shape = { static_cast<int64_t>(rows.size()), maxLength };
+        if (innerSize > 0) {
+            shape.push_back(innerSize);
+        }
+
+        Ort::AllocatorWithDefaultOptions allocator;
+        auto tensor = Ort::Value::CreateTensor<T_tensor>(allocator, shape.data(), shape.size());
+        auto buffer = tensor.template GetTensorMutableData<T_tensor>();
+        auto rowStride = maxLength * stepSize;
+        for (size_t i = 0; i < rows.size(); i++) {
+            auto rowBuffer = buffer + i * rowStride;
+            const auto &row = *rows[i];
+            for (size_t j = 0; j < row.size(); j++) {
+                rowBuffer[j] = static_cast<T_tensor>(row[j]);
+            }
+            std::fill(rowBuffer + row.size(), rowBuffer + rowStride, padValue);
+        }
+
+        return tensor;
+    }
+
+    template<class T_tensor, class T_vector>
+    std::vector<T_vector> tensorRowToVector(const Ort::Value &value, size_t index, int64_t length) {
+        auto shape = value.GetTensorTypeAndShapeInfo().GetShape();
+        if (shape.size() < 2) {
+            return {};
+        }
+        int64_t stepSize = 1;
+        for (size_t i = 2; i < shape.size(); i++) {
+            stepSize *= shape[i];
+        }
+        length = std::min(length, shape[1]);
+
+        auto buffer = value.template GetTensorData<T_tensor>() + index * shape[1] * stepSize;
+        return std::vector<T_vector>(buffer, buffer + length * stepSize);
+    }
+
     bool hasKey(const std::unordered_set<std::string> &container, const std::string &key) {
         return container.find(key) != container.end();
     }
@@ -2,41 +2,76 @@
 #include "InferenceUtils.hpp"
 
 namespace diffsinger {
-    LinguisticInference::LinguisticInference(const TString &modelPath) : Inference(modelPath) {}
+    LinguisticInference::LinguisticInference(const TString &modelPath)
+            : Inference(modelPath),
+              m_bindingPlan(),
+              m_tokensSlot(BindingPlan::npos),
+              m_wordDivSlot(BindingPlan::npos),
+              m_wordDurSlot(BindingPlan::npos),
+              m_phDurSlot(BindingPlan::npos),
+              m_canBatch(false) {}
 
-    LinguisticEncodedData LinguisticInference::infer(const LinguisticInput &input) {
-        if (!m_session) {
-            return {};
-        }
-
-        auto supportedInputNames = getSupportedInputNames(m_session);
-        auto supportedOutputNames = getSupportedOutputNames(m_session);
+    bool LinguisticInference::postInitCheck() {
+        bool hasWordInputs = m_signature.hasInput("word_div") && m_signature.hasInput("word_dur");
+        bool hasPhonemeInputs = m_signature.hasInput("ph_dur");
 
         bool isValidModel = true;
-        isValidModel &= hasKey(supportedInputNames, "tokens");
-        isValidModel &= hasKey(supportedInputNames, "word_div");
-        isValidModel &= hasKey(supportedInputNames, "word_dur");
-        isValidModel &= hasKey(supportedOutputNames, "encoder_out");
-        isValidModel &= hasKey(supportedOutputNames, "x_masks");
+        isValidModel &= m_signature.hasInput("tokens");
+        isValidModel &= (hasWordInputs || hasPhonemeInputs);
+        isValidModel &= m_signature.hasOutput("encoder_out");
+        isValidModel &= m_signature.hasOutput("x_masks");
 
         if (!isValidModel) {
             std::cout << "Invalid Linguistic predictor model! "
-                         "Must have inputs: tokens, word_div, word_dur; "
+                         "Must have inputs: tokens, word_div, word_dur (or tokens, ph_dur); "
                          "outputs: encoder_out, x_masks\n";
-            return {};
+            endSession();
+            return false;
+        }
+
+        m_bindingPlan.clear();
+        m_tokensSlot = m_bindingPlan.addInput(m_signature, "tokens");
+        if (hasWordInputs) {
+            m_wordDivSlot = m_bindingPlan.addInput(m_signature, "word_div");
+            m_wordDurSlot = m_bindingPlan.addInput(m_signature, "word_dur");
+        } else {
+            m_phDurSlot = m_bindingPlan.addInput(m_signature, "ph_dur");
         }
+        m_bindingPlan.addOutput("encoder_out");
+        m_bindingPlan.addOutput("x_masks");
+
+        m_canBatch = m_signature.findInput("tokens")->isDynamicAxis(0);
+        return true;
+    }
 
-        std::vector<const char *> inputNames;
-        std::vector<Ort::Value> inputTensors;
+    void LinguisticInference::postCleanup() {
+        m_bindingPlan.clear();
+        m_tokensSlot = BindingPlan::npos;
+        m_wordDivSlot = BindingPlan::npos;
+        m_wordDurSlot = BindingPlan::npos;
+        m_phDurSlot = BindingPlan::npos;
+        m_canBatch = false;
+    }
 
-        appendVectorToInputTensors<int64_t, int64_t>("tokens", input.tokens, inputNames, inputTensors);
-        appendVectorToInputTensors<int64_t, int64_t>("word_div", input.word_div, inputNames, inputTensors);
-        appendVectorToInputTensors<int64_t, int64_t>("word_dur", input.word_dur, inputNames, inputTensors);
+    bool LinguisticInference::usesPhonemeDurations() const {
+        return m_phDurSlot != BindingPlan::npos;
+    }
 
-        std::vector<const char*> outputNames = {"encoder_out", "x_masks"};
-        std::vector<Ort::Value> outputTensors = m_session.Run(
-                Ort::RunOptions{}, inputNames.data(), inputTensors.data(),
-                inputNames.size(), outputNames.data(), outputNames.size());
+    LinguisticEncodedData LinguisticInference::infer(const LinguisticInput &input) {
+        if (!m_session) {
+            return {};
+        }
+
+        auto inputTensors = m_bindingPlan.createInputs();
+        inputTensors[m_tokensSlot] = vectorToTensor<int64_t, int64_t>(input.tokens);
+        if (m_phDurSlot != BindingPlan::npos) {
+            inputTensors[m_phDurSlot] = vectorToTensor<int64_t, int64_t>(input.ph_dur);
+        } else {
+            inputTensors[m_wordDivSlot] = vectorToTensor<int64_t, int64_t>(input.word_div);
+            inputTensors[m_wordDurSlot] = vectorToTensor<int64_t, int64_t>(input.word_dur);
+        }
+
+        std::vector<Ort::Value> outputTensors = m_bindingPlan.run(m_session, inputTensors);
 
         if (outputTensors.size() < 2) {
             return {};
@@ -58,4 +93,82 @@ namespace diffsinger {
         return out;
     }
 
+    std::vector<LinguisticEncodedData> LinguisticInference::inferBatch(
+            const std::vector<const LinguisticInput *> &inputs) {
+        std::vector<LinguisticEncodedData> out;
+        if (!m_session || inputs.empty()) {
+            return out;
+        }
+        out.reserve(inputs.size());
+
+        if (!m_canBatch || inputs.size() == 1) {
+            for (const auto *input : inputs) {
+                out.push_back(infer(*input));
+            }
+            return out;
+        }
+
+        std::vector<const std::vector<int64_t> *> tokens;
+        tokens.reserve(inputs.size());
+        size_t maxTokens = 0;
+        for (const auto *input : inputs) {
+            tokens.push_back(&input->tokens);
+            maxTokens = std::max(maxTokens, input->tokens.size());
+        }
+
+        // Token 0 is the padding token, which is masked out by the model.
+        auto inputTensors = m_bindingPlan.createInputs();
+        inputTensors[m_tokensSlot] = stackVectorsToTensor<int64_t, int64_t>(tokens, 0, 0);
+        if (m_phDurSlot != BindingPlan::npos) {
+            // Padded tokens last zero frames.
+            std::vector<const std::vector<int64_t> *> phDur;
+            phDur.reserve(inputs.size());
+            for (const auto *input : inputs) {
+                phDur.push_back(&input->ph_dur);
+            }
+            inputTensors[m_phDurSlot] = stackVectorsToTensor<int64_t, int64_t>(phDur, 0, 0);
+        } else {
+            // Padded tokens form one extra word lasting zero frames, and the word lists are padded with
+            // empty words, so that each row of word_div still covers all tokens of the row.
+            std::vector<std::vector<int64_t>> wordDiv;
+            std::vector<std::vector<int64_t>> wordDur;
+            wordDiv.reserve(inputs.size());
+            wordDur.reserve(inputs.size());
+            for (const auto *input : inputs) {
+                wordDiv.push_back(input->word_div);
+                wordDur.push_back(input->word_dur);
+                auto numPadTokens = static_cast<int64_t>(maxTokens - input->tokens.size());
+                if (numPadTokens > 0) {
+                    wordDiv.back().push_back(numPadTokens);
+                    wordDur.back().push_back(0);
+                }
+            }
+            std::vector<const std::vector<int64_t> *> wordDivRows;
+            std::vector<const std::vector<int64_t> *> wordDurRows;
+            for (size_t i = 0; i < inputs.size(); ++i) {
+                wordDivRows.push_back(&wordDiv[i]);
+                wordDurRows.push_back(&wordDur[i]);
+            }
+            inputTensors[m_wordDivSlot] = stackVectorsToTensor<int64_t, int64_t>(wordDivRows, 0, 0);
+            inputTensors[m_wordDurSlot] = stackVectorsToTensor<int64_t, int64_t>(wordDurRows, 0, 0);
+        }
+
+        std::vector<Ort::Value> outputTensors = m_bindingPlan.run(m_session, inputTensors);
+        if (outputTensors.size() < 2) {
+            return {};
+        }
+
+        auto encoderOutShape = outputTensors[0].GetTensorTypeAndShapeInfo().GetShape();
+        auto hiddenSize = static_cast<int>(encoderOutShape[encoderOutShape.size() - 1]);
+        for (size_t i = 0; i < inputs.size(); ++i) {
+            auto numTokens = static_cast<int64_t>(inputs[i]->tokens.size());
+            LinguisticEncodedData item;
+            item.encoder_out = tensorRowToVector<float>(outputTensors[0], i, numTokens);
+            item.x_masks = tensorRowToVector<bool, char>(outputTensors[1], i, numTokens);
+            item.hidden_size = hiddenSize;
+            out.push_back(std::move(item));
+        }
+        return out;
+    }
+
 } // namespace diffsinger
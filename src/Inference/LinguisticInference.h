@@ -1,6 +1,8 @@
 #ifndef DS_ONNX_INFER_LINGUISTICINFERENCE_H
 #define DS_ONNX_INFER_LINGUISTICINFERENCE_H
 
+#include <vector>
+
 #include "TString.h"
 #include "Inference.h"
 #include "ModelData.h"
@@ -15,6 +17,31 @@ namespace diffsinger {
         explicit LinguisticInference(const TString &modelPath);
 
         LinguisticEncodedData infer(const LinguisticInput &input);
+
+        /**
+         * @brief Encodes several inputs. They are run as one batch if the model has a dynamic batch axis,
+         *        or one by one otherwise.
+         */
+        std::vector<LinguisticEncodedData> inferBatch(const std::vector<const LinguisticInput *> &inputs);
+
+        /**
+         * @brief Whether the model takes phoneme durations (tokens, ph_dur) instead of
+         *        word divisions and durations (tokens, word_div, word_dur).
+         */
+        bool usesPhonemeDurations() const;
+
+    protected:
+        bool postInitCheck() override;
+
+        void postCleanup() override;
+
+    private:
+        BindingPlan m_bindingPlan;
+        int m_tokensSlot;
+        int m_wordDivSlot;
+        int m_wordDurSlot;
+        int m_phDurSlot;
+        bool m_canBatch;
     };
 
 } // diffsinger
@@ -0,0 +1,123 @@
+#include "ModelSignature.h"
+
+namespace diffsinger {
+
+    namespace {
+        TensorSignature readTensorSignature(const Ort::TypeInfo &typeInfo, const char *name) {
+            TensorSignature tensor;
+            tensor.name = name;
+            if (typeInfo.GetONNXType() == ONNX_TYPE_TENSOR) {
+                auto tensorInfo = typeInfo.GetTensorTypeAndShapeInfo();
+                tensor.elementType = tensorInfo.GetElementType();
+                tensor.shape = tensorInfo.GetShape();
+            }
+            return tensor;
+        }
+
+        const TensorSignature *findTensor(const std::vector<TensorSignature> &tensors, std::string_view name) {
+            for (const auto &tensor : tensors) {
+                if (tensor.name == name) {
+                    return &tensor;
+                }
+            }
+            return nullptr;
+        }
+    }
+
+    bool TensorSignature::isDynamicAxis(size_t axis) const {
+        return axis < shape.size() && shape[axis] < 0;
+    }
+
+    ModelSignature ModelSignature::fromSession(const Ort::Session &session) {
+        ModelSignature signature;
+        if (!session) {
+            return signature;
+        }
+
+        Ort::AllocatorWithDefaultOptions allocator;
+
+        auto inputCount = session.GetInputCount();
+        signature.m_inputs.reserve(inputCount);
+        for (size_t i = 0; i < inputCount; ++i) {
+            auto inputNamePtr = session.GetInputNameAllocated(i, allocator);
+            signature.m_inputs.push_back(readTensorSignature(session.GetInputTypeInfo(i), inputNamePtr.get()));
+        }
+
+        auto outputCount = session.GetOutputCount();
+        signature.m_outputs.reserve(outputCount);
+        for (size_t i = 0; i < outputCount; ++i) {
+            auto outputNamePtr = session.GetOutputNameAllocated(i, allocator);
+            signature.m_outputs.push_back(readTensorSignature(session.GetOutputTypeInfo(i), outputNamePtr.get()));
+        }
+        return signature;
+    }
+
+    const std::vector<TensorSignature> &ModelSignature::inputs() const {
+        return m_inputs;
+    }
+
+    const std::vector<TensorSignature> &ModelSignature::outputs() const {
+        return m_outputs;
+    }
+
+    const TensorSignature *ModelSignature::findInput(std::string_view name) const {
+        return findTensor(m_inputs, name);
+    }
+
+    const TensorSignature *ModelSignature::findOutput(std::string_view name) const {
+        return findTensor(m_outputs, name);
+    }
+
+    bool ModelSignature::hasInput(std::string_view name) const {
+        return findInput(name) != nullptr;
+    }
+
+    bool ModelSignature::hasOutput(std::string_view name) const {
+        return findOutput(name) != nullptr;
+    }
+
+    bool ModelSignature::empty() const {
+        return m_inputs.empty() && m_outputs.empty();
+    }
+
+    int BindingPlan::addInput(const ModelSignature &signature, const char *name) {
+        if (!signature.hasInput(name)) {
+            return npos;
+        }
+        m_inputNames.push_back(name);
+        return static_cast<int>(m_inputNames.size() - 1);
+    }
+
+    void BindingPlan::addOutput(const char *name) {
+        m_outputNames.push_back(name);
+    }
+
+    size_t BindingPlan::inputCount() const {
+        return m_inputNames.size();
+    }
+
+    size_t BindingPlan::outputCount() const {
+        return m_outputNames.size();
+    }
+
+    std::vector<Ort::Value> BindingPlan::createInputs() const {
+        std::vector<Ort::Value> inputs;
+        inputs.reserve(m_inputNames.size());
+        for (size_t i = 0; i < m_inputNames.size(); ++i) {
+            inputs.emplace_back(nullptr);
+        }
+        return inputs;
+    }
+
+    std::vector<Ort::Value> BindingPlan::run(Ort::Session &session, const std::vector<Ort::Value> &inputs) const {
+        return session.Run(Ort::RunOptions{},
+                           m_inputNames.data(), inputs.data(), m_inputNames.size(),
+                           m_outputNames.data(), m_outputNames.size());
+    }
+
+    void BindingPlan::clear() {
+        m_inputNames.clear();
+        m_outputNames.clear();
+    }
+
+}  // namespace diffsinger
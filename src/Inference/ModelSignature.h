@@ -0,0 +1,98 @@
+#ifndef DS_ONNX_INFER_MODELSIGNATURE_H
+#define DS_ONNX_INFER_MODELSIGNATURE_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <onnxruntime_cxx_api.h>
+
+namespace diffsinger {
+
+    struct TensorSignature {
+        std::string name;
+        ONNXTensorElementDataType elementType = ONNX_TENSOR_ELEMENT_DATA_TYPE_UNDEFINED;
+
+        // -1 for dynamic axes.
+        std::vector<int64_t> shape;
+
+        bool isDynamicAxis(size_t axis) const;
+    };  // struct TensorSignature
+
+
+    /**
+     * @brief Input and output tensors of a session, read once after the session is created.
+     */
+    class ModelSignature {
+    public:
+        static ModelSignature fromSession(const Ort::Session &session);
+
+        const std::vector<TensorSignature> &inputs() const;
+
+        const std::vector<TensorSignature> &outputs() const;
+
+        /**
+         * @return The input named `name`, or nullptr if the model does not have it.
+         */
+        const TensorSignature *findInput(std::string_view name) const;
+
+        const TensorSignature *findOutput(std::string_view name) const;
+
+        bool hasInput(std::string_view name) const;
+
+        bool hasOutput(std::string_view name) const;
+
+        bool empty() const;
+
+    private:
+        std::vector<TensorSignature> m_inputs;
+        std::vector<TensorSignature> m_outputs;
+    };  // class ModelSignature
+
+
+    /**
+     * @brief Input and output names of a session call, resolved once against the model signature.
+     *
+     * At call time, only the input values are filled (in the slots returned by `addInput`),
+     * so that no name lookup or name vector is needed per call.
+     *
+     * The names passed in must have static storage duration (e.g. string literals).
+     */
+    class BindingPlan {
+    public:
+        static constexpr int npos = -1;
+
+        /**
+         * @brief Adds an input if the model has it.
+         *
+         * @return The slot of the input, or `npos` if the model does not have it.
+         */
+        int addInput(const ModelSignature &signature, const char *name);
+
+        void addOutput(const char *name);
+
+        size_t inputCount() const;
+
+        size_t outputCount() const;
+
+        /**
+         * @brief Creates empty input values, one for each slot.
+         */
+        std::vector<Ort::Value> createInputs() const;
+
+        /**
+         * @brief Runs the session with the input values filled in the slots. Throws Ort::Exception on failure.
+         */
+        std::vector<Ort::Value> run(Ort::Session &session, const std::vector<Ort::Value> &inputs) const;
+
+        void clear();
+
+    private:
+        std::vector<const char *> m_inputNames;
+        std::vector<const char *> m_outputNames;
+    };  // class BindingPlan
+
+}  // namespace diffsinger
+
+#endif //DS_ONNX_INFER_MODELSIGNATURE_H
@@ -0,0 +1,100 @@
+#include <iostream>
+
+#include "FileUtil.h"
+#include "HashUtil.hpp"
+#include "InferenceUtils.hpp"
+#include "OptimizedModelCache.h"
+
+namespace diffsinger {
+
+    namespace {
+        // Saved models are optimized up to the extended level. Layout optimizations of ORT_ENABLE_ALL
+        // depend on the CPU, and are applied again by ORT when the cached model is loaded.
+        constexpr auto CACHE_OPTIMIZATION_LEVEL = GraphOptimizationLevel::ORT_ENABLE_EXTENDED;
+        constexpr auto CACHE_OPTIONS_KEY = "ep=cpu;level=extended;format=ort";
+    }
+
+    OptimizedModelCache::OptimizedModelCache(std::filesystem::path cacheDirectory)
+            : m_cacheDirectory(std::move(cacheDirectory)) {}
+
+    std::filesystem::path OptimizedModelCache::getCachePath(SharedModel &model) const {
+        auto key = Hasher()
+                .updateValue(model.getContentHash())
+                .update(Ort::GetVersionString())
+                .update(CACHE_OPTIONS_KEY)
+                .digest();
+        auto stem = std::filesystem::path(model.getModelPath()).stem();
+        stem += "-" + toHexString(key) + ".ort";
+        return m_cacheDirectory / "models" / stem;
+    }
+
+    Ort::Session OptimizedModelCache::createSession(const Ort::Env &env,
+                                                    const Ort::SessionOptions &options,
+                                                    std::shared_ptr<SharedModel> &model) const {
+        auto cachePath = getCachePath(*model);
+
+        std::error_code ec;
+        if (std::filesystem::exists(cachePath, ec)) {
+            auto session = loadCachedModel(env, options, cachePath, model);
+            if (session) {
+                std::cout << "Loaded optimized model from cache.\n";
+                return session;
+            }
+            std::cout << "The cached optimized model is invalid. Rebuilding...\n";
+            std::filesystem::remove(cachePath, ec);
+        }
+
+        bool isSaved = writeFileAtomicallyByPath(cachePath, [&](const std::filesystem::path &tempPath) {
+            try {
+                // Only the optimized graph is needed, the session created here is discarded.
+                auto saveOptions = options.Clone();
+                saveOptions.SetGraphOptimizationLevel(CACHE_OPTIMIZATION_LEVEL);
+                saveOptions.SetOptimizedModelFilePath(tempPath.c_str());
+                saveOptions.AddConfigEntry("session.save_model_format", "ORT");
+
+                const auto &modelBuffer = model->getBuffer();
+                Ort::Session saveSession(env, modelBuffer.data, modelBuffer.size, saveOptions);
+                return true;
+            }
+            catch (const Ort::Exception &ortException) {
+                printOrtError(ortException);
+            }
+            return false;
+        });
+        if (!isSaved) {
+            std::cout << "Failed to save the optimized model to cache.\n";
+            return Ort::Session(nullptr);
+        }
+        std::cout << "Saved optimized model to cache.\n";
+
+        // Load the model just saved, so that the first run behaves exactly like the later ones.
+        return loadCachedModel(env, options, cachePath, model);
+    }
+
+    Ort::Session OptimizedModelCache::loadCachedModel(const Ort::Env &env,
+                                                      const Ort::SessionOptions &options,
+                                                      const std::filesystem::path &cachePath,
+                                                      std::shared_ptr<SharedModel> &model) const {
+        auto cachedModel = SharedModel::acquire(cachePath.native());
+        if (!cachedModel) {
+            return Ort::Session(nullptr);
+        }
+        try {
+            auto loadOptions = options.Clone();
+            loadOptions.AddConfigEntry("session.load_model_format", "ORT");
+            // The mapped bytes are kept alive by the shared model, so ORT can use them without copying.
+            loadOptions.AddConfigEntry("session.use_ort_model_bytes_directly", "1");
+
+            const auto &modelBuffer = cachedModel->getBuffer();
+            Ort::Session session(env, modelBuffer.data, modelBuffer.size, loadOptions,
+                                 cachedModel->getPrepackedWeights());
+            model = std::move(cachedModel);
+            return session;
+        }
+        catch (const Ort::Exception &ortException) {
+            printOrtError(ortException);
+        }
+        return Ort::Session(nullptr);
+    }
+
+}  // namespace diffsinger
@@ -0,0 +1,54 @@
+#ifndef DS_ONNX_INFER_OPTIMIZEDMODELCACHE_H
+#define DS_ONNX_INFER_OPTIMIZEDMODELCACHE_H
+
+#include <filesystem>
+#include <memory>
+#include <string>
+
+#include <onnxruntime_cxx_api.h>
+
+#include "SharedModel.h"
+
+namespace diffsinger {
+
+    /**
+     * @brief On-disk cache of graph-optimized models in ORT format.
+     *
+     * On the first load of a model, the graph optimized by ORT is saved in ORT (flatbuffer) format.
+     * Later loads memory-map the saved model and use its bytes directly, skipping the graph
+     * optimizations of the raw .onnx model. Cached models are keyed by the hash of the model bytes,
+     * the ORT version and the session options that affect the optimized graph.
+     *
+     * Only used with the CPU execution provider: other providers may fuse provider-specific nodes,
+     * which cannot be saved in ORT format.
+     */
+    class OptimizedModelCache {
+    public:
+        explicit OptimizedModelCache(std::filesystem::path cacheDirectory);
+
+        std::filesystem::path getCachePath(SharedModel &model) const;
+
+        /**
+         * @brief Creates a session from the cached model, optimizing and caching the model first if needed.
+         *
+         * @param env      The ORT environment.
+         * @param options  Session options (with execution providers already appended).
+         * @param model    The source model. On success, it is replaced by the cached model the session uses.
+         * @return         The session, or an empty session if the cache cannot be used.
+         */
+        Ort::Session createSession(const Ort::Env &env,
+                                   const Ort::SessionOptions &options,
+                                   std::shared_ptr<SharedModel> &model) const;
+
+    private:
+        Ort::Session loadCachedModel(const Ort::Env &env,
+                                     const Ort::SessionOptions &options,
+                                     const std::filesystem::path &cachePath,
+                                     std::shared_ptr<SharedModel> &model) const;
+
+        std::filesystem::path m_cacheDirectory;
+    };  // class OptimizedModelCache
+
+}  // namespace diffsinger
+
+#endif //DS_ONNX_INFER_OPTIMIZEDMODELCACHE_H
@@ -3,56 +3,110 @@
 #include "ModelData.h"
 
 namespace diffsinger {
-    PhonemeDurInference::PhonemeDurInference(const TString &modelPath) : Inference(modelPath) {}
-
-    std::vector<float>
-    PhonemeDurInference::infer(
-            const LinguisticEncodedData &linguisticEncodedData,
-            const std::vector<int> &ph_midi) {
-        if (!m_session) {
-            return {};
-        }
-
-        auto supportedInputNames = getSupportedInputNames(m_session);
-        auto supportedOutputNames = getSupportedOutputNames(m_session);
+    PhonemeDurInference::PhonemeDurInference(const TString &modelPath)
+            : Inference(modelPath),
+              m_bindingPlan(),
+              m_encoderOutSlot(BindingPlan::npos),
+              m_xMasksSlot(BindingPlan::npos),
+              m_phMidiSlot(BindingPlan::npos),
+              m_canBatch(false) {}
 
+    bool PhonemeDurInference::postInitCheck() {
         bool isValidModel = true;
-        isValidModel &= hasKey(supportedInputNames, "encoder_out");
-        isValidModel &= hasKey(supportedInputNames, "x_masks");
-        isValidModel &= hasKey(supportedInputNames, "ph_midi");
-        isValidModel &= hasKey(supportedOutputNames, "ph_dur_pred");
+        isValidModel &= m_signature.hasInput("encoder_out");
+        isValidModel &= m_signature.hasInput("x_masks");
+        isValidModel &= m_signature.hasInput("ph_midi");
+        isValidModel &= m_signature.hasOutput("ph_dur_pred");
 
         if (!isValidModel) {
             std::cout << "Invalid Dur predictor model! "
                          "Must have inputs: encoder_out, x_masks, ph_midi; "
                          "outputs: ph_dur_pred\n";
-            return {};
+            endSession();
+            return false;
         }
 
-        std::vector<const char *> inputNames;
-        std::vector<Ort::Value> inputTensors;
+        m_bindingPlan.clear();
+        m_xMasksSlot = m_bindingPlan.addInput(m_signature, "x_masks");
+        m_encoderOutSlot = m_bindingPlan.addInput(m_signature, "encoder_out");
+        m_phMidiSlot = m_bindingPlan.addInput(m_signature, "ph_midi");
+        m_bindingPlan.addOutput("ph_dur_pred");
+
+        m_canBatch = m_signature.findInput("encoder_out")->isDynamicAxis(0);
+        return true;
+    }
+
+    void PhonemeDurInference::postCleanup() {
+        m_bindingPlan.clear();
+        m_encoderOutSlot = BindingPlan::npos;
+        m_xMasksSlot = BindingPlan::npos;
+        m_phMidiSlot = BindingPlan::npos;
+        m_canBatch = false;
+    }
 
-        appendVectorToInputTensors<char, bool>("x_masks", linguisticEncodedData.x_masks, inputNames, inputTensors);
-        auto sp = static_cast<int64_t>(linguisticEncodedData.encoder_out.size()) / linguisticEncodedData.hidden_size;
-        appendVectorToInputTensorsWithShape<float, float>(
-                "encoder_out",
+    std::vector<float>
+    PhonemeDurInference::infer(
+            const LinguisticEncodedData &linguisticEncodedData,
+            const std::vector<int> &ph_midi) {
+        if (!m_session) {
+            return {};
+        }
+
+        auto inputTensors = m_bindingPlan.createInputs();
+        inputTensors[m_xMasksSlot] = vectorToTensor<char, bool>(linguisticEncodedData.x_masks);
+        inputTensors[m_encoderOutSlot] = vectorToTensorWithShape<float, float>(
                 linguisticEncodedData.encoder_out,
                 {
                     1,
                     static_cast<int64_t>(linguisticEncodedData.encoder_out.size()) / linguisticEncodedData.hidden_size,
                     linguisticEncodedData.hidden_size
-                },
-                inputNames, inputTensors);
-        appendVectorToInputTensors<int, int64_t>("ph_midi", ph_midi, inputNames, inputTensors);
+                });
+        inputTensors[m_phMidiSlot] = vectorToTensor<int, int64_t>(ph_midi);
 
-        std::vector<const char*> outputNames = {"ph_dur_pred"};
-        std::vector<Ort::Value> outputTensors = m_session.Run(
-                Ort::RunOptions{}, inputNames.data(), inputTensors.data(),
-                inputNames.size(), outputNames.data(), outputNames.size());
+        std::vector<Ort::Value> outputTensors = m_bindingPlan.run(m_session, inputTensors);
 
         Ort::Value &phDurPredOutput = outputTensors[0];
         auto phDurPredBuffer = phDurPredOutput.GetTensorData<float>();
 
         return {phDurPredBuffer, phDurPredBuffer + phDurPredOutput.GetTensorTypeAndShapeInfo().GetElementCount()};
     }
+
+    std::vector<std::vector<float>> PhonemeDurInference::inferBatch(
+            const std::vector<const LinguisticEncodedData *> &linguisticEncodedData,
+            const std::vector<const std::vector<int> *> &ph_midi) {
+        std::vector<std::vector<float>> out;
+        if (!m_session || linguisticEncodedData.empty() || linguisticEncodedData.size() != ph_midi.size()) {
+            return out;
+        }
+        out.reserve(linguisticEncodedData.size());
+
+        if (!m_canBatch || linguisticEncodedData.size() == 1) {
+            for (size_t i = 0; i < linguisticEncodedData.size(); ++i) {
+                out.push_back(infer(*linguisticEncodedData[i], *ph_midi[i]));
+            }
+            return out;
+        }
+
+        std::vector<const std::vector<float> *> encoderOut;
+        std::vector<const std::vector<char> *> xMasks;
+        for (const auto *encoded : linguisticEncodedData) {
+            encoderOut.push_back(&encoded->encoder_out);
+            xMasks.push_back(&encoded->x_masks);
+        }
+
+        // Padded tokens are masked (x_masks is true for padding).
+        auto hiddenSize = static_cast<int64_t>(linguisticEncodedData[0]->hidden_size);
+        auto inputTensors = m_bindingPlan.createInputs();
+        inputTensors[m_xMasksSlot] = stackVectorsToTensor<char, bool>(xMasks, 0, true);
+        inputTensors[m_encoderOutSlot] = stackVectorsToTensor<float, float>(encoderOut, hiddenSize, 0.0f);
+        inputTensors[m_phMidiSlot] = stackVectorsToTensor<int, int64_t>(ph_midi, 0, 0);
+
+        std::vector<Ort::Value> outputTensors = m_bindingPlan.run(m_session, inputTensors);
+
+        for (size_t i = 0; i < linguisticEncodedData.size(); ++i) {
+            auto numTokens = static_cast<int64_t>(ph_midi[i]->size());
+            out.push_back(tensorRowToVector<float>(outputTensors[0], i, numTokens));
+        }
+        return out;
+    }
 } // namespace diffsinger
@@ -13,6 +13,25 @@ namespace diffsinger {
 
         std::vector<float> infer(const LinguisticEncodedData &linguisticEncodedData,
                                  const std::vector<int> &ph_midi);
+
+        /**
+         * @brief Predicts the phoneme durations (in frames) of several inputs. They are run as one batch
+         *        if the model has a dynamic batch axis, or one by one otherwise.
+         */
+        std::vector<std::vector<float>> inferBatch(const std::vector<const LinguisticEncodedData *> &linguisticEncodedData,
+                                                   const std::vector<const std::vector<int> *> &ph_midi);
+
+    protected:
+        bool postInitCheck() override;
+
+        void postCleanup() override;
+
+    private:
+        BindingPlan m_bindingPlan;
+        int m_encoderOutSlot;
+        int m_xMasksSlot;
+        int m_phMidiSlot;
+        bool m_canBatch;
     };
 
 } // namespace diffsinger
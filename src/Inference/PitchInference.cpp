@@ -1,4 +1,156 @@
 #include "PitchInference.h"
+#include "InferenceUtils.hpp"
 
 namespace diffsinger {
-} // namespace diffsinger
\ No newline at end of file
+
+    PitchInference::PitchInference(const TString &modelPath)
+            : Inference(modelPath), m_bindingPlan(), m_inputSlots(), m_canBatch(false) {}
+
+    bool PitchInference::postInitCheck() {
+        bool isValidModel = true;
+        isValidModel &= m_signature.hasInput("encoder_out");
+        isValidModel &= m_signature.hasInput("ph_dur");
+        isValidModel &= m_signature.hasInput("note_midi");
+        isValidModel &= m_signature.hasInput("note_dur");
+        isValidModel &= m_signature.hasInput("pitch");
+        isValidModel &= m_signature.hasOutput("pitch_pred");
+
+        if (!isValidModel) {
+            std::cout << "Invalid pitch predictor model! "
+                         "Must have inputs: encoder_out, ph_dur, note_midi, note_dur, pitch; "
+                         "outputs: pitch_pred\n";
+            endSession();
+            return false;
+        }
+
+        m_bindingPlan.clear();
+        m_inputSlots.encoderOut = m_bindingPlan.addInput(m_signature, "encoder_out");
+        m_inputSlots.phDur = m_bindingPlan.addInput(m_signature, "ph_dur");
+        m_inputSlots.noteMidi = m_bindingPlan.addInput(m_signature, "note_midi");
+        m_inputSlots.noteRest = m_bindingPlan.addInput(m_signature, "note_rest");
+        m_inputSlots.noteDur = m_bindingPlan.addInput(m_signature, "note_dur");
+        m_inputSlots.pitch = m_bindingPlan.addInput(m_signature, "pitch");
+        m_inputSlots.expr = m_bindingPlan.addInput(m_signature, "expr");
+        m_inputSlots.retake = m_bindingPlan.addInput(m_signature, "retake");
+        m_inputSlots.speedup = m_bindingPlan.addInput(m_signature, "speedup");
+        m_inputSlots.steps = m_bindingPlan.addInput(m_signature, "steps");
+        m_inputSlots.spkEmbed = m_bindingPlan.addInput(m_signature, "spk_embed");
+        m_bindingPlan.addOutput("pitch_pred");
+
+        m_canBatch = m_signature.findInput("encoder_out")->isDynamicAxis(0);
+        return true;
+    }
+
+    void PitchInference::postCleanup() {
+        m_bindingPlan.clear();
+        m_inputSlots = InputSlots();
+        m_canBatch = false;
+    }
+
+    bool PitchInference::requiresSpeakerEmbed() const {
+        return m_inputSlots.spkEmbed != BindingPlan::npos;
+    }
+
+    std::vector<float> PitchInference::infer(const PitchInput &input, const VarianceInferenceSettings &inferSettings) {
+        auto out = run({&input}, inferSettings);
+        return out.empty() ? std::vector<float>{} : std::move(out[0]);
+    }
+
+    std::vector<std::vector<float>> PitchInference::inferBatch(const std::vector<const PitchInput *> &inputs,
+                                                               const VarianceInferenceSettings &inferSettings) {
+        if (m_canBatch || inputs.size() <= 1) {
+            return run(inputs, inferSettings);
+        }
+
+        std::vector<std::vector<float>> out;
+        out.reserve(inputs.size());
+        for (const auto *input : inputs) {
+            out.push_back(infer(*input, inferSettings));
+        }
+        return out;
+    }
+
+    std::vector<std::vector<float>> PitchInference::run(const std::vector<const PitchInput *> &inputs,
+                                                        const VarianceInferenceSettings &inferSettings) {
+        if (!m_session || inputs.empty()) {
+            return {};
+        }
+
+        auto hiddenSize = static_cast<int64_t>(inputs[0]->encoded->hidden_size);
+
+        std::vector<const std::vector<float> *> encoderOut;
+        std::vector<const std::vector<int64_t> *> phDur;
+        std::vector<const std::vector<float> *> noteMidi;
+        std::vector<const std::vector<char> *> noteRest;
+        std::vector<const std::vector<int64_t> *> noteDur;
+        std::vector<const std::vector<float> *> pitch;
+        std::vector<const std::vector<float> *> spkEmbed;
+
+        // Every frame is retaken, with neutral expressiveness.
+        std::vector<std::vector<float>> expr;
+        std::vector<std::vector<char>> retake;
+        expr.reserve(inputs.size());
+        retake.reserve(inputs.size());
+
+        for (const auto *input : inputs) {
+            encoderOut.push_back(&input->encoded->encoder_out);
+            phDur.push_back(&input->ph_dur);
+            noteMidi.push_back(&input->note_midi);
+            noteRest.push_back(&input->note_rest);
+            noteDur.push_back(&input->note_dur);
+            pitch.push_back(&input->pitch);
+            spkEmbed.push_back(&input->spk_embed);
+            expr.emplace_back(input->pitch.size(), 1.0f);
+            retake.emplace_back(input->pitch.size(), 1);
+        }
+        std::vector<const std::vector<float> *> exprRows;
+        std::vector<const std::vector<char> *> retakeRows;
+        for (size_t i = 0; i < inputs.size(); ++i) {
+            exprRows.push_back(&expr[i]);
+            retakeRows.push_back(&retake[i]);
+        }
+
+        auto inputTensors = m_bindingPlan.createInputs();
+        inputTensors[m_inputSlots.encoderOut] = stackVectorsToTensor<float, float>(encoderOut, hiddenSize, 0.0f);
+        inputTensors[m_inputSlots.phDur] = stackVectorsToTensor<int64_t, int64_t>(phDur, 0, 0);
+        inputTensors[m_inputSlots.noteMidi] = stackVectorsToTensor<float, float>(noteMidi, 0, 0.0f);
+        inputTensors[m_inputSlots.noteDur] = stackVectorsToTensor<int64_t, int64_t>(noteDur, 0, 0);
+        inputTensors[m_inputSlots.pitch] = stackVectorsToTensor<float, float>(pitch, 0, 0.0f);
+        if (m_inputSlots.noteRest != BindingPlan::npos) {
+            inputTensors[m_inputSlots.noteRest] = stackVectorsToTensor<char, bool>(noteRest, 0, true);
+        }
+        if (m_inputSlots.expr != BindingPlan::npos) {
+            inputTensors[m_inputSlots.expr] = stackVectorsToTensor<float, float>(exprRows, 0, 1.0f);
+        }
+        if (m_inputSlots.retake != BindingPlan::npos) {
+            inputTensors[m_inputSlots.retake] = stackVectorsToTensor<char, bool>(retakeRows, 0, false);
+        }
+        if (m_inputSlots.speedup != BindingPlan::npos) {
+            inputTensors[m_inputSlots.speedup] = scalarToTensor<int, int64_t>(inferSettings.speedup);
+        }
+        if (m_inputSlots.steps != BindingPlan::npos) {
+            inputTensors[m_inputSlots.steps] = scalarToTensor<int, int64_t>(inferSettings.steps);
+        }
+        if (m_inputSlots.spkEmbed != BindingPlan::npos) {
+            inputTensors[m_inputSlots.spkEmbed] = stackVectorsToTensor<float, float>(
+                    spkEmbed, spkEmbedLastDimension, 0.0f);
+        }
+
+        std::vector<std::vector<float>> out;
+        try {
+            auto outputTensors = m_bindingPlan.run(m_session, inputTensors);
+
+            out.reserve(inputs.size());
+            for (size_t i = 0; i < inputs.size(); ++i) {
+                auto numFrames = static_cast<int64_t>(inputs[i]->pitch.size());
+                out.push_back(tensorRowToVector<float>(outputTensors[0], i, numFrames));
+            }
+        }
+        catch (const Ort::Exception &ortException) {
+            printOrtError(ortException);
+            out.clear();
+        }
+        return out;
+    }
+
+} // namespace diffsinger
@@ -1,12 +1,58 @@
 #ifndef DS_ONNX_INFER_PITCHINFERENCE_H
 #define DS_ONNX_INFER_PITCHINFERENCE_H
 
+#include <vector>
+
 #include "Inference.h"
+#include "ModelData.h"
+#include "VarianceInference.h"
 
 namespace diffsinger {
 
     class PitchInference : public Inference {
+    public:
+        explicit PitchInference(const TString &modelPath);
+
+        /**
+         * @return The predicted MIDI pitch of each frame, or an empty vector if the inference failed.
+         */
+        std::vector<float> infer(const PitchInput &input, const VarianceInferenceSettings &inferSettings);
+
+        /**
+         * @brief Predicts the pitch of several inputs. They are run as one batch if the model has
+         *        a dynamic batch axis, or one by one otherwise.
+         */
+        std::vector<std::vector<float>> inferBatch(const std::vector<const PitchInput *> &inputs,
+                                                   const VarianceInferenceSettings &inferSettings);
+
+        bool requiresSpeakerEmbed() const;
+
+    protected:
+        bool postInitCheck() override;
+
+        void postCleanup() override;
+
+    private:
+        struct InputSlots {
+            int encoderOut = BindingPlan::npos;
+            int phDur = BindingPlan::npos;
+            int noteMidi = BindingPlan::npos;
+            int noteRest = BindingPlan::npos;
+            int noteDur = BindingPlan::npos;
+            int pitch = BindingPlan::npos;
+            int expr = BindingPlan::npos;
+            int retake = BindingPlan::npos;
+            int speedup = BindingPlan::npos;
+            int steps = BindingPlan::npos;
+            int spkEmbed = BindingPlan::npos;
+        };
+
+        BindingPlan m_bindingPlan;
+        InputSlots m_inputSlots;
+        bool m_canBatch;
 
+        std::vector<std::vector<float>> run(const std::vector<const PitchInput *> &inputs,
+                                            const VarianceInferenceSettings &inferSettings);
     };
 
 } // namespace diffsinger
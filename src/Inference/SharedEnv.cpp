@@ -0,0 +1,77 @@
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+#include "SharedEnv.h"
+#include "ThreadPool.h"
+
+namespace diffsinger {
+
+    namespace {
+        struct ThreadCreationOptions {
+            std::atomic<size_t> nextCore{0};
+            bool pinThreads = false;
+        };
+
+        std::mutex envMutex;
+        std::shared_ptr<Ort::Env> env;
+        bool isGlobalThreadPool = false;
+        ThreadCreationOptions threadCreationOptions;
+
+        OrtCustomThreadHandle createThread(void *options, OrtThreadWorkerFn workerFn, void *workerParam) {
+            auto &creationOptions = *static_cast<ThreadCreationOptions *>(options);
+            auto core = creationOptions.nextCore++;
+            auto pinThread = creationOptions.pinThreads;
+            auto *thread = new std::thread([workerFn, workerParam, core, pinThread]() {
+                if (pinThread) {
+                    pinCurrentThreadToCore(core);
+                }
+                workerFn(workerParam);
+            });
+            return reinterpret_cast<OrtCustomThreadHandle>(thread);
+        }
+
+        void joinThread(OrtCustomThreadHandle handle) {
+            auto *thread = reinterpret_cast<std::thread *>(const_cast<OrtCustomHandleType *>(handle));
+            thread->join();
+            delete thread;
+        }
+    }  // namespace
+
+    bool useGlobalThreadPool(size_t firstCore, bool pinThreads) {
+        std::lock_guard<std::mutex> lock(envMutex);
+        if (env) {
+            return false;
+        }
+        // ORT counts the calling thread as one of the intra-op threads, and creates the others.
+        size_t hardwareThreads = std::max(std::thread::hardware_concurrency(), 1u);
+        auto numThreads = static_cast<int>(hardwareThreads > firstCore ? hardwareThreads - firstCore + 1 : 1);
+        threadCreationOptions.nextCore = firstCore;
+        threadCreationOptions.pinThreads = pinThreads;
+
+        Ort::ThreadingOptions threadingOptions;
+        threadingOptions.SetGlobalIntraOpNumThreads(numThreads);
+        threadingOptions.SetGlobalSpinControl(0);
+        threadingOptions.SetGlobalCustomCreateThreadFn(createThread);
+        threadingOptions.SetGlobalCustomThreadCreationOptions(&threadCreationOptions);
+        threadingOptions.SetGlobalCustomJoinThreadFn(joinThread);
+        env = std::make_shared<Ort::Env>(threadingOptions, ORT_LOGGING_LEVEL_ERROR, "DiffSinger");
+        isGlobalThreadPool = true;
+        return true;
+    }
+
+    bool hasGlobalThreadPool() {
+        std::lock_guard<std::mutex> lock(envMutex);
+        return isGlobalThreadPool;
+    }
+
+    std::shared_ptr<Ort::Env> sharedOrtEnv() {
+        std::lock_guard<std::mutex> lock(envMutex);
+        if (!env) {
+            env = std::make_shared<Ort::Env>(ORT_LOGGING_LEVEL_ERROR, "DiffSinger");
+        }
+        return env;
+    }
+
+}  // namespace diffsinger
@@ -0,0 +1,30 @@
+#ifndef DS_ONNX_INFER_SHAREDENV_H
+#define DS_ONNX_INFER_SHAREDENV_H
+
+#include <memory>
+
+#include <onnxruntime_cxx_api.h>
+
+namespace diffsinger {
+
+    /**
+     * @brief Makes all sessions created afterwards run on one ORT thread pool, instead of a pool per session.
+     *
+     * The cores before `firstCore` are left to the application: the pool gets one thread for each core from
+     * `firstCore` on (none if there are no such cores), and the threads calling Run() work alongside them on their
+     * own cores. The threads are created through ORT's custom thread hooks, pinned to their cores with
+     * `pinThreads`, and do not spin while waiting for work. Must be called before the first session is created;
+     * later calls return false.
+     */
+    bool useGlobalThreadPool(size_t firstCore, bool pinThreads);
+
+    bool hasGlobalThreadPool();
+
+    /**
+     * @brief The ORT environment shared by all sessions, created on first use.
+     */
+    std::shared_ptr<Ort::Env> sharedOrtEnv();
+
+}  // namespace diffsinger
+
+#endif //DS_ONNX_INFER_SHAREDENV_H
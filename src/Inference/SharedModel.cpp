@@ -0,0 +1,60 @@
+#include <filesystem>
+#include <mutex>
+#include <unordered_map>
+
+#include "HashUtil.hpp"
+#include "SharedModel.h"
+
+namespace diffsinger {
+
+    SharedModel::SharedModel(const TString &modelPath, MappedBuffer buffer)
+            : m_modelPath(modelPath), m_buffer(std::move(buffer)), m_prepackedWeights(), m_contentHash(0) {}
+
+    std::shared_ptr<SharedModel> SharedModel::acquire(const TString &modelPath, const MappedBuffer &modelData) {
+        static std::mutex registryMutex;
+        static std::unordered_map<TString, std::weak_ptr<SharedModel>> registry;
+
+        auto key = std::filesystem::path(modelPath).lexically_normal().native();
+
+        std::lock_guard<std::mutex> lock(registryMutex);
+        auto it = registry.find(key);
+        if (it != registry.end()) {
+            if (auto model = it->second.lock()) {
+                return model;
+            }
+        }
+
+        MappedBuffer buffer = modelData;
+        if (buffer.empty()) {
+            auto file = MappedFile::open(modelPath);
+            if (!file) {
+                return nullptr;
+            }
+            buffer = file->buffer();
+        }
+
+        auto model = std::make_shared<SharedModel>(modelPath, std::move(buffer));
+        registry[key] = model;
+        return model;
+    }
+
+    const TString &SharedModel::getModelPath() const {
+        return m_modelPath;
+    }
+
+    const MappedBuffer &SharedModel::getBuffer() const {
+        return m_buffer;
+    }
+
+    Ort::PrepackedWeightsContainer &SharedModel::getPrepackedWeights() {
+        return m_prepackedWeights;
+    }
+
+    uint64_t SharedModel::getContentHash() {
+        std::call_once(m_contentHashFlag, [this]() {
+            m_contentHash = Hasher().update(m_buffer.data, m_buffer.size).digest();
+        });
+        return m_contentHash;
+    }
+
+}  // namespace diffsinger
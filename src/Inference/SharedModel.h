@@ -0,0 +1,58 @@
+#ifndef DS_ONNX_INFER_SHAREDMODEL_H
+#define DS_ONNX_INFER_SHAREDMODEL_H
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+
+#include <onnxruntime_cxx_api.h>
+
+#include "TString.h"
+#include "MappedFile.h"
+
+namespace diffsinger {
+
+    /**
+     * @brief Model bytes and prepacked weights shared by all sessions of the same model.
+     *
+     * Sessions are created from the memory-mapped model bytes, so the file is not read again for
+     * every session, and the prepacked weights container lets ORT prepack each weight only once
+     * no matter how many sessions of the model exist.
+     */
+    class SharedModel {
+    public:
+        /**
+         * @brief Gets the shared model identified by `modelPath`, creating it on first use.
+         *
+         * @param modelPath  Path to the model. It also identifies the model when `modelData` is given.
+         * @param modelData  Optional in-memory model bytes. If empty, the file at `modelPath` is memory-mapped.
+         * @return           The shared model, or nullptr if the model file could not be mapped.
+         *
+         * The model is kept alive as long as any session (or other holder) still references it.
+         */
+        static std::shared_ptr<SharedModel> acquire(const TString &modelPath, const MappedBuffer &modelData = {});
+
+        const TString &getModelPath() const;
+
+        const MappedBuffer &getBuffer() const;
+
+        Ort::PrepackedWeightsContainer &getPrepackedWeights();
+
+        /**
+         * @brief Hash of the model bytes. Computed on first call only.
+         */
+        uint64_t getContentHash();
+
+        SharedModel(const TString &modelPath, MappedBuffer buffer);
+
+    private:
+        TString m_modelPath;
+        MappedBuffer m_buffer;
+        Ort::PrepackedWeightsContainer m_prepackedWeights;
+        std::once_flag m_contentHashFlag;
+        uint64_t m_contentHash;
+    };  // class SharedModel
+
+}  // namespace diffsinger
+
+#endif //DS_ONNX_INFER_SHAREDMODEL_H
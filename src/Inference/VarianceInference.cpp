@@ -1,4 +1,177 @@
 #include "VarianceInference.h"
+#include "InferenceUtils.hpp"
 
 namespace diffsinger {
-} // namespace diffsinger
\ No newline at end of file
+
+    VarianceInference::VarianceInference(const TString &modelPath)
+            : Inference(modelPath),
+              m_bindingPlan(),
+              m_inputSlots(),
+              m_energyOutput(-1),
+              m_breathinessOutput(-1),
+              m_canBatch(false) {}
+
+    bool VarianceInference::postInitCheck() {
+        bool isValidModel = true;
+        isValidModel &= m_signature.hasInput("encoder_out");
+        isValidModel &= m_signature.hasInput("ph_dur");
+        isValidModel &= m_signature.hasInput("pitch");
+        isValidModel &= (m_signature.hasOutput("energy_pred") || m_signature.hasOutput("breathiness_pred"));
+
+        if (!isValidModel) {
+            std::cout << "Invalid variance model! "
+                         "Must have inputs: encoder_out, ph_dur, pitch; "
+                         "outputs: energy_pred and/or breathiness_pred\n";
+            endSession();
+            return false;
+        }
+
+        m_bindingPlan.clear();
+        m_inputSlots.encoderOut = m_bindingPlan.addInput(m_signature, "encoder_out");
+        m_inputSlots.phDur = m_bindingPlan.addInput(m_signature, "ph_dur");
+        m_inputSlots.pitch = m_bindingPlan.addInput(m_signature, "pitch");
+        m_inputSlots.energy = m_bindingPlan.addInput(m_signature, "energy");
+        m_inputSlots.breathiness = m_bindingPlan.addInput(m_signature, "breathiness");
+        m_inputSlots.retake = m_bindingPlan.addInput(m_signature, "retake");
+        m_inputSlots.speedup = m_bindingPlan.addInput(m_signature, "speedup");
+        m_inputSlots.steps = m_bindingPlan.addInput(m_signature, "steps");
+        m_inputSlots.spkEmbed = m_bindingPlan.addInput(m_signature, "spk_embed");
+
+        int outputIndex = 0;
+        if (m_signature.hasOutput("energy_pred")) {
+            m_bindingPlan.addOutput("energy_pred");
+            m_energyOutput = outputIndex++;
+        }
+        if (m_signature.hasOutput("breathiness_pred")) {
+            m_bindingPlan.addOutput("breathiness_pred");
+            m_breathinessOutput = outputIndex++;
+        }
+
+        m_canBatch = m_signature.findInput("encoder_out")->isDynamicAxis(0);
+        return true;
+    }
+
+    void VarianceInference::postCleanup() {
+        m_bindingPlan.clear();
+        m_inputSlots = InputSlots();
+        m_energyOutput = -1;
+        m_breathinessOutput = -1;
+        m_canBatch = false;
+    }
+
+    bool VarianceInference::predictsEnergy() const {
+        return m_energyOutput >= 0;
+    }
+
+    bool VarianceInference::predictsBreathiness() const {
+        return m_breathinessOutput >= 0;
+    }
+
+    bool VarianceInference::requiresSpeakerEmbed() const {
+        return m_inputSlots.spkEmbed != BindingPlan::npos;
+    }
+
+    VarianceOutput VarianceInference::infer(const VarianceInput &input,
+                                            const VarianceInferenceSettings &inferSettings) {
+        auto out = run({&input}, inferSettings);
+        return out.empty() ? VarianceOutput{} : std::move(out[0]);
+    }
+
+    std::vector<VarianceOutput> VarianceInference::inferBatch(const std::vector<const VarianceInput *> &inputs,
+                                                              const VarianceInferenceSettings &inferSettings) {
+        if (m_canBatch || inputs.size() <= 1) {
+            return run(inputs, inferSettings);
+        }
+
+        std::vector<VarianceOutput> out;
+        out.reserve(inputs.size());
+        for (const auto *input : inputs) {
+            out.push_back(infer(*input, inferSettings));
+        }
+        return out;
+    }
+
+    std::vector<VarianceOutput> VarianceInference::run(const std::vector<const VarianceInput *> &inputs,
+                                                       const VarianceInferenceSettings &inferSettings) {
+        if (!m_session || inputs.empty()) {
+            return {};
+        }
+
+        auto hiddenSize = static_cast<int64_t>(inputs[0]->encoded->hidden_size);
+        int64_t numVariances = (m_energyOutput >= 0 ? 1 : 0) + (m_breathinessOutput >= 0 ? 1 : 0);
+
+        std::vector<const std::vector<float> *> encoderOut;
+        std::vector<const std::vector<int64_t> *> phDur;
+        std::vector<const std::vector<float> *> pitch;
+        std::vector<const std::vector<float> *> spkEmbed;
+
+        // Initial variances are ignored since every frame is retaken.
+        std::vector<std::vector<float>> initialVariances;
+        std::vector<std::vector<char>> retake;
+        initialVariances.reserve(inputs.size());
+        retake.reserve(inputs.size());
+
+        for (const auto *input : inputs) {
+            encoderOut.push_back(&input->encoded->encoder_out);
+            phDur.push_back(&input->ph_dur);
+            pitch.push_back(&input->pitch);
+            spkEmbed.push_back(&input->spk_embed);
+            initialVariances.emplace_back(input->pitch.size(), 0.0f);
+            retake.emplace_back(input->pitch.size() * numVariances, 1);
+        }
+        std::vector<const std::vector<float> *> initialVariancesRows;
+        std::vector<const std::vector<char> *> retakeRows;
+        for (size_t i = 0; i < inputs.size(); ++i) {
+            initialVariancesRows.push_back(&initialVariances[i]);
+            retakeRows.push_back(&retake[i]);
+        }
+
+        auto inputTensors = m_bindingPlan.createInputs();
+        inputTensors[m_inputSlots.encoderOut] = stackVectorsToTensor<float, float>(encoderOut, hiddenSize, 0.0f);
+        inputTensors[m_inputSlots.phDur] = stackVectorsToTensor<int64_t, int64_t>(phDur, 0, 0);
+        inputTensors[m_inputSlots.pitch] = stackVectorsToTensor<float, float>(pitch, 0, 0.0f);
+        if (m_inputSlots.energy != BindingPlan::npos) {
+            inputTensors[m_inputSlots.energy] = stackVectorsToTensor<float, float>(initialVariancesRows, 0, 0.0f);
+        }
+        if (m_inputSlots.breathiness != BindingPlan::npos) {
+            inputTensors[m_inputSlots.breathiness] = stackVectorsToTensor<float, float>(initialVariancesRows, 0, 0.0f);
+        }
+        if (m_inputSlots.retake != BindingPlan::npos) {
+            inputTensors[m_inputSlots.retake] = stackVectorsToTensor<char, bool>(retakeRows, numVariances, false);
+        }
+        if (m_inputSlots.speedup != BindingPlan::npos) {
+            inputTensors[m_inputSlots.speedup] = scalarToTensor<int, int64_t>(inferSettings.speedup);
+        }
+        if (m_inputSlots.steps != BindingPlan::npos) {
+            inputTensors[m_inputSlots.steps] = scalarToTensor<int, int64_t>(inferSettings.steps);
+        }
+        if (m_inputSlots.spkEmbed != BindingPlan::npos) {
+            inputTensors[m_inputSlots.spkEmbed] = stackVectorsToTensor<float, float>(
+                    spkEmbed, spkEmbedLastDimension, 0.0f);
+        }
+
+        std::vector<VarianceOutput> out;
+        try {
+            auto outputTensors = m_bindingPlan.run(m_session, inputTensors);
+
+            out.reserve(inputs.size());
+            for (size_t i = 0; i < inputs.size(); ++i) {
+                auto numFrames = static_cast<int64_t>(inputs[i]->pitch.size());
+                VarianceOutput item;
+                if (m_energyOutput >= 0) {
+                    item.energy = tensorRowToVector<float>(outputTensors[m_energyOutput], i, numFrames);
+                }
+                if (m_breathinessOutput >= 0) {
+                    item.breathiness = tensorRowToVector<float>(outputTensors[m_breathinessOutput], i, numFrames);
+                }
+                out.push_back(std::move(item));
+            }
+        }
+        catch (const Ort::Exception &ortException) {
+            printOrtError(ortException);
+            out.clear();
+        }
+        return out;
+    }
+
+} // namespace diffsinger
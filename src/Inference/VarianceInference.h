@@ -1,12 +1,66 @@
 #ifndef DS_ONNX_INFER_VARIANCEINFERENCE_H
 #define DS_ONNX_INFER_VARIANCEINFERENCE_H
 
+#include <vector>
+
 #include "Inference.h"
+#include "ModelData.h"
 
 namespace diffsinger {
 
+    struct VarianceInferenceSettings {
+        int speedup = 10;  // Used by models with a `speedup` input (DDPM-based).
+        int steps = 10;    // Used by models with a `steps` input (rectified flow based).
+    };  // struct VarianceInferenceSettings
+
+
     class VarianceInference : public Inference {
+    public:
+        explicit VarianceInference(const TString &modelPath);
+
+        VarianceOutput infer(const VarianceInput &input, const VarianceInferenceSettings &inferSettings);
+
+        /**
+         * @brief Predicts the variances of several inputs. They are run as one batch if the model has
+         *        a dynamic batch axis, or one by one otherwise.
+         */
+        std::vector<VarianceOutput> inferBatch(const std::vector<const VarianceInput *> &inputs,
+                                               const VarianceInferenceSettings &inferSettings);
+
+        bool predictsEnergy() const;
+
+        bool predictsBreathiness() const;
+
+        bool requiresSpeakerEmbed() const;
+
+    protected:
+        bool postInitCheck() override;
+
+        void postCleanup() override;
+
+    private:
+        struct InputSlots {
+            int encoderOut = BindingPlan::npos;
+            int phDur = BindingPlan::npos;
+            int pitch = BindingPlan::npos;
+            int energy = BindingPlan::npos;
+            int breathiness = BindingPlan::npos;
+            int retake = BindingPlan::npos;
+            int speedup = BindingPlan::npos;
+            int steps = BindingPlan::npos;
+            int spkEmbed = BindingPlan::npos;
+        };
+
+        BindingPlan m_bindingPlan;
+        InputSlots m_inputSlots;
+
+        // Indices of the outputs in m_bindingPlan, -1 if the model does not predict it.
+        int m_energyOutput;
+        int m_breathinessOutput;
+        bool m_canBatch;
 
+        std::vector<VarianceOutput> run(const std::vector<const VarianceInput *> &inputs,
+                                        const VarianceInferenceSettings &inferSettings);
     };
 
 } // namespace diffsinger
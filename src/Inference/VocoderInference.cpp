@@ -1,27 +1,62 @@
+#include <algorithm>
+
 #include "VocoderInference.h"
 #include "InferenceUtils.hpp"
 
 namespace diffsinger {
 
-    VocoderInference::VocoderInference(const TString &modelPath) : Inference(modelPath) {}
+    namespace {
+        // Log mel of silence, used to pad the shorter segments of a batch.
+        constexpr float silentMelValue = -5.0f;
+    }
 
-    std::vector<float> VocoderInference::infer(Ort::Value &mel, const std::vector<double> &f0) {
-        std::vector<const char *> inputNames;
-        std::vector<Ort::Value> inputTensors;
+    VocoderInference::VocoderInference(const TString &modelPath, const MappedBuffer &modelData)
+            : Inference(modelPath, modelData), m_bindingPlan(), m_melSlot(BindingPlan::npos), m_f0Slot(BindingPlan::npos),
+              m_canBatch(false) {}
 
-        // f0
-        appendVectorToInputTensors<double, float>("f0", f0, inputNames, inputTensors);
+    bool VocoderInference::postInitCheck() {
+        bool isValidModel = true;
+        isValidModel &= m_signature.hasInput("mel");
+        isValidModel &= m_signature.hasInput("f0");
+        isValidModel &= m_signature.hasOutput("waveform");
+        if (!isValidModel) {
+            std::cout << "Invalid vocoder model! "
+                         "Must have inputs: mel, f0; "
+                         "outputs: waveform\n";
+            endSession();
+            return false;
+        }
 
-        // mel
-        inputNames.push_back("mel");
+        m_bindingPlan.clear();
+        m_f0Slot = m_bindingPlan.addInput(m_signature, "f0");
+        m_melSlot = m_bindingPlan.addInput(m_signature, "mel");
+        m_bindingPlan.addOutput("waveform");
+
+        m_canBatch = m_signature.findInput("mel")->isDynamicAxis(0)
+                     && m_signature.findInput("f0")->isDynamicAxis(0);
+        return true;
+    }
+
+    void VocoderInference::postCleanup() {
+        m_bindingPlan.clear();
+        m_melSlot = BindingPlan::npos;
+        m_f0Slot = BindingPlan::npos;
+        m_canBatch = false;
+    }
+
+    std::vector<float> VocoderInference::infer(Ort::Value &mel, const std::vector<double> &f0) {
+        if (!m_session) {
+            std::cout << "Session is not initialized!\n";
+            return {};
+        }
+
+        auto inputTensors = m_bindingPlan.createInputs();
+        inputTensors[m_f0Slot] = vectorToTensor<double, float>(f0);
 
         // TODO: Why not omit std::move? Why not omit const in function parameter of mel?
-        inputTensors.push_back(std::move(mel));
+        inputTensors[m_melSlot] = std::move(mel);
 
-        std::vector<const char*> outputNames = {"waveform"};
-        std::vector<Ort::Value> outputTensors = m_session.Run(
-                Ort::RunOptions{}, inputNames.data(), inputTensors.data(),
-                inputNames.size(), outputNames.data(), outputNames.size());
+        std::vector<Ort::Value> outputTensors = m_bindingPlan.run(m_session, inputTensors);
 
         Ort::Value& waveformOutput = outputTensors[0];
         auto waveformBuffer = waveformOutput.GetTensorData<float>();
@@ -30,4 +65,82 @@ namespace diffsinger {
         return waveform;
     }
 
+    std::vector<std::vector<float>> VocoderInference::inferBatch(std::vector<Ort::Value> &mels,
+                                                                 const std::vector<const std::vector<double> *> &f0s) {
+        std::vector<std::vector<float>> waveforms;
+        if (!m_session) {
+            std::cout << "Session is not initialized!\n";
+            return waveforms;
+        }
+        waveforms.reserve(mels.size());
+        if (!m_canBatch || mels.size() == 1) {
+            for (size_t i = 0; i < mels.size(); i++) {
+                waveforms.push_back(infer(mels[i], *f0s[i]));
+            }
+            return waveforms;
+        }
+
+        std::vector<int64_t> frames;
+        std::vector<std::vector<float>> melRows;
+        frames.reserve(mels.size());
+        melRows.reserve(mels.size());
+        int64_t numMelBins = 0;
+        for (const auto &mel : mels) {
+            // mel: [1, frames, mel_bins]
+            auto shape = mel.GetTensorTypeAndShapeInfo().GetShape();
+            frames.push_back(shape[1]);
+            numMelBins = shape[2];
+            melRows.push_back(tensorRowToVector<float>(mel, 0, shape[1]));
+        }
+        std::vector<const std::vector<float> *> melRowPtrs;
+        for (const auto &row : melRows) {
+            melRowPtrs.push_back(&row);
+        }
+
+        auto inputTensors = m_bindingPlan.createInputs();
+        inputTensors[m_melSlot] = stackVectorsToTensor<float, float>(melRowPtrs, numMelBins, silentMelValue);
+        inputTensors[m_f0Slot] = stackVectorsToTensor<double, float>(f0s, 0, 0.0f);
+        mels.clear();
+
+        auto outputTensors = m_bindingPlan.run(m_session, inputTensors);
+
+        // waveform: [batch, samples], where samples is a multiple of the padded frames.
+        const auto &waveformOutput = outputTensors[0];
+        auto waveformShape = waveformOutput.GetTensorTypeAndShapeInfo().GetShape();
+        auto maxFrames = *std::max_element(frames.begin(), frames.end());
+        auto samplesPerFrame = (maxFrames > 0) ? waveformShape[1] / maxFrames : 0;
+        for (size_t i = 0; i < frames.size(); i++) {
+            waveforms.push_back(tensorRowToVector<float>(waveformOutput, i, frames[i] * samplesPerFrame));
+        }
+        return waveforms;
+    }
+
+    bool VocoderInference::canBatch() const {
+        return m_canBatch;
+    }
+
+    bool VocoderInference::warmUp(int64_t frames) {
+        auto numMelBins = getNumMelBins();
+        std::vector<float> melData(frames * numMelBins, -5.0f);
+        auto mel = vectorToTensorWithShape<float, float>(melData, {1, frames, numMelBins});
+        std::vector<double> f0(frames, 440.0);
+        try {
+            return !infer(mel, f0).empty();
+        }
+        catch (const Ort::Exception &ortException) {
+            printOrtError(ortException);
+        }
+        return false;
+    }
+
+    int64_t VocoderInference::getNumMelBins() const {
+        // mel: [1, frames, mel_bins]. Fall back to the most common value if the axis is dynamic.
+        constexpr int64_t defaultNumMelBins = 128;
+        auto mel = m_signature.findInput("mel");
+        if (mel && mel->shape.size() == 3 && !mel->isDynamicAxis(2)) {
+            return mel->shape[2];
+        }
+        return defaultNumMelBins;
+    }
+
 }  // namespace diffsinger
@@ -11,9 +11,35 @@ namespace diffsinger {
 
     class VocoderInference : public Inference {
     public:
-        explicit VocoderInference(const TString &modelPath);
+        explicit VocoderInference(const TString &modelPath, const MappedBuffer &modelData = {});
 
         std::vector<float> infer(Ort::Value &mel, const std::vector<double> &f0);
+
+        /**
+         * @brief Runs the mels [1, frames, mel_bins] of several segments in one [batch, frames, mel_bins] call.
+         *
+         * Shorter segments are padded with silence, and each waveform is cut to the length of its own frames.
+         * Runs the segments one by one if the model has no dynamic batch axis. Throws Ort::Exception on failure.
+         */
+        std::vector<std::vector<float>> inferBatch(std::vector<Ort::Value> &mels,
+                                                   const std::vector<const std::vector<double> *> &f0s);
+
+        bool canBatch() const;
+
+    protected:
+        bool postInitCheck() override;
+
+        void postCleanup() override;
+
+        bool warmUp(int64_t frames) override;
+
+    private:
+        BindingPlan m_bindingPlan;
+        int m_melSlot;
+        int m_f0Slot;
+        bool m_canBatch;
+
+        int64_t getNumMelBins() const;
     };  // class VocoderInference
 
 }  // namespace diffsinger
@@ -0,0 +1,123 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace diffsinger {
+
+#ifdef _WIN32
+    MappedFile::MappedFile() : m_data(nullptr), m_size(0), m_fileHandle(nullptr), m_mappingHandle(nullptr) {}
+
+    MappedFile::~MappedFile() {
+        if (m_data) {
+            ::UnmapViewOfFile(m_data);
+        }
+        if (m_mappingHandle) {
+            ::CloseHandle(m_mappingHandle);
+        }
+        if (m_fileHandle && m_fileHandle != INVALID_HANDLE_VALUE) {
+            ::CloseHandle(m_fileHandle);
+        }
+    }
+
+    std::shared_ptr<MappedFile> MappedFile::open(const TString &path) {
+        std::shared_ptr<MappedFile> mappedFile(new MappedFile());
+
+        mappedFile->m_fileHandle = ::CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                                                 OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (mappedFile->m_fileHandle == INVALID_HANDLE_VALUE) {
+            return nullptr;
+        }
+
+        LARGE_INTEGER fileSize;
+        if (!::GetFileSizeEx(mappedFile->m_fileHandle, &fileSize)) {
+            return nullptr;
+        }
+        mappedFile->m_size = static_cast<size_t>(fileSize.QuadPart);
+        if (mappedFile->m_size == 0) {
+            // Empty files cannot be mapped, but they are still valid (empty) files.
+            return mappedFile;
+        }
+
+        mappedFile->m_mappingHandle = ::CreateFileMappingW(mappedFile->m_fileHandle, nullptr, PAGE_READONLY,
+                                                           0, 0, nullptr);
+        if (!mappedFile->m_mappingHandle) {
+            return nullptr;
+        }
+
+        auto view = ::MapViewOfFile(mappedFile->m_mappingHandle, FILE_MAP_READ, 0, 0, 0);
+        if (!view) {
+            return nullptr;
+        }
+        mappedFile->m_data = static_cast<const char *>(view);
+        return mappedFile;
+    }
+#else
+    MappedFile::MappedFile() : m_data(nullptr), m_size(0), m_fd(-1) {}
+
+    MappedFile::~MappedFile() {
+        if (m_data) {
+            ::munmap(const_cast<char *>(m_data), m_size);
+        }
+        if (m_fd >= 0) {
+            ::close(m_fd);
+        }
+    }
+
+    std::shared_ptr<MappedFile> MappedFile::open(const TString &path) {
+        std::shared_ptr<MappedFile> mappedFile(new MappedFile());
+
+        mappedFile->m_fd = ::open(path.c_str(), O_RDONLY);
+        if (mappedFile->m_fd < 0) {
+            return nullptr;
+        }
+
+        struct stat fileStat{};
+        if (::fstat(mappedFile->m_fd, &fileStat) != 0) {
+            return nullptr;
+        }
+        mappedFile->m_size = static_cast<size_t>(fileStat.st_size);
+        if (mappedFile->m_size == 0) {
+            // Empty files cannot be mapped, but they are still valid (empty) files.
+            return mappedFile;
+        }
+
+        auto view = ::mmap(nullptr, mappedFile->m_size, PROT_READ, MAP_PRIVATE, mappedFile->m_fd, 0);
+        if (view == MAP_FAILED) {
+            return nullptr;
+        }
+        mappedFile->m_data = static_cast<const char *>(view);
+        return mappedFile;
+    }
+#endif
+
+    const char *MappedFile::data() const {
+        return m_data;
+    }
+
+    size_t MappedFile::size() const {
+        return m_size;
+    }
+
+    MappedBuffer MappedFile::slice(size_t offset, size_t size) const {
+        if (offset > m_size || size > m_size - offset) {
+            return {};
+        }
+        MappedBuffer buffer;
+        buffer.holder = shared_from_this();
+        buffer.data = m_data + offset;
+        buffer.size = size;
+        return buffer;
+    }
+
+    MappedBuffer MappedFile::buffer() const {
+        return slice(0, m_size);
+    }
+
+}  // namespace diffsinger
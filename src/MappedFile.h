@@ -0,0 +1,70 @@
+#ifndef DS_ONNX_INFER_MAPPEDFILE_H
+#define DS_ONNX_INFER_MAPPEDFILE_H
+
+#include <cstddef>
+#include <memory>
+
+#include "TString.h"
+
+namespace diffsinger {
+
+    /**
+     * @brief A read-only view of bytes whose lifetime is tied to `holder`.
+     *
+     * The view stays valid for as long as any copy of the buffer is alive, so it can be handed
+     * to long-lived objects (e.g. inference sessions) without copying the underlying bytes.
+     */
+    struct MappedBuffer {
+        std::shared_ptr<const void> holder;
+        const char *data = nullptr;
+        size_t size = 0;
+
+        bool empty() const {
+            return size == 0;
+        }
+    };
+
+    class MappedFile : public std::enable_shared_from_this<MappedFile> {
+    public:
+        ~MappedFile();
+
+        MappedFile(const MappedFile &) = delete;
+        MappedFile &operator=(const MappedFile &) = delete;
+
+        /**
+         * @brief Maps a whole file into memory (read only).
+         *
+         * @param path  The file to map.
+         * @return      The mapped file, or nullptr if the file could not be opened or mapped.
+         */
+        static std::shared_ptr<MappedFile> open(const TString &path);
+
+        const char *data() const;
+
+        size_t size() const;
+
+        /**
+         * @brief Returns a view of [offset, offset + size) which keeps this mapping alive.
+         *
+         * An empty buffer is returned if the range is out of bounds.
+         */
+        MappedBuffer slice(size_t offset, size_t size) const;
+
+        MappedBuffer buffer() const;
+
+    private:
+        MappedFile();
+
+        const char *m_data;
+        size_t m_size;
+#ifdef _WIN32
+        void *m_fileHandle;
+        void *m_mappingHandle;
+#else
+        int m_fd;
+#endif
+    };  // class MappedFile
+
+}  // namespace diffsinger
+
+#endif //DS_ONNX_INFER_MAPPEDFILE_H
@@ -0,0 +1,41 @@
+#include <algorithm>
+#include <functional>
+
+#include "Mixer.h"
+
+namespace diffsinger {
+
+    void Mixer::add(const std::vector<float> &clip, int64_t offsetInSamples,
+                    int64_t fadeInSamples, int64_t fadeOutSamples) {
+        auto clipSize = static_cast<int64_t>(clip.size());
+        int64_t first = (offsetInSamples < 0) ? std::min(-offsetInSamples, clipSize) : 0;
+        if (first >= clipSize) {
+            return;
+        }
+        auto end = static_cast<size_t>(offsetInSamples + clipSize);
+        if (m_samples.size() < end) {
+            m_samples.resize(end, 0.0f);
+        }
+
+        if (fadeInSamples <= 0 && fadeOutSamples <= 0) {
+            std::transform(clip.begin() + first, clip.end(), m_samples.begin() + (offsetInSamples + first),
+                           m_samples.begin() + (offsetInSamples + first), std::plus<>());
+            return;
+        }
+        for (auto i = first; i < clipSize; ++i) {
+            float gain = 1.0f;
+            if (i < fadeInSamples) {
+                gain = (static_cast<float>(i) + 0.5f) / static_cast<float>(fadeInSamples);
+            }
+            if (clipSize - i <= fadeOutSamples) {
+                gain *= (static_cast<float>(clipSize - i) - 0.5f) / static_cast<float>(fadeOutSamples);
+            }
+            m_samples[offsetInSamples + i] += gain * clip[i];
+        }
+    }
+
+    const std::vector<float> &Mixer::samples() const {
+        return m_samples;
+    }
+
+}  // namespace diffsinger
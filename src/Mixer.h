@@ -0,0 +1,32 @@
+#ifndef DS_ONNX_INFER_MIXER_H
+#define DS_ONNX_INFER_MIXER_H
+
+#include <cstdint>
+#include <vector>
+
+namespace diffsinger {
+
+    /**
+     * @brief Sums rendered clips into one output buffer at their offsets.
+     */
+    class Mixer {
+    public:
+        /**
+         * @brief Adds `clip` to the output starting at `offsetInSamples`, growing the output as needed.
+         *        Samples before the start of the output are dropped.
+         *
+         * The first `fadeInSamples` and the last `fadeOutSamples` samples of the clip are faded linearly,
+         * so that overlapping clips with matching fades crossfade with constant gain.
+         */
+        void add(const std::vector<float> &clip, int64_t offsetInSamples,
+                 int64_t fadeInSamples = 0, int64_t fadeOutSamples = 0);
+
+        const std::vector<float> &samples() const;
+
+    private:
+        std::vector<float> m_samples;
+    };  // class Mixer
+
+}  // namespace diffsinger
+
+#endif //DS_ONNX_INFER_MIXER_H
@@ -2,6 +2,7 @@
 #define DS_ONNX_INFER_MODELDATA_H
 
 #include <cstdint>
+#include <memory>
 #include <vector>
 
 namespace diffsinger {
@@ -18,10 +19,22 @@ namespace diffsinger {
         std::vector<double> breathiness;
     };
 
+    struct AcousticEncodedData {
+        // Encoder output of a split acoustic model, [frames, hidden_size]
+        std::vector<float> condition;
+
+        // Auxiliary mel [frames, mel_bins] of shallow diffusion models, empty otherwise
+        std::vector<float> aux_mel;
+
+        int64_t frames = 0;
+        int64_t hidden_size = 0;
+    };
+
     struct LinguisticInput {
         std::vector<int64_t> tokens;
         std::vector<int64_t> word_div;
         std::vector<int64_t> word_dur;
+        std::vector<int64_t> ph_dur;
     };
 
     struct LinguisticEncodedData {
@@ -36,6 +49,36 @@ namespace diffsinger {
             return encoder_out.empty() && x_masks.empty();
         }
     };
+
+    struct VarianceInput {
+        // Shared with the other models that take the same linguistic encoding.
+        std::shared_ptr<const LinguisticEncodedData> encoded;
+        std::vector<int64_t> ph_dur;
+
+        // MIDI pitch of each frame
+        std::vector<float> pitch;
+        std::vector<float> spk_embed;
+    };
+
+    struct PitchInput {
+        // Shared with the other models that take the same linguistic encoding.
+        std::shared_ptr<const LinguisticEncodedData> encoded;
+        std::vector<int64_t> ph_dur;
+        std::vector<float> note_midi;
+
+        // note_rest should be bool vector, see x_masks above
+        std::vector<char> note_rest;
+        std::vector<int64_t> note_dur;
+
+        // Initial MIDI pitch of each frame, following the notes
+        std::vector<float> pitch;
+        std::vector<float> spk_embed;
+    };
+
+    struct VarianceOutput {
+        std::vector<float> energy;
+        std::vector<float> breathiness;
+    };
 }
 
 #endif //DS_ONNX_INFER_MODELDATA_H
@@ -0,0 +1,183 @@
+#include <cstring>
+#include <fstream>
+#include <unordered_set>
+
+#include "PhonemeTable.h"
+
+namespace diffsinger {
+
+    namespace {
+        constexpr size_t HEADER_SIZE = 2 * sizeof(uint32_t);
+    }
+
+    PhonemeTable::PhonemeTable()
+            : m_buckets(nullptr), m_pool(nullptr), m_poolSize(0), m_bucketCount(0), m_entryCount(0) {}
+
+    PhonemeTable PhonemeTable::fromFile(const std::filesystem::path &path, bool *ok) {
+        std::ifstream phonemesFile(path);
+        if (!phonemesFile.is_open()) {
+            if (ok) {
+                *ok = false;
+            }
+            return {};
+        }
+
+        std::vector<std::string> names;
+        std::string line;
+        while (std::getline(phonemesFile, line)) {
+            // handle CRLF line endings on Linux and macOS
+            if (!line.empty() && line[line.size() - 1] == '\r')
+                line.erase(line.size() - 1);
+
+            names.push_back(std::move(line));
+        }
+
+        if (ok) {
+            *ok = true;
+        }
+        return fromNames(names);
+    }
+
+    PhonemeTable PhonemeTable::fromNames(const std::vector<std::string> &names) {
+        // Load factor <= 0.5 keeps linear probing sequences short.
+        uint32_t bucketCount = 1;
+        while (bucketCount < names.size() * 2) {
+            bucketCount <<= 1;
+        }
+
+        size_t poolSize = 0;
+        for (const auto &name : names) {
+            poolSize += name.size();
+        }
+
+        auto storage = std::make_shared<std::vector<char>>(HEADER_SIZE + bucketCount * sizeof(Bucket) + poolSize);
+        auto header = reinterpret_cast<uint32_t *>(storage->data());
+        auto buckets = reinterpret_cast<Bucket *>(storage->data() + HEADER_SIZE);
+        auto pool = storage->data() + HEADER_SIZE + bucketCount * sizeof(Bucket);
+
+        for (uint32_t i = 0; i < bucketCount; ++i) {
+            buckets[i] = {0, EMPTY_BUCKET, 0, 0};
+        }
+
+        std::unordered_set<std::string_view> seen;
+        uint32_t entryCount = 0;
+        uint32_t poolOffset = 0;
+        for (size_t token = 0; token < names.size(); ++token) {
+            const auto &name = names[token];
+            if (!seen.emplace(name).second) {
+                continue;
+            }
+            auto hash = hashName(name);
+            auto index = hash & (bucketCount - 1);
+            while (buckets[index].nameOffset != EMPTY_BUCKET) {
+                index = (index + 1) & (bucketCount - 1);
+            }
+            buckets[index] = {hash, poolOffset, static_cast<uint32_t>(name.size()), static_cast<int32_t>(token)};
+            std::memcpy(pool + poolOffset, name.data(), name.size());
+            poolOffset += static_cast<uint32_t>(name.size());
+            ++entryCount;
+        }
+        header[0] = bucketCount;
+        header[1] = entryCount;
+
+        MappedBuffer buffer;
+        buffer.data = storage->data();
+        buffer.size = HEADER_SIZE + bucketCount * sizeof(Bucket) + poolOffset;
+        buffer.holder = std::move(storage);
+
+        PhonemeTable table;
+        table.attach(buffer);
+        return table;
+    }
+
+    PhonemeTable PhonemeTable::fromBuffer(const MappedBuffer &buffer, bool *ok) {
+        PhonemeTable table;
+        bool isValid = table.attach(buffer);
+        if (ok) {
+            *ok = isValid;
+        }
+        return isValid ? table : PhonemeTable();
+    }
+
+    bool PhonemeTable::attach(const MappedBuffer &buffer) {
+        if (buffer.size < HEADER_SIZE) {
+            return false;
+        }
+        uint32_t header[2];
+        std::memcpy(header, buffer.data, sizeof(header));
+        auto bucketCount = header[0];
+        auto entryCount = header[1];
+        if (bucketCount == 0 || (bucketCount & (bucketCount - 1)) != 0 || entryCount > bucketCount) {
+            return false;
+        }
+        auto bucketsSize = static_cast<size_t>(bucketCount) * sizeof(Bucket);
+        if (buffer.size - HEADER_SIZE < bucketsSize) {
+            return false;
+        }
+
+        auto buckets = reinterpret_cast<const Bucket *>(buffer.data + HEADER_SIZE);
+        auto poolSize = buffer.size - HEADER_SIZE - bucketsSize;
+        for (uint32_t i = 0; i < bucketCount; ++i) {
+            const auto &bucket = buckets[i];
+            if (bucket.nameOffset != EMPTY_BUCKET
+                && (bucket.nameOffset > poolSize || bucket.nameLength > poolSize - bucket.nameOffset)) {
+                return false;
+            }
+        }
+
+        m_buffer = buffer;
+        m_buckets = buckets;
+        m_pool = buffer.data + HEADER_SIZE + bucketsSize;
+        m_poolSize = poolSize;
+        m_bucketCount = bucketCount;
+        m_entryCount = entryCount;
+        return true;
+    }
+
+    int64_t PhonemeTable::find(std::string_view name) const {
+        if (m_bucketCount == 0) {
+            return -1;
+        }
+        auto hash = hashName(name);
+        auto index = hash & (m_bucketCount - 1);
+        for (uint32_t probes = 0; probes < m_bucketCount; ++probes) {
+            const auto &bucket = m_buckets[index];
+            if (bucket.nameOffset == EMPTY_BUCKET) {
+                break;
+            }
+            if (bucket.hash == hash
+                && std::string_view(m_pool + bucket.nameOffset, bucket.nameLength) == name) {
+                return bucket.token;
+            }
+            index = (index + 1) & (m_bucketCount - 1);
+        }
+        return -1;
+    }
+
+    bool PhonemeTable::contains(std::string_view name) const {
+        return find(name) >= 0;
+    }
+
+    size_t PhonemeTable::size() const {
+        return m_entryCount;
+    }
+
+    bool PhonemeTable::empty() const {
+        return m_entryCount == 0;
+    }
+
+    const MappedBuffer &PhonemeTable::buffer() const {
+        return m_buffer;
+    }
+
+    uint32_t PhonemeTable::hashName(std::string_view name) {
+        // 32-bit FNV-1a. This is part of the serialized format and must not change.
+        uint32_t hash = 2166136261u;
+        for (unsigned char c : name) {
+            hash ^= c;
+            hash *= 16777619u;
+        }
+        return hash;
+    }
+
+}  // namespace diffsinger
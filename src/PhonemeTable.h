@@ -0,0 +1,89 @@
+#ifndef DS_ONNX_INFER_PHONEMETABLE_H
+#define DS_ONNX_INFER_PHONEMETABLE_H
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "MappedFile.h"
+
+namespace diffsinger {
+
+    /**
+     * @brief Phoneme name to token lookup table.
+     *
+     * The table is always stored in its serialized form (an open-addressing hash table followed
+     * by a string pool), so a table loaded from `phonemes.txt` and a table memory-mapped from a
+     * voicebank bundle share the same lookup code, and the latter needs no parsing at all.
+     *
+     * Serialized layout (little endian):
+     *   uint32 bucketCount (power of two), uint32 entryCount,
+     *   Bucket[bucketCount] { uint32 hash, uint32 nameOffset, uint32 nameLength, int32 token },
+     *   char namePool[]
+     * Empty buckets have nameOffset == 0xFFFFFFFF.
+     */
+    class PhonemeTable {
+    public:
+        PhonemeTable();
+
+        /**
+         * @brief Loads a phoneme list file. Token of each phoneme is its line number (0-based).
+         */
+        static PhonemeTable fromFile(const std::filesystem::path &path, bool *ok = nullptr);
+
+        /**
+         * @brief Builds a table where token of each phoneme is its index in `names`.
+         *        If a name occurs more than once, the first occurrence wins.
+         */
+        static PhonemeTable fromNames(const std::vector<std::string> &names);
+
+        /**
+         * @brief Uses an already serialized table without copying it.
+         */
+        static PhonemeTable fromBuffer(const MappedBuffer &buffer, bool *ok = nullptr);
+
+        /**
+         * @brief Looks up the token of a phoneme.
+         *
+         * @return The token, or -1 if the phoneme does not exist in the table.
+         */
+        int64_t find(std::string_view name) const;
+
+        bool contains(std::string_view name) const;
+
+        size_t size() const;
+
+        bool empty() const;
+
+        /**
+         * @brief Returns the serialized table, which can be written to a voicebank bundle as is.
+         */
+        const MappedBuffer &buffer() const;
+
+    private:
+        struct Bucket {
+            uint32_t hash;
+            uint32_t nameOffset;
+            uint32_t nameLength;
+            int32_t token;
+        };
+
+        static constexpr uint32_t EMPTY_BUCKET = 0xFFFFFFFFu;
+
+        static uint32_t hashName(std::string_view name);
+
+        bool attach(const MappedBuffer &buffer);
+
+        MappedBuffer m_buffer;
+        const Bucket *m_buckets;
+        const char *m_pool;
+        size_t m_poolSize;
+        uint32_t m_bucketCount;
+        uint32_t m_entryCount;
+    };  // class PhonemeTable
+
+}  // namespace diffsinger
+
+#endif //DS_ONNX_INFER_PHONEMETABLE_H
@@ -0,0 +1,59 @@
+#include <fstream>
+
+#include "BinaryFile.hpp"
+#include "FileUtil.h"
+#include "HashUtil.hpp"
+#include "PredictionCache.h"
+
+namespace diffsinger {
+
+    namespace {
+        // File layout: magic, uint64 key, uint64 count, float[count]
+        constexpr BinaryFileMagic ENTRY_MAGIC = {'D', 'S', 'P', 'R', 'E', 'D', '0', '1'};
+    }
+
+    PredictionCache::PredictionCache(std::filesystem::path directory)
+            : m_directory(std::move(directory)) {}
+
+    std::filesystem::path PredictionCache::getEntryPath(uint64_t key) const {
+        return m_directory / (toHexString(key) + ".bin");
+    }
+
+    bool PredictionCache::find(uint64_t key, std::vector<float> &values) {
+        auto it = m_entries.find(key);
+        if (it != m_entries.end()) {
+            values = it->second;
+            return true;
+        }
+        if (m_directory.empty()) {
+            return false;
+        }
+
+        std::ifstream file(getEntryPath(key), std::ios::binary);
+        if (!file.is_open()) {
+            return false;
+        }
+        std::vector<float> entry;
+        if (!readBinaryFileHeader(file, ENTRY_MAGIC, key) || !readArray(file, entry, true)) {
+            return false;
+        }
+        values = entry;
+        m_entries.emplace(key, std::move(entry));
+        return true;
+    }
+
+    void PredictionCache::insert(uint64_t key, const std::vector<float> &values) {
+        m_entries[key] = values;
+        if (m_directory.empty()) {
+            return;
+        }
+
+        // Failing to store the entry only means it is predicted again next time.
+        writeFileAtomically(getEntryPath(key), [key, &values](std::ostream &file) {
+            writeBinaryFileHeader(file, ENTRY_MAGIC, key);
+            writeArray(file, values);
+            return true;
+        }, true);
+    }
+
+}  // namespace diffsinger
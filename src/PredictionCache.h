@@ -0,0 +1,40 @@
+#ifndef DS_ONNX_INFER_PREDICTIONCACHE_H
+#define DS_ONNX_INFER_PREDICTIONCACHE_H
+
+#include <cstdint>
+#include <filesystem>
+#include <unordered_map>
+#include <vector>
+
+namespace diffsinger {
+
+    /**
+     * @brief Memoizes predicted curves by the hash of the model and its inputs.
+     *
+     * Entries are kept in memory, and also stored as one file per entry in the cache directory (if set),
+     * so that they are reused by later runs.
+     */
+    class PredictionCache {
+    public:
+        /**
+         * @param directory  Directory of the cache files. Empty to keep the entries in memory only.
+         */
+        explicit PredictionCache(std::filesystem::path directory = {});
+
+        /**
+         * @return true if the entry is found, in which case it is copied to `values`.
+         */
+        bool find(uint64_t key, std::vector<float> &values);
+
+        void insert(uint64_t key, const std::vector<float> &values);
+
+    private:
+        std::filesystem::path m_directory;
+        std::unordered_map<uint64_t, std::vector<float>> m_entries;
+
+        std::filesystem::path getEntryPath(uint64_t key) const;
+    };  // class PredictionCache
+
+}  // namespace diffsinger
+
+#endif //DS_ONNX_INFER_PREDICTIONCACHE_H
@@ -6,21 +6,27 @@
 #include "DsProject.h"
 #include "ArrayUtil.hpp"
 #include "SampleCurve.h"
+#include "PhonemeTable.h"
 #include "Preprocess.h"
 
 
 namespace diffsinger {
 
-    inline std::vector<int64_t> phonemesToTokens(const std::unordered_map<std::string, int64_t> &name2token,
+    inline std::vector<int64_t> phonemesToTokens(const PhonemeTable &name2token,
                                           const std::vector<std::string> &phonemes);
     inline std::vector<int64_t> phonemeDurationToFrames(const std::vector<double> &durations,
                                                  double frameLength);
+    inline std::vector<float> speakerEmbedFrames(const SpeakerMixCurve &spkMix,
+                                                 const std::vector<std::string> &speakers,
+                                                 const SpeakerEmbed &spkEmb,
+                                                 double frameLength,
+                                                 int64_t targetLength);
 
 
     /* IMPLEMENTATION BELOW */
 
     PreprocessedData acousticPreprocess(
-            const std::unordered_map<std::string, int64_t> &name2token,
+            const PhonemeTable &name2token,
             const DsSegment &dsSegment,
             const DsConfig &dsConfig,
             double frameLength) {
@@ -48,61 +54,241 @@ namespace diffsinger {
 
         // DONE: static spk_mix
         // TODO: curve spk_mix
-        if (!dsConfig.speakers.empty()) {
-            // Required to choose a speaker.
-            int64_t spkEmbedArraySize = targetLength * SPK_EMBED_SIZE;
-            pd.spk_embed.resize(spkEmbedArraySize);
-            if (dsSegment.spk_mix.empty()) {
-                // Use the first one by default.
-                auto emb = dsConfig.spkEmb.getMixedEmb({{dsConfig.speakers[0], 1.0}});
-                for (size_t i = 0; i < spkEmbedArraySize; ++i) {
-                    pd.spk_embed[i] = emb[i % SPK_EMBED_SIZE];
-                }
-            } else {
-                auto spkMixResampled = dsSegment.spk_mix.resample(frameLength, targetLength);
-                for (int64_t i = 0; i < targetLength; ++i) {
-                    std::unordered_map<std::string, double> mix;
-                    int64_t speakerIndex = 0;
-                    for (const auto &speakerItem : spkMixResampled.spk) {
-                        // If SampleCurve::resample guarantees the size of returned array is at least `targetLength`,
-                        // subscripting will not go out of range here.
-                        mix[speakerItem.first] = speakerItem.second.samples[i];
-                        ++speakerIndex;
-                    }
-                    auto emb = dsConfig.spkEmb.getMixedEmb(mix);
-                    int64_t y = i * SPK_EMBED_SIZE;
-                    for (int64_t j = 0; j < SPK_EMBED_SIZE; ++j) {
-                        pd.spk_embed[y + j] = emb[j];
-                    }
-                }
+        pd.spk_embed = speakerEmbedFrames(dsSegment.spk_mix, dsConfig.speakers, dsConfig.spkEmb, frameLength, targetLength);
+
+        return pd;
+    }
+
+    int64_t padToFrameBucket(PreprocessedData &pd, const std::vector<int64_t> &frameBuckets, int64_t padToken) {
+        int64_t targetLength = std::accumulate(pd.durations.begin(), pd.durations.end(), static_cast<int64_t>(0));
+
+        int64_t bucket = -1;
+        for (auto frames : frameBuckets) {
+            if (frames >= targetLength && (bucket < 0 || frames < bucket)) {
+                bucket = frames;
             }
         }
+        if (bucket <= targetLength) {
+            return targetLength;
+        }
 
-        return pd;
+        auto padFrames = bucket - targetLength;
+        pd.tokens.push_back(padToken);
+        pd.durations.push_back(padFrames);
+
+        auto padCurve = [bucket](auto &curve) {
+            if (!curve.empty()) {
+                curve.resize(bucket, curve.back());
+            }
+        };
+        padCurve(pd.f0);
+        padCurve(pd.velocity);
+        padCurve(pd.gender);
+        padCurve(pd.energy);
+        padCurve(pd.breathiness);
+
+        if (!pd.spk_embed.empty()) {
+            pd.spk_embed.reserve(bucket * SPK_EMBED_SIZE);
+            auto lastFrame = pd.spk_embed.end() - SPK_EMBED_SIZE;
+            std::vector<float> lastEmb(lastFrame, pd.spk_embed.end());
+            for (int64_t i = 0; i < padFrames; ++i) {
+                pd.spk_embed.insert(pd.spk_embed.end(), lastEmb.begin(), lastEmb.end());
+            }
+        }
+        return targetLength;
+    }
+
+    bool isSilentSegment(const DsSegment &dsSegment, const std::vector<std::string> &silencePhonemes) {
+        return std::all_of(dsSegment.ph_seq.begin(), dsSegment.ph_seq.end(), [&silencePhonemes](const auto &ph) {
+            return std::find(silencePhonemes.begin(), silencePhonemes.end(), ph) != silencePhonemes.end();
+        });
+    }
+
+    SilenceTrim trimSilentEdges(PreprocessedData &pd, const std::vector<int64_t> &silenceTokens, int64_t keepFrames) {
+        SilenceTrim trim;
+        if (pd.tokens.size() < 2 || pd.tokens.size() != pd.durations.size()) {
+            return trim;
+        }
+        auto isSilence = [&silenceTokens](int64_t token) {
+            return std::find(silenceTokens.begin(), silenceTokens.end(), token) != silenceTokens.end();
+        };
+        keepFrames = std::max(keepFrames, static_cast<int64_t>(1));
+
+        // Only the first and last phonemes are shortened, the voiced part in between is kept as is.
+        if (isSilence(pd.tokens.front()) && pd.durations.front() > keepFrames) {
+            trim.leadingFrames = pd.durations.front() - keepFrames;
+            pd.durations.front() = keepFrames;
+        }
+        if (isSilence(pd.tokens.back()) && pd.durations.back() > keepFrames) {
+            trim.trailingFrames = pd.durations.back() - keepFrames;
+            pd.durations.back() = keepFrames;
+        }
+        if (trim.leadingFrames == 0 && trim.trailingFrames == 0) {
+            return trim;
+        }
+
+        auto cutCurve = [&trim](auto &curve, int64_t frameSize) {
+            auto frames = static_cast<int64_t>(curve.size()) / frameSize;
+            if (frames < trim.leadingFrames + trim.trailingFrames) {
+                return;
+            }
+            curve.erase(curve.end() - trim.trailingFrames * frameSize, curve.end());
+            curve.erase(curve.begin(), curve.begin() + trim.leadingFrames * frameSize);
+        };
+        cutCurve(pd.f0, 1);
+        cutCurve(pd.velocity, 1);
+        cutCurve(pd.gender, 1);
+        cutCurve(pd.energy, 1);
+        cutCurve(pd.breathiness, 1);
+        cutCurve(pd.spk_embed, SPK_EMBED_SIZE);
+        return trim;
+    }
+
+    void replaceSpeakerMix(PreprocessedData &pd,
+                           const DsSegment &dsSegment,
+                           const SpeakerMixCurve &spkMix,
+                           const DsConfig &dsConfig,
+                           double frameLength,
+                           const SilenceTrim &trim) {
+        auto durations = phonemeDurationToFrames(dsSegment.ph_dur, frameLength);
+        int64_t targetLength = std::accumulate(durations.begin(), durations.end(), static_cast<int64_t>(0));
+        pd.spk_embed = speakerEmbedFrames(spkMix, dsConfig.speakers, dsConfig.spkEmb, frameLength, targetLength);
+        if (pd.spk_embed.empty()) {
+            return;
+        }
+
+        // Cut like trimSilentEdges, then pad to the frames of the other inputs like padToFrameBucket.
+        if (targetLength >= trim.leadingFrames + trim.trailingFrames) {
+            pd.spk_embed.erase(pd.spk_embed.end() - trim.trailingFrames * SPK_EMBED_SIZE, pd.spk_embed.end());
+            pd.spk_embed.erase(pd.spk_embed.begin(), pd.spk_embed.begin() + trim.leadingFrames * SPK_EMBED_SIZE);
+        }
+        auto frames = static_cast<int64_t>(pd.f0.size());
+        auto embedFrames = static_cast<int64_t>(pd.spk_embed.size() / SPK_EMBED_SIZE);
+        if (embedFrames > 0 && frames > embedFrames) {
+            std::vector<float> lastEmb(pd.spk_embed.end() - SPK_EMBED_SIZE, pd.spk_embed.end());
+            pd.spk_embed.reserve(frames * SPK_EMBED_SIZE);
+            for (auto i = embedFrames; i < frames; ++i) {
+                pd.spk_embed.insert(pd.spk_embed.end(), lastEmb.begin(), lastEmb.end());
+            }
+        }
     }
 
     LinguisticInput linguisticPreprocess(
-            const std::unordered_map<std::string, int64_t> &name2token,
+            const PhonemeTable &name2token,
             const DsSegment &dsSegment,
             double frameLength) {
         LinguisticInput li{};
         li.tokens = phonemesToTokens(name2token, dsSegment.ph_seq);
         li.word_div = std::vector<int64_t>(dsSegment.ph_num.begin(), dsSegment.ph_num.end());
         li.word_dur = phonemeDurationToFrames(dsSegment.note_dur, frameLength);
+        li.ph_dur = phonemeDurationToFrames(dsSegment.ph_dur, frameLength);
 
         return li;
     }
 
-    std::vector<int64_t> phonemesToTokens(const std::unordered_map<std::string, int64_t> &name2token,
+    VarianceInput variancePreprocess(
+            const DsSegment &dsSegment,
+            const DsVarianceConfig &dsVarianceConfig,
+            double frameLength) {
+        VarianceInput vi{};
+        vi.ph_dur = phonemeDurationToFrames(dsSegment.ph_dur, frameLength);
+
+        int64_t targetLength = std::accumulate(vi.ph_dur.begin(), vi.ph_dur.end(), static_cast<int64_t>(0));
+
+        // Hz -> MIDI pitch. Non-positive (unvoiced) frequencies are mapped to 0.
+        auto f0 = dsSegment.f0.resample(frameLength, targetLength);
+        vi.pitch.reserve(f0.size());
+        for (auto hz : f0) {
+            vi.pitch.push_back(hz > 0 ? static_cast<float>(12.0 * std::log2(hz / 440.0) + 69.0) : 0.0f);
+        }
+
+        vi.spk_embed = speakerEmbedFrames(dsSegment.spk_mix, dsVarianceConfig.speakers, dsVarianceConfig.spkEmb,
+                                          frameLength, targetLength);
+        return vi;
+    }
+
+    PitchInput pitchPreprocess(
+            const DsSegment &dsSegment,
+            const DsVarianceConfig &dsVarianceConfig,
+            double frameLength) {
+        PitchInput pi{};
+        pi.ph_dur = phonemeDurationToFrames(dsSegment.ph_dur, frameLength);
+        pi.note_dur = phonemeDurationToFrames(dsSegment.note_dur, frameLength);
+
+        int64_t targetLength = std::accumulate(pi.ph_dur.begin(), pi.ph_dur.end(), static_cast<int64_t>(0));
+
+        // Notes and phonemes are rounded to frames separately, so make the notes end with the phonemes.
+        int64_t notesLength = std::accumulate(pi.note_dur.begin(), pi.note_dur.end(), static_cast<int64_t>(0));
+        if (!pi.note_dur.empty() && pi.note_dur.back() + targetLength - notesLength > 0) {
+            pi.note_dur.back() += targetLength - notesLength;
+        }
+
+        auto noteMidi = fillZeroMidiWithNearest(dsSegment.note_seq);
+        pi.note_midi = std::vector<float>(noteMidi.begin(), noteMidi.end());
+        pi.note_rest.reserve(dsSegment.note_seq.size());
+        for (auto midi : dsSegment.note_seq) {
+            pi.note_rest.push_back(midi == 0 ? 1 : 0);
+        }
+
+        pi.pitch.reserve(targetLength);
+        for (size_t i = 0; i < pi.note_dur.size() && i < pi.note_midi.size(); ++i) {
+            pi.pitch.insert(pi.pitch.end(), pi.note_dur[i], pi.note_midi[i]);
+        }
+        pi.pitch.resize(targetLength, pi.pitch.empty() ? 60.0f : pi.pitch.back());
+
+        pi.spk_embed = speakerEmbedFrames(dsSegment.spk_mix, dsVarianceConfig.speakers, dsVarianceConfig.spkEmb,
+                                          frameLength, targetLength);
+        return pi;
+    }
+
+    std::vector<float> speakerEmbedFrames(const SpeakerMixCurve &spkMix,
+                                          const std::vector<std::string> &speakers,
+                                          const SpeakerEmbed &spkEmb,
+                                          double frameLength,
+                                          int64_t targetLength) {
+        std::vector<float> spkEmbed;
+        if (speakers.empty()) {
+            return spkEmbed;
+        }
+
+        // Required to choose a speaker.
+        int64_t spkEmbedArraySize = targetLength * SPK_EMBED_SIZE;
+        spkEmbed.resize(spkEmbedArraySize);
+        if (spkMix.empty()) {
+            // Use the first one by default.
+            auto emb = spkEmb.getMixedEmb({{speakers[0], 1.0}});
+            for (size_t i = 0; i < spkEmbedArraySize; ++i) {
+                spkEmbed[i] = emb[i % SPK_EMBED_SIZE];
+            }
+        } else {
+            auto spkMixResampled = spkMix.resample(frameLength, targetLength);
+            for (int64_t i = 0; i < targetLength; ++i) {
+                std::unordered_map<std::string, double> mix;
+                for (const auto &speakerItem : spkMixResampled.spk) {
+                    // If SampleCurve::resample guarantees the size of returned array is at least `targetLength`,
+                    // subscripting will not go out of range here.
+                    mix[speakerItem.first] = speakerItem.second.samples[i];
+                }
+                auto emb = spkEmb.getMixedEmb(mix);
+                int64_t y = i * SPK_EMBED_SIZE;
+                for (int64_t j = 0; j < SPK_EMBED_SIZE; ++j) {
+                    spkEmbed[y + j] = emb[j];
+                }
+            }
+        }
+        return spkEmbed;
+    }
+
+    std::vector<int64_t> phonemesToTokens(const PhonemeTable &name2token,
                                              const std::vector<std::string> &phonemes) {
         std::vector<int64_t> tokens;
         tokens.reserve(phonemes.size());
 
         for (const auto &ph: phonemes) {
-            auto it = name2token.find(ph);
-            if (it != name2token.end()) {
+            auto token = name2token.find(ph);
+            if (token >= 0) {
                 // If phoneme is found in name2token, push back value (token).
-                tokens.push_back(it->second);
+                tokens.push_back(token);
             } else {
                 // Handle error: phoneme not found in name2token
                 tokens.push_back(0);
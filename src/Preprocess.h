@@ -16,17 +16,84 @@
 namespace diffsinger {
 
     struct DsSegment;
+    struct SpeakerMixCurve;
     struct DsConfig;
+    struct DsVarianceConfig;
+    class PhonemeTable;
 
     PreprocessedData acousticPreprocess(
-            const std::unordered_map<std::string, int64_t> &name2token,
+            const PhonemeTable &name2token,
             const DsSegment &dsSegment,
             const DsConfig &dsConfig,
             double frameLength);
 
+    /**
+     * @brief Pads the acoustic inputs to the smallest frame bucket that fits them.
+     *
+     * A phoneme `padToken` is appended to cover the extra frames, and the curves are extended
+     * with their last values. Inputs longer than the largest bucket are left unchanged.
+     *
+     * @return The frame count before padding.
+     */
+    int64_t padToFrameBucket(PreprocessedData &pd, const std::vector<int64_t> &frameBuckets, int64_t padToken);
+
+    struct SilenceTrim {
+        int64_t leadingFrames = 0;   // Frames removed from the start
+        int64_t trailingFrames = 0;  // Frames removed from the end
+    };
+
+    /**
+     * @brief Whether every phoneme of the segment is one of `silencePhonemes`, so it renders to silence.
+     */
+    bool isSilentSegment(const DsSegment &dsSegment, const std::vector<std::string> &silencePhonemes);
+
+    /**
+     * @brief Shortens silence phonemes at both edges of the acoustic inputs to `keepFrames` frames.
+     *
+     * The kept frames give the acoustic model the same context at the edges of the voiced part.
+     * The curves and speaker embeddings are cut accordingly.
+     *
+     * @param silenceTokens  Tokens of the silence phonemes.
+     * @return               The frames removed from each edge.
+     */
+    SilenceTrim trimSilentEdges(PreprocessedData &pd, const std::vector<int64_t> &silenceTokens, int64_t keepFrames);
+
+    /**
+     * @brief Replaces the speaker embeddings of acoustic inputs with those of another speaker mix.
+     *
+     * Nothing else in the inputs depends on the speakers, so rendering a segment for several speaker mixes
+     * only needs this part again. `trim` is what trimSilentEdges removed from `pd` (if called); frames added
+     * by padToFrameBucket are filled with the last embedding.
+     */
+    void replaceSpeakerMix(PreprocessedData &pd,
+                           const DsSegment &dsSegment,
+                           const SpeakerMixCurve &spkMix,
+                           const DsConfig &dsConfig,
+                           double frameLength,
+                           const SilenceTrim &trim);
+
     LinguisticInput linguisticPreprocess(
-            const std::unordered_map<std::string, int64_t> &name2token,
+            const PhonemeTable &name2token,
+            const DsSegment &dsSegment,
+            double frameLength);
+
+    /**
+     * @brief Builds the variance model inputs of a segment, except the linguistic encoding.
+     */
+    VarianceInput variancePreprocess(
+            const DsSegment &dsSegment,
+            const DsVarianceConfig &dsVarianceConfig,
+            double frameLength);
+
+    /**
+     * @brief Builds the pitch model inputs of a segment, except the linguistic encoding.
+     *
+     * Requires note_seq and note_dur. Rest notes (MIDI 0) are marked in note_rest and take the pitch
+     * of the nearest notes.
+     */
+    PitchInput pitchPreprocess(
             const DsSegment &dsSegment,
+            const DsVarianceConfig &dsVarianceConfig,
             double frameLength);
 
     std::vector<int> noteMidiToDurMidi(const std::vector<int> &noteMidi, const std::vector<int> &noteNum);
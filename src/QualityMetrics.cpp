@@ -0,0 +1,124 @@
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <numeric>
+
+#include "QualityMetrics.h"
+
+namespace diffsinger {
+
+    namespace {
+
+        // In-place iterative radix-2 FFT; the size must be a power of two.
+        void fft(std::vector<std::complex<double>> &data) {
+            auto n = data.size();
+            for (size_t i = 1, j = 0; i < n; ++i) {
+                auto bit = n >> 1;
+                for (; j & bit; bit >>= 1) {
+                    j ^= bit;
+                }
+                j ^= bit;
+                if (i < j) {
+                    std::swap(data[i], data[j]);
+                }
+            }
+            const double pi = std::acos(-1.0);
+            for (size_t length = 2; length <= n; length <<= 1) {
+                auto angle = -2.0 * pi / static_cast<double>(length);
+                std::complex<double> step(std::cos(angle), std::sin(angle));
+                for (size_t start = 0; start < n; start += length) {
+                    std::complex<double> twiddle(1.0, 0.0);
+                    for (size_t k = 0; k < length / 2; ++k) {
+                        auto even = data[start + k];
+                        auto odd = data[start + k + length / 2] * twiddle;
+                        data[start + k] = even + odd;
+                        data[start + k + length / 2] = even - odd;
+                        twiddle *= step;
+                    }
+                }
+            }
+        }
+
+        // Power spectrum (fftSize / 2 + 1 bins) of the Hann-windowed frame starting at `start`.
+        void powerSpectrum(const std::vector<float> &waveform, size_t start, const std::vector<double> &window,
+                           std::vector<std::complex<double>> &buffer, std::vector<double> &power) {
+            auto fftSize = window.size();
+            for (size_t k = 0; k < fftSize; ++k) {
+                auto pos = start + k;
+                buffer[k] = (pos < waveform.size()) ? waveform[pos] * window[k] : 0.0;
+            }
+            fft(buffer);
+            for (size_t k = 0; k < power.size(); ++k) {
+                power[k] = std::norm(buffer[k]);
+            }
+        }
+
+    }  // namespace
+
+    double melL1Distance(const std::vector<float> &mel, const std::vector<float> &referenceMel, size_t numBins) {
+        if (numBins == 0) {
+            return 0.0;
+        }
+        auto numValues = std::min(mel.size(), referenceMel.size()) / numBins * numBins;
+        if (numValues == 0) {
+            return 0.0;
+        }
+        double sum = 0.0;
+        for (size_t i = 0; i < numValues; ++i) {
+            sum += std::abs(static_cast<double>(mel[i]) - referenceMel[i]);
+        }
+        return sum / static_cast<double>(numValues);
+    }
+
+    double logSpectralDistance(const std::vector<float> &waveform, const std::vector<float> &referenceWaveform,
+                               size_t fftSize, size_t hopSize) {
+        auto numSamples = std::min(waveform.size(), referenceWaveform.size());
+        if (numSamples == 0 || fftSize < 2 || (fftSize & (fftSize - 1)) != 0 || hopSize == 0) {
+            return 0.0;
+        }
+
+        const double pi = std::acos(-1.0);
+        std::vector<double> window(fftSize);
+        for (size_t k = 0; k < fftSize; ++k) {
+            window[k] = 0.5 - 0.5 * std::cos(2.0 * pi * static_cast<double>(k) / static_cast<double>(fftSize));
+        }
+        std::vector<std::complex<double>> buffer(fftSize);
+        std::vector<double> power(fftSize / 2 + 1);
+        std::vector<double> referencePower(fftSize / 2 + 1);
+
+        // Keeps silent bins from dominating the distance.
+        constexpr double powerFloor = 1e-10;
+        double sum = 0.0;
+        size_t numFrames = 0;
+        for (size_t start = 0; start < numSamples; start += hopSize) {
+            powerSpectrum(waveform, start, window, buffer, power);
+            powerSpectrum(referenceWaveform, start, window, buffer, referencePower);
+            double squaredSum = 0.0;
+            for (size_t k = 0; k < power.size(); ++k) {
+                auto difference = 10.0 * std::log10((power[k] + powerFloor) / (referencePower[k] + powerFloor));
+                squaredSum += difference * difference;
+            }
+            sum += std::sqrt(squaredSum / static_cast<double>(power.size()));
+            ++numFrames;
+        }
+        return sum / static_cast<double>(numFrames);
+    }
+
+    std::vector<size_t> paretoFrontier(const std::vector<double> &costs, const std::vector<double> &distances) {
+        std::vector<size_t> order(std::min(costs.size(), distances.size()));
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+            return costs[a] != costs[b] ? costs[a] < costs[b] : distances[a] < distances[b];
+        });
+
+        // By ascending cost, a point is on the frontier if it is closer than every cheaper one.
+        std::vector<size_t> frontier;
+        for (auto i : order) {
+            if (frontier.empty() || distances[i] < distances[frontier.back()]) {
+                frontier.push_back(i);
+            }
+        }
+        return frontier;
+    }
+
+}  // namespace diffsinger
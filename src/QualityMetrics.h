@@ -0,0 +1,31 @@
+#ifndef DS_ONNX_INFER_QUALITYMETRICS_H
+#define DS_ONNX_INFER_QUALITYMETRICS_H
+
+#include <cstddef>
+#include <vector>
+
+namespace diffsinger {
+
+    /**
+     * @brief Mean absolute difference of two mel spectrograms of `numBins` bins per frame.
+     *
+     * Only the frames both spectrograms have are compared. Returns 0 if there are none.
+     */
+    double melL1Distance(const std::vector<float> &mel, const std::vector<float> &referenceMel, size_t numBins);
+
+    /**
+     * @brief Log-spectral distance (in dB) of two waveforms, averaged over Hann-windowed frames.
+     *
+     * `fftSize` must be a power of two. Only the samples both waveforms have are compared.
+     */
+    double logSpectralDistance(const std::vector<float> &waveform, const std::vector<float> &referenceWaveform,
+                               size_t fftSize = 1024, size_t hopSize = 256);
+
+    /**
+     * @brief Indices of the points no other point beats in both cost and distance, by ascending cost.
+     */
+    std::vector<size_t> paretoFrontier(const std::vector<double> &costs, const std::vector<double> &distances);
+
+}  // namespace diffsinger
+
+#endif //DS_ONNX_INFER_QUALITYMETRICS_H
@@ -0,0 +1,904 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <thread>
+#include <utility>
+
+#include <onnxruntime_cxx_api.h>
+
+#include "Render.h"
+#include "PowerManagement.h"
+#include "SpeakerEmbed.h"
+#include "FileUtil.h"
+#include "SegmentUtil.h"
+#include "SegmentIndex.h"
+#include "IncrementalRender.h"
+#include "FileWatcher.h"
+#include "CostModel.h"
+#include "QualityMetrics.h"
+#include "TuningProfile.h"
+#include "HashUtil.hpp"
+#include "AcousticPipeline.h"
+#include "DurationPipeline.h"
+#include "VariancePipeline.h"
+#include "DeadlinePlan.h"
+#include "ThreadPool.h"
+#include "Inference/VocoderInference.h"
+#include "Inference/InferenceUtils.hpp"
+#include "Inference/SharedEnv.h"
+
+namespace diffsinger {
+
+    /**
+     * @brief Keeps the segments selected by --range and --segments.
+     *
+     * @param outputStart, outputEnd  Set to the time range to write, or to (0, -1) to write the whole timeline.
+     * @return false if no segment is selected.
+     */
+    bool selectSegments(const RenderSettings &settings, std::vector<DsSegment> &dsProject,
+                        double &outputStart, double &outputEnd);
+
+    /**
+     * @brief Key of the incremental render state of a job: the project, the place of the job in it,
+     *        the speaker mix, everything in the settings that changes the rendered audio, and the content
+     *        of the models (`modelHash`), so that a retrained or repacked voicebank at the same path renders anew.
+     */
+    uint64_t jobStateKey(const RenderSettings &settings, const DsSegment &job, const std::string &spkMixStr,
+                         int speedup, int depth, uint64_t modelHash);
+
+    bool predictDurations(const RenderSettings &settings, std::vector<DsSegment> &dsProject);
+
+    bool predictVariances(const RenderSettings &settings,
+                          std::vector<DsSegment> &dsProject,
+                          bool needsEnergy,
+                          bool needsBreathiness);
+
+    TString fanoutOutputPath(const TString &outputWavePath, const std::string &spkMixStr);
+
+    void run(const RenderSettings &settings) {
+        auto acousticSpeedup = settings.acousticSpeedup;
+        auto shallowDiffusionDepth = settings.shallowDiffusionDepth;
+
+        // Preprocessing, mixing and file output run on this pool, called from the thread running the inferences.
+        // With --shared-threads, the cores are split between them instead of each session having a pool: this
+        // thread on core 0, a quarter of the cores for the workers, and the rest for one ORT pool of all sessions.
+        size_t numWorkers = 0;
+        if (settings.sharedThreads) {
+            size_t hardwareThreads = std::max(std::thread::hardware_concurrency(), 1u);
+            numWorkers = std::max<size_t>(hardwareThreads / 4, 1);
+            pinCurrentThreadToCore(0);
+            useGlobalThreadPool(numWorkers + 1, true);
+        }
+        ThreadPool workerPool(numWorkers, settings.sharedThreads, 1);
+
+        // Disable sleep mode
+        keepSystemAwake();
+
+        // Get the available providers
+        auto availableProviders = Ort::GetAvailableProviders();
+
+        // Print the available providers
+        std::cout << "Available Providers:" << std::endl;
+        for (const auto &provider: availableProviders) {
+            std::cout << '-' << ' ' << provider << std::endl;
+        }
+
+        DsConfig dsConfig;
+        DsVocoderConfig vocoderConfig;
+        bool hasVocoder = false;
+        if (!loadConfigs(settings, dsConfig, vocoderConfig, hasVocoder)) {
+            return;
+        }
+        if (!hasVocoder) {
+            std::cout << "!! ERROR: --vocoder-config is required because no vocoder is packed in the bundle.\n";
+            return;
+        }
+
+        if (!resolveDiffusionSettings(dsConfig, acousticSpeedup, shallowDiffusionDepth)) {
+            return;
+        }
+
+        // Render passes: the draft (if progressive), then the final quality.
+        struct RenderPass {
+            AcousticInferenceSettings inferSettings;
+            int diffusionSteps;
+            bool isDraft;
+        };
+        std::vector<RenderPass> renderPasses;
+        if (settings.draftSpeedup > 0) {
+            auto draftSpeedup = settings.draftSpeedup;
+            auto draftDepth = settings.draftDepth < 0 ? shallowDiffusionDepth : settings.draftDepth;
+            if (!resolveDiffusionSettings(dsConfig, draftSpeedup, draftDepth)) {
+                return;
+            }
+            AcousticInferenceSettings draftSettings{};
+            draftSettings.speedup = draftSpeedup;
+            draftSettings.depth = draftDepth;
+            draftSettings.sampler = settings.sampler;
+            renderPasses.push_back({draftSettings, diffusionStepCount(dsConfig, draftSpeedup, draftDepth), true});
+        }
+        AcousticInferenceSettings inferSettings{};
+        inferSettings.speedup = acousticSpeedup;
+        inferSettings.depth = shallowDiffusionDepth;
+        inferSettings.sampler = settings.sampler;
+        renderPasses.push_back({inferSettings, diffusionStepCount(dsConfig, acousticSpeedup, shallowDiffusionDepth),
+                                false});
+
+        // With --deadline, each job of the final pass renders with one of these.
+        std::vector<DiffusionSettings> deadlineSettings;
+        if (settings.deadline > 0) {
+            deadlineSettings = fasterDiffusionSettings(dsConfig, acousticSpeedup, shallowDiffusionDepth);
+        }
+
+        int sampleRate = vocoderConfig.sampleRate;
+        int hopSize = vocoderConfig.hopSize;
+        double frameLength = 1.0 * hopSize / sampleRate;
+
+        // With speaker fan-out, the project is loaded with the first mix; the duration and variance models
+        // predict with it, and only the speaker embeddings of the acoustic inputs change for the other mixes.
+        const auto &spkMixes = settings.spkMixFanout;
+        size_t numMixes = std::max<size_t>(spkMixes.size(), 1);
+        std::vector<SpeakerMixCurve> spkMixCurves;
+        for (const auto &spkMix : spkMixes) {
+            spkMixCurves.push_back(SpeakerMixCurve::fromStaticMix(SpeakerEmbed::parseMixString(spkMix)));
+        }
+
+        // Threads and execution modes found fastest on this machine by the autotune subcommand.
+        auto acousticSessionConfig = settings.sessionConfig;
+        auto vocoderSessionConfig = settings.sessionConfig;
+        bool hasTuningProfile = false;
+        auto tuningProfile = loadTuningProfile(tuningProfilePath(settings), &hasTuningProfile);
+        if (hasTuningProfile) {
+            std::cout << "Using the tuning profile of this machine.\n";
+            acousticSessionConfig = tunedSessionConfig(settings.sessionConfig, tuningProfile.acoustic);
+            vocoderSessionConfig = tunedSessionConfig(settings.sessionConfig, tuningProfile.vocoder);
+        }
+
+        std::cout << '\n';
+        std::cout << "Initializing acoustic inference session...\n";
+        AcousticPipeline acousticPipeline(dsConfig);
+
+        // Warm-up inferences only need to run the kernels once, so use a single diffusion step.
+        AcousticInferenceSettings warmupSettings{};
+        warmupSettings.depth = dsConfig.useShallowDiffusion ? shallowDiffusionDepth : 1000;
+        warmupSettings.speedup = std::max(warmupSettings.depth, 1);
+        acousticPipeline.setWarmupSettings(warmupSettings);
+
+        bool isAcousticSessionInitOk = acousticPipeline.initSessions(settings.ep, settings.deviceIndex,
+                                                                     acousticSessionConfig);
+        if (!isAcousticSessionInitOk) {
+            std::cout << "!! ERROR: Acoustic Session initialization failed.\n";
+            return;
+        }
+        std::cout << "Successfully created acoustic inference session.\n";
+        acousticPipeline.printModelFeatures();
+
+        auto acousticModelFlags = acousticPipeline.getModelFlags();
+        bool needsEnergy = acousticModelFlags.check(AcousticModelFlags::Energy);
+        bool needsBreathiness = acousticModelFlags.check(AcousticModelFlags::Breathiness);
+
+        std::cout << '\n';
+        std::cout << "Initializing vocoder inference session...\n";
+        VocoderInference vocoderInference(vocoderConfig.model, vocoderConfig.modelData);
+
+        bool isVocoderSessionInitOk = vocoderInference.initSession(ExecutionProvider::CPU, 0, vocoderSessionConfig);
+        if (!isVocoderSessionInitOk) {
+            std::cout << "!! ERROR: Vocoder Session initialization failed.\n";
+            return;
+        }
+        std::cout << "Successfully created vocoder inference session.\n";
+        std::cout << '\n';
+
+        JobPreparer jobPreparer(dsConfig, jobPrepareOptions(settings), sampleRate, hopSize);
+
+        // Content of the acoustic, denoiser and vocoder models, for the keys of the incremental render state.
+        auto modelHash = Hasher()
+                .updateValue(acousticPipeline.getModelHash())
+                .updateValue(vocoderInference.getModelHash())
+                .digest();
+
+        // Incremental renders keep the state of each job in the cache directory. Watch mode always renders
+        // incrementally, keeping the state in memory unless --incremental is given too.
+        std::unique_ptr<IncrementalRenderer> incrementalRenderer;
+        if (settings.incremental || settings.watch) {
+            std::filesystem::path stateDirectory;
+            if (settings.incremental && settings.sessionConfig.cacheDirectory.empty()) {
+                std::cout << "!! WARNING: --incremental needs the cache directory to keep renders between runs.\n";
+            } else if (settings.incremental) {
+                stateDirectory = settings.sessionConfig.cacheDirectory / "render-state";
+            }
+            incrementalRenderer = std::make_unique<IncrementalRenderer>(stateDirectory, settings.incrementalContext,
+                                                                        sampleRate, hopSize);
+        }
+
+        // Renders the project as it is on disk; in watch mode, again after each change.
+        auto renderProject = [&]() {
+            auto renderStart = std::chrono::steady_clock::now();
+            auto dsProject = loadDsProject(settings.dsFilePath, spkMixes.empty() ? settings.spkMixStr : spkMixes[0]);
+            if (dsProject.empty()) {
+                std::cout << "!! ERROR: The project has no segments.\n";
+                return;
+            }
+            double outputStart = 0.0;
+            double outputEnd = -1.0;
+            if (!selectSegments(settings, dsProject, outputStart, outputEnd)) {
+                return;
+            }
+            size_t numSegments = dsProject.size();
+
+            bool needsDurations = std::any_of(dsProject.begin(), dsProject.end(),
+                                              [](const DsSegment &segment) { return segment.ph_dur.empty(); });
+            bool hasPredictions = false;
+            if (!settings.durConfigPath.empty() && needsDurations) {
+                std::cout << '\n';
+                if (!predictDurations(settings, dsProject)) {
+                    std::cout << "!! ERROR: Duration prediction failed.\n";
+                    return;
+                }
+                hasPredictions = true;
+            }
+
+            bool needsPitch = std::any_of(dsProject.begin(), dsProject.end(),
+                                          [](const DsSegment &segment) { return segment.f0.samples.empty(); });
+            if (!settings.varianceConfigPath.empty() && (needsPitch || needsEnergy || needsBreathiness)) {
+                std::cout << '\n';
+                if (!predictVariances(settings, dsProject, needsEnergy, needsBreathiness)) {
+                    std::cout << "!! ERROR: Variance prediction failed.\n";
+                    return;
+                }
+                hasPredictions = true;
+            }
+
+            if (hasPredictions && settings.savePredictions) {
+                if (saveDsProjectPredictions(settings.dsFilePath, dsProject)) {
+                    std::cout << ">> Saved predicted parameters to the .ds file.\n";
+                } else {
+                    std::cout << "!! WARNING: Failed to save predicted parameters to the .ds file.\n";
+                }
+            }
+
+            // Identical segments (e.g. repeated choruses) are rendered once and placed at each of their offsets.
+            // Long segments are rendered in overlapping pieces if --split-long is given, and runs of short
+            // segments are rendered together if --coalesce-short is given.
+            auto renderPlan = RenderPlan::fromSegments(dsProject, settings.renderPlanOptions);
+            auto &jobs = renderPlan.jobs;
+            size_t numJobs = jobs.size();
+            if (numJobs != numSegments) {
+                std::cout << "Rendering " << numJobs << " jobs for " << numSegments << " segments.\n";
+            }
+
+            // The most expensive jobs run first, so that no long job is left alone at the end. Batches are also
+            // formed of jobs of similar lengths this way. The estimates are calibrated by the calls timed below.
+            CostModel costModel(costModelPath(settings));
+            std::vector<double> jobCosts(numJobs);
+            double totalCost = 0.0;
+            double draftCost = 0.0;
+            for (size_t i = 0; i < numJobs; i++) {
+                auto frames = estimateJobFrames(settings, jobs[i], frameLength);
+                jobCosts[i] = costModel.estimate(frames, renderPasses.back().diffusionSteps, hopSize).totalSeconds();
+                totalCost += jobCosts[i];
+                if (renderPasses.front().isDraft) {
+                    draftCost += costModel.estimate(frames, renderPasses.front().diffusionSteps, hopSize)
+                            .totalSeconds();
+                }
+            }
+            auto jobOrder = scheduleLongestFirst(jobCosts);
+            std::cout << "Estimated render time: " << std::fixed << std::setprecision(1)
+                      << totalCost * static_cast<double>(numMixes);
+            if (renderPasses.front().isDraft) {
+                std::cout << " seconds, draft first in " << draftCost * static_cast<double>(numMixes);
+            }
+            std::cout << std::defaultfloat << " seconds\n";
+
+            // Audio of each job, per speaker mix.
+            std::vector<std::vector<JobWaveform>> jobWaveforms(numMixes, std::vector<JobWaveform>(numJobs));
+
+            auto lastOutputWrite = std::chrono::steady_clock::now();
+            auto writeOutputs = [&]() {
+                lastOutputWrite = std::chrono::steady_clock::now();
+                auto writeOutput = [&](const TString &path, const std::vector<JobWaveform> &waveforms) {
+                    auto samples = mixJobWaveforms(renderPlan, waveforms, sampleRate, outputStart);
+                    if (outputEnd >= 0) {
+                        samples.resize(static_cast<size_t>(std::round((outputEnd - outputStart) * sampleRate)),
+                                       0.0f);
+                    }
+                    writeWaveFile(path, samples, sampleRate);
+                };
+                if (spkMixes.empty()) {
+                    writeOutput(settings.outputWavePath, jobWaveforms[0]);
+                } else {
+                    workerPool.parallelFor(numMixes, [&](size_t m) {
+                        writeOutput(fanoutOutputPath(settings.outputWavePath, spkMixes[m]), jobWaveforms[m]);
+                    });
+                }
+            };
+            bool isDraftPass = false;
+
+            // Mels waiting for the vocoder. They are collected over several acoustic batches, so that segments
+            // of similar lengths can be vocoded together.
+            struct PendingVocoderJob {
+                size_t job;
+                size_t mix;
+                Ort::Value mel;
+                int64_t melFrames;
+                PreparedJob prepared;
+                IncrementalRenderer::Unit unit;
+                bool isFinal;  // Rendered with the requested settings, not a draft or lowered for --deadline
+            };
+            std::vector<PendingVocoderJob> pendingVocoderJobs;
+            size_t vocoderBatchSize = vocoderInference.canBatch() ? static_cast<size_t>(settings.vocoderBatchSize) : 1;
+
+            auto flushVocoderJobs = [&]() {
+                // Shortest first, and a new batch wherever the length grows too much, to limit the padded frames.
+                constexpr double maxLengthRatio = 1.25;
+                std::sort(pendingVocoderJobs.begin(), pendingVocoderJobs.end(),
+                          [](const PendingVocoderJob &a, const PendingVocoderJob &b) {
+                              return a.melFrames < b.melFrames;
+                          });
+                size_t groupStart = 0;
+                while (groupStart < pendingVocoderJobs.size()) {
+                    auto groupEnd = groupStart + 1;
+                    auto maxFrames = static_cast<double>(pendingVocoderJobs[groupStart].melFrames) * maxLengthRatio;
+                    while (groupEnd < pendingVocoderJobs.size() && groupEnd - groupStart < vocoderBatchSize
+                           && static_cast<double>(pendingVocoderJobs[groupEnd].melFrames) <= maxFrames) {
+                        ++groupEnd;
+                    }
+
+                    std::cout << ">> Vocoder infer -> Waveform (" << groupEnd - groupStart << " segments)" << "\n";
+                    std::vector<Ort::Value> groupMels;
+                    std::vector<const std::vector<double> *> groupF0s;
+                    for (auto k = groupStart; k < groupEnd; k++) {
+                        groupMels.push_back(std::move(pendingVocoderJobs[k].mel));
+                        groupF0s.push_back(&pendingVocoderJobs[k].prepared.pd.f0);
+                    }
+                    int64_t groupFrames = 0;
+                    for (auto k = groupStart; k < groupEnd; k++) {
+                        groupFrames += pendingVocoderJobs[k].melFrames;
+                    }
+                    auto vocoderStart = std::chrono::steady_clock::now();
+                    std::vector<std::vector<float>> waveforms;
+                    try {
+                        waveforms = vocoderInference.inferBatch(groupMels, groupF0s);
+                        costModel.addVocoderSample(groupFrames, std::chrono::duration<double>(
+                                std::chrono::steady_clock::now() - vocoderStart).count());
+                    }
+                    catch (const Ort::Exception &ortException) {
+                        printOrtError(ortException);
+                    }
+
+                    for (auto k = groupStart; k < groupEnd; k++) {
+                        auto &pending = pendingVocoderJobs[k];
+                        if (k - groupStart >= waveforms.size() || waveforms[k - groupStart].empty()) {
+                            std::cout << "!! ERROR: Vocoder Infer failed (segment " << pending.job + 1 << ").\n";
+                            continue;
+                        }
+                        auto waveform = jobPreparer.finishWaveform(std::move(waveforms[k - groupStart]),
+                                                                   pending.prepared);
+                        // Only audio of the requested settings is kept as the state of incremental renders, as the
+                        // state is keyed by them.
+                        if (incrementalRenderer) {
+                            waveform = pending.isFinal
+                                       ? incrementalRenderer->finish(pending.unit, std::move(waveform))
+                                       : incrementalRenderer->preview(pending.unit, std::move(waveform));
+                        }
+                        jobWaveforms[pending.mix][pending.job] = std::move(waveform);
+                    }
+                    groupStart = groupEnd;
+                }
+                pendingVocoderJobs.clear();
+            };
+
+            // Segments of a batch share the denoising steps of split acoustic models. Whole models render one by one.
+            // The speaker mixes of a job are adjacent, so that they batch together with inputs of the same length.
+            size_t acousticBatchSize = acousticPipeline.canBatch()
+                                       ? static_cast<size_t>(settings.acousticBatchSize) : 1;
+            size_t numUnits = numJobs * numMixes;
+            // With --deadline, the jobs not started yet get the best diffusion settings that let the project
+            // finish in the time left, with the calibrated costs.
+            auto deadlinePlan = makeDeadlinePlan(renderPlan, deadlineSettings);
+            auto planDeadline = [&](size_t firstJob) {
+                auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - renderStart).count();
+                replanDeadline(deadlinePlan, settings, renderPlan, jobOrder, firstJob, costModel, frameLength, hopSize,
+                               numMixes, settings.deadline - elapsed);
+            };
+
+            bool hasDraft = false;
+            for (const auto &pass : renderPasses) {
+                isDraftPass = pass.isDraft;
+                if (renderPasses.size() > 1) {
+                    std::cout << (isDraftPass ? "\n>> Draft pass" : "\n>> Refinement pass") << " (speedup "
+                              << pass.inferSettings.speedup << ", depth " << pass.inferSettings.depth << ")\n";
+                }
+                bool hasDeadline = !isDraftPass && !deadlineSettings.empty();
+                if (hasDeadline) {
+                    planDeadline(0);
+                    printDeadlinePlan(deadlinePlan, settings.deadline);
+                }
+                size_t preparedJobIndex = numJobs;
+                PreparedJob preparedJob;
+                auto preparedStatus = JobPreparer::Status::Failed;
+                size_t nextUnit = 0;
+                while (nextUnit < numUnits) {
+                    auto batchStart = nextUnit;
+                    auto batchEnd = std::min(numUnits, batchStart + acousticBatchSize);
+                    // A batch shares its diffusion settings.
+                    auto batchSettings = pass.inferSettings;
+                    auto batchSteps = pass.diffusionSteps;
+                    if (hasDeadline) {
+                        const auto &chosen = deadlinePlan.ladder[limitBatchToOneSetting(deadlinePlan, jobOrder,
+                                                                                        numMixes, batchStart,
+                                                                                        batchEnd)];
+                        batchSettings.speedup = chosen.speedup;
+                        batchSettings.depth = chosen.depth;
+                        batchSteps = chosen.steps;
+                    }
+                    nextUnit = batchEnd;
+                    auto timeStart = std::chrono::steady_clock::now();
+
+                    // The jobs of the batch are preprocessed side by side.
+                    std::vector<size_t> batchJobs;
+                    for (size_t n = batchStart; n < batchEnd; n++) {
+                        auto i = jobOrder[n / numMixes];
+                        if (i != preparedJobIndex && (batchJobs.empty() || batchJobs.back() != i)) {
+                            batchJobs.push_back(i);
+                        }
+                    }
+                    std::vector<PreparedJob> batchPrepared(batchJobs.size());
+                    std::vector<JobPreparer::Status> batchStatus(batchJobs.size(), JobPreparer::Status::Failed);
+                    workerPool.parallelFor(batchJobs.size(), [&](size_t k) {
+                        batchStatus[k] = jobPreparer.prepare(jobs[batchJobs[k]], batchPrepared[k]);
+                    });
+                    size_t nextBatchJob = 0;
+
+                    std::vector<std::pair<size_t, size_t>> batchIndices;  // (job, mix)
+                    std::vector<PreparedJob> batchInputs;
+                    std::vector<IncrementalRenderer::Unit> batchUnits;
+                    for (size_t n = batchStart; n < batchEnd; n++) {
+                        auto i = jobOrder[n / numMixes];
+                        auto m = n % numMixes;
+                        std::cout << n + 1 << " of " << numUnits << "\n";
+                        if (i != preparedJobIndex) {
+                            std::cout << ">> Preprocessing input" << "\n";
+                            preparedStatus = batchStatus[nextBatchJob];
+                            preparedJob = std::move(batchPrepared[nextBatchJob]);
+                            ++nextBatchJob;
+                            preparedJobIndex = i;
+                        }
+                        if (!spkMixes.empty()) {
+                            std::cout << ">> Speaker mix: " << spkMixes[m] << "\n";
+                        }
+
+                        if (preparedStatus == JobPreparer::Status::Silent) {
+                            std::cout << ">> Silent segment, skipped inference" << "\n";
+                            jobWaveforms[m][i] = jobPreparer.silentWaveform(jobs[i]);
+                            continue;
+                        }
+                        if (preparedStatus != JobPreparer::Status::Ready) {
+                            continue;
+                        }
+                        // The first mix is the one the job was prepared with.
+                        auto unitPrepared = (m == 0)
+                                            ? preparedJob
+                                            : jobPreparer.withSpeakerMix(preparedJob, jobs[i], spkMixCurves[m]);
+                        IncrementalRenderer::Unit unit;
+                        if (incrementalRenderer) {
+                            JobWaveform reused;
+                            double windowStart = 0.0;
+                            double windowEnd = 0.0;
+                            auto key = jobStateKey(settings, jobs[i],
+                                                   spkMixes.empty() ? settings.spkMixStr : spkMixes[m],
+                                                   acousticSpeedup, shallowDiffusionDepth, modelHash);
+                            auto decision = incrementalRenderer->plan(key, unitPrepared, unit, reused,
+                                                                      windowStart, windowEnd);
+                            if (decision == IncrementalRenderer::Decision::Reuse) {
+                                std::cout << ">> Unchanged since the last render, skipped inference" << "\n";
+                                jobWaveforms[m][i] = std::move(reused);
+                                continue;
+                            }
+                            if (decision == IncrementalRenderer::Decision::Window) {
+                                auto windowJob = sliceSegment(jobs[i], windowStart, windowEnd);
+                                PreparedJob windowPrepared;
+                                if (jobPreparer.prepare(windowJob, windowPrepared) == JobPreparer::Status::Ready) {
+                                    std::cout << ">> Rendering the changed part only (" << windowStart << "s to "
+                                              << windowEnd << "s)" << "\n";
+                                    unitPrepared = (m == 0) ? std::move(windowPrepared)
+                                                            : jobPreparer.withSpeakerMix(windowPrepared, windowJob,
+                                                                                         spkMixCurves[m]);
+                                } else {
+                                    unit.isWindow = false;
+                                }
+                            }
+                        }
+                        batchIndices.emplace_back(i, m);
+                        batchInputs.push_back(std::move(unitPrepared));
+                        batchUnits.push_back(std::move(unit));
+                    }
+                    if (batchIndices.empty()) {
+                        continue;
+                    }
+
+                    std::cout << ">> Acoustic infer -> Mel" << "\n";
+                    std::vector<const PreprocessedData *> batchInputPtrs;
+                    for (const auto &prepared : batchInputs) {
+                        batchInputPtrs.push_back(&prepared.pd);
+                    }
+                    int64_t batchFrames = 0;
+                    for (const auto &prepared : batchInputs) {
+                        batchFrames += static_cast<int64_t>(prepared.pd.f0.size());
+                    }
+                    auto acousticStart = std::chrono::steady_clock::now();
+                    if (hasDeadline && batchSteps != pass.diffusionSteps) {
+                        std::cout << ">> Speedup " << batchSettings.speedup << ", depth " << batchSettings.depth
+                                  << " to meet the deadline" << "\n";
+                    }
+                    auto mels = acousticPipeline.inferBatch(batchInputPtrs, batchSettings);
+                    costModel.addAcousticSample(batchFrames, batchSteps, std::chrono::duration<double>(
+                            std::chrono::steady_clock::now() - acousticStart).count());
+
+                    bool isFinalBatch = !isDraftPass && batchSettings.speedup == acousticSpeedup
+                                        && batchSettings.depth == shallowDiffusionDepth;
+                    for (size_t k = 0; k < batchIndices.size(); k++) {
+                        auto [i, m] = batchIndices[k];
+                        if (k >= mels.size() || mels[k] == Ort::Value(nullptr)) {
+                            std::cout << "!! ERROR: Acoustic Infer failed (segment " << i + 1 << ").\n";
+                            continue;
+                        }
+                        auto melFrames = mels[k].GetTensorTypeAndShapeInfo().GetShape()[1];
+                        pendingVocoderJobs.push_back({i, m, std::move(mels[k]), melFrames, std::move(batchInputs[k]),
+                                                      std::move(batchUnits[k]), isFinalBatch});
+                    }
+                    if (pendingVocoderJobs.size() >= vocoderBatchSize) {
+                        flushVocoderJobs();
+                        // Replace the drafted segments in the output as they are refined, every few seconds.
+                        constexpr auto refinedOutputInterval = std::chrono::seconds(2);
+                        if (!isDraftPass && hasDraft
+                            && std::chrono::steady_clock::now() - lastOutputWrite >= refinedOutputInterval) {
+                            writeOutputs();
+                        }
+                    }
+                    auto timeEnd = std::chrono::steady_clock::now();
+                    auto timeSpent = std::chrono::duration_cast<std::chrono::milliseconds>(timeEnd - timeStart).count();
+                    std::cout << ">> Time Elapsed: " << millisecondsToSecondsString(timeSpent) << " seconds\n";
+                    if (hasDeadline) {
+                        // Jobs of the batches done so far keep their settings.
+                        planDeadline((nextUnit + numMixes - 1) / numMixes);
+                    }
+                }
+                flushVocoderJobs();
+
+                if (isDraftPass) {
+                    std::cout << ">> Saving the draft...\n";
+                    writeOutputs();
+                    hasDraft = true;
+                }
+            }
+            costModel.save();
+
+            std::cout << "Inference finished.\n";
+            if (settings.deadline > 0) {
+                auto renderTime = std::chrono::duration_cast<std::chrono::milliseconds>(
+                        std::chrono::steady_clock::now() - renderStart).count();
+                std::cout << ">> Rendered in " << millisecondsToSecondsString(renderTime) << " seconds (deadline "
+                          << settings.deadline << " seconds)\n";
+            }
+            std::cout << ">> Concatenating and saving wave file...\n";
+            writeOutputs();
+        };
+
+        // Changes made while rendering are picked up by the next wait.
+        std::unique_ptr<FileWatcher> watcher;
+        if (settings.watch) {
+            watcher = std::make_unique<FileWatcher>(settings.dsFilePath);
+        }
+        renderProject();
+        while (watcher) {
+            if (settings.savePredictions) {
+                // Writing the predictions back is not a change to render.
+                watcher->acceptCurrentContent();
+            }
+            std::cout << "\nWatching the .ds file for changes (Ctrl+C to stop)...\n";
+            if (!watcher->waitForChange()) {
+                std::cout << "!! ERROR: Failed to watch the .ds file.\n";
+                break;
+            }
+            std::cout << "\n>> The .ds file changed, rendering again.\n";
+            renderProject();
+        }
+
+        // Allow system sleep
+        restorePowerState();
+    }
+
+    bool selectSegments(const RenderSettings &settings, std::vector<DsSegment> &dsProject,
+                        double &outputStart, double &outputEnd) {
+        outputStart = 0.0;
+        outputEnd = -1.0;
+        bool hasRange = settings.rangeEnd >= 0;
+        if (!hasRange && settings.segmentSelection.empty()) {
+            return true;
+        }
+
+        SegmentIntervalIndex index(dsProject);
+        std::vector<size_t> selected;
+        if (hasRange) {
+            selected = index.query(settings.rangeStart, settings.rangeEnd);
+        } else {
+            selected.resize(dsProject.size());
+            std::iota(selected.begin(), selected.end(), 0);
+        }
+        if (!settings.segmentSelection.empty()) {
+            const auto &ranges = settings.segmentSelection;
+            if (ranges.back().second >= dsProject.size()) {
+                std::cout << "!! ERROR: --segments: the project has only " << dsProject.size() << " segments.\n";
+                return false;
+            }
+            selected.erase(std::remove_if(selected.begin(), selected.end(), [&ranges](size_t i) {
+                // The first range not ending before the segment.
+                auto range = std::lower_bound(ranges.begin(), ranges.end(), i, [](const auto &r, size_t value) {
+                    return r.second < value;
+                });
+                return range == ranges.end() || range->first > i;
+            }), selected.end());
+        }
+        if (selected.empty()) {
+            std::cout << "!! ERROR: No segment in the selected range.\n";
+            return false;
+        }
+
+        if (hasRange) {
+            outputStart = settings.rangeStart;
+            outputEnd = settings.rangeEnd;
+        } else {
+            // The span of the selected segments.
+            outputStart = index.segmentStart(selected.front());
+            outputEnd = index.segmentEnd(selected.front());
+            for (auto i : selected) {
+                outputStart = std::min(outputStart, index.segmentStart(i));
+                outputEnd = std::max(outputEnd, index.segmentEnd(i));
+            }
+        }
+        std::cout << "Rendering " << selected.size() << " of " << dsProject.size() << " segments ("
+                  << outputStart << "s to " << outputEnd << "s)\n";
+
+        std::vector<DsSegment> selectedSegments;
+        selectedSegments.reserve(selected.size());
+        for (auto i : selected) {
+            selectedSegments.push_back(std::move(dsProject[i]));
+        }
+        dsProject = std::move(selectedSegments);
+        return true;
+    }
+
+    uint64_t jobStateKey(const RenderSettings &settings, const DsSegment &job, const std::string &spkMixStr,
+                         int speedup, int depth, uint64_t modelHash) {
+        Hasher hasher;
+        hasher.updateValue(modelHash);
+        for (const auto *path : {&settings.dsFilePath, &settings.dsConfigPath, &settings.bundlePath,
+                                 &settings.vocoderConfigPath}) {
+            hasher.updateValue(static_cast<uint64_t>(path->size()));
+            hasher.update(path->data(), path->size() * sizeof(TString::value_type));
+        }
+        hasher.update(spkMixStr);
+        hasher.updateValue(static_cast<int>(settings.sampler)).updateValue(speedup).updateValue(depth);
+        hasher.updateValue(static_cast<uint64_t>(job.index)).updateValue(job.offset);
+        return hasher.digest();
+    }
+
+    bool printRenderPlan(const RenderSettings &settings) {
+        DsConfig dsConfig;
+        DsVocoderConfig vocoderConfig;
+        bool hasVocoder = false;
+        if (!loadConfigs(settings, dsConfig, vocoderConfig, hasVocoder)) {
+            return false;
+        }
+        if (!hasVocoder) {
+            std::cout << "!! ERROR: --vocoder-config is required because no vocoder is packed in the bundle.\n";
+            return false;
+        }
+
+        auto speedup = settings.acousticSpeedup;
+        auto depth = settings.shallowDiffusionDepth;
+        if (!resolveDiffusionSettings(dsConfig, speedup, depth)) {
+            return false;
+        }
+        auto diffusionSteps = diffusionStepCount(dsConfig, speedup, depth);
+        int hopSize = vocoderConfig.hopSize;
+        double frameLength = 1.0 * hopSize / vocoderConfig.sampleRate;
+
+        auto dsProject = loadDsProject(settings.dsFilePath, settings.spkMixStr);
+        double outputStart = 0.0;
+        double outputEnd = -1.0;
+        if (!selectSegments(settings, dsProject, outputStart, outputEnd)) {
+            return false;
+        }
+        auto renderPlan = RenderPlan::fromSegments(dsProject, settings.renderPlanOptions);
+        std::vector<size_t> jobSegments(renderPlan.jobs.size(), 0);
+        for (const auto &clip : renderPlan.clips) {
+            ++jobSegments[clip.job];
+        }
+
+        CostModel costModel(costModelPath(settings));
+        std::vector<CostEstimate> costs;
+        std::vector<double> totalCosts;
+        for (const auto &job : renderPlan.jobs) {
+            costs.push_back(costModel.estimate(estimateJobFrames(settings, job, frameLength), diffusionSteps, hopSize));
+            totalCosts.push_back(costs.back().totalSeconds());
+        }
+
+        std::cout << "Render plan (" << renderPlan.jobs.size() << " jobs for " << dsProject.size()
+                  << " segments, " << diffusionSteps << " diffusion steps), in the order of rendering:\n";
+        std::cout << std::setw(6) << "job" << std::setw(10) << "segments" << std::setw(11) << "duration"
+                  << std::setw(9) << "frames" << std::setw(11) << "acoustic" << std::setw(10) << "vocoder"
+                  << std::setw(11) << "memory" << '\n';
+        std::cout << std::fixed;
+        CostEstimate total;
+        double peakMemory = 0.0;
+        for (auto i : scheduleLongestFirst(totalCosts)) {
+            const auto &job = renderPlan.jobs[i];
+            const auto &cost = costs[i];
+            auto frames = estimateJobFrames(settings, job, frameLength);
+            std::cout << std::setw(6) << i + 1 << std::setw(10) << jobSegments[i]
+                      << std::setw(10) << std::setprecision(2) << segmentDuration(job) << 's'
+                      << std::setw(9) << frames;
+            if (job.ph_dur.empty()) {
+                std::cout << "   (no ph_dur, needs --dur-config)\n";
+                continue;
+            }
+            std::cout << std::setw(10) << cost.acousticSeconds << 's'
+                      << std::setw(9) << cost.vocoderSeconds << 's'
+                      << std::setw(8) << std::setprecision(0) << cost.memoryBytes / (1024 * 1024) << " MB\n";
+            total.acousticSeconds += cost.acousticSeconds;
+            total.vocoderSeconds += cost.vocoderSeconds;
+            peakMemory = std::max(peakMemory, cost.memoryBytes);
+        }
+        std::cout << std::setprecision(1)
+                  << "Estimated total: " << total.totalSeconds() << " seconds (acoustic " << total.acousticSeconds
+                  << ", vocoder " << total.vocoderSeconds << "), peak memory per job "
+                  << std::setprecision(0) << peakMemory / (1024 * 1024) << " MB\n";
+        std::cout << std::defaultfloat;
+        if (costModel.numSamples() > 0) {
+            std::cout << "Costs calibrated from " << costModel.numSamples() << " timed model calls.\n";
+        } else {
+            std::cout << "Costs are not calibrated yet; they are measured on the first render.\n";
+        }
+        return true;
+    }
+
+    bool precompile(const RenderSettings &settings) {
+        if (settings.sessionConfig.cacheDirectory.empty()) {
+            std::cout << "!! ERROR: No cache directory. Please specify --cache-dir.\n";
+            return false;
+        }
+
+        DsConfig dsConfig;
+        DsVocoderConfig vocoderConfig;
+        bool hasVocoder = false;
+        if (!loadConfigs(settings, dsConfig, vocoderConfig, hasVocoder)) {
+            return false;
+        }
+
+        // The optimized model cache is only used with CPU execution provider.
+        std::cout << "Precompiling acoustic model...\n";
+        AcousticPipeline acousticPipeline(dsConfig);
+        if (!acousticPipeline.initSessions(ExecutionProvider::CPU, 0, settings.sessionConfig)) {
+            std::cout << "!! ERROR: Acoustic Session initialization failed.\n";
+            return false;
+        }
+
+        if (hasVocoder) {
+            std::cout << "Precompiling vocoder model...\n";
+            VocoderInference vocoderInference(vocoderConfig.model, vocoderConfig.modelData);
+            if (!vocoderInference.initSession(ExecutionProvider::CPU, 0, settings.sessionConfig)) {
+                std::cout << "!! ERROR: Vocoder Session initialization failed.\n";
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool predictDurations(const RenderSettings &settings, std::vector<DsSegment> &dsProject) {
+        bool ok = false;
+        auto durConfig = DsDurConfig::fromYAML(settings.durConfigPath, &ok);
+        if (!ok) {
+            std::cout << "!! ERROR: Could not load duration configuration.\n";
+            return false;
+        }
+
+        std::cout << "Initializing duration inference sessions...\n";
+        SessionConfig sessionConfig;
+        sessionConfig.cacheDirectory = settings.sessionConfig.cacheDirectory;
+        DurationPipeline durationPipeline(durConfig);
+        if (!durationPipeline.initSessions(settings.ep, settings.deviceIndex, sessionConfig)) {
+            return false;
+        }
+
+        std::cout << ">> Predicting missing phoneme durations...\n";
+        auto timeStart = std::chrono::steady_clock::now();
+        if (!durationPipeline.fillDurations(dsProject)) {
+            return false;
+        }
+        auto timeEnd = std::chrono::steady_clock::now();
+        auto timeSpent = std::chrono::duration_cast<std::chrono::milliseconds>(timeEnd - timeStart).count();
+        std::cout << ">> Time Elapsed: " << millisecondsToSecondsString(timeSpent) << " seconds\n";
+        return true;
+    }
+
+    bool predictVariances(const RenderSettings &settings,
+                          std::vector<DsSegment> &dsProject,
+                          bool needsEnergy,
+                          bool needsBreathiness) {
+        bool ok = false;
+        auto varianceConfig = DsVarianceConfig::fromYAML(settings.varianceConfigPath, &ok);
+        if (!ok) {
+            std::cout << "!! ERROR: Could not load variance configuration.\n";
+            return false;
+        }
+
+        std::cout << "Initializing variance inference sessions...\n";
+        SessionConfig sessionConfig;
+        sessionConfig.cacheDirectory = settings.sessionConfig.cacheDirectory;
+        VariancePipeline variancePipeline(varianceConfig);
+        if (!variancePipeline.initSessions(settings.ep, settings.deviceIndex, sessionConfig)) {
+            return false;
+        }
+
+        std::cout << ">> Predicting missing variance parameters...\n";
+        auto timeStart = std::chrono::steady_clock::now();
+
+        // Predicted pitch is memoized in the cache directory, so that re-renders of a draft do not run
+        // the pitch model again.
+        PredictionCache pitchCache(settings.sessionConfig.cacheDirectory.empty()
+                                   ? std::filesystem::path()
+                                   : settings.sessionConfig.cacheDirectory / "pitch");
+        if (!variancePipeline.fillPitch(dsProject, &pitchCache)) {
+            return false;
+        }
+        if ((needsEnergy || needsBreathiness)
+            && !variancePipeline.fillVariances(dsProject, needsEnergy, needsBreathiness)) {
+            return false;
+        }
+
+        auto timeEnd = std::chrono::steady_clock::now();
+        auto timeSpent = std::chrono::duration_cast<std::chrono::milliseconds>(timeEnd - timeStart).count();
+        std::cout << ">> Time Elapsed: " << millisecondsToSecondsString(timeSpent) << " seconds\n";
+        return true;
+    }
+
+    TString fanoutOutputPath(const TString &outputWavePath, const std::string &spkMixStr) {
+        // "name1:0.25|name2:0.75" -> "name1-0.25+name2-0.75", which is safe in file names.
+        std::string suffix;
+        for (char c : spkMixStr) {
+            switch (c) {
+                case '|':
+                    suffix += '+';
+                    break;
+                case ':':
+                    suffix += '-';
+                    break;
+                case '/':
+                case '\\':
+                case '*':
+                case '?':
+                case '"':
+                case '<':
+                case '>':
+                    suffix += '_';
+                    break;
+                default:
+                    suffix += c;
+            }
+        }
+        std::filesystem::path path(outputWavePath);
+        auto fileName = path.stem().native() + toTString("_" + suffix) + path.extension().native();
+        return (path.parent_path() / fileName).native();
+    }
+
+}  // namespace diffsinger
@@ -0,0 +1,25 @@
+#ifndef DS_ONNX_INFER_RENDER_H
+#define DS_ONNX_INFER_RENDER_H
+
+#include "RenderCommon.h"
+
+namespace diffsinger {
+
+    /**
+     * @brief Renders the project of the settings to the output wave file(s).
+     */
+    void run(const RenderSettings &settings);
+
+    /**
+     * @brief Builds the optimized CPU models of the voicebank into the cache directory ahead of the first render.
+     */
+    bool precompile(const RenderSettings &settings);
+
+    /**
+     * @brief Prints the jobs the project would be rendered as, without loading any model.
+     */
+    bool printRenderPlan(const RenderSettings &settings);
+
+}  // namespace diffsinger
+
+#endif //DS_ONNX_INFER_RENDER_H
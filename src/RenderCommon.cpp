@@ -0,0 +1,161 @@
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <sstream>
+
+#include <sndfile.hh>
+
+#include "RenderCommon.h"
+#include "FileUtil.h"
+#include "HashUtil.hpp"
+#include "SegmentUtil.h"
+#include "VoicebankBundle.h"
+
+namespace diffsinger {
+
+    bool loadConfigs(const RenderSettings &settings,
+                     DsConfig &dsConfig,
+                     DsVocoderConfig &vocoderConfig,
+                     bool &hasVocoder) {
+        VoicebankBundle bundle;
+        bool ok = false;
+        if (!settings.bundlePath.empty()) {
+            bundle = VoicebankBundle::open(settings.bundlePath, &ok);
+            if (!ok) {
+                std::cout << "!! ERROR: Could not open voicebank bundle.\n";
+                return false;
+            }
+            dsConfig = DsConfig::fromBundle(bundle, &ok);
+        } else {
+            dsConfig = DsConfig::fromYAML(settings.dsConfigPath, &ok);
+        }
+        if (!ok) {
+            std::cout << "!! ERROR: Could not load acoustic configuration.\n";
+            return false;
+        }
+
+        // An explicitly given vocoder config takes precedence over the vocoder in the bundle.
+        hasVocoder = false;
+        if (!settings.vocoderConfigPath.empty()) {
+            vocoderConfig = DsVocoderConfig::fromYAML(settings.vocoderConfigPath, &ok);
+            hasVocoder = ok;
+        } else if (bundle.isOpen() && bundle.hasSection(VoicebankBundle::VOCODER_MODEL)) {
+            vocoderConfig = DsVocoderConfig::fromBundle(bundle, &ok);
+            hasVocoder = ok;
+        }
+        if (!ok) {
+            std::cout << "!! ERROR: Could not load vocoder configuration.\n";
+            return false;
+        }
+        return true;
+    }
+
+    bool resolveDiffusionSettings(const DsConfig &dsConfig, int &speedup, int &depth) {
+        if (speedup < 1 || speedup > 1000) {
+            std::cout << "!! WARNING: speedup must be in range [1, 1000]. Falling back to 10.\n";
+            speedup = 10;
+        }
+
+        if (dsConfig.useShallowDiffusion) {
+            if (dsConfig.maxDepth < 0) {
+                std::cout << "!! ERROR: max_depth is unset or negative in acoustic configuration.\n";
+                return false;
+            }
+            if (depth > dsConfig.maxDepth) {
+                depth = dsConfig.maxDepth;
+            }
+            // make sure depth can be divided by speedup
+            depth = depth / speedup * speedup;
+        }
+        return true;
+    }
+
+    int diffusionStepCount(const DsConfig &dsConfig, int speedup, int depth) {
+        auto steps = dsConfig.useShallowDiffusion ? depth : dsConfig.timesteps;
+        return std::max(steps / std::max(speedup, 1), 1);
+    }
+
+    JobPrepareOptions jobPrepareOptions(const RenderSettings &settings) {
+        JobPrepareOptions options;
+        options.silencePhonemes = settings.silencePhonemes;
+        options.trimSilence = settings.trimSilence;
+        options.silenceMarginSeconds = settings.silenceMarginSeconds;
+        if (settings.padToBuckets) {
+            options.frameBuckets = settings.sessionConfig.warmupFrameBuckets;
+        }
+        return options;
+    }
+
+    int64_t estimateJobFrames(const RenderSettings &settings, const DsSegment &job, double frameLength) {
+        if (job.ph_dur.empty() || isSilentSegment(job, settings.silencePhonemes)) {
+            return 0;
+        }
+        return static_cast<int64_t>(std::ceil(segmentDuration(job) / frameLength));
+    }
+
+    bool writeWaveFile(const TString &path, const std::vector<float> &samples, int sampleRate) {
+        // Written to a temporary file first, so that a player never sees a half-written file.
+        bool isWriteOk = true;
+        bool isReplaced = writeFileAtomicallyByPath(path, [&](const std::filesystem::path &tempPath) {
+            SndfileHandle audioFile(tempPath.c_str(), SFM_WRITE, SF_FORMAT_WAV | SF_FORMAT_FLOAT, 1, sampleRate);
+            auto numFrames = static_cast<sf_count_t>(samples.size());
+            auto numWritten = audioFile.write(samples.data(), numFrames);
+            isWriteOk = (audioFile.error() == SF_ERR_NO_ERROR) && (numWritten != 0);
+            if (!isWriteOk) {
+                std::cout << "!! ERROR: audio write failed. Reason: " << audioFile.strError() << '\n';
+            }
+            return isWriteOk;
+        });
+        if (isWriteOk && !isReplaced) {
+            std::cout << "!! ERROR: audio write failed. Could not replace the output file.\n";
+        }
+        return isReplaced;
+    }
+
+    std::string modelDeviceKey(const RenderSettings &settings) {
+        const auto &acousticSource = settings.bundlePath.empty() ? settings.dsConfigPath : settings.bundlePath;
+        auto key = Hasher()
+                .update(std::filesystem::absolute(acousticSource).generic_u8string())
+                .update(settings.vocoderConfigPath.empty()
+                        ? std::string()
+                        : std::filesystem::absolute(settings.vocoderConfigPath).generic_u8string())
+                .updateValue(static_cast<int>(settings.ep))
+                .updateValue(settings.deviceIndex)
+                .digest();
+        return toHexString(key);
+    }
+
+    std::filesystem::path costModelPath(const RenderSettings &settings) {
+        if (settings.sessionConfig.cacheDirectory.empty()) {
+            return {};
+        }
+        // Costs depend on the models and where they run.
+        return settings.sessionConfig.cacheDirectory / "costs" / (modelDeviceKey(settings) + ".txt");
+    }
+
+    std::filesystem::path tuningProfilePath(const RenderSettings &settings) {
+        if (settings.sessionConfig.cacheDirectory.empty()) {
+            return {};
+        }
+        return settings.sessionConfig.cacheDirectory / "tuning" / (modelDeviceKey(settings) + ".yaml");
+    }
+
+    std::string millisecondsToSecondsString(long long milliseconds) {
+        auto integerPart = milliseconds / 1000;
+        auto decimalPart = milliseconds % 1000;
+        std::stringstream ss;
+        ss << integerPart << '.';
+        if (decimalPart < 100) {
+            ss << '0';
+        }
+        if (decimalPart < 10) {
+            ss << '0';
+        }
+        if (decimalPart == 0) {
+            ss << '0';
+        }
+        ss << decimalPart;
+        return ss.str();
+    }
+
+}  // namespace diffsinger
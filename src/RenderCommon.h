@@ -0,0 +1,131 @@
+#ifndef DS_ONNX_INFER_RENDERCOMMON_H
+#define DS_ONNX_INFER_RENDERCOMMON_H
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "TString.h"
+#include "DsConfig.h"
+#include "DsProject.h"
+#include "RenderPlan.h"
+#include "RenderJob.h"
+#include "Inference/Inference.h"
+#include "Inference/DiffusionSampler.h"
+
+namespace diffsinger {
+    struct RenderSettings {
+        TString dsFilePath;
+        TString dsConfigPath;
+        TString vocoderConfigPath;
+        TString durConfigPath;
+        TString varianceConfigPath;
+        TString bundlePath;
+        TString outputWavePath;
+        std::string spkMixStr;
+
+        // Render the project once per speaker mix, each into its own file. Overrides spkMixStr.
+        std::vector<std::string> spkMixFanout;
+        int acousticSpeedup = 10;
+        int shallowDiffusionDepth = 1000;
+        SamplerType sampler = SamplerType::PNDM;
+
+        // Maximum number of segments whose denoising steps run in one batch (split acoustic models only).
+        int acousticBatchSize = 4;
+
+        // Maximum number of segments vocoded in one call (vocoders with a dynamic batch axis only).
+        int vocoderBatchSize = 4;
+        ExecutionProvider ep = ExecutionProvider::CPU;
+        int deviceIndex = 0;
+        SessionConfig sessionConfig;
+
+        // Write the parameters predicted by the variance models back into the .ds file.
+        bool savePredictions = false;
+
+        // Pad the acoustic inputs of each segment to the warm-up frame buckets (sessionConfig.warmupFrameBuckets),
+        // so that every inference reuses the shapes the sessions are warmed up with.
+        bool padToBuckets = false;
+
+        // Segments made up of these phonemes only are rendered as silence without running the models.
+        std::vector<std::string> silencePhonemes{"SP"};
+
+        // Shorten silence phonemes at the edges of each segment to `silenceMarginSeconds` before inference.
+        bool trimSilence = true;
+        double silenceMarginSeconds = 0.2;
+
+        // Splitting of long segments and deduplication (see RenderPlan).
+        RenderPlanOptions renderPlanOptions;
+
+        // Only print the estimated cost of each job, without loading any model.
+        bool planOnly = false;
+
+        // Render only the segments overlapping [rangeStart, rangeEnd) (in seconds), and write only that range.
+        // No range if rangeEnd is negative.
+        double rangeStart = 0.0;
+        double rangeEnd = -1.0;
+
+        // Render only these ranges of segments (first and last indices in the .ds file, sorted and disjoint).
+        // Empty to render all segments.
+        std::vector<std::pair<size_t, size_t>> segmentSelection;
+
+        // Render again only the frames of each job that changed since the last render (see IncrementalRenderer),
+        // with this many seconds of context at each side.
+        bool incremental = false;
+        double incrementalContext = 0.5;
+
+        // Keep the sessions loaded after rendering, and render again whenever the .ds file changes.
+        bool watch = false;
+
+        // Progressive rendering: write a draft rendered with these diffusion settings first, then replace it
+        // with the final quality. Off if draftSpeedup is 0; draftDepth < 0 uses shallowDiffusionDepth.
+        int draftSpeedup = 0;
+        int draftDepth = -1;
+
+        // Seconds to render the project in, choosing faster diffusion settings for some segments as needed.
+        // 0 to always use acousticSpeedup and shallowDiffusionDepth.
+        double deadline = 0.0;
+
+        // Split the cores between the application's workers and one ORT thread pool shared by all sessions
+        // (see useGlobalThreadPool), instead of a thread pool per session.
+        bool sharedThreads = false;
+    };  // struct RenderSettings
+
+    bool loadConfigs(const RenderSettings &settings,
+                     DsConfig &dsConfig,
+                     DsVocoderConfig &vocoderConfig,
+                     bool &hasVocoder);
+
+    /**
+     * @brief Validates speedup and shallow diffusion depth against the acoustic configuration.
+     *
+     * @return false if the configuration cannot be used for shallow diffusion.
+     */
+    bool resolveDiffusionSettings(const DsConfig &dsConfig, int &speedup, int &depth);
+
+    int diffusionStepCount(const DsConfig &dsConfig, int speedup, int depth);
+
+    JobPrepareOptions jobPrepareOptions(const RenderSettings &settings);
+
+    int64_t estimateJobFrames(const RenderSettings &settings, const DsSegment &job, double frameLength);
+
+    bool writeWaveFile(const TString &path, const std::vector<float> &samples, int sampleRate);
+
+    /**
+     * @brief Hex key of the models and the device they run on, naming the files calibrated on this machine.
+     */
+    std::string modelDeviceKey(const RenderSettings &settings);
+
+    std::filesystem::path costModelPath(const RenderSettings &settings);
+
+    /**
+     * @brief Where the autotune subcommand saves its profile, which later runs load. Empty without a cache.
+     */
+    std::filesystem::path tuningProfilePath(const RenderSettings &settings);
+
+    std::string millisecondsToSecondsString(long long milliseconds);
+
+}  // namespace diffsinger
+
+#endif //DS_ONNX_INFER_RENDERCOMMON_H
@@ -0,0 +1,116 @@
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <numeric>
+
+#include "Mixer.h"
+#include "RenderJob.h"
+
+namespace diffsinger {
+
+    JobPreparer::JobPreparer(const DsConfig &dsConfig, JobPrepareOptions options, int sampleRate, int hopSize)
+            : m_dsConfig(dsConfig),
+              m_options(std::move(options)),
+              m_sampleRate(sampleRate),
+              m_hopSize(hopSize),
+              m_frameLength(1.0 * hopSize / sampleRate),
+              m_padToken(dsConfig.phonemeTable.find("SP")) {
+        if (m_padToken < 0) {
+            m_padToken = 0;
+        }
+        for (const auto &phoneme : m_options.silencePhonemes) {
+            auto token = dsConfig.phonemeTable.find(phoneme);
+            if (token >= 0) {
+                m_silenceTokens.push_back(token);
+            }
+        }
+        m_silenceMarginFrames = static_cast<int64_t>(std::ceil(m_options.silenceMarginSeconds / m_frameLength));
+    }
+
+    JobPreparer::Status JobPreparer::prepare(const DsSegment &job, PreparedJob &prepared) const {
+        if (job.ph_dur.empty()) {
+            std::cout << "!! ERROR: The segment has no ph_dur. Please specify --dur-config with a duration model.\n";
+            return Status::Failed;
+        }
+        if (isSilentSegment(job, m_options.silencePhonemes)) {
+            return Status::Silent;
+        }
+        if (job.f0.samples.empty()) {
+            std::cout << "!! ERROR: The segment has no f0. Please specify --variance-config with a pitch model.\n";
+            return Status::Failed;
+        }
+
+        prepared.pd = acousticPreprocess(m_dsConfig.phonemeTable, job, m_dsConfig, m_frameLength);
+        prepared.trim = SilenceTrim();
+        if (m_options.trimSilence) {
+            prepared.trim = trimSilentEdges(prepared.pd, m_silenceTokens, m_silenceMarginFrames);
+        }
+        prepared.numFrames = -1;
+        if (!m_options.frameBuckets.empty()) {
+            prepared.numFrames = padToFrameBucket(prepared.pd, m_options.frameBuckets, m_padToken);
+        }
+        return Status::Ready;
+    }
+
+    PreparedJob JobPreparer::withSpeakerMix(const PreparedJob &prepared, const DsSegment &job,
+                                            const SpeakerMixCurve &spkMix) const {
+        auto copy = prepared;
+        replaceSpeakerMix(copy.pd, job, spkMix, m_dsConfig, m_frameLength, copy.trim);
+        return copy;
+    }
+
+    JobWaveform JobPreparer::silentWaveform(const DsSegment &job) const {
+        auto duration = std::accumulate(job.ph_dur.begin(), job.ph_dur.end(), 0.0);
+        auto numSamples = static_cast<size_t>(std::ceil(duration * m_sampleRate));
+        return {0, std::vector<float>(numSamples, 0.0f)};
+    }
+
+    JobWaveform JobPreparer::finishWaveform(std::vector<float> waveform, const PreparedJob &prepared) const {
+        if (prepared.numFrames >= 0) {
+            // Drop the audio of padded frames.
+            auto numSamples = static_cast<size_t>(prepared.numFrames * m_hopSize);
+            if (waveform.size() > numSamples) {
+                waveform.resize(numSamples);
+            }
+        }
+        // Restore the trimmed trailing silence, so that the job keeps its length.
+        waveform.resize(waveform.size() + static_cast<size_t>(prepared.trim.trailingFrames * m_hopSize), 0.0f);
+
+        // The audio starts after the trimmed leading silence.
+        return {prepared.trim.leadingFrames * m_hopSize, std::move(waveform)};
+    }
+
+    std::vector<float> mixJobWaveforms(const RenderPlan &plan, const std::vector<JobWaveform> &jobWaveforms,
+                                       int sampleRate, double startTime) {
+        Mixer mixer;
+        auto startTimeInSamples = static_cast<int64_t>(std::round(startTime * sampleRate));
+        for (const auto &clip : plan.clips) {
+            const auto &[startInSamples, waveform] = jobWaveforms[clip.job];
+            auto offsetInSamples = static_cast<int64_t>(std::ceil(clip.offset * sampleRate)) - startTimeInSamples;
+            auto fadeInSamples = static_cast<int64_t>(std::round(clip.fadeIn * sampleRate));
+            auto fadeOutSamples = static_cast<int64_t>(std::round(clip.fadeOut * sampleRate));
+            if (clip.sourceLength >= 0) {
+                // Part of a coalesced job: cut out the samples of this segment.
+                auto sourceStart = static_cast<int64_t>(std::round(clip.sourceStart * sampleRate));
+                auto sourceLength = static_cast<int64_t>(std::round(clip.sourceLength * sampleRate));
+                std::vector<float> clipWaveform(sourceLength, 0.0f);
+                auto waveformSize = static_cast<int64_t>(waveform.size());
+                auto from = std::max(sourceStart, startInSamples);
+                auto to = std::min(sourceStart + sourceLength, startInSamples + waveformSize);
+                for (auto pos = from; pos < to; ++pos) {
+                    clipWaveform[pos - sourceStart] = waveform[pos - startInSamples];
+                }
+                mixer.add(clipWaveform, offsetInSamples, fadeInSamples, fadeOutSamples);
+            } else if (fadeInSamples > 0 && startInSamples > 0) {
+                // Fades are relative to the start of the clip, before the trimmed leading silence.
+                std::vector<float> paddedWaveform(startInSamples, 0.0f);
+                paddedWaveform.insert(paddedWaveform.end(), waveform.begin(), waveform.end());
+                mixer.add(paddedWaveform, offsetInSamples, fadeInSamples, fadeOutSamples);
+            } else {
+                mixer.add(waveform, offsetInSamples + startInSamples, fadeInSamples, fadeOutSamples);
+            }
+        }
+        return mixer.samples();
+    }
+
+}  // namespace diffsinger
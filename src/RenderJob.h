@@ -0,0 +1,92 @@
+#ifndef DS_ONNX_INFER_RENDERJOB_H
+#define DS_ONNX_INFER_RENDERJOB_H
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "DsConfig.h"
+#include "DsProject.h"
+#include "ModelData.h"
+#include "Preprocess.h"
+#include "RenderPlan.h"
+
+namespace diffsinger {
+
+    // Audio of a job: (start of the audio within the job in samples, samples).
+    using JobWaveform = std::pair<int64_t, std::vector<float>>;
+
+    struct JobPrepareOptions {
+        // Jobs made up of these phonemes only are rendered as silence without running the models.
+        std::vector<std::string> silencePhonemes{"SP"};
+
+        // Shorten silence phonemes at the edges of each job to `silenceMarginSeconds` before inference.
+        bool trimSilence = true;
+        double silenceMarginSeconds = 0.2;
+
+        // Pad the acoustic inputs to the smallest of these frame counts that fits them. Empty to disable.
+        std::vector<int64_t> frameBuckets;
+    };  // struct JobPrepareOptions
+
+
+    struct PreparedJob {
+        PreprocessedData pd;
+        SilenceTrim trim;
+        int64_t numFrames = -1;  // Frames before padding to a bucket, or -1 if not padded
+    };  // struct PreparedJob
+
+
+    /**
+     * @brief Turns render jobs into acoustic model inputs, and the vocoded audio back into job audio.
+     *
+     * The config must outlive the preparer.
+     */
+    class JobPreparer {
+    public:
+        enum class Status {
+            Ready,   // `prepared` is filled
+            Silent,  // Nothing to render, use `silentWaveform`
+            Failed   // The job lacks parameters; the reason is printed
+        };
+
+        JobPreparer(const DsConfig &dsConfig, JobPrepareOptions options, int sampleRate, int hopSize);
+
+        Status prepare(const DsSegment &job, PreparedJob &prepared) const;
+
+        /**
+         * @brief Copy of a prepared job with the speaker embeddings of another speaker mix.
+         */
+        PreparedJob withSpeakerMix(const PreparedJob &prepared, const DsSegment &job,
+                                   const SpeakerMixCurve &spkMix) const;
+
+        JobWaveform silentWaveform(const DsSegment &job) const;
+
+        /**
+         * @brief Drops the audio of padded frames, and restores the trimmed silence around the vocoded audio.
+         */
+        JobWaveform finishWaveform(std::vector<float> waveform, const PreparedJob &prepared) const;
+
+    private:
+        const DsConfig &m_dsConfig;
+        JobPrepareOptions m_options;
+        int m_sampleRate;
+        int m_hopSize;
+        double m_frameLength;
+        int64_t m_padToken;
+        std::vector<int64_t> m_silenceTokens;
+        int64_t m_silenceMarginFrames;
+    };  // class JobPreparer
+
+
+    /**
+     * @brief Places the audio of the jobs at the clips of the plan.
+     *
+     * The output starts at `startTime` (in seconds) of the timeline; audio before it is dropped.
+     */
+    std::vector<float> mixJobWaveforms(const RenderPlan &plan, const std::vector<JobWaveform> &jobWaveforms,
+                                       int sampleRate, double startTime = 0.0);
+
+}  // namespace diffsinger
+
+#endif //DS_ONNX_INFER_RENDERJOB_H
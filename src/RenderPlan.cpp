@@ -0,0 +1,169 @@
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+
+#include "HashUtil.hpp"
+#include "RenderPlan.h"
+#include "SegmentUtil.h"
+
+namespace diffsinger {
+
+    namespace {
+        void updateCurve(Hasher &hasher, const SampleCurve &curve) {
+            hasher.update(curve.samples).updateValue(curve.timestep);
+        }
+
+        bool isSameCurve(const SampleCurve &a, const SampleCurve &b) {
+            return a.samples == b.samples && a.timestep == b.timestep;
+        }
+
+        // Compares everything segmentContentHash hashes.
+        bool isSameContent(const DsSegment &a, const DsSegment &b) {
+            if (a.ph_seq != b.ph_seq || a.ph_dur != b.ph_dur || !isSameCurve(a.f0, b.f0)
+                || !isSameCurve(a.gender, b.gender) || !isSameCurve(a.velocity, b.velocity)
+                || !isSameCurve(a.energy, b.energy) || !isSameCurve(a.breathiness, b.breathiness)
+                || a.spk_mix.spk.size() != b.spk_mix.spk.size()) {
+                return false;
+            }
+            for (const auto &[speaker, curve] : a.spk_mix.spk) {
+                auto it = b.spk_mix.spk.find(speaker);
+                if (it == b.spk_mix.spk.end() || !isSameCurve(curve, it->second)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+    }
+
+    uint64_t segmentContentHash(const DsSegment &segment) {
+        Hasher hasher;
+        hasher.update(segment.ph_seq).update(segment.ph_dur);
+        updateCurve(hasher, segment.f0);
+        updateCurve(hasher, segment.gender);
+        updateCurve(hasher, segment.velocity);
+        updateCurve(hasher, segment.energy);
+        updateCurve(hasher, segment.breathiness);
+
+        // The speaker mix is unordered, so hash it by speaker name.
+        std::vector<std::string> speakers;
+        speakers.reserve(segment.spk_mix.size());
+        for (const auto &[speaker, curve] : segment.spk_mix.spk) {
+            speakers.push_back(speaker);
+        }
+        std::sort(speakers.begin(), speakers.end());
+        hasher.update(speakers);
+        for (const auto &speaker : speakers) {
+            updateCurve(hasher, segment.spk_mix.spk.at(speaker));
+        }
+        return hasher.digest();
+    }
+
+    RenderPlan RenderPlan::fromSegments(const std::vector<DsSegment> &segments, const RenderPlanOptions &options) {
+        RenderPlan plan;
+        plan.clips.reserve(segments.size());
+
+        // Jobs by content hash. A job is only reused if its content is the same, not just its hash.
+        std::unordered_multimap<uint64_t, size_t> jobIndices;
+        auto findOrAddJob = [&plan, &jobIndices](const DsSegment &segment) {
+            auto key = segmentContentHash(segment);
+            auto [first, last] = jobIndices.equal_range(key);
+            for (auto it = first; it != last; ++it) {
+                if (isSameContent(plan.jobs[it->second], segment)) {
+                    return it->second;
+                }
+            }
+            auto jobIndex = plan.jobs.size();
+            jobIndices.emplace(key, jobIndex);
+            plan.jobs.push_back(segment);
+            // The job is placed by its clips, so its own offset is unused.
+            plan.jobs.back().offset = 0.0;
+            return jobIndex;
+        };
+        auto addJob = [&plan, &findOrAddJob](const DsSegment &segment, double fadeIn, double fadeOut) {
+            plan.clips.push_back({findOrAddJob(segment), segment.offset, fadeIn, fadeOut});
+        };
+
+        // Runs of short segments that can be joined, in order of offset. Other segments are left as they are.
+        std::vector<const DsSegment *> remaining;
+        if (options.coalesceShorterThan > 0) {
+            std::vector<const DsSegment *> sorted;
+            sorted.reserve(segments.size());
+            for (const auto &segment : segments) {
+                sorted.push_back(&segment);
+            }
+            std::stable_sort(sorted.begin(), sorted.end(), [](const DsSegment *a, const DsSegment *b) {
+                return a->offset < b->offset;
+            });
+
+            auto isShort = [&options](const DsSegment &segment) {
+                return !segment.ph_dur.empty() && segmentDuration(segment) < options.coalesceShorterThan;
+            };
+            auto addRun = [&](const std::vector<const DsSegment *> &run) {
+                if (run.size() == 1) {
+                    remaining.push_back(run[0]);
+                    return;
+                }
+                auto jobIndex = findOrAddJob(concatenateSegments(run, options.gapPhoneme));
+                for (const auto *segment : run) {
+                    RenderClip clip;
+                    clip.job = jobIndex;
+                    clip.offset = segment->offset;
+                    clip.sourceStart = segment->offset - run[0]->offset;
+                    clip.sourceLength = segmentDuration(*segment);
+                    plan.clips.push_back(clip);
+                }
+            };
+
+            std::vector<const DsSegment *> run;
+            for (const auto *segment : sorted) {
+                if (!run.empty()) {
+                    const auto &last = *run.back();
+                    double gap = segment->offset - (last.offset + segmentDuration(last));
+                    double joinedLength = segment->offset + segmentDuration(*segment) - run[0]->offset;
+                    if (!isShort(*segment) || gap > options.coalesceMaxGap
+                        || joinedLength > options.coalesceMaxLength || !canConcatenateSegments(last, *segment)) {
+                        addRun(run);
+                        run.clear();
+                    }
+                }
+                if (isShort(*segment)) {
+                    run.push_back(segment);
+                } else {
+                    remaining.push_back(segment);
+                }
+            }
+            if (!run.empty()) {
+                addRun(run);
+            }
+        } else {
+            remaining.reserve(segments.size());
+            for (const auto &segment : segments) {
+                remaining.push_back(&segment);
+            }
+        }
+
+        auto context = std::max(options.splitContext, 0.0);
+        for (const auto *segmentPtr : remaining) {
+            const auto &segment = *segmentPtr;
+            auto splitPoints = findSplitPoints(segment, options.maxSegmentLength, context, options.restPhonemes);
+            if (splitPoints.empty()) {
+                addJob(segment, 0.0, 0.0);
+                continue;
+            }
+
+            // Each piece extends `context` past its split points, and overlaps its neighbours by twice that.
+            auto totalDuration = segmentDuration(segment);
+            for (size_t k = 0; k <= splitPoints.size(); ++k) {
+                bool isFirst = (k == 0);
+                bool isLast = (k == splitPoints.size());
+                double pieceStart = isFirst ? 0.0 : std::max(splitPoints[k - 1] - context, 0.0);
+                double pieceEnd = isLast ? totalDuration : std::min(splitPoints[k] + context, totalDuration);
+                addJob(sliceSegment(segment, pieceStart, pieceEnd),
+                       isFirst ? 0.0 : 2 * context,
+                       isLast ? 0.0 : 2 * context);
+            }
+        }
+        return plan;
+    }
+
+}  // namespace diffsinger
@@ -0,0 +1,73 @@
+#ifndef DS_ONNX_INFER_RENDERPLAN_H
+#define DS_ONNX_INFER_RENDERPLAN_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "DsProject.h"
+
+namespace diffsinger {
+
+    struct RenderClip {
+        size_t job = 0;        // Index of the job in RenderPlan::jobs whose audio is placed
+        double offset = 0.0;   // Start of the clip in the output, in seconds
+
+        // Linear fades at the edges of the clip, in seconds. Set where pieces of a split segment overlap.
+        double fadeIn = 0.0;
+        double fadeOut = 0.0;
+
+        // Part of the job audio placed, in seconds from the start of the job. A negative length means
+        // up to the end. Set for segments rendered as part of a coalesced job.
+        double sourceStart = 0.0;
+        double sourceLength = -1.0;
+    };  // struct RenderClip
+
+
+    struct RenderPlanOptions {
+        // Segments longer than this (in seconds) are split at rests and rendered in pieces. 0 to disable.
+        double maxSegmentLength = 0.0;
+
+        // Extra time rendered on each side of a split point. Adjacent pieces are crossfaded over twice this length.
+        double splitContext = 0.25;
+
+        // Phonemes whose middle is preferred as a split point.
+        std::vector<std::string> restPhonemes{"SP", "AP"};
+
+        // Adjacent segments shorter than this (in seconds) are joined and rendered as one job. 0 to disable.
+        double coalesceShorterThan = 0.0;
+
+        // Maximum gap between joined segments, and maximum length of a joined job, in seconds.
+        double coalesceMaxGap = 1.0;
+        double coalesceMaxLength = 15.0;
+
+        // Phoneme rendered in the gaps between joined segments.
+        std::string gapPhoneme = "SP";
+    };  // struct RenderPlanOptions
+
+
+    /**
+     * @brief The segments to render, and where their audio goes in the output.
+     *
+     * Segments with the same content (everything but the offset) are rendered once, and their audio is
+     * placed at every offset they occur at. Segments longer than the maximum length are split into
+     * overlapping pieces first, which are rendered as separate jobs and crossfaded back together.
+     *
+     * Runs of short adjacent segments can be joined into one job instead, so that models without a batch axis
+     * need fewer calls. The audio of the joined job is cut back at the segment boundaries.
+     */
+    struct RenderPlan {
+        std::vector<DsSegment> jobs;
+        std::vector<RenderClip> clips;
+
+        static RenderPlan fromSegments(const std::vector<DsSegment> &segments, const RenderPlanOptions &options = {});
+    };  // struct RenderPlan
+
+    /**
+     * @brief Hash of everything in the segment that determines its audio (all but the offset and index).
+     */
+    uint64_t segmentContentHash(const DsSegment &segment);
+
+}  // namespace diffsinger
+
+#endif //DS_ONNX_INFER_RENDERPLAN_H
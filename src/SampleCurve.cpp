@@ -42,6 +42,29 @@ namespace diffsinger {
         return targetSamples;
     }
 
+    SampleCurve SampleCurve::slice(double startTime, double endTime) const {
+        if (samples.empty() || timestep <= 0 || endTime <= startTime) {
+            return {};
+        }
+        if (samples.size() == 1) {
+            return *this;
+        }
+
+        auto numSamples = static_cast<int64_t>(std::ceil((endTime - startTime) / timestep)) + 1;
+        std::vector<double> targetTimeAxis(numSamples);
+        for (int64_t i = 0; i < numSamples; ++i) {
+            targetTimeAxis[i] = startTime + static_cast<double>(i) * timestep;
+        }
+
+        auto inputTimeAxis = arange(0.0, static_cast<double>(samples.size()), 1.0);
+        std::transform(inputTimeAxis.begin(), inputTimeAxis.end(), inputTimeAxis.begin(),
+                       [this](double value) { return value * timestep; });
+
+        return {interpolate(targetTimeAxis, inputTimeAxis, samples, InterpolateLinear,
+                            samples.front(), samples.back()),
+                timestep};
+    }
+
     SampleCurve::SampleCurve() : samples(), timestep(0.0) {}
 
     SampleCurve::SampleCurve(double fillValue, int64_t targetLength, double targetTimestep)
@@ -62,6 +85,15 @@ namespace diffsinger {
         return smc;
     }
 
+    SpeakerMixCurve SpeakerMixCurve::slice(double startTime, double endTime) const {
+        SpeakerMixCurve smc;
+        smc.spk.reserve(spk.size());
+        for (const auto &s : spk) {
+            smc.spk[s.first] = s.second.slice(startTime, endTime);
+        }
+        return smc;
+    }
+
     SpeakerMixCurve SpeakerMixCurve::fromStaticMix(const std::unordered_map<std::string, double> &spk,
                                                    int64_t targetLength, double targetTimestep) {
         SpeakerMixCurve smc;
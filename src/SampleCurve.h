@@ -28,6 +28,14 @@ namespace diffsinger {
          * smaller than target length, it will be truncated; otherwise, it will be expanded using the last value.
          */
         std::vector<double> resample(double targetTimestep, int64_t targetLength) const;
+
+        /**
+         * @brief Cuts the part of the curve between `startTime` and `endTime` (in seconds).
+         *
+         * The returned curve has the same time step and starts at `startTime`. Values between the
+         * original sample points are interpolated, and values outside the curve take the nearest end value.
+         */
+        SampleCurve slice(double startTime, double endTime) const;
     };
 
     // TODO: still figuring out the format of spk_mix
@@ -35,6 +43,7 @@ namespace diffsinger {
         std::unordered_map<std::string, SampleCurve> spk;
 
         SpeakerMixCurve resample(double targetTimestep, int64_t targetLength) const;
+        SpeakerMixCurve slice(double startTime, double endTime) const;
         static SpeakerMixCurve fromStaticMix(const std::unordered_map<std::string, double> &spk,
                                              int64_t targetLength = 1,
                                              double targetTimestep = 1.0);
@@ -0,0 +1,50 @@
+#include <algorithm>
+#include <numeric>
+
+#include "SegmentIndex.h"
+
+namespace diffsinger {
+
+    SegmentIntervalIndex::SegmentIntervalIndex(const std::vector<DsSegment> &segments) {
+        m_intervals.reserve(segments.size());
+        for (size_t i = 0; i < segments.size(); ++i) {
+            const auto &segment = segments[i];
+            const auto &durations = segment.ph_dur.empty() ? segment.note_dur : segment.ph_dur;
+            auto duration = std::accumulate(durations.begin(), durations.end(), 0.0);
+            m_intervals.push_back({segment.offset, segment.offset + duration, i});
+        }
+        std::stable_sort(m_intervals.begin(), m_intervals.end(),
+                         [](const Interval &a, const Interval &b) { return a.start < b.start; });
+
+        m_maxEnd.resize(m_intervals.size());
+        m_position.resize(m_intervals.size());
+        for (size_t k = 0; k < m_intervals.size(); ++k) {
+            m_maxEnd[k] = (k == 0) ? m_intervals[k].end : std::max(m_maxEnd[k - 1], m_intervals[k].end);
+            m_position[m_intervals[k].segment] = k;
+        }
+    }
+
+    std::vector<size_t> SegmentIntervalIndex::query(double startTime, double endTime) const {
+        // Intervals starting at or after `endTime` cannot overlap. Among the others, walk back from the latest
+        // start until no earlier interval reaches past `startTime`.
+        auto last = std::lower_bound(m_intervals.begin(), m_intervals.end(), endTime,
+                                     [](const Interval &interval, double time) { return interval.start < time; });
+        std::vector<size_t> result;
+        for (auto k = static_cast<size_t>(last - m_intervals.begin()); k > 0 && m_maxEnd[k - 1] > startTime; --k) {
+            if (m_intervals[k - 1].end > startTime) {
+                result.push_back(m_intervals[k - 1].segment);
+            }
+        }
+        std::sort(result.begin(), result.end());
+        return result;
+    }
+
+    double SegmentIntervalIndex::segmentStart(size_t segment) const {
+        return m_intervals[m_position[segment]].start;
+    }
+
+    double SegmentIntervalIndex::segmentEnd(size_t segment) const {
+        return m_intervals[m_position[segment]].end;
+    }
+
+}  // namespace diffsinger
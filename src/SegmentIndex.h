@@ -0,0 +1,42 @@
+#ifndef DS_ONNX_INFER_SEGMENTINDEX_H
+#define DS_ONNX_INFER_SEGMENTINDEX_H
+
+#include <cstddef>
+#include <vector>
+
+#include "DsProject.h"
+
+namespace diffsinger {
+
+    /**
+     * @brief Interval index over the time spans `[offset, offset + duration)` of the segments of a project.
+     *
+     * The duration is the sum of ph_dur, or of note_dur for segments whose phoneme durations are not known yet.
+     */
+    class SegmentIntervalIndex {
+    public:
+        explicit SegmentIntervalIndex(const std::vector<DsSegment> &segments);
+
+        /**
+         * @brief Indices of the segments overlapping `[startTime, endTime)` (in seconds), in ascending order.
+         */
+        std::vector<size_t> query(double startTime, double endTime) const;
+
+        double segmentStart(size_t segment) const;
+        double segmentEnd(size_t segment) const;
+
+    private:
+        struct Interval {
+            double start;
+            double end;
+            size_t segment;
+        };
+
+        std::vector<Interval> m_intervals;  // Sorted by start
+        std::vector<double> m_maxEnd;       // Latest end among m_intervals[0..i]
+        std::vector<size_t> m_position;     // Position of each segment in m_intervals
+    };  // class SegmentIntervalIndex
+
+}  // namespace diffsinger
+
+#endif //DS_ONNX_INFER_SEGMENTINDEX_H
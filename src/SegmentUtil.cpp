@@ -0,0 +1,241 @@
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+#include "SegmentUtil.h"
+
+namespace diffsinger {
+
+    namespace {
+        double curveValueAt(const SampleCurve &curve, double time) {
+            auto index = static_cast<int64_t>(std::round(time / curve.timestep));
+            index = std::clamp(index, static_cast<int64_t>(0), static_cast<int64_t>(curve.samples.size()) - 1);
+            return curve.samples[index];
+        }
+
+        // Linear interpolation, holding the end values outside the curve.
+        double interpolatedValueAt(const SampleCurve &curve, double time) {
+            auto position = time / curve.timestep;
+            if (position <= 0) {
+                return curve.samples.front();
+            }
+            auto index = static_cast<size_t>(position);
+            if (index + 1 >= curve.samples.size()) {
+                return curve.samples.back();
+            }
+            auto frac = position - static_cast<double>(index);
+            return curve.samples[index] * (1 - frac) + curve.samples[index + 1] * frac;
+        }
+
+        // Joins one curve of the segments. `starts` and `ends` are the times of the segments in the joined one.
+        SampleCurve concatenateCurves(const std::vector<const SampleCurve *> &curves,
+                                      const std::vector<double> &starts,
+                                      const std::vector<double> &ends,
+                                      double timestep) {
+            if (curves.empty() || curves[0]->samples.empty()) {
+                return {};
+            }
+            auto numSamples = static_cast<size_t>(std::ceil(ends.back() / timestep)) + 1;
+            std::vector<double> samples(numSamples);
+            size_t k = 0;
+            for (size_t i = 0; i < numSamples; ++i) {
+                double time = static_cast<double>(i) * timestep;
+                while (k + 1 < curves.size() && time >= starts[k + 1]) {
+                    ++k;
+                }
+                if (time <= ends[k] || k + 1 >= curves.size()) {
+                    samples[i] = interpolatedValueAt(*curves[k], time - starts[k]);
+                } else {
+                    // In the gap after segment k
+                    double from = curves[k]->samples.back();
+                    double to = curves[k + 1]->samples.front();
+                    double frac = (time - ends[k]) / (starts[k + 1] - ends[k]);
+                    samples[i] = from + (to - from) * frac;
+                }
+            }
+            return {std::move(samples), timestep};
+        }
+    }
+
+    double segmentDuration(const DsSegment &segment) {
+        return std::accumulate(segment.ph_dur.begin(), segment.ph_dur.end(), 0.0);
+    }
+
+    DsSegment sliceSegment(const DsSegment &segment, double startTime, double endTime) {
+        // Parts of phonemes shorter than this are rounding errors of the split times.
+        constexpr double minPhonemeDuration = 1e-6;
+
+        DsSegment out;
+        out.index = segment.index;
+        out.offset = segment.offset + startTime;
+
+        double phStart = 0.0;
+        for (size_t i = 0; i < segment.ph_seq.size() && i < segment.ph_dur.size(); ++i) {
+            double phEnd = phStart + segment.ph_dur[i];
+            double duration = std::min(phEnd, endTime) - std::max(phStart, startTime);
+            if (duration > minPhonemeDuration) {
+                out.ph_seq.push_back(segment.ph_seq[i]);
+                out.ph_dur.push_back(duration);
+            }
+            phStart = phEnd;
+        }
+
+        out.f0 = segment.f0.slice(startTime, endTime);
+        out.gender = segment.gender.slice(startTime, endTime);
+        out.velocity = segment.velocity.slice(startTime, endTime);
+        out.energy = segment.energy.slice(startTime, endTime);
+        out.breathiness = segment.breathiness.slice(startTime, endTime);
+        out.spk_mix = segment.spk_mix.slice(startTime, endTime);
+
+        out.isPhDurPredicted = segment.isPhDurPredicted;
+        out.isF0Predicted = segment.isF0Predicted;
+        out.isEnergyPredicted = segment.isEnergyPredicted;
+        out.isBreathinessPredicted = segment.isBreathinessPredicted;
+        return out;
+    }
+
+    bool canConcatenateSegments(const DsSegment &segment, const DsSegment &next) {
+        constexpr double tolerance = 1e-6;
+        if (next.offset + tolerance < segment.offset + segmentDuration(segment)) {
+            return false;
+        }
+        auto sameCurves = [](const SampleCurve &a, const SampleCurve &b) {
+            return a.samples.empty() == b.samples.empty();
+        };
+        if (segment.f0.samples.empty() || !sameCurves(segment.f0, next.f0)
+            || !sameCurves(segment.gender, next.gender)
+            || !sameCurves(segment.velocity, next.velocity)
+            || !sameCurves(segment.energy, next.energy)
+            || !sameCurves(segment.breathiness, next.breathiness)
+            || segment.spk_mix.size() != next.spk_mix.size()) {
+            return false;
+        }
+        for (const auto &[speaker, curve] : segment.spk_mix.spk) {
+            auto it = next.spk_mix.spk.find(speaker);
+            if (it == next.spk_mix.spk.end() || !sameCurves(curve, it->second)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    DsSegment concatenateSegments(const std::vector<const DsSegment *> &segments, const std::string &gapPhoneme) {
+        constexpr double minGap = 1e-6;
+
+        DsSegment out;
+        if (segments.empty()) {
+            return out;
+        }
+        const auto &first = *segments[0];
+        out.index = first.index;
+        out.offset = first.offset;
+
+        std::vector<double> starts;
+        std::vector<double> ends;
+        for (const auto *segment : segments) {
+            double start = segment->offset - first.offset;
+            if (!ends.empty() && start - ends.back() > minGap) {
+                out.ph_seq.push_back(gapPhoneme);
+                out.ph_dur.push_back(start - ends.back());
+            }
+            out.ph_seq.insert(out.ph_seq.end(), segment->ph_seq.begin(), segment->ph_seq.end());
+            out.ph_dur.insert(out.ph_dur.end(), segment->ph_dur.begin(), segment->ph_dur.end());
+            starts.push_back(start);
+            ends.push_back(start + segmentDuration(*segment));
+
+            out.isPhDurPredicted |= segment->isPhDurPredicted;
+            out.isF0Predicted |= segment->isF0Predicted;
+            out.isEnergyPredicted |= segment->isEnergyPredicted;
+            out.isBreathinessPredicted |= segment->isBreathinessPredicted;
+        }
+
+        double timestep = (first.f0.timestep > 0) ? first.f0.timestep : 0.005;
+        auto joinCurve = [&segments, &starts, &ends, timestep](SampleCurve DsSegment::*member) {
+            std::vector<const SampleCurve *> curves;
+            for (const auto *segment : segments) {
+                curves.push_back(&(segment->*member));
+            }
+            return concatenateCurves(curves, starts, ends, timestep);
+        };
+        out.f0 = joinCurve(&DsSegment::f0);
+        out.gender = joinCurve(&DsSegment::gender);
+        out.velocity = joinCurve(&DsSegment::velocity);
+        out.energy = joinCurve(&DsSegment::energy);
+        out.breathiness = joinCurve(&DsSegment::breathiness);
+
+        for (const auto &[speaker, curve] : first.spk_mix.spk) {
+            std::vector<const SampleCurve *> curves;
+            for (const auto *segment : segments) {
+                curves.push_back(&segment->spk_mix.spk.at(speaker));
+            }
+            out.spk_mix.spk[speaker] = concatenateCurves(curves, starts, ends, timestep);
+        }
+        return out;
+    }
+
+    std::vector<double> findSplitPoints(const DsSegment &segment,
+                                        double maxLength,
+                                        double margin,
+                                        const std::vector<std::string> &restPhonemes) {
+        std::vector<double> splitPoints;
+        auto totalDuration = segmentDuration(segment);
+        if (maxLength <= 0 || totalDuration <= maxLength) {
+            return splitPoints;
+        }
+
+        // Candidates: the middle of each rest phoneme, and each phoneme boundary.
+        std::vector<double> restCandidates;
+        std::vector<double> boundaryCandidates;
+        double phStart = 0.0;
+        for (size_t i = 0; i < segment.ph_seq.size() && i < segment.ph_dur.size(); ++i) {
+            if (i > 0) {
+                boundaryCandidates.push_back(phStart);
+            }
+            if (std::find(restPhonemes.begin(), restPhonemes.end(), segment.ph_seq[i]) != restPhonemes.end()) {
+                restCandidates.push_back(phStart + segment.ph_dur[i] / 2);
+            }
+            phStart += segment.ph_dur[i];
+        }
+        bool hasEnergy = !segment.energy.samples.empty() && segment.energy.timestep > 0;
+
+        // Pieces are kept at least half the maximum length, so that splitting does not produce tiny pieces.
+        double pieceStart = 0.0;
+        while (totalDuration - pieceStart > maxLength) {
+            double low = std::max(pieceStart + maxLength / 2, margin);
+            double high = std::min(pieceStart + maxLength, totalDuration - margin);
+            if (high <= low) {
+                break;
+            }
+            auto inWindow = [low, high](double time) { return time >= low && time <= high; };
+
+            double splitPoint = -1.0;
+            for (auto time : restCandidates) {
+                if (inWindow(time)) {
+                    splitPoint = time;  // The latest rest in the window
+                }
+            }
+            if (splitPoint < 0) {
+                double lowestEnergy = INFINITY;
+                for (auto time : boundaryCandidates) {
+                    if (!inWindow(time)) {
+                        continue;
+                    }
+                    double energy = hasEnergy ? curveValueAt(segment.energy, time) : 0.0;
+                    if (energy <= lowestEnergy) {
+                        lowestEnergy = energy;
+                        splitPoint = time;
+                    }
+                }
+            }
+            if (splitPoint < 0) {
+                // A single phoneme fills the whole window.
+                splitPoint = high;
+            }
+
+            splitPoints.push_back(splitPoint);
+            pieceStart = splitPoint;
+        }
+        return splitPoints;
+    }
+
+}  // namespace diffsinger
@@ -0,0 +1,56 @@
+#ifndef DS_ONNX_INFER_SEGMENTUTIL_H
+#define DS_ONNX_INFER_SEGMENTUTIL_H
+
+#include <string>
+#include <vector>
+
+#include "DsProject.h"
+
+namespace diffsinger {
+
+    /**
+     * @brief Total duration of the phonemes of the segment, in seconds.
+     */
+    double segmentDuration(const DsSegment &segment);
+
+    /**
+     * @brief Cuts the part of the segment between `startTime` and `endTime` (in seconds, relative to the segment).
+     *
+     * Phonemes crossing the edges are shortened, and the curves are cut along with them.
+     * The offset of the result is moved to `startTime`. Words and notes are dropped, since only the
+     * rendering parameters can be cut at arbitrary times.
+     */
+    DsSegment sliceSegment(const DsSegment &segment, double startTime, double endTime);
+
+    /**
+     * @brief Finds the times (relative to the segment) at which to split a segment longer than `maxLength`.
+     *
+     * The middle of rest phonemes is preferred. If a stretch longer than `maxLength` has no rest, it is split
+     * at the phoneme boundary with the lowest energy (or the latest boundary if there is no energy curve).
+     * No split point is closer than `margin` to the ends of the segment.
+     *
+     * @return The split times in ascending order. Empty if the segment does not need splitting.
+     */
+    /**
+     * @brief Whether `next` can be appended to `segment` by `concatenateSegments`.
+     *
+     * The segments must not overlap, and must have the same curves and speakers.
+     */
+    bool canConcatenateSegments(const DsSegment &segment, const DsSegment &next);
+
+    /**
+     * @brief Joins segments (in order of offset) into one segment at the offset of the first one.
+     *
+     * The gaps between the segments are filled with `gapPhoneme`, and the curves are resampled to the time step
+     * of the first f0 curve. Curve values in the gaps are interpolated between the neighbouring segments.
+     */
+    DsSegment concatenateSegments(const std::vector<const DsSegment *> &segments, const std::string &gapPhoneme);
+
+    std::vector<double> findSplitPoints(const DsSegment &segment,
+                                        double maxLength,
+                                        double margin,
+                                        const std::vector<std::string> &restPhonemes);
+
+}  // namespace diffsinger
+
+#endif //DS_ONNX_INFER_SEGMENTUTIL_H
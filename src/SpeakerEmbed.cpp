@@ -11,34 +11,51 @@ namespace diffsinger {
     }
 
     void SpeakerEmbed::loadSpeakers(const std::vector<std::string> &speakers, const diffsinger::TString &path) {
+        auto matrix = std::make_shared<std::vector<float>>(speakers.size() * SPK_EMBED_SIZE);
+        std::unordered_map<std::string, const float *> emb;
+        size_t row = 0;
         for (const auto &speaker : speakers) {
             auto fullPath = std::filesystem::path(path) / (speaker + ".emb");
-            if (!std::filesystem::exists(fullPath)) {
+            // Open first and query the size from the stream, saving two extra file system round trips per speaker.
+            std::ifstream inputFile(fullPath, std::ios::binary | std::ios::ate);
+            if (!inputFile.is_open()) {
                 // ERROR!
-                std::cout << "ERROR: emb file of speaker \"" << speaker << "\" does not exist!\n";
+                std::cout << "ERROR: emb file of speaker \"" << speaker << "\" does not exist or could not be opened!\n";
                 continue;
             }
-            auto size = std::filesystem::file_size(fullPath);
+            auto size = static_cast<std::streamoff>(inputFile.tellg());
             if (size != SPK_EMBED_SIZE * sizeof(float)) {
-                std::cout << "ERROR: emb file size of speaker \"" << speaker << "\" must be exactly " << SPK_EMBED_SIZE << " bytes!\n";
-                continue;
-            }
-            std::ifstream inputFile(fullPath, std::ios::binary);
-            if (!inputFile.is_open()) {
-                std::cout << "ERROR: emb file size of speaker \"" << speaker << "\" could not be opened!\n";
+                std::cout << "ERROR: emb file size of speaker \"" << speaker << "\" must be exactly " << SPK_EMBED_SIZE * sizeof(float) << " bytes!\n";
                 continue;
             }
-            SpeakerEmbedArray emb{};
-            inputFile.read(reinterpret_cast<char *>(emb.data()), emb.size() * sizeof(float));
-            m_emb[speaker] = emb;
-            SpeakerEmbedMap mmmm;
+            inputFile.seekg(0);
+            auto rowData = matrix->data() + row * SPK_EMBED_SIZE;
+            inputFile.read(reinterpret_cast<char *>(rowData), SPK_EMBED_SIZE * sizeof(float));
+            emb[speaker] = rowData;
+            ++row;
 
             inputFile.close();
         }
+        m_emb = std::move(emb);
+        m_matrix = std::move(matrix);
+    }
+
+    bool SpeakerEmbed::loadSpeakersFromMatrix(const std::vector<std::string> &speakers, const MappedBuffer &matrix) {
+        if (matrix.size != speakers.size() * SPK_EMBED_SIZE * sizeof(float)) {
+            return false;
+        }
+        auto rows = reinterpret_cast<const float *>(matrix.data);
+        std::unordered_map<std::string, const float *> emb;
+        for (size_t i = 0; i < speakers.size(); ++i) {
+            emb[speakers[i]] = rows + i * SPK_EMBED_SIZE;
+        }
+        m_emb = std::move(emb);
+        m_matrix = matrix.holder;
+        return true;
     }
 
-    const SpeakerEmbedMap &SpeakerEmbed::getEmb() {
-        return m_emb;
+    bool SpeakerEmbed::hasSpeaker(const std::string &speaker) const {
+        return m_emb.find(speaker) != m_emb.end();
     }
 
     SpeakerEmbedArray SpeakerEmbed::getMixedEmb(const std::unordered_map<std::string, double> &mix) const {
@@ -46,7 +63,7 @@ namespace diffsinger {
         for (const auto &item : mix) {
             auto it = m_emb.find(item.first);
             if (it != m_emb.end()) {
-                const auto currentArr = it->second;
+                const auto *currentArr = it->second;
                 for (size_t i = 0; i < SPK_EMBED_SIZE; i++) {
                     arr[i] += static_cast<float>(currentArr[i] * item.second);
                 }
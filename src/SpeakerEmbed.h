@@ -2,32 +2,43 @@
 #define DS_ONNX_INFER_SPEAKEREMBED_H
 
 #include <array>
+#include <memory>
 #include <vector>
 #include <string>
 #include <unordered_map>
 
 #include "TString.h"
+#include "MappedFile.h"
 
 namespace diffsinger {
 
     constexpr unsigned int SPK_EMBED_SIZE = 256;
     using SpeakerEmbedArray = std::array<float, SPK_EMBED_SIZE>;
-    using SpeakerEmbedMap = std::unordered_map<std::string, SpeakerEmbedArray>;
 
     class SpeakerEmbed {
     private:
-        SpeakerEmbedMap m_emb;
+        // Name -> row of the embedding matrix. Rows point into m_matrix, which is either owned
+        // (loaded from .emb files) or a view into a memory-mapped voicebank bundle.
+        std::unordered_map<std::string, const float *> m_emb;
+        std::shared_ptr<const void> m_matrix;
     public:
         SpeakerEmbed();
         SpeakerEmbed(const std::vector<std::string> &speakers, const TString &path);
 
         void loadSpeakers(const std::vector<std::string> &speakers, const TString &path);
+
+        /**
+         * @brief Uses a contiguous [speakers.size(), SPK_EMBED_SIZE] float matrix without copying it.
+         *
+         * @return false if the buffer size does not match the number of speakers.
+         */
+        bool loadSpeakersFromMatrix(const std::vector<std::string> &speakers, const MappedBuffer &matrix);
+
+        bool hasSpeaker(const std::string &speaker) const;
         SpeakerEmbedArray getMixedEmb(const std::unordered_map<std::string, double> &mix) const;
         SpeakerEmbedArray getMixedEmb(const std::string &inputString) const;
 
         static std::unordered_map<std::string, double> parseMixString(const std::string &inputString);
-
-        const SpeakerEmbedMap &getEmb();
     };
 }
 
@@ -14,4 +14,12 @@ namespace diffsinger {
         return buffer;
     }
 #endif
+
+    TString toTString(const std::string &str) {
+#ifdef _WIN32
+        return MBStringToWString(str, ::GetACP());
+#else
+        return str;
+#endif
+    }
 }
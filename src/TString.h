@@ -17,6 +17,11 @@ namespace diffsinger {
     using TString = std::string;
     using TChar = char;
 #endif
+
+    /**
+     * @brief Converts a string in the encoding of the command line (the ANSI code page on Windows).
+     */
+    TString toTString(const std::string &str);
 }
 
 #endif //DS_ONNX_INFER_TSTRING_H
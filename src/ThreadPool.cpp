@@ -0,0 +1,193 @@
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <iostream>
+
+#ifdef _WIN32
+#include <Windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "ThreadPool.h"
+
+namespace diffsinger {
+
+    ThreadPool::ThreadPool(size_t numThreads, bool pinThreads, size_t firstCore) {
+        if (numThreads == 0) {
+            numThreads = std::max(std::thread::hardware_concurrency(), 1u);
+        }
+        m_queues.reserve(numThreads);
+        for (size_t i = 0; i < numThreads; ++i) {
+            m_queues.push_back(std::make_unique<WorkerQueue>());
+        }
+        m_threads.reserve(numThreads);
+        for (size_t i = 0; i < numThreads; ++i) {
+            m_threads.emplace_back(&ThreadPool::workerLoop, this, i, pinThreads, firstCore + i);
+        }
+    }
+
+    ThreadPool::~ThreadPool() {
+        wait();
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = true;
+        }
+        m_taskAvailable.notify_all();
+        for (auto &thread : m_threads) {
+            thread.join();
+        }
+    }
+
+    void ThreadPool::submit(std::function<void()> task) {
+        size_t queue;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            queue = m_nextQueue;
+            m_nextQueue = (m_nextQueue + 1) % m_queues.size();
+            ++m_unfinishedTasks;
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_queues[queue]->mutex);
+            m_queues[queue]->tasks.push_back(std::move(task));
+        }
+        {
+            // Counted only once the task can be taken, so that a woken worker always finds it.
+            std::lock_guard<std::mutex> lock(m_mutex);
+            ++m_queuedTasks;
+        }
+        m_taskAvailable.notify_one();
+    }
+
+    void ThreadPool::wait() {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_allDone.wait(lock, [this] { return m_unfinishedTasks == 0; });
+    }
+
+    void ThreadPool::parallelFor(size_t count, const std::function<void(size_t)> &body) {
+        if (count == 0) {
+            return;
+        }
+        // Helpers that start after the work is taken return at once, so the state must outlive this call.
+        struct State {
+            std::atomic<size_t> next{0};
+            std::mutex mutex;
+            std::condition_variable allDone;
+            size_t numDone = 0;
+        };
+        auto state = std::make_shared<State>();
+        auto runItems = [state, count, &body]() {
+            size_t numRun = 0;
+            for (auto i = state->next++; i < count; i = state->next++) {
+                try {
+                    body(i);
+                }
+                catch (const std::exception &e) {
+                    std::cout << "ERROR: Task failed: " << e.what() << '\n';
+                }
+                ++numRun;
+            }
+            if (numRun == 0) {
+                return;
+            }
+            std::lock_guard<std::mutex> lock(state->mutex);
+            state->numDone += numRun;
+            if (state->numDone == count) {
+                state->allDone.notify_all();
+            }
+        };
+
+        // The helpers only touch `body` while items are left, which the wait below outlasts.
+        auto numHelpers = std::min(count, m_threads.size() + 1) - 1;
+        for (size_t k = 0; k < numHelpers; ++k) {
+            submit(runItems);
+        }
+        runItems();
+        std::unique_lock<std::mutex> lock(state->mutex);
+        state->allDone.wait(lock, [&state, count] { return state->numDone == count; });
+    }
+
+    size_t ThreadPool::size() const {
+        return m_threads.size();
+    }
+
+    bool ThreadPool::tryTakeTask(size_t worker, std::function<void()> &task) {
+        // Own queue from the front, keeping the submission order.
+        {
+            auto &own = *m_queues[worker];
+            std::lock_guard<std::mutex> lock(own.mutex);
+            if (!own.tasks.empty()) {
+                task = std::move(own.tasks.front());
+                own.tasks.pop_front();
+                return true;
+            }
+        }
+        // Other queues from the back, where their cheapest tasks are.
+        for (size_t offset = 1; offset < m_queues.size(); ++offset) {
+            auto &victim = *m_queues[(worker + offset) % m_queues.size()];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.tasks.empty()) {
+                task = std::move(victim.tasks.back());
+                victim.tasks.pop_back();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void ThreadPool::workerLoop(size_t worker, bool pinThread, size_t core) {
+        if (pinThread) {
+            pinCurrentThreadToCore(core);
+        }
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_taskAvailable.wait(lock, [this] { return m_stopping || m_queuedTasks > 0; });
+                if (m_queuedTasks == 0) {
+                    return;
+                }
+                // Reserve a task; one is guaranteed to be in some queue.
+                --m_queuedTasks;
+            }
+
+            std::function<void()> task;
+            while (!tryTakeTask(worker, task)) {
+                std::this_thread::yield();
+            }
+            try {
+                task();
+            }
+            catch (const std::exception &e) {
+                std::cout << "ERROR: Task failed: " << e.what() << '\n';
+            }
+
+            bool isAllDone;
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                isAllDone = (--m_unfinishedTasks == 0);
+            }
+            if (isAllDone) {
+                m_allDone.notify_all();
+            }
+        }
+    }
+
+    bool pinCurrentThreadToCore(size_t core) {
+        core %= std::max(std::thread::hardware_concurrency(), 1u);
+#ifdef _WIN32
+        if (core >= sizeof(DWORD_PTR) * 8) {
+            return false;
+        }
+        return SetThreadAffinityMask(GetCurrentThread(), static_cast<DWORD_PTR>(1) << core) != 0;
+#elif defined(__linux__)
+        cpu_set_t cpuSet;
+        CPU_ZERO(&cpuSet);
+        CPU_SET(core, &cpuSet);
+        return pthread_setaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet) == 0;
+#else
+        return false;
+#endif
+    }
+
+}  // namespace diffsinger
@@ -0,0 +1,85 @@
+#ifndef DS_ONNX_INFER_THREADPOOL_H
+#define DS_ONNX_INFER_THREADPOOL_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace diffsinger {
+
+    /**
+     * @brief Fixed set of worker threads with one task queue each.
+     *
+     * Tasks are spread over the queues round-robin. A worker runs the tasks of its own queue in order,
+     * and when it runs out, it steals from the back of the other queues, so no worker idles while
+     * tasks are left anywhere. Submitting tasks most expensive first makes the stolen ones the cheapest.
+     */
+    class ThreadPool {
+    public:
+        /**
+         * @param numThreads  Number of workers. 0 to use the number of hardware threads.
+         * @param pinThreads  Pin worker i to core `firstCore + i` (modulo the hardware threads).
+         */
+        explicit ThreadPool(size_t numThreads = 0, bool pinThreads = false, size_t firstCore = 0);
+
+        // Waits for the remaining tasks before joining the workers.
+        ~ThreadPool();
+
+        ThreadPool(const ThreadPool &) = delete;
+        ThreadPool &operator=(const ThreadPool &) = delete;
+
+        /**
+         * @brief Queues a task. Exceptions thrown by the task are printed and otherwise ignored.
+         */
+        void submit(std::function<void()> task);
+
+        /**
+         * @brief Blocks until all tasks submitted so far are finished.
+         */
+        void wait();
+
+        /**
+         * @brief Runs `body(0)` ... `body(count - 1)` on the workers and the calling thread, and blocks until
+         *        they are finished. Other tasks are not waited for, so it may be called from a task too.
+         */
+        void parallelFor(size_t count, const std::function<void(size_t)> &body);
+
+        size_t size() const;
+
+    private:
+        struct WorkerQueue {
+            std::mutex mutex;
+            std::deque<std::function<void()>> tasks;
+        };
+
+        std::vector<std::unique_ptr<WorkerQueue>> m_queues;
+        std::vector<std::thread> m_threads;
+
+        // Guards the counters below, and is used with the condition variables.
+        std::mutex m_mutex;
+        std::condition_variable m_taskAvailable;
+        std::condition_variable m_allDone;
+        size_t m_queuedTasks = 0;
+        size_t m_unfinishedTasks = 0;
+        size_t m_nextQueue = 0;
+        bool m_stopping = false;
+
+        bool tryTakeTask(size_t worker, std::function<void()> &task);
+
+        void workerLoop(size_t worker, bool pinThread, size_t core);
+    };  // class ThreadPool
+
+    /**
+     * @brief Restricts the calling thread to one core (modulo the hardware threads).
+     *
+     * @return false where thread affinity is not supported.
+     */
+    bool pinCurrentThreadToCore(size_t core);
+
+}  // namespace diffsinger
+
+#endif //DS_ONNX_INFER_THREADPOOL_H
@@ -0,0 +1,98 @@
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include <yaml-cpp/yaml.h>
+
+#include "FileUtil.h"
+#include "TuningProfile.h"
+
+namespace diffsinger {
+
+    namespace {
+        SessionTuning loadSessionTuning(const YAML::Node &node) {
+            SessionTuning tuning;
+            if (!node.IsMap()) {
+                return tuning;
+            }
+            if (node["intra_op_threads"]) {
+                tuning.intraOpThreads = std::max(node["intra_op_threads"].as<int>(), 0);
+            }
+            if (node["inter_op_threads"]) {
+                tuning.interOpThreads = std::max(node["inter_op_threads"].as<int>(), 0);
+            }
+            if (node["execution_mode"]) {
+                tuning.parallelExecution = (node["execution_mode"].as<std::string>() == "parallel");
+            }
+            return tuning;
+        }
+
+        void emitSessionTuning(YAML::Emitter &out, const char *name, const SessionTuning &tuning) {
+            out << YAML::Key << name << YAML::Value << YAML::BeginMap;
+            out << YAML::Key << "intra_op_threads" << YAML::Value << tuning.intraOpThreads;
+            out << YAML::Key << "inter_op_threads" << YAML::Value << tuning.interOpThreads;
+            out << YAML::Key << "execution_mode" << YAML::Value
+                << (tuning.parallelExecution ? "parallel" : "sequential");
+            out << YAML::EndMap;
+        }
+    }  // namespace
+
+    TuningProfile loadTuningProfile(const std::filesystem::path &path, bool *ok) {
+        if (ok) {
+            *ok = false;
+        }
+        std::ifstream file(path);
+        if (!file.is_open()) {
+            return {};
+        }
+
+        TuningProfile profile;
+        try {
+            auto node = YAML::Load(file);
+            profile.acoustic = loadSessionTuning(node["acoustic"]);
+            profile.vocoder = loadSessionTuning(node["vocoder"]);
+            if (const auto &batch = node["batch"]; batch.IsMap()) {
+                if (batch["workers"]) {
+                    profile.batchWorkers = std::max(batch["workers"].as<int>(), 0);
+                }
+                if (batch["intra_op_threads"]) {
+                    profile.batchIntraOpThreads = std::max(batch["intra_op_threads"].as<int>(), 0);
+                }
+            }
+        } catch (const YAML::Exception &e) {
+            std::cout << "ERROR: Failed to read the tuning profile: " << e.what() << '\n';
+            return {};
+        }
+
+        if (ok) {
+            *ok = true;
+        }
+        return profile;
+    }
+
+    bool saveTuningProfile(const std::filesystem::path &path, const TuningProfile &profile) {
+        YAML::Emitter out;
+        out << YAML::BeginMap;
+        emitSessionTuning(out, "acoustic", profile.acoustic);
+        emitSessionTuning(out, "vocoder", profile.vocoder);
+        out << YAML::Key << "batch" << YAML::Value << YAML::BeginMap;
+        out << YAML::Key << "workers" << YAML::Value << profile.batchWorkers;
+        out << YAML::Key << "intra_op_threads" << YAML::Value << profile.batchIntraOpThreads;
+        out << YAML::EndMap;
+        out << YAML::EndMap;
+
+        return writeFileAtomically(path, [&out](std::ostream &file) {
+            file << out.c_str() << '\n';
+            return true;
+        });
+    }
+
+    SessionConfig tunedSessionConfig(SessionConfig config, const SessionTuning &tuning) {
+        config.intraOpThreads = tuning.intraOpThreads;
+        config.interOpThreads = tuning.interOpThreads;
+        config.parallelExecution = tuning.parallelExecution;
+        return config;
+    }
+
+}  // namespace diffsinger
@@ -0,0 +1,44 @@
+#ifndef DS_ONNX_INFER_TUNINGPROFILE_H
+#define DS_ONNX_INFER_TUNINGPROFILE_H
+
+#include <filesystem>
+
+#include "Inference/Inference.h"
+
+namespace diffsinger {
+
+    struct SessionTuning {
+        int intraOpThreads = 0;
+        int interOpThreads = 0;
+        bool parallelExecution = false;
+    };  // struct SessionTuning
+
+
+    /**
+     * @brief Session options and worker counts found fastest on this machine by the autotune subcommand.
+     */
+    struct TuningProfile {
+        // Sessions of a single render.
+        SessionTuning acoustic;
+        SessionTuning vocoder;
+
+        // Batch renders: worker threads, and the threads of each session shared by them.
+        int batchWorkers = 0;
+        int batchIntraOpThreads = 0;
+    };  // struct TuningProfile
+
+    /**
+     * @brief Reads a profile written by `saveTuningProfile`. A missing file leaves `ok` false silently.
+     */
+    TuningProfile loadTuningProfile(const std::filesystem::path &path, bool *ok = nullptr);
+
+    bool saveTuningProfile(const std::filesystem::path &path, const TuningProfile &profile);
+
+    /**
+     * @brief Copy of the session config with the threads and execution mode of the tuning.
+     */
+    SessionConfig tunedSessionConfig(SessionConfig config, const SessionTuning &tuning);
+
+}  // namespace diffsinger
+
+#endif //DS_ONNX_INFER_TUNINGPROFILE_H
@@ -0,0 +1,315 @@
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <numeric>
+
+#include "HashUtil.hpp"
+#include "Preprocess.h"
+#include "VariancePipeline.h"
+
+namespace diffsinger {
+
+    namespace {
+        std::vector<double> midiToHz(const std::vector<float> &midi) {
+            std::vector<double> hz;
+            hz.reserve(midi.size());
+            for (auto m : midi) {
+                hz.push_back(440.0 * std::pow(2.0, (m - 69.0) / 12.0));
+            }
+            return hz;
+        }
+    }
+
+    VariancePipeline::VariancePipeline(const DsVarianceConfig &config)
+            : m_config(config),
+              m_frameLength(1.0 * config.hopSize / config.sampleRate),
+              m_linguisticInference(config.linguistic),
+              m_varianceInference(config.variance),
+              m_pitchInference(config.pitch) {}
+
+    bool VariancePipeline::initSessions(ExecutionProvider ep, int deviceIndex, const SessionConfig &sessionConfig) {
+        if (!m_linguisticInference.initSession(ep, deviceIndex, sessionConfig)) {
+            std::cout << "ERROR: Linguistic encoder session initialization failed.\n";
+            return false;
+        }
+        if (!m_varianceInference.initSession(ep, deviceIndex, sessionConfig)) {
+            std::cout << "ERROR: Variance session initialization failed.\n";
+            return false;
+        }
+        if (hasPitchModel() && !m_pitchInference.initSession(ep, deviceIndex, sessionConfig)) {
+            std::cout << "ERROR: Pitch session initialization failed.\n";
+            return false;
+        }
+        return true;
+    }
+
+    void VariancePipeline::endSessions() {
+        m_linguisticInference.endSession();
+        m_varianceInference.endSession();
+        m_pitchInference.endSession();
+        m_encoderCache.clear();
+    }
+
+    double VariancePipeline::getFrameLength() const {
+        return m_frameLength;
+    }
+
+    bool VariancePipeline::hasPitchModel() const {
+        return !m_config.pitch.empty();
+    }
+
+    uint64_t VariancePipeline::encoderCacheKey(const LinguisticInput &input) const {
+        Hasher hasher;
+        hasher.update(input.tokens);
+        if (m_linguisticInference.usesPhonemeDurations()) {
+            hasher.update(input.ph_dur);
+        } else {
+            hasher.update(input.word_div).update(input.word_dur);
+        }
+        return hasher.digest();
+    }
+
+    uint64_t VariancePipeline::pitchCacheKey(const LinguisticInput &linguisticInput,
+                                             const PitchInput &pitchInput,
+                                             const VarianceInferenceSettings &inferSettings) const {
+        return Hasher()
+                .updateValue(m_linguisticInference.getModelHash())
+                .updateValue(m_pitchInference.getModelHash())
+                .updateValue(encoderCacheKey(linguisticInput))
+                .update(pitchInput.ph_dur)
+                .update(pitchInput.note_midi)
+                .update(pitchInput.note_rest)
+                .update(pitchInput.note_dur)
+                .update(pitchInput.spk_embed)
+                .updateValue(inferSettings.speedup)
+                .updateValue(inferSettings.steps)
+                .digest();
+    }
+
+    std::vector<std::shared_ptr<const LinguisticEncodedData>> VariancePipeline::encode(
+            const std::vector<LinguisticInput> &inputs) {
+        std::vector<std::shared_ptr<const LinguisticEncodedData>> out(inputs.size());
+
+        std::vector<uint64_t> keys;
+        keys.reserve(inputs.size());
+        std::vector<const LinguisticInput *> missingInputs;
+        std::vector<uint64_t> missingKeys;
+        for (const auto &input : inputs) {
+            auto key = encoderCacheKey(input);
+            keys.push_back(key);
+            if (m_encoderCache.find(key) == m_encoderCache.end()
+                && std::find(missingKeys.begin(), missingKeys.end(), key) == missingKeys.end()) {
+                missingInputs.push_back(&input);
+                missingKeys.push_back(key);
+            }
+        }
+
+        if (!missingInputs.empty()) {
+            std::vector<LinguisticEncodedData> encoded;
+            try {
+                encoded = m_linguisticInference.inferBatch(missingInputs);
+            }
+            catch (const Ort::Exception &ortException) {
+                std::cout << "ERROR: Linguistic encoder failed: " << ortException.what() << '\n';
+                return {};
+            }
+            if (encoded.size() != missingInputs.size()) {
+                return {};
+            }
+            for (size_t i = 0; i < encoded.size(); ++i) {
+                m_encoderCache[missingKeys[i]] = std::make_shared<const LinguisticEncodedData>(std::move(encoded[i]));
+            }
+        }
+
+        for (size_t i = 0; i < inputs.size(); ++i) {
+            out[i] = m_encoderCache[keys[i]];
+        }
+        return out;
+    }
+
+    bool VariancePipeline::fillPitch(std::vector<DsSegment> &segments,
+                                     PredictionCache *cache,
+                                     const VarianceInferenceSettings &inferSettings) {
+        std::vector<size_t> indices;
+        for (size_t i = 0; i < segments.size(); ++i) {
+            if (segments[i].f0.samples.empty()) {
+                indices.push_back(i);
+            }
+        }
+        if (indices.empty()) {
+            return true;
+        }
+
+        if (!hasPitchModel()) {
+            std::cout << "ERROR: Some segments have no f0, but no pitch model is given.\n";
+            return false;
+        }
+        for (auto i : indices) {
+            if (segments[i].note_seq.empty() || segments[i].note_seq.size() != segments[i].note_dur.size()) {
+                std::cout << "ERROR: Segment at index " << segments[i].index
+                          << " has no f0, and no valid notes (note_seq, note_dur) to predict it from.\n";
+                return false;
+            }
+        }
+
+        // Look up the cache first, so that only the remaining segments are encoded and predicted.
+        std::vector<size_t> missingIndices;
+        std::vector<LinguisticInput> linguisticInputs(segments.size());
+        std::vector<PitchInput> pitchInputs(segments.size());
+        std::vector<uint64_t> keys(segments.size());
+        for (auto i : indices) {
+            linguisticInputs[i] = linguisticPreprocess(m_config.phonemeTable, segments[i], m_frameLength);
+            pitchInputs[i] = pitchPreprocess(segments[i], m_config, m_frameLength);
+            if (m_pitchInference.requiresSpeakerEmbed() && pitchInputs[i].spk_embed.empty()) {
+                std::cout << "ERROR: The pitch model requires a speaker, "
+                             "but no speakers are listed in the variance configuration.\n";
+                return false;
+            }
+            keys[i] = pitchCacheKey(linguisticInputs[i], pitchInputs[i], inferSettings);
+
+            std::vector<float> pitch;
+            if (cache && cache->find(keys[i], pitch)) {
+                segments[i].f0 = SampleCurve(midiToHz(pitch), m_frameLength);
+                segments[i].isF0Predicted = true;
+            } else {
+                missingIndices.push_back(i);
+            }
+        }
+        if (missingIndices.size() < indices.size()) {
+            std::cout << "Reused cached pitch of " << indices.size() - missingIndices.size() << " segment(s).\n";
+        }
+
+        for (const auto &batch : makeBatches(missingIndices, segments)) {
+            std::vector<LinguisticInput> batchLinguisticInputs;
+            batchLinguisticInputs.reserve(batch.size());
+            for (auto i : batch) {
+                batchLinguisticInputs.push_back(linguisticInputs[i]);
+            }
+            auto encoded = encode(batchLinguisticInputs);
+            if (encoded.size() != batch.size()) {
+                std::cout << "ERROR: Linguistic encoding failed.\n";
+                return false;
+            }
+
+            std::vector<const PitchInput *> pitchInputPtrs;
+            for (size_t k = 0; k < batch.size(); ++k) {
+                pitchInputs[batch[k]].encoded = encoded[k];
+                pitchInputPtrs.push_back(&pitchInputs[batch[k]]);
+            }
+
+            auto outputs = m_pitchInference.inferBatch(pitchInputPtrs, inferSettings);
+            if (outputs.size() != batch.size()) {
+                std::cout << "ERROR: Pitch inference failed.\n";
+                return false;
+            }
+
+            for (size_t k = 0; k < batch.size(); ++k) {
+                auto i = batch[k];
+                if (cache) {
+                    cache->insert(keys[i], outputs[k]);
+                }
+                segments[i].f0 = SampleCurve(midiToHz(outputs[k]), m_frameLength);
+                segments[i].isF0Predicted = true;
+            }
+        }
+        return true;
+    }
+
+    bool VariancePipeline::fillVariances(std::vector<DsSegment> &segments,
+                                         bool needsEnergy,
+                                         bool needsBreathiness,
+                                         const VarianceInferenceSettings &inferSettings) {
+        std::vector<size_t> indices;
+        for (size_t i = 0; i < segments.size(); ++i) {
+            if ((needsEnergy && segments[i].energy.samples.empty())
+                || (needsBreathiness && segments[i].breathiness.samples.empty())) {
+                indices.push_back(i);
+            }
+        }
+        if (indices.empty()) {
+            return true;
+        }
+
+        if (needsEnergy && !m_varianceInference.predictsEnergy()) {
+            std::cout << "ERROR: Energy is required, but the variance model does not predict it.\n";
+            return false;
+        }
+        if (needsBreathiness && !m_varianceInference.predictsBreathiness()) {
+            std::cout << "ERROR: Breathiness is required, but the variance model does not predict it.\n";
+            return false;
+        }
+
+        for (const auto &batch : makeBatches(indices, segments)) {
+            std::vector<LinguisticInput> linguisticInputs;
+            linguisticInputs.reserve(batch.size());
+            for (auto i : batch) {
+                linguisticInputs.push_back(linguisticPreprocess(m_config.phonemeTable, segments[i], m_frameLength));
+            }
+            auto encoded = encode(linguisticInputs);
+            if (encoded.size() != batch.size()) {
+                std::cout << "ERROR: Linguistic encoding failed.\n";
+                return false;
+            }
+
+            std::vector<VarianceInput> varianceInputs;
+            std::vector<const VarianceInput *> varianceInputPtrs;
+            varianceInputs.reserve(batch.size());
+            for (size_t k = 0; k < batch.size(); ++k) {
+                auto vi = variancePreprocess(segments[batch[k]], m_config, m_frameLength);
+                vi.encoded = encoded[k];
+                if (m_varianceInference.requiresSpeakerEmbed() && vi.spk_embed.empty()) {
+                    std::cout << "ERROR: The variance model requires a speaker, "
+                                 "but no speakers are listed in the variance configuration.\n";
+                    return false;
+                }
+                varianceInputs.push_back(std::move(vi));
+            }
+            for (const auto &vi : varianceInputs) {
+                varianceInputPtrs.push_back(&vi);
+            }
+
+            auto outputs = m_varianceInference.inferBatch(varianceInputPtrs, inferSettings);
+            if (outputs.size() != batch.size()) {
+                std::cout << "ERROR: Variance inference failed.\n";
+                return false;
+            }
+
+            for (size_t k = 0; k < batch.size(); ++k) {
+                auto &segment = segments[batch[k]];
+                auto &output = outputs[k];
+                if (needsEnergy && segment.energy.samples.empty()) {
+                    segment.energy = SampleCurve(std::vector<double>(output.energy.begin(), output.energy.end()),
+                                                 m_frameLength);
+                    segment.isEnergyPredicted = true;
+                }
+                if (needsBreathiness && segment.breathiness.samples.empty()) {
+                    segment.breathiness = SampleCurve(
+                            std::vector<double>(output.breathiness.begin(), output.breathiness.end()),
+                            m_frameLength);
+                    segment.isBreathinessPredicted = true;
+                }
+            }
+        }
+        return true;
+    }
+
+    std::vector<std::vector<size_t>> VariancePipeline::makeBatches(std::vector<size_t> indices,
+                                                                   const std::vector<DsSegment> &segments) {
+        // Sorting by duration keeps the padding within each batch small.
+        auto segmentDuration = [&segments](size_t i) {
+            const auto &phDur = segments[i].ph_dur;
+            return std::accumulate(phDur.begin(), phDur.end(), 0.0);
+        };
+        std::stable_sort(indices.begin(), indices.end(), [&segmentDuration](size_t a, size_t b) {
+            return segmentDuration(a) < segmentDuration(b);
+        });
+
+        std::vector<std::vector<size_t>> batches;
+        for (size_t i = 0; i < indices.size(); i += maxBatchSize) {
+            auto end = std::min(indices.size(), i + maxBatchSize);
+            batches.emplace_back(indices.begin() + i, indices.begin() + end);
+        }
+        return batches;
+    }
+
+}  // namespace diffsinger
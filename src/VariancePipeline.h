@@ -0,0 +1,100 @@
+#ifndef DS_ONNX_INFER_VARIANCEPIPELINE_H
+#define DS_ONNX_INFER_VARIANCEPIPELINE_H
+
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "DsConfig.h"
+#include "DsProject.h"
+#include "ModelData.h"
+#include "Inference/LinguisticInference.h"
+#include "Inference/PitchInference.h"
+#include "Inference/VarianceInference.h"
+#include "PredictionCache.h"
+
+namespace diffsinger {
+
+    /**
+     * @brief Predicts the parameters missing from the segments with the variance models of a voicebank.
+     *
+     * All models of the variance voicebank take the output of the same linguistic encoder. Encodings are
+     * cached by their input, so the encoder runs only once per segment no matter how many models use it.
+     * Segments are run in batches of similar lengths.
+     *
+     * The config must outlive the pipeline.
+     */
+    class VariancePipeline {
+    public:
+        explicit VariancePipeline(const DsVarianceConfig &config);
+
+        bool initSessions(ExecutionProvider ep = ExecutionProvider::CPU, int deviceIndex = 0,
+                          const SessionConfig &sessionConfig = {});
+
+        void endSessions();
+
+        /**
+         * @brief Encodes the inputs, running the linguistic encoder only for inputs not encoded before.
+         *
+         * @return The encodings in the order of `inputs`. Empty if the encoder failed.
+         */
+        std::vector<std::shared_ptr<const LinguisticEncodedData>> encode(const std::vector<LinguisticInput> &inputs);
+
+        /**
+         * @brief Whether the config has a pitch model (which is only loaded then).
+         */
+        bool hasPitchModel() const;
+
+        /**
+         * @brief Predicts f0 from the notes for the segments that do not have it.
+         *
+         * Predictions are looked up in `cache` first (if not null), keyed by the hash of the pitch model
+         * and all its inputs, so that repeated phrases and re-renders do not run the pitch model again.
+         *
+         * @return false if there is no pitch model, a segment lacks notes, or the inference failed.
+         */
+        bool fillPitch(std::vector<DsSegment> &segments,
+                       PredictionCache *cache = nullptr,
+                       const VarianceInferenceSettings &inferSettings = {});
+
+        /**
+         * @brief Predicts energy and/or breathiness for the segments that do not have them.
+         *
+         * Curves already present in a segment are kept.
+         *
+         * @return false if the variance model cannot predict a required curve, or the inference failed.
+         */
+        bool fillVariances(std::vector<DsSegment> &segments,
+                           bool needsEnergy,
+                           bool needsBreathiness,
+                           const VarianceInferenceSettings &inferSettings = {});
+
+        double getFrameLength() const;
+
+    private:
+        static constexpr size_t maxBatchSize = 8;
+
+        const DsVarianceConfig &m_config;
+        double m_frameLength;
+        LinguisticInference m_linguisticInference;
+        VarianceInference m_varianceInference;
+        PitchInference m_pitchInference;
+        std::unordered_map<uint64_t, std::shared_ptr<const LinguisticEncodedData>> m_encoderCache;
+
+        uint64_t encoderCacheKey(const LinguisticInput &input) const;
+
+        uint64_t pitchCacheKey(const LinguisticInput &linguisticInput,
+                               const PitchInput &pitchInput,
+                               const VarianceInferenceSettings &inferSettings) const;
+
+        /**
+         * @brief Splits `indices` into batches of at most `maxBatchSize`, grouping similar lengths.
+         */
+        static std::vector<std::vector<size_t>> makeBatches(std::vector<size_t> indices,
+                                                            const std::vector<DsSegment> &segments);
+    };  // class VariancePipeline
+
+}  // namespace diffsinger
+
+#endif //DS_ONNX_INFER_VARIANCEPIPELINE_H
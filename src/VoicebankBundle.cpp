@@ -0,0 +1,229 @@
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+#include "DsConfig.h"
+#include "VoicebankBundle.h"
+
+namespace diffsinger {
+
+    namespace {
+        constexpr char BUNDLE_MAGIC[8] = {'D', 'S', 'B', 'U', 'N', 'D', 'L', 'E'};
+        constexpr size_t BUNDLE_HEADER_SIZE = sizeof(BUNDLE_MAGIC) + 2 * sizeof(uint32_t);
+        constexpr size_t SECTION_ENTRY_SIZE = VoicebankBundle::SECTION_NAME_SIZE + 2 * sizeof(uint64_t);
+
+        struct PendingSection {
+            std::string name;
+            MappedBuffer data;
+        };
+
+        MappedBuffer stringToBuffer(std::string str) {
+            auto storage = std::make_shared<std::string>(std::move(str));
+            MappedBuffer buffer;
+            buffer.data = storage->data();
+            buffer.size = storage->size();
+            buffer.holder = std::move(storage);
+            return buffer;
+        }
+
+        bool addFileSection(std::vector<PendingSection> &sections, const char *name,
+                            const std::filesystem::path &path) {
+            auto file = MappedFile::open(path.native());
+            if (!file) {
+                std::cout << "ERROR: Could not open \"" << path.string() << "\" for bundle section " << name << ".\n";
+                return false;
+            }
+            sections.push_back({name, file->buffer()});
+            return true;
+        }
+
+        size_t alignUp(size_t value) {
+            constexpr auto alignment = VoicebankBundle::SECTION_ALIGNMENT;
+            return (value + alignment - 1) / alignment * alignment;
+        }
+    }
+
+    VoicebankBundle::VoicebankBundle() = default;
+
+    VoicebankBundle VoicebankBundle::open(const TString &bundlePath, bool *ok) {
+        auto fail = [ok]() {
+            if (ok) {
+                *ok = false;
+            }
+            return VoicebankBundle();
+        };
+
+        auto file = MappedFile::open(bundlePath);
+        if (!file || file->size() < BUNDLE_HEADER_SIZE) {
+            return fail();
+        }
+
+        auto data = file->data();
+        if (std::memcmp(data, BUNDLE_MAGIC, sizeof(BUNDLE_MAGIC)) != 0) {
+            return fail();
+        }
+        uint32_t version;
+        uint32_t sectionCount;
+        std::memcpy(&version, data + sizeof(BUNDLE_MAGIC), sizeof(version));
+        std::memcpy(&sectionCount, data + sizeof(BUNDLE_MAGIC) + sizeof(version), sizeof(sectionCount));
+        if (version != VERSION) {
+            std::cout << "ERROR: Unsupported bundle version " << version << " (expected " << VERSION << ").\n";
+            return fail();
+        }
+        if ((file->size() - BUNDLE_HEADER_SIZE) / SECTION_ENTRY_SIZE < sectionCount) {
+            return fail();
+        }
+
+        VoicebankBundle bundle;
+        bundle.m_sections.reserve(sectionCount);
+        for (uint32_t i = 0; i < sectionCount; ++i) {
+            auto entry = data + BUNDLE_HEADER_SIZE + i * SECTION_ENTRY_SIZE;
+            SectionEntry section;
+            section.name.assign(entry, strnlen(entry, SECTION_NAME_SIZE));
+            std::memcpy(&section.offset, entry + SECTION_NAME_SIZE, sizeof(section.offset));
+            std::memcpy(&section.size, entry + SECTION_NAME_SIZE + sizeof(section.offset), sizeof(section.size));
+            if (section.offset > file->size() || section.size > file->size() - section.offset) {
+                return fail();
+            }
+            bundle.m_sections.push_back(std::move(section));
+        }
+        bundle.m_path = bundlePath;
+        bundle.m_file = std::move(file);
+
+        if (ok) {
+            *ok = true;
+        }
+        return bundle;
+    }
+
+    bool VoicebankBundle::isBundleFile(const TString &path) {
+        std::ifstream fileStream(std::filesystem::path(path), std::ios::binary);
+        char magic[sizeof(BUNDLE_MAGIC)] = {};
+        if (!fileStream.read(magic, sizeof(magic))) {
+            return false;
+        }
+        return std::memcmp(magic, BUNDLE_MAGIC, sizeof(BUNDLE_MAGIC)) == 0;
+    }
+
+    bool VoicebankBundle::pack(const TString &acousticConfigPath,
+                               const TString &vocoderConfigPath,
+                               const TString &outputPath) {
+        bool ok = false;
+        auto dsConfig = DsConfig::fromYAML(acousticConfigPath, &ok);
+        if (!ok) {
+            std::cout << "ERROR: Could not open acoustic config.\n";
+            return false;
+        }
+        if (dsConfig.phonemeTable.empty()) {
+            std::cout << "ERROR: The acoustic config has no phonemes.\n";
+            return false;
+        }
+
+        std::vector<PendingSection> sections;
+        if (!addFileSection(sections, ACOUSTIC_CONFIG, acousticConfigPath)) {
+            return false;
+        }
+        sections.push_back({PHONEMES, dsConfig.phonemeTable.buffer()});
+
+        if (!dsConfig.speakers.empty()) {
+            std::string names;
+            std::string matrix;
+            for (const auto &speaker : dsConfig.speakers) {
+                if (!dsConfig.spkEmb.hasSpeaker(speaker)) {
+                    // loadSpeakers() already reported the error.
+                    continue;
+                }
+                auto emb = dsConfig.spkEmb.getMixedEmb({{speaker, 1.0}});
+                names.append(speaker).push_back('\n');
+                matrix.append(reinterpret_cast<const char *>(emb.data()), emb.size() * sizeof(float));
+            }
+            sections.push_back({SPEAKER_NAMES, stringToBuffer(std::move(names))});
+            sections.push_back({SPEAKER_EMBEDS, stringToBuffer(std::move(matrix))});
+        }
+
+        if (!addFileSection(sections, ACOUSTIC_MODEL, dsConfig.acoustic)) {
+            return false;
+        }
+        if (!dsConfig.denoiser.empty() && !addFileSection(sections, DENOISER_MODEL, dsConfig.denoiser)) {
+            return false;
+        }
+
+        if (!vocoderConfigPath.empty()) {
+            auto vocoderConfig = DsVocoderConfig::fromYAML(vocoderConfigPath, &ok);
+            if (!ok) {
+                std::cout << "ERROR: Could not open vocoder config.\n";
+                return false;
+            }
+            if (!addFileSection(sections, VOCODER_CONFIG, vocoderConfigPath)
+                || !addFileSection(sections, VOCODER_MODEL, vocoderConfig.model)) {
+                return false;
+            }
+        }
+
+        std::ofstream outFile(std::filesystem::path(outputPath), std::ios::binary);
+        if (!outFile.is_open()) {
+            std::cout << "ERROR: Could not open bundle file for writing.\n";
+            return false;
+        }
+
+        auto sectionCount = static_cast<uint32_t>(sections.size());
+        outFile.write(BUNDLE_MAGIC, sizeof(BUNDLE_MAGIC));
+        outFile.write(reinterpret_cast<const char *>(&VERSION), sizeof(VERSION));
+        outFile.write(reinterpret_cast<const char *>(&sectionCount), sizeof(sectionCount));
+
+        auto offset = alignUp(BUNDLE_HEADER_SIZE + sections.size() * SECTION_ENTRY_SIZE);
+        for (const auto &section : sections) {
+            char name[SECTION_NAME_SIZE] = {};
+            std::memcpy(name, section.name.data(), std::min(section.name.size(), SECTION_NAME_SIZE - 1));
+            uint64_t sectionOffset = offset;
+            uint64_t sectionSize = section.data.size;
+            outFile.write(name, sizeof(name));
+            outFile.write(reinterpret_cast<const char *>(&sectionOffset), sizeof(sectionOffset));
+            outFile.write(reinterpret_cast<const char *>(&sectionSize), sizeof(sectionSize));
+            offset = alignUp(offset + section.data.size);
+        }
+
+        const std::vector<char> padding(SECTION_ALIGNMENT, 0);
+        for (const auto &section : sections) {
+            auto position = static_cast<size_t>(outFile.tellp());
+            outFile.write(padding.data(), static_cast<std::streamsize>(alignUp(position) - position));
+            outFile.write(section.data.data, static_cast<std::streamsize>(section.data.size));
+        }
+
+        if (!outFile) {
+            std::cout << "ERROR: Failed to write bundle file.\n";
+            return false;
+        }
+        return true;
+    }
+
+    bool VoicebankBundle::isOpen() const {
+        return m_file != nullptr;
+    }
+
+    TString VoicebankBundle::getPath() const {
+        return m_path;
+    }
+
+    bool VoicebankBundle::hasSection(std::string_view name) const {
+        return std::any_of(m_sections.begin(), m_sections.end(),
+                           [name](const SectionEntry &section) { return section.name == name; });
+    }
+
+    MappedBuffer VoicebankBundle::section(std::string_view name) const {
+        for (const auto &section : m_sections) {
+            if (section.name == name) {
+                return m_file->slice(section.offset, section.size);
+            }
+        }
+        return {};
+    }
+
+    std::string VoicebankBundle::sectionString(std::string_view name) const {
+        auto buffer = section(name);
+        return {buffer.data, buffer.size};
+    }
+
+}  // namespace diffsinger
@@ -0,0 +1,99 @@
+#ifndef DS_ONNX_INFER_VOICEBANKBUNDLE_H
+#define DS_ONNX_INFER_VOICEBANKBUNDLE_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "TString.h"
+#include "MappedFile.h"
+
+namespace diffsinger {
+
+    /**
+     * @brief A single-file voicebank container which is memory-mapped and used in place.
+     *
+     * File layout (little endian):
+     *   char   magic[8] = "DSBUNDLE"
+     *   uint32 version
+     *   uint32 sectionCount
+     *   Section[sectionCount] { char name[48]; uint64 offset; uint64 size; }
+     *   section data, each section aligned to SECTION_ALIGNMENT bytes
+     *
+     * Known sections:
+     *   acoustic.yaml    acoustic dsconfig.yaml (paths in it are ignored)
+     *   phonemes.table   prebuilt PhonemeTable
+     *   speakers.names   speaker names, one per line, in matrix row order
+     *   speakers.emb     float matrix [speakers, SPK_EMBED_SIZE]
+     *   acoustic.onnx    acoustic model bytes (the encoder of split models)
+     *   denoiser.onnx    denoiser model bytes of split acoustic models (optional)
+     *   vocoder.yaml     vocoder.yaml (optional)
+     *   vocoder.onnx     vocoder model bytes (optional)
+     */
+    class VoicebankBundle {
+    public:
+        static constexpr uint32_t VERSION = 1;
+        static constexpr size_t SECTION_ALIGNMENT = 64;
+        static constexpr size_t SECTION_NAME_SIZE = 48;
+
+        static constexpr const char *ACOUSTIC_CONFIG = "acoustic.yaml";
+        static constexpr const char *PHONEMES = "phonemes.table";
+        static constexpr const char *SPEAKER_NAMES = "speakers.names";
+        static constexpr const char *SPEAKER_EMBEDS = "speakers.emb";
+        static constexpr const char *ACOUSTIC_MODEL = "acoustic.onnx";
+        static constexpr const char *DENOISER_MODEL = "denoiser.onnx";
+        static constexpr const char *VOCODER_CONFIG = "vocoder.yaml";
+        static constexpr const char *VOCODER_MODEL = "vocoder.onnx";
+
+        VoicebankBundle();
+
+        static VoicebankBundle open(const TString &bundlePath, bool *ok = nullptr);
+
+        /**
+         * @brief Checks the magic bytes of a file without mapping it.
+         */
+        static bool isBundleFile(const TString &path);
+
+        /**
+         * @brief Packs an acoustic voicebank (and optionally a vocoder) into a bundle file.
+         *
+         * @param acousticConfigPath  Path to acoustic dsconfig.yaml
+         * @param vocoderConfigPath   Path to vocoder.yaml. Can be empty.
+         * @param outputPath          Path to the bundle file to write.
+         * @return                    true on success.
+         */
+        static bool pack(const TString &acousticConfigPath,
+                         const TString &vocoderConfigPath,
+                         const TString &outputPath);
+
+        bool isOpen() const;
+
+        TString getPath() const;
+
+        bool hasSection(std::string_view name) const;
+
+        /**
+         * @brief Returns the bytes of a section (empty if it does not exist).
+         *        The returned buffer keeps the bundle mapping alive.
+         */
+        MappedBuffer section(std::string_view name) const;
+
+        std::string sectionString(std::string_view name) const;
+
+    private:
+        struct SectionEntry {
+            std::string name;
+            uint64_t offset;
+            uint64_t size;
+        };
+
+        TString m_path;
+        std::shared_ptr<MappedFile> m_file;
+        std::vector<SectionEntry> m_sections;
+    };  // class VoicebankBundle
+
+}  // namespace diffsinger
+
+#endif //DS_ONNX_INFER_VOICEBANKBUNDLE_H
@@ -1,71 +1,194 @@
 #include <iostream>
-#include <fstream>
 #include <sstream>
 #include <cctype>
-#include <filesystem>
-#include <chrono>
 #include <utility>
-
-#include <onnxruntime_cxx_api.h>
+#include <algorithm>
 
 #include <argparse/argparse.hpp>
 
-#include <sndfile.hh>
-
-#ifdef _WIN32
-#include <Windows.h>
-#endif
-
 #include "TString.h"
-#include "PowerManagement.h"
-#include "DsProject.h"
-#include "DsConfig.h"
-#include "Preprocess.h"
-#include "ModelData.h"
-#include "Inference/AcousticInference.h"
-#include "Inference/VocoderInference.h"
-
+#include "FileUtil.h"
+#include "VoicebankBundle.h"
+#include "Inference/Inference.h"
+#include "Inference/DiffusionSampler.h"
+#include "RenderCommon.h"
+#include "Render.h"
+#include "BatchRender.h"
+#include "Benchmark.h"
+#include "Autotune.h"
 
 namespace diffsinger {
-    void run(const TString &dsFilePath,
-             const TString &dsConfigPath,
-             const TString &vocoderConfigPath,
-             const TString &outputWavePath,
-             const std::string &spkMixStr = "",
-             int acousticSpeedup = 10,
-             int shallowDiffusionDepth = 1000,
-             ExecutionProvider ep = ExecutionProvider::CPU,
-             int deviceIndex = 0);
 
     ExecutionProvider parseEPFromString(const std::string &ep);
-    std::string millisecondsToSecondsString(long long milliseconds);
+    std::vector<int64_t> parseFrameBuckets(const std::string &str, bool *ok = nullptr);
+    std::vector<std::string> parseCommaList(const std::string &str);
+    std::vector<int> parsePositiveIntList(const std::string &str, bool *ok = nullptr);
+    std::vector<std::string> parseSpeakerMixList(const std::string &str);
+    bool parseTimeRange(const std::string &str, double &start, double &end);
+    std::vector<std::pair<size_t, size_t>> parseSegmentSelection(const std::string &str, bool *ok = nullptr);
 }
 
-#ifdef _WIN32
-using diffsinger::MBStringToWString;
-#endif
+using diffsinger::toTString;
 
 int main(int argc, char *argv[]) {
 
+    // The session arguments of the commands that run inference. Without `canDisableCache` (autotune), the cache
+    // directory is always used, as the tuning profile is saved there.
+    auto addSessionArguments = [](argparse::ArgumentParser &parser, bool canDisableCache) {
+        parser.add_argument("--ep").default_value("cpu").help(
+                "Execution Provider for audio inference. Supported: cpu (CPUExecutionProvider)"
+#ifdef ONNXRUNTIME_ENABLE_CUDA
+                ", cuda (CUDAExecutionProvider)"
+#endif
+#ifdef ONNXRUNTIME_ENABLE_DML
+                ", directml, dml (DmlExecutionProvider)"
+#endif
+                );
+        parser.add_argument("--device-index").scan<'i', int>().default_value(0).help("GPU device index");
+        if (canDisableCache) {
+            parser.add_argument("--cache-dir").default_value(diffsinger::defaultCacheDirectory().string())
+                    .help("Directory of cached optimized models");
+            parser.add_argument("--no-cache").default_value(false).implicit_value(true)
+                    .help("Do not use the optimized model cache");
+        } else {
+            parser.add_argument("--cache-dir").default_value(diffsinger::defaultCacheDirectory().string())
+                    .help("Directory of cached optimized models, where the profile is saved");
+        }
+    };
+
     argparse::ArgumentParser program("DiffSinger");
-    program.add_argument("--ds-file").required().help("Path to .ds file");
-    program.add_argument("--acoustic-config").required().help("Path to acoustic dsconfig.yaml");
-    program.add_argument("--vocoder-config").required().help("Path to vocoder.yaml");
+    program.add_argument("--ds-file").help("Path to .ds file [required]");
+    program.add_argument("--acoustic-config").help("Path to acoustic dsconfig.yaml [required unless --bundle is given]");
+    program.add_argument("--vocoder-config").help("Path to vocoder.yaml [required unless the bundle contains a vocoder]");
+    program.add_argument("--bundle").help("Path to a voicebank bundle created by the \"pack\" command. "
+                                          "Overrides --acoustic-config.");
+    program.add_argument("--dur-config")
+            .help("Path to duration dsconfig.yaml, used to predict ph_dur missing from the .ds file");
+    program.add_argument("--variance-config")
+            .help("Path to variance dsconfig.yaml, used to predict f0, energy and breathiness missing from the .ds file");
+    program.add_argument("--save-predictions").default_value(false).implicit_value(true)
+            .help("Write the parameters predicted by the duration and variance models back into the .ds file");
     program.add_argument("--spk").default_value(std::string())
             .help(R"(Speaker Mixture (e.g. "name" or "name1|name2" or "name1:0.25|name2:0.75"))");
-    program.add_argument("--out").required().help("Output Audio Filename (*.wav)");
+    program.add_argument("--spk-fanout")
+            .help(R"(Render one file per speaker mixture, separated by ";" (e.g. "alto;alto:0.5|tenor:0.5;tenor"). )"
+                  "Each file is named after --out with the mixture appended.");
+    program.add_argument("--out").help("Output Audio Filename (*.wav) [required]");
     program.add_argument("--speedup").scan<'i', int>().default_value(10).help("PNDM speedup ratio");
     program.add_argument("--depth").scan<'i', int>().default_value(1000).help("Shallow diffusion depth (needs acoustic model support)");
-    program.add_argument("--ep").default_value("cpu").help(
-            "Execution Provider for audio inference. Supported: cpu (CPUExecutionProvider)"
-#ifdef ONNXRUNTIME_ENABLE_CUDA
-            ", cuda (CUDAExecutionProvider)"
-#endif
-#ifdef ONNXRUNTIME_ENABLE_DML
-            ", directml, dml (DmlExecutionProvider)"
-#endif
-            );
-    program.add_argument("--device-index").scan<'i', int>().default_value(0).help("GPU device index");
+    program.add_argument("--sampler").default_value(std::string("pndm"))
+            .help("Diffusion sampler of split acoustic models (pndm/ddim)");
+    program.add_argument("--acoustic-batch").scan<'i', int>().default_value(4)
+            .help("Maximum number of segments denoised in one batch (split acoustic models only)");
+    program.add_argument("--vocoder-batch").scan<'i', int>().default_value(4)
+            .help("Maximum number of segments vocoded in one batch (vocoders with a dynamic batch axis only)");
+    addSessionArguments(program, true);
+    program.add_argument("--warmup-buckets").default_value(std::string())
+            .help("Comma-separated frame lengths to warm up the sessions with (e.g. \"256,512,1024\")");
+    program.add_argument("--pad-to-buckets").default_value(false).implicit_value(true)
+            .help("Pad each segment to the smallest warm-up bucket that fits it");
+    program.add_argument("--silence-phonemes").default_value(std::string("SP"))
+            .help("Comma-separated phonemes treated as silence (e.g. \"SP,AP\")");
+    program.add_argument("--no-silence-trim").default_value(false).implicit_value(true)
+            .help("Do not shorten silence at the edges of segments before inference");
+    program.add_argument("--split-long").scan<'g', double>().default_value(0.0)
+            .help("Split segments longer than this many seconds at rests, and crossfade the pieces (0 to disable)");
+    program.add_argument("--split-context").scan<'g', double>().default_value(0.25)
+            .help("Seconds rendered past each split point; pieces are crossfaded over twice this length");
+    program.add_argument("--coalesce-short").scan<'g', double>().default_value(0.0)
+            .help("Render adjacent segments shorter than this many seconds together in one pass (0 to disable)");
+    program.add_argument("--coalesce-gap").scan<'g', double>().default_value(1.0)
+            .help("Maximum gap in seconds between segments rendered together; the gap is filled with SP");
+    program.add_argument("--plan").default_value(false).implicit_value(true)
+            .help("Print the estimated time and memory of each segment without rendering (--out is not needed)");
+    program.add_argument("--range")
+            .help("Render only the segments overlapping this time range in seconds (start:end), "
+                  "and write only that range");
+    program.add_argument("--segments")
+            .help("Render only these segments, numbered from 1 in the .ds file (e.g. 3,5-8)");
+    program.add_argument("--incremental").default_value(false).implicit_value(true)
+            .help("Render again only the parts of segments changed since the last render (needs the cache)");
+    program.add_argument("--incremental-context").scan<'g', double>().default_value(0.5)
+            .help("Seconds rendered around each changed part, to crossfade it into the previous render");
+    program.add_argument("--draft-speedup").scan<'i', int>().default_value(0)
+            .help("Write a draft rendered with this speedup first, then refine it to the final quality "
+                  "(0 to disable)");
+    program.add_argument("--draft-depth").scan<'i', int>()
+            .help("Shallow diffusion depth of the draft (default: same as --depth)");
+    program.add_argument("--deadline").scan<'g', double>().default_value(0.0)
+            .help("Render the project within this many seconds, lowering the quality of some segments if needed "
+                  "(0 to disable)");
+    program.add_argument("--shared-threads").default_value(false).implicit_value(true)
+            .help("Split the cores between the workers and one thread pool of all sessions");
+    program.add_argument("--watch").default_value(false).implicit_value(true)
+            .help("Keep the models loaded, and render the changed parts again whenever the .ds file is saved");
+
+    argparse::ArgumentParser packCommand("pack");
+    packCommand.add_description("Pack an acoustic voicebank (and optionally a vocoder) into a single bundle file, "
+                                "which is memory-mapped and used in place at startup.");
+    packCommand.add_argument("--acoustic-config").required().help("Path to acoustic dsconfig.yaml");
+    packCommand.add_argument("--vocoder-config").default_value(std::string()).help("Path to vocoder.yaml (optional)");
+    packCommand.add_argument("--out").required().help("Output bundle filename");
+    program.add_subparser(packCommand);
+
+    argparse::ArgumentParser precompileCommand("precompile");
+    precompileCommand.add_description("Optimize the acoustic and vocoder models and save them to the cache directory, "
+                                      "so that later runs start faster.");
+    precompileCommand.add_argument("--acoustic-config").help("Path to acoustic dsconfig.yaml");
+    precompileCommand.add_argument("--vocoder-config").help("Path to vocoder.yaml");
+    precompileCommand.add_argument("--bundle").help("Path to a voicebank bundle. Overrides --acoustic-config.");
+    precompileCommand.add_argument("--cache-dir").default_value(diffsinger::defaultCacheDirectory().string())
+            .help("Directory of cached optimized models");
+    program.add_subparser(precompileCommand);
+
+    argparse::ArgumentParser batchCommand("batch");
+    batchCommand.add_description("Render the projects listed in a JSON manifest. Each voicebank is loaded once, "
+                                 "and the segments of all projects are spread over a pool of worker threads.");
+    batchCommand.add_argument("--manifest").required().help("Path to the batch manifest (JSON)");
+    batchCommand.add_argument("--workers").scan<'i', int>().default_value(0)
+            .help("Number of worker threads (0 for one per hardware thread)");
+    addSessionArguments(batchCommand, true);
+    batchCommand.add_argument("--shared-threads").default_value(false).implicit_value(true)
+            .help("Split the cores between the workers and one thread pool of all sessions");
+    program.add_subparser(batchCommand);
+
+    argparse::ArgumentParser benchCommand("bench");
+    benchCommand.add_description("Render a project with a grid of speedups and depths, and report the real-time "
+                                 "factor and the distance to a reference render of each.");
+    benchCommand.add_argument("--ds-file").required().help("Path to .ds file (with durations and pitch)");
+    benchCommand.add_argument("--acoustic-config").help("Path to acoustic dsconfig.yaml");
+    benchCommand.add_argument("--vocoder-config").help("Path to vocoder.yaml");
+    benchCommand.add_argument("--bundle").help("Path to a voicebank bundle. Overrides --acoustic-config.");
+    benchCommand.add_argument("--spk").default_value(std::string())
+            .help(R"(Speaker Mixture (e.g. "name" or "name1|name2" or "name1:0.25|name2:0.75"))");
+    benchCommand.add_argument("--speedups").default_value(std::string("2,5,10,20,50,100"))
+            .help("Comma-separated speedups to measure");
+    benchCommand.add_argument("--depths").default_value(std::string())
+            .help("Comma-separated shallow diffusion depths to measure (default: the maximum depth)");
+    benchCommand.add_argument("--reference-speedup").scan<'i', int>().default_value(1)
+            .help("Speedup of the reference render");
+    benchCommand.add_argument("--max-distance").scan<'g', double>().default_value(0.0)
+            .help("Recommend the cheapest setting within this log-spectral distance (dB) of the reference");
+    addSessionArguments(benchCommand, true);
+    program.add_subparser(benchCommand);
+
+    argparse::ArgumentParser autotuneCommand("autotune");
+    autotuneCommand.add_description("Find the fastest session threads, execution modes and batch workers for a "
+                                    "voicebank on this machine. Later runs load the profile from the cache "
+                                    "directory.");
+    autotuneCommand.add_argument("--ds-file").required()
+            .help("Path to a representative .ds file (with durations and pitch)");
+    autotuneCommand.add_argument("--acoustic-config").help("Path to acoustic dsconfig.yaml");
+    autotuneCommand.add_argument("--vocoder-config").help("Path to vocoder.yaml");
+    autotuneCommand.add_argument("--bundle").help("Path to a voicebank bundle. Overrides --acoustic-config.");
+    autotuneCommand.add_argument("--spk").default_value(std::string())
+            .help(R"(Speaker Mixture (e.g. "name" or "name1|name2" or "name1:0.25|name2:0.75"))");
+    autotuneCommand.add_argument("--speedup").scan<'i', int>().default_value(10).help("PNDM speedup ratio");
+    autotuneCommand.add_argument("--depth").scan<'i', int>().default_value(1000).help("Shallow diffusion depth");
+    autotuneCommand.add_argument("--sample-jobs").scan<'i', int>().default_value(8)
+            .help("Number of jobs of the project rendered by each candidate");
+    addSessionArguments(autotuneCommand, false);
+    program.add_subparser(autotuneCommand);
 
     try {
         program.parse_args(argc, argv);
@@ -75,187 +198,275 @@ int main(int argc, char *argv[]) {
         std::exit(1);
     }
 
-    auto dsPath = program.get("--ds-file");
-    auto dsConfigPath = program.get("--acoustic-config");
-    auto vocoderConfigPath = program.get("--vocoder-config");
-    auto spkMixStr = program.get("--spk");
-    auto outputAudioTitle = program.get("--out");
-    auto speedup = program.get<int>("--speedup");
-    auto depth = program.get<int>("--depth");
-    auto ep = program.get("--ep");
-    auto deviceIndex = program.get<int>("--device-index");
-
-    auto epEnum = diffsinger::parseEPFromString(ep);
-
-#ifdef _WIN32
-    auto currentCodePage = ::GetACP();
-    diffsinger::run(MBStringToWString(dsPath, currentCodePage),
-                    MBStringToWString(dsConfigPath, currentCodePage),
-                    MBStringToWString(vocoderConfigPath, currentCodePage),
-                    MBStringToWString(outputAudioTitle, currentCodePage),
-                    spkMixStr,
-                    speedup,
-                    depth,
-                    epEnum,
-                    deviceIndex);
-#else
-    diffsinger::run(dsPath, dsConfigPath, vocoderConfigPath, outputAudioTitle, spkMixStr, speedup, depth, epEnum, deviceIndex);
-#endif
-
-    return 0;
-}
-
-
-namespace diffsinger {
-    void run(const TString &dsFilePath,
-             const TString &dsConfigPath,
-             const TString &vocoderConfigPath,
-             const TString &outputWavePath,
-             const std::string &spkMixStr,
-             int acousticSpeedup,
-             int shallowDiffusionDepth,
-             ExecutionProvider ep,
-             int deviceIndex) {
-
-        // Disable sleep mode
-        keepSystemAwake();
-
-        // Get the available providers
-        auto availableProviders = Ort::GetAvailableProviders();
-
-        // Print the available providers
-        std::cout << "Available Providers:" << std::endl;
-        for (const auto &provider: availableProviders) {
-            std::cout << '-' << ' ' << provider << std::endl;
+    if (program.is_subcommand_used(packCommand)) {
+        bool ok = diffsinger::VoicebankBundle::pack(toTString(packCommand.get("--acoustic-config")),
+                                                    toTString(packCommand.get("--vocoder-config")),
+                                                    toTString(packCommand.get("--out")));
+        if (!ok) {
+            std::cout << "!! ERROR: Failed to pack voicebank bundle.\n";
+            return 1;
         }
+        std::cout << "Successfully packed voicebank bundle.\n";
+        return 0;
+    }
 
-        auto dsConfig = DsConfig::fromYAML(dsConfigPath);
-
-        if (acousticSpeedup < 1 || acousticSpeedup > 1000) {
-            std::cout << "!! WARNING: speedup must be in range [1, 1000]. Falling back to 10.\n";
-            acousticSpeedup = 10;
+    // These are only required in some cases, so they cannot be marked as required in argparse
+    // (which would also require them for subcommands).
+    auto requireArgument = [](const argparse::ArgumentParser &parser, const char *name) {
+        auto value = parser.present(name);
+        if (!value) {
+            std::cerr << name << ": required." << std::endl;
+            std::cerr << parser;
+            std::exit(1);
         }
-
-        if (dsConfig.useShallowDiffusion) {
-            if (dsConfig.maxDepth < 0) {
-                std::cout << "!! ERROR: max_depth is unset or negative in acoustic configuration.\n";
-                return;
-            }
-            if (shallowDiffusionDepth > dsConfig.maxDepth) {
-                shallowDiffusionDepth = dsConfig.maxDepth;
-            }
-            // make sure depth can be divided by speedup
-            shallowDiffusionDepth = shallowDiffusionDepth / acousticSpeedup * acousticSpeedup;
+        return *value;
+    };
+
+    auto loadVoicebankArguments = [&requireArgument](const argparse::ArgumentParser &parser,
+                                                     diffsinger::RenderSettings &settings) {
+        if (auto bundlePath = parser.present("--bundle")) {
+            settings.bundlePath = toTString(*bundlePath);
+        } else {
+            settings.dsConfigPath = toTString(requireArgument(parser, "--acoustic-config"));
         }
-
-        std::unordered_map<std::string, int64_t> name2token;
-        std::string line;
-        std::ifstream phonemesFile(dsConfig.phonemes);
-
-        int64_t token = 0;
-        while (std::getline(phonemesFile, line)) {
-            // handle CRLF line endings on Linux and macOS
-            if (!line.empty() && line[line.size() - 1] == '\r')
-                line.erase(line.size() - 1);
-
-            name2token.emplace(line, token);
-            ++token;
+        if (auto vocoderConfigPath = parser.present("--vocoder-config")) {
+            settings.vocoderConfigPath = toTString(*vocoderConfigPath);
+        }
+    };
+
+    auto loadSessionArguments = [](const argparse::ArgumentParser &parser, bool canDisableCache,
+                                   diffsinger::RenderSettings &settings) {
+        settings.ep = diffsinger::parseEPFromString(parser.get("--ep"));
+        settings.deviceIndex = parser.get<int>("--device-index");
+        if (!canDisableCache || !parser.get<bool>("--no-cache")) {
+            settings.sessionConfig.cacheDirectory = toTString(parser.get("--cache-dir"));
         }
-        phonemesFile.close();
+    };
 
-        auto vocoderConfig = DsVocoderConfig::fromYAML(vocoderConfigPath);
-        int sampleRate = vocoderConfig.sampleRate;
-        int hopSize = vocoderConfig.hopSize;
-        double frameLength = 1.0 * hopSize / sampleRate;
+    diffsinger::RenderSettings settings;
 
-        auto dsProject = loadDsProject(dsFilePath, spkMixStr);
-        size_t numSegments = dsProject.size();
+    if (program.is_subcommand_used(precompileCommand)) {
+        loadVoicebankArguments(precompileCommand, settings);
+        settings.sessionConfig.cacheDirectory = toTString(precompileCommand.get("--cache-dir"));
+        if (!diffsinger::precompile(settings)) {
+            return 1;
+        }
+        std::cout << "Successfully precompiled models.\n";
+        return 0;
+    }
 
-        std::cout << '\n';
-        std::cout << "Initializing acoustic inference session...\n";
-        AcousticInference acousticInference(dsConfig.acoustic);
+    if (program.is_subcommand_used(batchCommand)) {
+        loadSessionArguments(batchCommand, true, settings);
+        settings.sharedThreads = batchCommand.get<bool>("--shared-threads");
+        auto numWorkers = batchCommand.get<int>("--workers");
+        if (numWorkers < 0) {
+            std::cerr << "--workers: must not be negative." << std::endl;
+            std::exit(1);
+        }
+        if (!diffsinger::renderBatch(settings, toTString(batchCommand.get("--manifest")), numWorkers)) {
+            return 1;
+        }
+        return 0;
+    }
 
-        bool isAcousticSessionInitOk = acousticInference.initSession(ep, deviceIndex);
-        if (!isAcousticSessionInitOk) {
-            std::cout << "!! ERROR: Acoustic Session initialization failed.\n";
-            return;
+    if (program.is_subcommand_used(benchCommand)) {
+        settings.dsFilePath = toTString(benchCommand.get("--ds-file"));
+        loadVoicebankArguments(benchCommand, settings);
+        settings.spkMixStr = benchCommand.get("--spk");
+        loadSessionArguments(benchCommand, true, settings);
+        diffsinger::BenchmarkOptions options;
+        bool isSpeedupsOk = false;
+        options.speedups = diffsinger::parsePositiveIntList(benchCommand.get("--speedups"), &isSpeedupsOk);
+        if (!isSpeedupsOk || options.speedups.empty()) {
+            std::cerr << "--speedups: must be a comma-separated list of positive integers." << std::endl;
+            std::exit(1);
         }
-        std::cout << "Successfully created acoustic inference session.\n";
-        acousticInference.printModelFeatures();
+        bool isDepthsOk = false;
+        options.depths = diffsinger::parsePositiveIntList(benchCommand.get("--depths"), &isDepthsOk);
+        if (!isDepthsOk) {
+            std::cerr << "--depths: must be a comma-separated list of positive integers." << std::endl;
+            std::exit(1);
+        }
+        options.referenceSpeedup = benchCommand.get<int>("--reference-speedup");
+        options.maxDistance = benchCommand.get<double>("--max-distance");
+        if (options.maxDistance < 0) {
+            std::cerr << "--max-distance: must not be negative." << std::endl;
+            std::exit(1);
+        }
+        if (!diffsinger::benchmarkDiffusionSettings(settings, options)) {
+            return 1;
+        }
+        return 0;
+    }
 
-        std::cout << '\n';
-        std::cout << "Initializing vocoder inference session...\n";
-        VocoderInference vocoderInference(vocoderConfig.model);
+    if (program.is_subcommand_used(autotuneCommand)) {
+        settings.dsFilePath = toTString(autotuneCommand.get("--ds-file"));
+        loadVoicebankArguments(autotuneCommand, settings);
+        settings.spkMixStr = autotuneCommand.get("--spk");
+        settings.acousticSpeedup = autotuneCommand.get<int>("--speedup");
+        settings.shallowDiffusionDepth = autotuneCommand.get<int>("--depth");
+        loadSessionArguments(autotuneCommand, false, settings);
+        auto numSampleJobs = autotuneCommand.get<int>("--sample-jobs");
+        if (numSampleJobs < 1) {
+            std::cerr << "--sample-jobs: must be at least 1." << std::endl;
+            std::exit(1);
+        }
+        if (!diffsinger::autotuneSessions(settings, numSampleJobs)) {
+            return 1;
+        }
+        return 0;
+    }
 
-        bool isVocoderSessionInitOk = vocoderInference.initSession(ExecutionProvider::CPU, 0);
-        if (!isVocoderSessionInitOk) {
-            std::cout << "!! ERROR: Vocoder Session initialization failed.\n";
-            return;
+    settings.dsFilePath = toTString(requireArgument(program, "--ds-file"));
+    settings.planOnly = program.get<bool>("--plan");
+    if (!settings.planOnly) {
+        settings.outputWavePath = toTString(requireArgument(program, "--out"));
+    }
+    loadVoicebankArguments(program, settings);
+    if (auto durConfigPath = program.present("--dur-config")) {
+        settings.durConfigPath = toTString(*durConfigPath);
+    }
+    if (auto varianceConfigPath = program.present("--variance-config")) {
+        settings.varianceConfigPath = toTString(*varianceConfigPath);
+    }
+    settings.savePredictions = program.get<bool>("--save-predictions");
+    settings.spkMixStr = program.get("--spk");
+    if (auto spkMixFanout = program.present("--spk-fanout")) {
+        if (!settings.spkMixStr.empty()) {
+            std::cerr << "--spk-fanout: cannot be used together with --spk." << std::endl;
+            std::exit(1);
         }
-        std::cout << "Successfully created vocoder inference session.\n";
-        std::cout << '\n';
+        settings.spkMixFanout = diffsinger::parseSpeakerMixList(*spkMixFanout);
+        if (settings.spkMixFanout.empty()) {
+            std::cerr << "--spk-fanout: no speaker mixture given." << std::endl;
+            std::exit(1);
+        }
+    }
+    settings.acousticSpeedup = program.get<int>("--speedup");
+    settings.shallowDiffusionDepth = program.get<int>("--depth");
+    bool isSamplerOk = false;
+    settings.sampler = diffsinger::parseSamplerFromString(program.get("--sampler"), &isSamplerOk);
+    if (!isSamplerOk) {
+        std::cerr << "--sampler: must be pndm or ddim." << std::endl;
+        std::exit(1);
+    }
+    settings.acousticBatchSize = program.get<int>("--acoustic-batch");
+    if (settings.acousticBatchSize < 1) {
+        std::cerr << "--acoustic-batch: must be at least 1." << std::endl;
+        std::exit(1);
+    }
+    settings.vocoderBatchSize = program.get<int>("--vocoder-batch");
+    if (settings.vocoderBatchSize < 1) {
+        std::cerr << "--vocoder-batch: must be at least 1." << std::endl;
+        std::exit(1);
+    }
+    loadSessionArguments(program, true, settings);
+    bool isBucketsOk = false;
+    settings.sessionConfig.warmupFrameBuckets = diffsinger::parseFrameBuckets(program.get("--warmup-buckets"),
+                                                                              &isBucketsOk);
+    if (!isBucketsOk) {
+        std::cerr << "--warmup-buckets: invalid frame lengths." << std::endl;
+        std::exit(1);
+    }
+    settings.padToBuckets = program.get<bool>("--pad-to-buckets");
+    if (settings.padToBuckets && settings.sessionConfig.warmupFrameBuckets.empty()) {
+        std::cerr << "--pad-to-buckets: requires --warmup-buckets." << std::endl;
+        std::exit(1);
+    }
 
-        std::vector< std::pair<int64_t, std::vector<float>> > waveformArr{};
-        waveformArr.reserve(numSegments);
+    settings.silencePhonemes = diffsinger::parseCommaList(program.get("--silence-phonemes"));
+    settings.trimSilence = !program.get<bool>("--no-silence-trim");
+    settings.renderPlanOptions.maxSegmentLength = program.get<double>("--split-long");
+    settings.renderPlanOptions.splitContext = program.get<double>("--split-context");
+    if (settings.renderPlanOptions.maxSegmentLength > 0
+        && settings.renderPlanOptions.maxSegmentLength <= 4 * settings.renderPlanOptions.splitContext) {
+        std::cerr << "--split-long: must be longer than 4 times --split-context." << std::endl;
+        std::exit(1);
+    }
+    settings.renderPlanOptions.coalesceShorterThan = program.get<double>("--coalesce-short");
+    settings.renderPlanOptions.coalesceMaxGap = program.get<double>("--coalesce-gap");
+    if (settings.renderPlanOptions.coalesceMaxGap < 0) {
+        std::cerr << "--coalesce-gap: must not be negative." << std::endl;
+        std::exit(1);
+    }
+    if (auto range = program.present("--range")) {
+        if (!diffsinger::parseTimeRange(*range, settings.rangeStart, settings.rangeEnd)) {
+            std::cerr << "--range: must be start:end in seconds, with start before end." << std::endl;
+            std::exit(1);
+        }
+    }
+    settings.incremental = program.get<bool>("--incremental");
+    settings.watch = program.get<bool>("--watch");
+    settings.sharedThreads = program.get<bool>("--shared-threads");
+    settings.deadline = program.get<double>("--deadline");
+    if (settings.deadline < 0) {
+        std::cerr << "--deadline: must not be negative." << std::endl;
+        std::exit(1);
+    }
+    settings.draftSpeedup = program.get<int>("--draft-speedup");
+    if (settings.draftSpeedup < 0) {
+        std::cerr << "--draft-speedup: must not be negative." << std::endl;
+        std::exit(1);
+    }
+    if (auto draftDepth = program.present<int>("--draft-depth")) {
+        settings.draftDepth = *draftDepth;
+    }
+    settings.incrementalContext = program.get<double>("--incremental-context");
+    if (settings.incrementalContext <= 0) {
+        std::cerr << "--incremental-context: must be positive." << std::endl;
+        std::exit(1);
+    }
+    if (auto segments = program.present("--segments")) {
+        bool isSelectionOk = false;
+        settings.segmentSelection = diffsinger::parseSegmentSelection(*segments, &isSelectionOk);
+        if (!isSelectionOk || settings.segmentSelection.empty()) {
+            std::cerr << "--segments: invalid segment numbers." << std::endl;
+            std::exit(1);
+        }
+    }
 
-        AcousticInferenceSettings inferSettings{};
-        inferSettings.speedup = acousticSpeedup;
-        inferSettings.depth = shallowDiffusionDepth;
+    if (settings.planOnly) {
+        return diffsinger::printRenderPlan(settings) ? 0 : 1;
+    }
 
-        for (size_t i = 0; i < numSegments; i++) {
-            std::cout << i + 1 << " of " << numSegments << "\n";
-            auto timeStart = std::chrono::steady_clock::now();
-            std::cout << ">> Preprocessing input" << "\n";
-            auto offsetInSamples = static_cast<int64_t>(std::ceil(dsProject[i].offset * vocoderConfig.sampleRate));
+    diffsinger::run(settings);
 
-            auto pd = acousticPreprocess(name2token, dsProject[i], dsConfig, frameLength);
+    return 0;
+}
 
-            std::cout << ">> Acoustic infer -> Mel" << "\n";
-            auto mel = acousticInference.inferToOrtValue(pd, inferSettings);
 
-            if (mel == Ort::Value(nullptr)) {
-                std::cout << "!! ERROR: Acoustic Infer failed.\n";
-                waveformArr.emplace_back(offsetInSamples, std::vector<float>{});
+namespace diffsinger {
+    std::vector<int64_t> parseFrameBuckets(const std::string &str, bool *ok) {
+        std::vector<int64_t> buckets;
+        std::istringstream iss(str);
+        std::string item;
+        while (std::getline(iss, item, ',')) {
+            if (item.empty()) {
                 continue;
             }
-            // mel will be `std::move`d in the next steps, so it will not be usable after that.
-            std::cout << ">> Vocoder infer -> Waveform" << "\n";
-            auto waveform = vocoderInference.infer(mel, pd.f0);
-
-            waveformArr.emplace_back(offsetInSamples, std::move(waveform));
-            auto timeEnd = std::chrono::steady_clock::now();
-            auto timeSpent = std::chrono::duration_cast<std::chrono::milliseconds>(timeEnd - timeStart).count();
-            std::cout << ">> Time Elapsed: " << millisecondsToSecondsString(timeSpent) << " seconds\n";
-        }
-
-        std::cout << "Inference finished.\n";
-        std::cout << ">> Concatenating and saving wave file...\n";
-        int64_t totalSamples = 0;
-        for (const auto& [offsetInSamples, waveform] : waveformArr) {
-            auto currentSamples = offsetInSamples + static_cast<int64_t>(waveform.size());
-            totalSamples = (totalSamples < currentSamples) ? currentSamples : totalSamples;
-        }
-        std::vector<float> wavBuffer(totalSamples, 0.0f);
-        for (const auto& [offsetInSamples, waveform] : waveformArr) {
-            auto currentSamples = offsetInSamples + static_cast<int64_t>(waveform.size());
-            std::transform(
-                wavBuffer.begin() + offsetInSamples,
-                wavBuffer.begin() + currentSamples,
-                waveform.begin(),
-                wavBuffer.begin() + offsetInSamples,
-                std::plus<>()
-            );
-        }
-
-        SndfileHandle audioFile(outputWavePath.c_str(), SFM_WRITE, SF_FORMAT_WAV | SF_FORMAT_FLOAT, 1, sampleRate);
-        auto numFrames = static_cast<sf_count_t>(wavBuffer.size());
-        auto numWritten = audioFile.write(wavBuffer.data(), numFrames);
-        if ((audioFile.error() != SF_ERR_NO_ERROR) || (numWritten == 0)) {
-            std::cout << "!! ERROR: audio write failed. Reason: " << audioFile.strError() << '\n';
-        }
-
-        // Allow system sleep
-        restorePowerState();
+            try {
+                size_t pos = 0;
+                auto frames = std::stoll(item, &pos);
+                if (pos != item.size() || frames <= 0) {
+                    if (ok) {
+                        *ok = false;
+                    }
+                    return {};
+                }
+                buckets.push_back(frames);
+            } catch (const std::exception &) {
+                if (ok) {
+                    *ok = false;
+                }
+                return {};
+            }
+        }
+        std::sort(buckets.begin(), buckets.end());
+        buckets.erase(std::unique(buckets.begin(), buckets.end()), buckets.end());
+        if (ok) {
+            *ok = true;
+        }
+        return buckets;
     }
 
     ExecutionProvider parseEPFromString(const std::string &ep) {
@@ -271,21 +482,125 @@ namespace diffsinger {
         return ExecutionProvider::CPU;
     }
 
-    std::string millisecondsToSecondsString(long long milliseconds) {
-        auto integerPart = milliseconds / 1000;
-        auto decimalPart = milliseconds % 1000;
-        std::stringstream ss;
-        ss << integerPart << '.';
-        if (decimalPart < 100) {
-            ss << '0';
+    std::vector<std::string> parseCommaList(const std::string &str) {
+        std::vector<std::string> items;
+        std::istringstream iss(str);
+        std::string item;
+        while (std::getline(iss, item, ',')) {
+            if (!item.empty()) {
+                items.push_back(item);
+            }
+        }
+        return items;
+    }
+
+    std::vector<int> parsePositiveIntList(const std::string &str, bool *ok) {
+        std::vector<int> values;
+        for (const auto &item : parseCommaList(str)) {
+            try {
+                size_t pos = 0;
+                auto value = std::stoi(item, &pos);
+                if (pos != item.size() || value <= 0) {
+                    if (ok) {
+                        *ok = false;
+                    }
+                    return {};
+                }
+                values.push_back(value);
+            } catch (const std::exception &) {
+                if (ok) {
+                    *ok = false;
+                }
+                return {};
+            }
         }
-        if (decimalPart < 10) {
-            ss << '0';
+        if (ok) {
+            *ok = true;
         }
-        if (decimalPart == 0) {
-            ss << '0';
+        return values;
+    }
+
+    std::vector<std::string> parseSpeakerMixList(const std::string &str) {
+        std::vector<std::string> items;
+        std::istringstream iss(str);
+        std::string item;
+        while (std::getline(iss, item, ';')) {
+            if (!item.empty()) {
+                items.push_back(item);
+            }
         }
-        ss << decimalPart;
-        return ss.str();
+        return items;
     }
+
+    bool parseTimeRange(const std::string &str, double &start, double &end) {
+        auto separator = str.find(':');
+        if (separator == std::string::npos) {
+            return false;
+        }
+        try {
+            size_t startPos = 0;
+            size_t endPos = 0;
+            auto startStr = str.substr(0, separator);
+            auto endStr = str.substr(separator + 1);
+            auto startValue = std::stod(startStr, &startPos);
+            auto endValue = std::stod(endStr, &endPos);
+            if (startPos != startStr.size() || endPos != endStr.size() || startValue < 0 || endValue <= startValue) {
+                return false;
+            }
+            start = startValue;
+            end = endValue;
+            return true;
+        } catch (const std::exception &) {
+            return false;
+        }
+    }
+
+    std::vector<std::pair<size_t, size_t>> parseSegmentSelection(const std::string &str, bool *ok) {
+        // Numbers from 1, and ranges "first-last". Returns ranges of indices from 0, which are not expanded, as they
+        // are only checked against the segment count of the project later.
+        std::vector<std::pair<size_t, size_t>> segments;
+        std::istringstream iss(str);
+        std::string item;
+        while (std::getline(iss, item, ',')) {
+            if (item.empty()) {
+                continue;
+            }
+            try {
+                auto dash = item.find('-');
+                auto firstStr = item.substr(0, dash);
+                auto lastStr = (dash == std::string::npos) ? firstStr : item.substr(dash + 1);
+                size_t firstPos = 0;
+                size_t lastPos = 0;
+                auto first = std::stoll(firstStr, &firstPos);
+                auto last = std::stoll(lastStr, &lastPos);
+                if (firstPos != firstStr.size() || lastPos != lastStr.size() || first < 1 || last < first) {
+                    if (ok) {
+                        *ok = false;
+                    }
+                    return {};
+                }
+                segments.emplace_back(static_cast<size_t>(first - 1), static_cast<size_t>(last - 1));
+            } catch (const std::exception &) {
+                if (ok) {
+                    *ok = false;
+                }
+                return {};
+            }
+        }
+        // Merge the overlapping and adjacent ranges.
+        std::sort(segments.begin(), segments.end());
+        std::vector<std::pair<size_t, size_t>> merged;
+        for (const auto &range : segments) {
+            if (!merged.empty() && range.first <= merged.back().second + 1) {
+                merged.back().second = std::max(merged.back().second, range.second);
+            } else {
+                merged.push_back(range);
+            }
+        }
+        if (ok) {
+            *ok = true;
+        }
+        return merged;
+    }
+
 }